@@ -0,0 +1,219 @@
+/*
+ * CRC32 and CRC32C shash drivers using the NEON folding from
+ * arch/arm/lib/crc32-neon.c.
+ *
+ * The library crc32_le()/__crc32c_le() use the same code by default;
+ * these drivers call it directly, so they keep using NEON even when
+ * that is turned off for the library (crc32_neon.lib=0), which lets
+ * tcrypt compare the two.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <crypto/internal/hash.h>
+
+#include <asm/crc32.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+static u32 crc32_neon_le(u32 crc, const u8 *p, unsigned int len)
+{
+	u8 folded[16];
+	size_t n = crc32_le_neon_fold(crc, p, len, folded);
+
+	if (n)
+		crc = crc32_le(0, folded, sizeof(folded));
+	return crc32_le(crc, p + n, len - n);
+}
+
+static u32 crc32c_neon_le(u32 crc, const u8 *p, unsigned int len)
+{
+	u8 folded[16];
+	size_t n = crc32c_le_neon_fold(crc, p, len, folded);
+
+	if (n)
+		crc = __crc32c_le(0, folded, sizeof(folded));
+	return __crc32c_le(crc, p + n, len - n);
+}
+
+static int crc32_neon_cra_init(struct crypto_tfm *tfm)
+{
+	u32 *key = crypto_tfm_ctx(tfm);
+
+	*key = 0;
+	return 0;
+}
+
+static int crc32c_neon_cra_init(struct crypto_tfm *tfm)
+{
+	u32 *key = crypto_tfm_ctx(tfm);
+
+	*key = ~0;
+	return 0;
+}
+
+static int crc32_neon_setkey(struct crypto_shash *hash, const u8 *key,
+			     unsigned int keylen)
+{
+	u32 *mctx = crypto_shash_ctx(hash);
+
+	if (keylen != sizeof(u32)) {
+		crypto_shash_set_flags(hash, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	*mctx = le32_to_cpup((__le32 *)key);
+	return 0;
+}
+
+static int crc32_neon_init(struct shash_desc *desc)
+{
+	u32 *mctx = crypto_shash_ctx(desc->tfm);
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*crcp = *mctx;
+	return 0;
+}
+
+static int crc32_neon_update(struct shash_desc *desc, const u8 *data,
+			     unsigned int len)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*crcp = crc32_neon_le(*crcp, data, len);
+	return 0;
+}
+
+static int crc32c_neon_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int len)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*crcp = crc32c_neon_le(*crcp, data, len);
+	return 0;
+}
+
+/* No final XOR 0xFFFFFFFF, like crc32_le */
+static int crc32_neon_final(struct shash_desc *desc, u8 *out)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*(__le32 *)out = cpu_to_le32p(crcp);
+	return 0;
+}
+
+static int crc32c_neon_final(struct shash_desc *desc, u8 *out)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32p(crcp);
+	return 0;
+}
+
+static int crc32_neon_finup(struct shash_desc *desc, const u8 *data,
+			    unsigned int len, u8 *out)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*(__le32 *)out = cpu_to_le32(crc32_neon_le(*crcp, data, len));
+	return 0;
+}
+
+static int crc32c_neon_finup(struct shash_desc *desc, const u8 *data,
+			     unsigned int len, u8 *out)
+{
+	u32 *crcp = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32(crc32c_neon_le(*crcp, data, len));
+	return 0;
+}
+
+static int crc32_neon_digest(struct shash_desc *desc, const u8 *data,
+			     unsigned int len, u8 *out)
+{
+	u32 *mctx = crypto_shash_ctx(desc->tfm);
+
+	*(__le32 *)out = cpu_to_le32(crc32_neon_le(*mctx, data, len));
+	return 0;
+}
+
+static int crc32c_neon_digest(struct shash_desc *desc, const u8 *data,
+			      unsigned int len, u8 *out)
+{
+	u32 *mctx = crypto_shash_ctx(desc->tfm);
+
+	*(__le32 *)out = ~cpu_to_le32(crc32c_neon_le(*mctx, data, len));
+	return 0;
+}
+
+static struct shash_alg crc32_neon_algs[] = { {
+	.setkey		= crc32_neon_setkey,
+	.init		= crc32_neon_init,
+	.update		= crc32_neon_update,
+	.final		= crc32_neon_final,
+	.finup		= crc32_neon_finup,
+	.digest		= crc32_neon_digest,
+	.descsize	= sizeof(u32),
+	.digestsize	= CHKSUM_DIGEST_SIZE,
+	.base		= {
+		.cra_name		= "crc32",
+		.cra_driver_name	= "crc32-neon",
+		.cra_priority		= 200,
+		.cra_blocksize		= CHKSUM_BLOCK_SIZE,
+		.cra_ctxsize		= sizeof(u32),
+		.cra_module		= THIS_MODULE,
+		.cra_init		= crc32_neon_cra_init,
+	}
+}, {
+	.setkey		= crc32_neon_setkey,
+	.init		= crc32_neon_init,
+	.update		= crc32c_neon_update,
+	.final		= crc32c_neon_final,
+	.finup		= crc32c_neon_finup,
+	.digest		= crc32c_neon_digest,
+	.descsize	= sizeof(u32),
+	.digestsize	= CHKSUM_DIGEST_SIZE,
+	.base		= {
+		.cra_name		= "crc32c",
+		.cra_driver_name	= "crc32c-neon",
+		.cra_priority		= 200,
+		.cra_blocksize		= CHKSUM_BLOCK_SIZE,
+		.cra_alignmask		= 3,
+		.cra_ctxsize		= sizeof(u32),
+		.cra_module		= THIS_MODULE,
+		.cra_init		= crc32c_neon_cra_init,
+	}
+} };
+
+static int __init crc32_neon_mod_init(void)
+{
+	if (!crc32_neon_available()) {
+		pr_info("NEON is not available.\n");
+		return -ENODEV;
+	}
+	return crypto_register_shashes(crc32_neon_algs,
+				       ARRAY_SIZE(crc32_neon_algs));
+}
+
+static void __exit crc32_neon_mod_fini(void)
+{
+	crypto_unregister_shashes(crc32_neon_algs,
+				  ARRAY_SIZE(crc32_neon_algs));
+}
+
+module_init(crc32_neon_mod_init);
+module_exit(crc32_neon_mod_fini);
+
+MODULE_DESCRIPTION("CRC32 and CRC32C using ARM NEON");
+MODULE_LICENSE("GPL");
+
+MODULE_ALIAS("crc32");
+MODULE_ALIAS("crc32-neon");
+MODULE_ALIAS("crc32c");
+MODULE_ALIAS("crc32c-neon");
@@ -0,0 +1,23 @@
+#ifndef __ASM_ARM_ADLER32_H
+#define __ASM_ARM_ADLER32_H
+
+/*
+ * NEON Adler-32 for zlib_adler32(), see arch/arm/lib/adler32-neon.c.
+ *
+ * adler32_neon() updates *@adler with a multiple of 32 bytes from the
+ * start of @buf and returns how many it consumed, or 0 if NEON is not
+ * usable for this call.
+ */
+#define ADLER32_NEON_MIN_LEN	128
+
+unsigned int adler32_neon(unsigned long *adler, const unsigned char *buf,
+			  unsigned int len);
+
+static inline unsigned int arch_adler32(unsigned long *adler,
+					const unsigned char *buf,
+					unsigned int len)
+{
+	return adler32_neon(adler, buf, len);
+}
+
+#endif /* __ASM_ARM_ADLER32_H */
@@ -0,0 +1,35 @@
+#ifndef __ASM_ARM_CRC32_H
+#define __ASM_ARM_CRC32_H
+
+#include <linux/types.h>
+
+/*
+ * NEON folding for crc32_le() and __crc32c_le(), see
+ * arch/arm/lib/crc32-neon.c.
+ *
+ * The *_fold() helpers fold a multiple of 16 bytes from the start of
+ * @p, with @crc as the seed, into the 16 bytes at @out and return how
+ * many bytes were consumed, or 0 if NEON is not usable for this call.
+ * The CRC of the consumed bytes is then the seed 0 CRC of @out.
+ */
+#define CRC32_NEON_MIN_LEN	256
+
+size_t crc32_le_neon_fold(u32 crc, const u8 *p, size_t len, u8 *out);
+size_t crc32c_le_neon_fold(u32 crc, const u8 *p, size_t len, u8 *out);
+bool crc32_neon_available(void);
+
+extern bool crc32_neon_lib;
+
+static inline size_t arch_crc32_le_fold(u32 crc, const u8 *p, size_t len,
+					u8 *out)
+{
+	return crc32_neon_lib ? crc32_le_neon_fold(crc, p, len, out) : 0;
+}
+
+static inline size_t arch_crc32c_le_fold(u32 crc, const u8 *p, size_t len,
+					 u8 *out)
+{
+	return crc32_neon_lib ? crc32c_le_neon_fold(crc, p, len, out) : 0;
+}
+
+#endif /* __ASM_ARM_CRC32_H */
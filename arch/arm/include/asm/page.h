@@ -142,6 +142,12 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
 extern void copy_page(void *to, const void *from);
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void copy_page_bulk(void *to, const void *from);
+#else
+#define copy_page_bulk(to,from)	copy_page(to,from)
+#endif
+
 #ifdef CONFIG_KUSER_HELPERS
 #define __HAVE_ARCH_GATE_AREA 1
 #endif
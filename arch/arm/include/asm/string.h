@@ -26,6 +26,19 @@ extern void * memset(void *, int, __kernel_size_t);
 
 extern void __memzero(void *ptr, __kernel_size_t n);
 
+/*
+ * Bulk copies and fills from process context.  These use NEON when the
+ * boot time calibration in arch/arm/lib/copy-neon.c found it faster
+ * for the given size, and fall back to memcpy()/memset() otherwise.
+ */
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void * memcpy_bulk(void *, const void *, __kernel_size_t);
+extern void * memset_bulk(void *, int, __kernel_size_t);
+#else
+#define memcpy_bulk(d,s,n)	memcpy(d,s,n)
+#define memset_bulk(p,v,n)	memset(p,v,n)
+#endif
+
 #define memset(p,v,n)							\
 	({								\
 	 	void *__p = (p); size_t __n = n;			\
@@ -0,0 +1,86 @@
+/*
+ * linux/arch/arm/lib/adler32-neon-core.c
+ *
+ * Adler-32 over whole 32 byte blocks with NEON.
+ *
+ * Within a run of n blocks, s1 grows by the sum of all bytes and s2 by
+ * 32 * n * s1 plus, per block, 32 times the s1 of the blocks before it
+ * and the block's bytes weighted 32 .. 1.  The per-block s1 values and
+ * the column sums are accumulated in vectors and only combined at the
+ * end of the run, which is kept short enough (NMAX bytes) for nothing
+ * to overflow before the modulo.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+#define BASE		65521U
+#define NMAX		5552
+#define BLOCK_SIZE	32
+
+static const uint16_t taps[BLOCK_SIZE] = {
+	32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+	16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,
+};
+
+static inline uint32_t sum_lanes(uint32x4_t v)
+{
+	uint64x2_t t = vpaddlq_u32(v);
+
+	return (uint32_t)(vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1));
+}
+
+/* @len must be a multiple of BLOCK_SIZE */
+uint32_t adler32_neon_blocks(uint32_t adler, const uint8_t *buf,
+			     unsigned long len)
+{
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+	unsigned long blocks = len / BLOCK_SIZE;
+
+	while (blocks) {
+		unsigned long n = NMAX / BLOCK_SIZE;
+		uint32x4_t v_s1 = vdupq_n_u32(0);
+		uint32x4_t v_s2;
+		uint16x8_t c0 = vdupq_n_u16(0);
+		uint16x8_t c1 = vdupq_n_u16(0);
+		uint16x8_t c2 = vdupq_n_u16(0);
+		uint16x8_t c3 = vdupq_n_u16(0);
+
+		if (n > blocks)
+			n = blocks;
+		blocks -= n;
+		v_s2 = vsetq_lane_u32(s1 * n, vdupq_n_u32(0), 3);
+
+		do {
+			uint8x16_t b0 = vld1q_u8(buf);
+			uint8x16_t b1 = vld1q_u8(buf + 16);
+
+			v_s2 = vaddq_u32(v_s2, v_s1);
+			v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(b0), b1));
+			c0 = vaddw_u8(c0, vget_low_u8(b0));
+			c1 = vaddw_u8(c1, vget_high_u8(b0));
+			c2 = vaddw_u8(c2, vget_low_u8(b1));
+			c3 = vaddw_u8(c3, vget_high_u8(b1));
+			buf += BLOCK_SIZE;
+		} while (--n);
+
+		v_s2 = vshlq_n_u32(v_s2, 5);
+		v_s2 = vmlal_u16(v_s2, vget_low_u16(c0), vld1_u16(taps));
+		v_s2 = vmlal_u16(v_s2, vget_high_u16(c0), vld1_u16(taps + 4));
+		v_s2 = vmlal_u16(v_s2, vget_low_u16(c1), vld1_u16(taps + 8));
+		v_s2 = vmlal_u16(v_s2, vget_high_u16(c1), vld1_u16(taps + 12));
+		v_s2 = vmlal_u16(v_s2, vget_low_u16(c2), vld1_u16(taps + 16));
+		v_s2 = vmlal_u16(v_s2, vget_high_u16(c2), vld1_u16(taps + 20));
+		v_s2 = vmlal_u16(v_s2, vget_low_u16(c3), vld1_u16(taps + 24));
+		v_s2 = vmlal_u16(v_s2, vget_high_u16(c3), vld1_u16(taps + 28));
+
+		s1 = (s1 + sum_lanes(v_s1)) % BASE;
+		s2 = (s2 + sum_lanes(v_s2)) % BASE;
+	}
+
+	return (s2 << 16) | s1;
+}
@@ -0,0 +1,30 @@
+/*
+ * linux/arch/arm/lib/adler32-neon.c
+ *
+ * NEON Adler-32 for zlib, see <asm/adler32.h>.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/export.h>
+#include <linux/hardirq.h>
+#include <asm/adler32.h>
+#include <asm/neon.h>
+
+extern u32 adler32_neon_blocks(u32 adler, const u8 *buf, unsigned long len);
+
+unsigned int adler32_neon(unsigned long *adler, const unsigned char *buf,
+			  unsigned int len)
+{
+	if (!cpu_has_neon() || len < ADLER32_NEON_MIN_LEN || in_interrupt())
+		return 0;
+
+	len &= ~31U;
+	kernel_neon_begin();
+	*adler = adler32_neon_blocks(*adler, buf, len);
+	kernel_neon_end();
+	return len;
+}
+EXPORT_SYMBOL(adler32_neon);
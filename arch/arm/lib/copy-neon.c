@@ -0,0 +1,211 @@
+/*
+ * linux/arch/arm/lib/copy-neon.c
+ *
+ * Boot time selection of the NEON memcpy()/memset() for bulk copies.
+ *
+ * Using NEON from the kernel has a fixed cost: kernel_neon_begin() may
+ * have to save the user's VFP state, and it cannot be used from
+ * interrupt context at all.  Whether (and from which size on) NEON is
+ * worth it therefore depends on the core and the memory system, so we
+ * measure it once at boot, like the xor and raid6 code do, and only
+ * route copies through NEON above the size where it won.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/export.h>
+#include <linux/gfp.h>
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+
+extern void *__memcpy_neon(void *dest, const void *src, size_t n);
+extern void *__memset_neon(void *s, int c, size_t n);
+
+/*
+ * Sizes from which on NEON is used, zero if it never won (or the CPU
+ * has no NEON); until calibration has run everything uses the integer
+ * routines.
+ */
+static size_t neon_memcpy_threshold __read_mostly;
+static size_t neon_memset_threshold __read_mostly;
+
+static inline bool neon_bulk_usable(size_t threshold, size_t n)
+{
+	return threshold && n >= threshold && !in_interrupt();
+}
+
+void *memcpy_bulk(void *dest, const void *src, size_t n)
+{
+	if (!neon_bulk_usable(neon_memcpy_threshold, n))
+		return memcpy(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, n);
+	kernel_neon_end();
+	return dest;
+}
+EXPORT_SYMBOL(memcpy_bulk);
+
+void *memset_bulk(void *s, int c, size_t n)
+{
+	if (!neon_bulk_usable(neon_memset_threshold, n))
+		return memset(s, c, n);
+
+	kernel_neon_begin();
+	__memset_neon(s, c, n);
+	kernel_neon_end();
+	return s;
+}
+EXPORT_SYMBOL(memset_bulk);
+
+void copy_page_bulk(void *to, const void *from)
+{
+	if (!neon_bulk_usable(neon_memcpy_threshold, PAGE_SIZE)) {
+		copy_page(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__memcpy_neon(to, from, PAGE_SIZE);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(copy_page_bulk);
+
+#define BENCH_ORDER	2
+#define BENCH_SIZE	(PAGE_SIZE << BENCH_ORDER)
+/* bytes moved per measurement, whatever the size of each call */
+#define BENCH_BYTES	(256 * 1024)
+#define BENCH_RUNS	3
+
+enum bulk_op {
+	BULK_MEMCPY,
+	BULK_MEMCPY_NEON,
+	BULK_MEMSET,
+	BULK_MEMSET_NEON,
+};
+
+static const size_t bench_sizes[] __initconst = {
+	256, 1024, PAGE_SIZE, BENCH_SIZE,
+};
+
+/* Returns the best of BENCH_RUNS measurements, in KB/sec. */
+static unsigned long __init bulk_speed(enum bulk_op op, void *dst,
+				       void *src, size_t len)
+{
+	unsigned long best = 0;
+	int run, i, count = BENCH_BYTES / len;
+
+	for (run = 0; run < BENCH_RUNS; run++) {
+		ktime_t start;
+		u64 ns;
+
+		start = ktime_get();
+		switch (op) {
+		case BULK_MEMCPY:
+			for (i = 0; i < count; i++)
+				memcpy(dst, src, len);
+			break;
+		case BULK_MEMCPY_NEON:
+			for (i = 0; i < count; i++) {
+				kernel_neon_begin();
+				__memcpy_neon(dst, src, len);
+				kernel_neon_end();
+			}
+			break;
+		case BULK_MEMSET:
+			for (i = 0; i < count; i++)
+				memset(dst, 0x5a, len);
+			break;
+		case BULK_MEMSET_NEON:
+			for (i = 0; i < count; i++) {
+				kernel_neon_begin();
+				__memset_neon(dst, 0x5a, len);
+				kernel_neon_end();
+			}
+			break;
+		}
+		mb();
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (ns) {
+			unsigned long speed = div64_u64((u64)(BENCH_BYTES / 1024) *
+							NSEC_PER_SEC, ns);
+			if (speed > best)
+				best = speed;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Measure the integer and NEON variant at increasing sizes and return
+ * the smallest size from which on NEON is faster at every size
+ * measured, or zero if it is not faster even for the largest one.
+ */
+static size_t __init calibrate_bulk_op(const char *name, enum bulk_op op,
+				       enum bulk_op neon_op, void *dst,
+				       void *src)
+{
+	size_t threshold = 0;
+	int i;
+
+	for (i = ARRAY_SIZE(bench_sizes) - 1; i >= 0; i--) {
+		size_t len = bench_sizes[i];
+		unsigned long arm, neon;
+
+		arm = bulk_speed(op, dst, src, len);
+		neon = bulk_speed(neon_op, dst, src, len);
+
+		printk(KERN_INFO "   %-6s %6zu bytes: arm %6lu.%03lu MB/sec, neon %6lu.%03lu MB/sec\n",
+		       name, len, arm / 1000, arm % 1000, neon / 1000, neon % 1000);
+
+		if (neon <= arm)
+			break;
+		threshold = len;
+	}
+
+	return threshold;
+}
+
+static int __init calibrate_neon_bulk(void)
+{
+	void *b1, *b2;
+
+	if (!cpu_has_neon())
+		return 0;
+
+	/* two buffers, so that src and dst do not share cache colour */
+	b1 = (void *)__get_free_pages(GFP_KERNEL, BENCH_ORDER + 1);
+	if (!b1) {
+		printk(KERN_WARNING "neon-copy: no memory for calibration\n");
+		return -ENOMEM;
+	}
+	b2 = b1 + BENCH_SIZE;
+
+	printk(KERN_INFO "neon-copy: measuring bulk copy speed\n");
+	neon_memcpy_threshold = calibrate_bulk_op("memcpy", BULK_MEMCPY,
+						  BULK_MEMCPY_NEON, b1, b2);
+	neon_memset_threshold = calibrate_bulk_op("memset", BULK_MEMSET,
+						  BULK_MEMSET_NEON, b1, b2);
+
+	free_pages((unsigned long)b1, BENCH_ORDER + 1);
+
+	if (neon_memcpy_threshold)
+		printk(KERN_INFO "neon-copy: using NEON memcpy for %zu bytes and up\n",
+		       neon_memcpy_threshold);
+	if (neon_memset_threshold)
+		printk(KERN_INFO "neon-copy: using NEON memset for %zu bytes and up\n",
+		       neon_memset_threshold);
+
+	return 0;
+}
+late_initcall(calibrate_neon_bulk);
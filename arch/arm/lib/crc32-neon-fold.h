@@ -0,0 +1,67 @@
+/*
+ * linux/arch/arm/lib/crc32-neon-fold.h
+ *
+ * CRC32/CRC32C folding loop shared by the vmull.p8 and vmull.p64
+ * variants.  Each of them defines struct fold_k, fold_k_init() and
+ * fold128() on top of its carry-less multiply before including this.
+ *
+ * This is the bit reflected folding from Intel's "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction", as also used by
+ * arch/x86/crypto/crc32-pclmul_asm.S, minus the final Barrett reduction:
+ * the caller finishes the 16 folded bytes with the table code.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+static inline uint64x2_t crc32_neon_load(const uint8_t *p)
+{
+	return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+/*
+ * @k holds the fold constants for a distance of 512 and of 128 bits,
+ * each as (x^(d+32) mod P, x^(d-32) mod P), bit reflected and shifted
+ * left by one.  @len must be a multiple of 16 and at least 64.
+ */
+static void crc32_neon_fold(const uint64_t k[4], uint32_t crc,
+			    const uint8_t *p, unsigned long len, uint8_t *out)
+{
+	struct fold_k k512, k128;
+	uint64x2_t x0, x1, x2, x3;
+
+	fold_k_init(&k512, k[0], k[1]);
+	fold_k_init(&k128, k[2], k[3]);
+
+	x0 = veorq_u64(crc32_neon_load(p),
+		       vcombine_u64(vcreate_u64(crc), vcreate_u64(0)));
+	x1 = crc32_neon_load(p + 16);
+	x2 = crc32_neon_load(p + 32);
+	x3 = crc32_neon_load(p + 48);
+	p += 64;
+	len -= 64;
+
+	/* four lanes, 64 bytes at a time */
+	while (len >= 64) {
+		x0 = veorq_u64(fold128(x0, &k512), crc32_neon_load(p));
+		x1 = veorq_u64(fold128(x1, &k512), crc32_neon_load(p + 16));
+		x2 = veorq_u64(fold128(x2, &k512), crc32_neon_load(p + 32));
+		x3 = veorq_u64(fold128(x3, &k512), crc32_neon_load(p + 48));
+		p += 64;
+		len -= 64;
+	}
+
+	/* down to a single lane */
+	x0 = veorq_u64(fold128(x0, &k128), x1);
+	x0 = veorq_u64(fold128(x0, &k128), x2);
+	x0 = veorq_u64(fold128(x0, &k128), x3);
+
+	while (len >= 16) {
+		x0 = veorq_u64(fold128(x0, &k128), crc32_neon_load(p));
+		p += 16;
+		len -= 16;
+	}
+
+	vst1q_u8(out, vreinterpretq_u8_u64(x0));
+}
@@ -0,0 +1,41 @@
+/*
+ * linux/arch/arm/lib/crc32-neon-p64.c
+ *
+ * CRC32/CRC32C folding built on vmull.p64 from the ARMv8 crypto
+ * extensions.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+struct fold_k {
+	poly64_t	lo;
+	poly64_t	hi;
+};
+
+static void fold_k_init(struct fold_k *fk, uint64_t klo, uint64_t khi)
+{
+	fk->lo = klo;
+	fk->hi = khi;
+}
+
+/* Return lo(x) * klo ^ hi(x) * khi. */
+static inline uint64x2_t fold128(uint64x2_t x, const struct fold_k *fk)
+{
+	poly128_t lo = vmull_p64(vgetq_lane_u64(x, 0), fk->lo);
+	poly128_t hi = vmull_p64(vgetq_lane_u64(x, 1), fk->hi);
+
+	return veorq_u64(vreinterpretq_u64_p128(lo),
+			 vreinterpretq_u64_p128(hi));
+}
+
+#include "crc32-neon-fold.h"
+
+void crc32_neon_fold_p64(const uint64_t k[4], uint32_t crc, const uint8_t *p,
+			 unsigned long len, uint8_t *out)
+{
+	crc32_neon_fold(k, crc, p, len, out);
+}
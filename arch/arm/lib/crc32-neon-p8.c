@@ -0,0 +1,96 @@
+/*
+ * linux/arch/arm/lib/crc32-neon-p8.c
+ *
+ * CRC32/CRC32C folding built on vmull.p8, for cores with NEON but
+ * without the 64-bit polynomial multiply of the ARMv8 crypto extensions.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+/*
+ * The fold constants are at most 33 bits wide, so a 64x33 bit carry-less
+ * multiply is all that is needed: four vmull.p8 against the low constant
+ * bytes, plus the data shifted left by 32 when bit 32 of the constant is
+ * set.  The two halves of a fold use different constants, so the low
+ * constant's bytes go in lanes 0-3 and the high one's in lanes 4-7.
+ */
+struct fold_k {
+	poly8x8_t	kb[4];
+	uint64x2_t	top;
+};
+
+static void fold_k_init(struct fold_k *fk, uint64_t klo, uint64_t khi)
+{
+	int j;
+
+	for (j = 0; j < 4; j++) {
+		uint64_t lo = (klo >> (8 * j)) & 0xff;
+		uint64_t hi = (khi >> (8 * j)) & 0xff;
+
+		fk->kb[j] = vcreate_p8(lo * 0x01010101ULL |
+				       (hi * 0x01010101ULL) << 32);
+	}
+	fk->top = vcombine_u64(vcreate_u64((klo >> 32) & 1 ? ~0ULL : 0),
+			       vcreate_u64((khi >> 32) & 1 ? ~0ULL : 0));
+}
+
+/* xor of the two 64-bit halves of a vmull.p8 result */
+static inline uint8x8_t fold_halves(poly16x8_t m)
+{
+	uint8x16_t b = vreinterpretq_u8_p16(m);
+
+	return veor_u8(vget_low_u8(b), vget_high_u8(b));
+}
+
+/*
+ * Return lo(x) * klo ^ hi(x) * khi.
+ *
+ * Splitting the data into even and odd bytes leaves each 16-bit product
+ * of vmull.p8 exactly where it belongs in the 64x8 bit product, up to a
+ * byte shift: the byte-j products of even bytes need a shift of j bytes,
+ * those of odd bytes j + 1.  Products with equal shifts are combined
+ * before shifting.
+ */
+static inline uint64x2_t fold128(uint64x2_t x, const struct fold_k *fk)
+{
+	const uint8x16_t zero = vdupq_n_u8(0);
+	uint8x16_t xb = vreinterpretq_u8_u64(x);
+	uint8x8x2_t eo = vuzp_u8(vget_low_u8(xb), vget_high_u8(xb));
+	poly8x8_t even = vreinterpret_p8_u8(eo.val[0]);
+	poly8x8_t odd = vreinterpret_p8_u8(eo.val[1]);
+	uint64x2_t t = vandq_u64(x, fk->top);
+	uint8x8_t h0, h1, h2, h3, h4;
+	uint8x16_t acc;
+
+	h0 = fold_halves(vmull_p8(even, fk->kb[0]));
+	h1 = veor_u8(fold_halves(vmull_p8(even, fk->kb[1])),
+		     fold_halves(vmull_p8(odd, fk->kb[0])));
+	h2 = veor_u8(fold_halves(vmull_p8(even, fk->kb[2])),
+		     fold_halves(vmull_p8(odd, fk->kb[1])));
+	h3 = veor_u8(fold_halves(vmull_p8(even, fk->kb[3])),
+		     fold_halves(vmull_p8(odd, fk->kb[2])));
+	/* the x^32 term of the constants lands on the same shift */
+	h4 = veor_u8(fold_halves(vmull_p8(odd, fk->kb[3])),
+		     vreinterpret_u8_u64(veor_u64(vget_low_u64(t),
+						  vget_high_u64(t))));
+
+	acc = vcombine_u8(h0, vget_low_u8(zero));
+	acc = veorq_u8(acc, vextq_u8(zero, vcombine_u8(h1, vget_low_u8(zero)), 15));
+	acc = veorq_u8(acc, vextq_u8(zero, vcombine_u8(h2, vget_low_u8(zero)), 14));
+	acc = veorq_u8(acc, vextq_u8(zero, vcombine_u8(h3, vget_low_u8(zero)), 13));
+	acc = veorq_u8(acc, vextq_u8(zero, vcombine_u8(h4, vget_low_u8(zero)), 12));
+
+	return vreinterpretq_u64_u8(acc);
+}
+
+#include "crc32-neon-fold.h"
+
+void crc32_neon_fold_p8(const uint64_t k[4], uint32_t crc, const uint8_t *p,
+			unsigned long len, uint8_t *out)
+{
+	crc32_neon_fold(k, crc, p, len, out);
+}
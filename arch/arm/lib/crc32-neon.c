@@ -0,0 +1,99 @@
+/*
+ * linux/arch/arm/lib/crc32-neon.c
+ *
+ * NEON folding for the little-endian CRC32 and CRC32C.
+ *
+ * The buffer is folded 64 bytes at a time down to a 16 byte remainder
+ * with the same CRC, which the caller finishes with the table code.
+ * Cores implementing the ARMv8 crypto extensions use vmull.p64, every
+ * other NEON core a table-free vmull.p8 variant.  As with the other
+ * kernel mode NEON users, short buffers and interrupt context stay on
+ * the integer code.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/export.h>
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <asm/crc32.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+
+typedef void crc32_fold_fn(const u64 k[4], u32 crc, const u8 *p,
+			   unsigned long len, u8 *out);
+
+extern crc32_fold_fn crc32_neon_fold_p8;
+#ifdef CRC32_NEON_PMULL
+extern crc32_fold_fn crc32_neon_fold_p64;
+#endif
+
+/* x^(512+32), x^(512-32), x^(128+32), x^(128-32) mod P, see -fold.h */
+static const u64 crc32_k[4] = {
+	0x154442bd4ULL, 0x1c6e41596ULL, 0x1751997d0ULL, 0x0ccaa009eULL,
+};
+static const u64 crc32c_k[4] = {
+	0x0740eef02ULL, 0x09e4addf8ULL, 0x0f20c0dfeULL, 0x14cd00bd6ULL,
+};
+
+static crc32_fold_fn *crc32_neon_fold __read_mostly;
+
+/* Whether lib/crc32.c uses the NEON code; the crypto drivers always do. */
+bool crc32_neon_lib __read_mostly = true;
+module_param_named(lib, crc32_neon_lib, bool, 0644);
+MODULE_PARM_DESC(lib, "Use NEON for the crc32_le()/__crc32c_le() library calls");
+EXPORT_SYMBOL(crc32_neon_lib);
+
+static size_t crc32_neon(const u64 k[4], u32 crc, const u8 *p, size_t len,
+			 u8 *out)
+{
+	if (!crc32_neon_fold || len < CRC32_NEON_MIN_LEN || in_interrupt())
+		return 0;
+
+	len &= ~(size_t)15;
+	kernel_neon_begin();
+	crc32_neon_fold(k, crc, p, len, out);
+	kernel_neon_end();
+	return len;
+}
+
+size_t crc32_le_neon_fold(u32 crc, const u8 *p, size_t len, u8 *out)
+{
+	return crc32_neon(crc32_k, crc, p, len, out);
+}
+EXPORT_SYMBOL(crc32_le_neon_fold);
+
+size_t crc32c_le_neon_fold(u32 crc, const u8 *p, size_t len, u8 *out)
+{
+	return crc32_neon(crc32c_k, crc, p, len, out);
+}
+EXPORT_SYMBOL(crc32c_le_neon_fold);
+
+bool crc32_neon_available(void)
+{
+	return crc32_neon_fold != NULL;
+}
+EXPORT_SYMBOL(crc32_neon_available);
+
+static int __init crc32_neon_init(void)
+{
+	if (!cpu_has_neon())
+		return 0;
+
+#ifdef CRC32_NEON_PMULL
+	/* ID_ISAR5.PMULL == 2: vmull.p64 is implemented */
+	if (((read_cpuid_ext(CPUID_EXT_ISAR5) >> 4) & 0xf) == 2) {
+		crc32_neon_fold = crc32_neon_fold_p64;
+		pr_info("crc32: using NEON vmull.p64 folding\n");
+		return 0;
+	}
+#endif
+	crc32_neon_fold = crc32_neon_fold_p8;
+	pr_info("crc32: using NEON vmull.p8 folding\n");
+	return 0;
+}
+arch_initcall(crc32_neon_init);
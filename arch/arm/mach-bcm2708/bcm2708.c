@@ -27,6 +27,8 @@
 #include <linux/interrupt.h>
 #include <linux/amba/bus.h>
 #include <linux/amba/clcd.h>
+#include <linux/amba/serial.h>
+#include <linux/dmaengine.h>
 #include <linux/clockchips.h>
 #include <linux/cnt32_to_63.h>
 #include <linux/io.h>
@@ -87,6 +89,7 @@ static unsigned disk_led_gpio = 16;
 static unsigned disk_led_active_low = 1;
 static unsigned reboot_part = 0;
 static unsigned w1_gpio_pin = W1_GPIO;
+static bool async_probe;
 
 static void __init bcm2708_init_led(void);
 
@@ -242,7 +245,42 @@ static struct clk_lookup lookups[] = {
 #define UART0_IRQ	{ IRQ_UART, 0 /*NO_IRQ*/ }
 #define UART0_DMA	{ 15, 14 }
 
-AMBA_DEVICE(uart0, "dev:f1", UART0, NULL);
+#if IS_ENABLED(CONFIG_DMA_BCM2708)
+/*
+ * The dmaengine driver may be a module, so match its channels by driver
+ * name and hand the DREQ over in chan->private.
+ */
+static bool bcm2708_uart0_dma_filter(struct dma_chan *chan, void *param)
+{
+	if (strcmp(dev_driver_string(chan->device->dev), "bcm2708-dmaengine"))
+		return false;
+
+	chan->private = param;
+	return true;
+}
+
+/*
+ * The DMA engine only does 32-bit accesses, which read the error flags of
+ * the data register along with each character, and it addresses the
+ * peripherals through the VideoCore bus.  RX runs as one cyclic transfer
+ * rather than a descriptor per FIFO timeout.
+ */
+#define UART0_DMA_DR	0x7E201000	/* UART0_BASE + UART01x_DR on the bus */
+
+static struct amba_pl011_data uart0_plat = {
+	.dma_filter = bcm2708_uart0_dma_filter,
+	.dma_rx_param = (void *)BCM2708_DMA_DREQ_UART_RX,
+	.dma_tx_param = (void *)BCM2708_DMA_DREQ_UART_TX,
+	.dma_rx_cyclic = true,
+	.dma_width = 4,
+	.dma_dr_addr = UART0_DMA_DR,
+};
+#define UART0_PLAT	(&uart0_plat)
+#else
+#define UART0_PLAT	NULL
+#endif
+
+AMBA_DEVICE(uart0, "dev:f1", UART0, UART0_PLAT);
 
 static struct amba_device *amba_devs[] __initdata = {
 	&uart0_device,
@@ -764,6 +802,32 @@ static void bcm2708_power_off(void)
 	}
 }
 
+/*
+ * With bcm2708.async_probe=1 the controllers below probe concurrently, so
+ * that e.g. SD card initialisation does not hold up the USB controller.
+ * The mailbox is probed from an arch_initcall and needs no ordering; the
+ * users of the DMA manager wait for it.
+ */
+static struct device *bcm2708_dma_users_deps[] = {
+	&bcm2708_dmaman_device.dev,
+	NULL
+};
+
+static void __init bcm2708_init_async_probe(void)
+{
+	bcm2708_dmaman_device.dev.async_probe = true;
+	bcm2708_fb_device.dev.async_probe = true;
+	bcm2708_fb_device.dev.probe_after = bcm2708_dma_users_deps;
+	bcm2708_usb_device.dev.async_probe = true;
+#ifdef CONFIG_MMC_SDHCI_BCM2708
+	bcm2708_emmc_device.dev.async_probe = true;
+	bcm2708_emmc_device.dev.probe_after = bcm2708_dma_users_deps;
+#endif
+	bcm2708_spi_device.dev.async_probe = true;
+	bcm2708_bsc0_device.dev.async_probe = true;
+	bcm2708_bsc1_device.dev.async_probe = true;
+}
+
 void __init bcm2708_init(void)
 {
 	int i;
@@ -780,6 +844,9 @@ void __init bcm2708_init(void)
 	for (i = 0; i < ARRAY_SIZE(lookups); i++)
 		clkdev_add(&lookups[i]);
 
+	if (async_probe)
+		bcm2708_init_async_probe();
+
 	bcm_register_device(&bcm2708_dmaman_device);
 	bcm_register_device(&bcm2708_vcio_device);
 #ifdef CONFIG_BCM2708_GPIO
@@ -1015,3 +1082,4 @@ module_param(disk_led_gpio, uint, 0644);
 module_param(disk_led_active_low, uint, 0644);
 module_param(reboot_part, uint, 0644);
 module_param(w1_gpio_pin, uint, 0644);
+module_param(async_probe, bool, 0444);
@@ -39,7 +39,9 @@
 #define	BCM2708_DMA_WAITS(x)	(((x)&0x1f) << 21)
 
 #define BCM2708_DMA_DREQ_EMMC	11
+#define BCM2708_DMA_DREQ_UART_TX	12
 #define BCM2708_DMA_DREQ_SDHOST	13
+#define BCM2708_DMA_DREQ_UART_RX	14
 
 #define BCM2708_DMA_CS		0x00 /* Control and Status */
 #define BCM2708_DMA_ADDR	0x04
@@ -26480,6 +26480,231 @@ static struct hash_testvec michael_mic_tv_template[] = {
 	}
 };
 
+/*
+ * CRC32 test vectors
+ */
+#define CRC32_TEST_VECTORS 7
+
+static struct hash_testvec crc32_tv_template[] = {
+	{
+		.psize = 0,
+		.digest = "\x00\x00\x00\x00",
+	},
+	{
+		.key = "\x78\x56\x34\x12",
+		.ksize = 4,
+		.psize = 0,
+		.digest = "\x78\x56\x34\x12",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x01\x02\x03\x04\x05\x06\x07\x08"
+			     "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+			     "\x11\x12\x13\x14\x15\x16\x17\x18"
+			     "\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20"
+			     "\x21\x22\x23\x24\x25\x26\x27\x28",
+		.psize = 40,
+		.digest = "\x3a\xdf\x4b\xb0",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30"
+			     "\x31\x32\x33\x34\x35\x36\x37\x38"
+			     "\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40"
+			     "\x41\x42\x43\x44\x45\x46\x47\x48"
+			     "\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50",
+		.psize = 40,
+		.digest = "\xa9\x7a\x7f\x7b",
+	},
+	{
+		.key = "\x7a\x5b\x1e\x2d",
+		.ksize = 4,
+		.plaintext = "\x51\x52\x53\x54\x55\x56\x57\x58"
+			     "\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60"
+			     "\x61\x62\x63\x64\x65\x66\x67\x68"
+			     "\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70"
+			     "\x71\x72\x73\x74\x75\x76\x77\x78",
+		.psize = 40,
+		.digest = "\x52\xb7\x14\x0e",
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x01\x02\x03\x04\x05\x06\x07\x08"
+			     "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+			     "\x11\x12\x13\x14\x15\x16\x17\x18"
+			     "\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20"
+			     "\x21\x22\x23\x24\x25\x26\x27\x28"
+			     "\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30"
+			     "\x31\x32\x33\x34\x35\x36\x37\x38"
+			     "\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40"
+			     "\x41\x42\x43\x44\x45\x46\x47\x48"
+			     "\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50"
+			     "\x51\x52\x53\x54\x55\x56\x57\x58"
+			     "\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60"
+			     "\x61\x62\x63\x64\x65\x66\x67\x68"
+			     "\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70"
+			     "\x71\x72\x73\x74\x75\x76\x77\x78"
+			     "\x79\x7a\x7b\x7c\x7d\x7e\x7f\x80"
+			     "\x81\x82\x83\x84\x85\x86\x87\x88"
+			     "\x89\x8a\x8b\x8c\x8d\x8e\x8f\x90"
+			     "\x91\x92\x93\x94\x95\x96\x97\x98"
+			     "\x99\x9a\x9b\x9c\x9d\x9e\x9f\xa0"
+			     "\xa1\xa2\xa3\xa4\xa5\xa6\xa7\xa8"
+			     "\xa9\xaa\xab\xac\xad\xae\xaf\xb0"
+			     "\xb1\xb2\xb3\xb4\xb5\xb6\xb7\xb8"
+			     "\xb9\xba\xbb\xbc\xbd\xbe\xbf\xc0"
+			     "\xc1\xc2\xc3\xc4\xc5\xc6\xc7\xc8"
+			     "\xc9\xca\xcb\xcc\xcd\xce\xcf\xd0"
+			     "\xd1\xd2\xd3\xd4\xd5\xd6\xd7\xd8"
+			     "\xd9\xda\xdb\xdc\xdd\xde\xdf\xe0"
+			     "\xe1\xe2\xe3\xe4\xe5\xe6\xe7\xe8"
+			     "\xe9\xea\xeb\xec\xed\xee\xef\xf0",
+		.psize = 240,
+		.digest = "\x6c\xc6\x56\xde",
+		.np = 2,
+		.tap = { 31, 209 }
+	},
+	{
+		.key = "\xff\xff\xff\xff",
+		.ksize = 4,
+		.plaintext = "\x1f\x6d\xc4\x60\x0d\xe7\x1a\xa2"
+			     "\x0b\x31\x00\x34\x19\x4b\x76\x16"
+			     "\x37\x35\x7c\x48\x65\xef\x12\xca"
+			     "\xa3\x79\x38\x9c\xf1\xd3\xee\xbe"
+			     "\x4f\xfd\x34\x30\xbd\xf7\x0a\xf2"
+			     "\x3b\xc1\x70\x04\xc9\x5b\x66\x66"
+			     "\x67\xc5\xec\x18\x15\xff\x02\x1a"
+			     "\xd3\x09\xa8\x6c\xa1\xe3\xde\x0e"
+			     "\x7f\x8d\xa4\x00\x6d\x07\xfa\x42"
+			     "\x6b\x51\xe0\xd4\x79\x6b\x56\xb6"
+			     "\x97\x55\x5c\xe8\xc5\x0f\xf2\x6a"
+			     "\x03\x99\x18\x3c\x51\xf3\xce\x5e"
+			     "\xaf\x1d\x14\xd0\x1d\x17\xea\x92"
+			     "\x9b\xe1\x50\xa4\x29\x7b\x46\x06"
+			     "\xc7\xe5\xcc\xb8\x75\x1f\xe2\xba"
+			     "\x33\x29\x88\x0c\x01\x03\xbe\xae"
+			     "\xdf\xad\x84\xa0\xcd\x27\xda\xe2"
+			     "\xcb\x71\xc0\x74\xd9\x8b\x36\x56"
+			     "\xf7\x75\x3c\x88\x25\x2f\xd2\x0a"
+			     "\x63\xb9\xf8\xdc\xb1\x13\xae\xfe"
+			     "\x0f\x3d\xf4\x70\x7d\x37\xca\x32"
+			     "\xfb\x01\x30\x44\x89\x9b\x26\xa6"
+			     "\x27\x05\xac\x58\xd5\x3f\xc2\x5a"
+			     "\x93\x49\x68\xac\x61\x23\x9e\x4e"
+			     "\x3f\xcd\x64\x40\x2d\x47\xba\x82"
+			     "\x2b\x91\xa0\x14\x39\xab\x16\xf6"
+			     "\x57\x95\x1c\x28\x85\x4f\xb2\xaa"
+			     "\xc3\xd9\xd8\x7c\x11\x33\x8e\x9e"
+			     "\x6f\x5d\xd4\x10\xdd\x57\xaa\xd2"
+			     "\x5b\x21\x10\xe4\xe9\xbb\x06\x46"
+			     "\x87\x25\x8c\xf8\x35\x5f\xa2\xfa"
+			     "\xf3\x69\x48\x4c\xc1\x43\x7e\xee"
+			     "\x9f\xed\x44\xe0\x8d\x67\x9a\x22"
+			     "\x8b\xb1\x80\xb4\x99\xcb\xf6\x96"
+			     "\xb7\xb5\xfc\xc8\xe5\x6f\x92\x4a"
+			     "\x23\xf9\xb8\x1c\x71\x53\x6e\x3e"
+			     "\xcf\x7d\xb4\xb0\x3d\x77\x8a\x72"
+			     "\xbb\x41\xf0\x84\x49\xdb\xe6\xe6"
+			     "\xe7\x45\x6c\x98\x95\x7f\x82\x9a"
+			     "\x53\x89\x28\xec\x21\x63\x5e\x8e"
+			     "\xff\x0d\x24\x80\xed\x87\x7a\xc2"
+			     "\xeb\xd1\x60\x54\xf9\xeb\xd6\x36"
+			     "\x17\xd5\xdc\x68\x45\x8f\x72\xea"
+			     "\x83\x19\x98\xbc\xd1\x73\x4e\xde"
+			     "\x2f\x9d\x94\x50\x9d\x97\x6a\x12"
+			     "\x1b\x61\xd0\x24\xa9\xfb\xc6\x86"
+			     "\x47\x65\x4c\x38\xf5\x9f\x62\x3a"
+			     "\xb3\xa9\x08\x8c\x81\x83\x3e\x2e"
+			     "\x5f\x2d\x04\x20\x4d\xa7\x5a\x62"
+			     "\x4b\xf1\x40\xf4\x59\x0b\xb6\xd6"
+			     "\x77\xf5\xbc\x08\xa5\xaf\x52\x8a"
+			     "\xe3\x39\x78\x5c\x31\x93\x2e\x7e"
+			     "\x8f\xbd\x74\xf0\xfd\xb7\x4a\xb2"
+			     "\x7b\x81\xb0\xc4\x09\x1b\xa6\x26"
+			     "\xa7\x85\x2c\xd8\x55\xbf\x42\xda"
+			     "\x13\xc9\xe8\x2c\xe1\xa3\x1e\xce"
+			     "\xbf\x4d\xe4\xc0\xad\xc7\x3a\x02"
+			     "\xab\x11\x20\x94\xb9\x2b\x96\x76"
+			     "\xd7\x15\x9c\xa8\x05\xcf\x32\x2a"
+			     "\x43\x59\x58\xfc\x91\xb3\x0e\x1e"
+			     "\xef\xdd\x54\x90\x5d\xd7\x2a\x52"
+			     "\xdb\xa1\x90\x64\x69\x3b\x86\xc6"
+			     "\x07\xa5\x0c\x78\xb5\xdf\x22\x7a"
+			     "\x73\xe9\xc8\xcc\x41\xc3\xfe\x6e"
+			     "\x1f\x6d\xc4\x60\x0d\xe7\x1a\xa2"
+			     "\x0b\x31\x00\x34\x19\x4b\x76\x16"
+			     "\x37\x35\x7c\x48\x65\xef\x12\xca"
+			     "\xa3\x79\x38\x9c\xf1\xd3\xee\xbe"
+			     "\x4f\xfd\x34\x30\xbd\xf7\x0a\xf2"
+			     "\x3b\xc1\x70\x04\xc9\x5b\x66\x66"
+			     "\x67\xc5\xec\x18\x15\xff\x02\x1a"
+			     "\xd3\x09\xa8\x6c\xa1\xe3\xde\x0e"
+			     "\x7f\x8d\xa4\x00\x6d\x07\xfa\x42"
+			     "\x6b\x51\xe0\xd4\x79\x6b\x56\xb6"
+			     "\x97\x55\x5c\xe8\xc5\x0f\xf2\x6a"
+			     "\x03\x99\x18\x3c\x51\xf3\xce\x5e"
+			     "\xaf\x1d\x14\xd0\x1d\x17\xea\x92"
+			     "\x9b\xe1\x50\xa4\x29\x7b\x46\x06"
+			     "\xc7\xe5\xcc\xb8\x75\x1f\xe2\xba"
+			     "\x33\x29\x88\x0c\x01\x03\xbe\xae"
+			     "\xdf\xad\x84\xa0\xcd\x27\xda\xe2"
+			     "\xcb\x71\xc0\x74\xd9\x8b\x36\x56"
+			     "\xf7\x75\x3c\x88\x25\x2f\xd2\x0a"
+			     "\x63\xb9\xf8\xdc\xb1\x13\xae\xfe"
+			     "\x0f\x3d\xf4\x70\x7d\x37\xca\x32"
+			     "\xfb\x01\x30\x44\x89\x9b\x26\xa6"
+			     "\x27\x05\xac\x58\xd5\x3f\xc2\x5a"
+			     "\x93\x49\x68\xac\x61\x23\x9e\x4e"
+			     "\x3f\xcd\x64\x40\x2d\x47\xba\x82"
+			     "\x2b\x91\xa0\x14\x39\xab\x16\xf6"
+			     "\x57\x95\x1c\x28\x85\x4f\xb2\xaa"
+			     "\xc3\xd9\xd8\x7c\x11\x33\x8e\x9e"
+			     "\x6f\x5d\xd4\x10\xdd\x57\xaa\xd2"
+			     "\x5b\x21\x10\xe4\xe9\xbb\x06\x46"
+			     "\x87\x25\x8c\xf8\x35\x5f\xa2\xfa"
+			     "\xf3\x69\x48\x4c\xc1\x43\x7e\xee"
+			     "\x9f\xed\x44\xe0\x8d\x67\x9a\x22"
+			     "\x8b\xb1\x80\xb4\x99\xcb\xf6\x96"
+			     "\xb7\xb5\xfc\xc8\xe5\x6f\x92\x4a"
+			     "\x23\xf9\xb8\x1c\x71\x53\x6e\x3e"
+			     "\xcf\x7d\xb4\xb0\x3d\x77\x8a\x72"
+			     "\xbb\x41\xf0\x84\x49\xdb\xe6\xe6"
+			     "\xe7\x45\x6c\x98\x95\x7f\x82\x9a"
+			     "\x53\x89\x28\xec\x21\x63\x5e\x8e"
+			     "\xff\x0d\x24\x80\xed\x87\x7a\xc2"
+			     "\xeb\xd1\x60\x54\xf9\xeb\xd6\x36"
+			     "\x17\xd5\xdc\x68\x45\x8f\x72\xea"
+			     "\x83\x19\x98\xbc\xd1\x73\x4e\xde"
+			     "\x2f\x9d\x94\x50\x9d\x97\x6a\x12"
+			     "\x1b\x61\xd0\x24\xa9\xfb\xc6\x86"
+			     "\x47\x65\x4c\x38\xf5\x9f\x62\x3a"
+			     "\xb3\xa9\x08\x8c\x81\x83\x3e\x2e"
+			     "\x5f\x2d\x04\x20\x4d\xa7\x5a\x62"
+			     "\x4b\xf1\x40\xf4\x59\x0b\xb6\xd6"
+			     "\x77\xf5\xbc\x08\xa5\xaf\x52\x8a"
+			     "\xe3\x39\x78\x5c\x31\x93\x2e\x7e"
+			     "\x8f\xbd\x74\xf0\xfd\xb7\x4a\xb2"
+			     "\x7b\x81\xb0\xc4\x09\x1b\xa6\x26"
+			     "\xa7\x85\x2c\xd8\x55\xbf\x42\xda"
+			     "\x13\xc9\xe8\x2c\xe1\xa3\x1e\xce"
+			     "\xbf\x4d\xe4\xc0\xad\xc7\x3a\x02"
+			     "\xab\x11\x20\x94\xb9\x2b\x96\x76"
+			     "\xd7\x15\x9c\xa8\x05\xcf\x32\x2a"
+			     "\x43\x59\x58\xfc\x91\xb3\x0e\x1e"
+			     "\xef\xdd\x54\x90\x5d\xd7\x2a\x52"
+			     "\xdb\xa1\x90\x64\x69\x3b\x86\xc6"
+			     "\x07\xa5\x0c\x78\xb5\xdf\x22\x7a"
+			     "\x73\xe9\xc8\xcc\x41\xc3\xfe\x6e",
+		.psize = 1024,
+		.digest = "\x37\x40\x70\xb3",
+		.np = 3,
+		.tap = { 100, 412, 512 }
+	}
+};
+
 /*
  * CRC32C test vectors
  */
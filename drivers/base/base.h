@@ -65,6 +65,8 @@ struct driver_private {
  *	probed first.
  * @driver_data - private pointer for driver specific info.  Will turn into a
  * list soon.
+ * @async_driver - driver the device is queued to be probed with
+ *	asynchronously, NULL when no asynchronous probe is pending.
  * @device - pointer back to the struct class that this structure is
  * associated with.
  *
@@ -77,6 +79,7 @@ struct device_private {
 	struct klist_node knode_bus;
 	struct list_head deferred_probe;
 	void *driver_data;
+	struct device_driver *async_driver;
 	struct device *device;
 };
 #define to_device_private_parent(obj)	\
@@ -370,6 +370,7 @@ EXPORT_SYMBOL_GPL(wait_for_device_probe);
  */
 int driver_probe_device(struct device_driver *drv, struct device *dev)
 {
+	ktime_t calltime;
 	int ret = 0;
 
 	if (!device_is_registered(dev))
@@ -378,9 +379,15 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	pr_debug("bus: '%s': %s: matched device %s with driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
 
+	if (initcall_debug)
+		calltime = ktime_get();
 	pm_runtime_barrier(dev);
 	ret = really_probe(dev, drv);
 	pm_request_idle(dev);
+	if (initcall_debug)
+		printk(KERN_DEBUG "probe of %s by %s returned %d after %lld usecs\n",
+		       dev_name(dev), drv->name, ret,
+		       ktime_to_us(ktime_sub(ktime_get(), calltime)));
 
 	return ret;
 }
@@ -436,6 +443,100 @@ out_unlock:
 }
 EXPORT_SYMBOL_GPL(device_attach);
 
+/*
+ * Asynchronous probing
+ *
+ * Devices that have async_probe set are probed from an async function when
+ * their driver registers, so that slow probes of independent devices
+ * overlap.  Before probing, such a device waits for the pending
+ * asynchronous probes of the devices in its probe_after array; the array
+ * must not form cycles.  Dependencies that are probed synchronously or
+ * whose driver has not registered yet are not waited for, the driver still
+ * has to return -EPROBE_DEFER for those.
+ *
+ * The parent of the device is not locked for an asynchronous probe, so
+ * this is not for USB interfaces.  wait_for_device_probe() and therefore
+ * mounting the root filesystem wait for all pending asynchronous probes.
+ */
+static ASYNC_DOMAIN(async_probe_domain);
+static DEFINE_SPINLOCK(async_probe_lock);
+static DECLARE_WAIT_QUEUE_HEAD(async_probe_waitqueue);
+static unsigned int async_probe_pending, async_probe_nr;
+static ktime_t async_probe_start;
+static s64 async_probe_busy;
+
+static bool async_probe_pending_on(struct device *dev)
+{
+	bool ret;
+
+	spin_lock(&async_probe_lock);
+	ret = dev->p && dev->p->async_driver;
+	spin_unlock(&async_probe_lock);
+	return ret;
+}
+
+static void __driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device *dev = data;
+	struct device_driver *drv = dev->p->async_driver;
+	struct device **dep;
+	ktime_t start, calltime;
+	unsigned int nr = 0;
+	s64 busy, total;
+
+	start = ktime_get();
+	for (dep = dev->probe_after; dep && *dep; dep++)
+		wait_event(async_probe_waitqueue, !async_probe_pending_on(*dep));
+	calltime = ktime_get();
+
+	device_lock(dev);
+	if (!dev->driver)
+		driver_probe_device(drv, dev);
+	device_unlock(dev);
+
+	busy = ktime_to_us(ktime_sub(ktime_get(), calltime));
+	if (initcall_debug)
+		printk(KERN_DEBUG "async probe of %s waited %lld usecs for "
+		       "dependencies, probed in %lld usecs\n", dev_name(dev),
+		       ktime_to_us(ktime_sub(calltime, start)), busy);
+
+	spin_lock(&async_probe_lock);
+	dev->p->async_driver = NULL;
+	async_probe_busy += busy;
+	async_probe_nr++;
+	if (!--async_probe_pending) {
+		nr = async_probe_nr;
+		busy = async_probe_busy;
+		total = ktime_to_us(ktime_sub(ktime_get(), async_probe_start));
+	}
+	spin_unlock(&async_probe_lock);
+	wake_up(&async_probe_waitqueue);
+
+	if (nr)
+		pr_info("async probe: %u devices probed in %lld usecs, "
+			"%lld usecs of probing\n", nr, total, busy);
+	put_device(dev);
+}
+
+static void driver_attach_async(struct device *dev, struct device_driver *drv)
+{
+	spin_lock(&async_probe_lock);
+	if (dev->p->async_driver) {
+		spin_unlock(&async_probe_lock);
+		return;
+	}
+	dev->p->async_driver = drv;
+	if (!async_probe_pending++) {
+		async_probe_start = ktime_get();
+		async_probe_busy = 0;
+		async_probe_nr = 0;
+	}
+	spin_unlock(&async_probe_lock);
+
+	get_device(dev);
+	async_schedule_domain(__driver_attach_async, dev, &async_probe_domain);
+}
+
 static int __driver_attach(struct device *dev, void *data)
 {
 	struct device_driver *drv = data;
@@ -453,6 +554,11 @@ static int __driver_attach(struct device *dev, void *data)
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	if (dev->async_probe) {
+		driver_attach_async(dev, drv);
+		return 0;
+	}
+
 	if (dev->parent)	/* Needed for USB */
 		device_lock(dev->parent);
 	device_lock(dev);
@@ -546,6 +652,9 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	/* an asynchronous probe may still be about to bind the driver */
+	async_synchronize_full_domain(&async_probe_domain);
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
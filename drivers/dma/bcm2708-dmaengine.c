@@ -1,8 +1,12 @@
 /*
  * BCM2708 DMA engine support
  *
- * This driver only supports cyclic DMA transfers
- * as needed for the I2S module.
+ * This driver supports cyclic DMA transfers as needed for the I2S
+ * module, and single slave scatter-gather transfers.
+ *
+ * The DREQ line of a channel is taken from the slave config, or from
+ * chan->private as set by the platform's channel filter when the client
+ * does not know about DREQs.
  *
  * Author:      Florian Meier <florian.meier@koalo.de>
  *              Copyright 2013
@@ -59,7 +63,6 @@ struct bcm2708_chan {
 	struct list_head node;
 
 	struct dma_slave_config	cfg;
-	bool cyclic;
 
 	int ch;
 	struct bcm2708_desc *desc;
@@ -71,6 +74,7 @@ struct bcm2708_chan {
 struct bcm2708_desc {
 	struct virt_dma_desc vd;
 	enum dma_transfer_direction dir;
+	bool cyclic;
 
 	unsigned int control_block_size;
 	struct bcm2708_dma_cb *control_block_base;
@@ -141,14 +145,18 @@ static irqreturn_t bcm2708_dma_callback(int irq, void *data)
 
 	d = c->desc;
 
-	if (d) {
-		/* TODO Only works for cyclic DMA */
-		vchan_cyclic_callback(&d->vd);
-	}
+	if (d && !d->cyclic) {
+		/* The last control block of the transfer is done */
+		vchan_cookie_complete(&d->vd);
+		bcm2708_dma_start_desc(c);
+	} else {
+		if (d)
+			vchan_cyclic_callback(&d->vd);
 
-	/* Keep the DMA engine running */
-	dsb(); /* ARM synchronization barrier */
-	writel(BCM2708_DMA_ACTIVE, c->chan_base + BCM2708_DMA_CS);
+		/* Keep the DMA engine running */
+		dsb(); /* ARM synchronization barrier */
+		writel(BCM2708_DMA_ACTIVE, c->chan_base + BCM2708_DMA_CS);
+	}
 
 	spin_unlock_irqrestore(&c->vc.lock, flags);
 
@@ -178,12 +186,21 @@ static size_t bcm2708_dma_desc_size(struct bcm2708_desc *d)
 	return d->size;
 }
 
-static size_t bcm2708_dma_desc_size_pos(struct bcm2708_desc *d, dma_addr_t addr)
+/*
+ * Bytes left in @d with the engine's memory address at @addr and its
+ * control block at @cb.  Right after a block completes the address still
+ * points just past it, which counts as that block being done.  A block
+ * that has been loaded but not started yet is found through @cb.
+ * Returns -EINVAL if neither places the engine within @d.
+ */
+static ssize_t bcm2708_dma_desc_size_pos(struct bcm2708_desc *d,
+					 dma_addr_t addr, dma_addr_t cb)
 {
 	unsigned i;
-	size_t size;
+	size_t size = 0;
+	bool found = false;
 
-	for (size = i = 0; i < d->frames; i++) {
+	for (i = 0; i < d->frames; i++) {
 		struct bcm2708_dma_cb *control_block =
 			&d->control_block_base[i];
 		size_t this_size = control_block->length;
@@ -194,11 +211,23 @@ static size_t bcm2708_dma_desc_size_pos(struct bcm2708_desc *d, dma_addr_t addr)
 		else
 			dma = control_block->src;
 
-		if (size)
+		if (found) {
 			size += this_size;
-		else if (addr >= dma && addr < dma + this_size)
+		} else if (addr >= dma && addr <= dma + this_size) {
 			size += dma + this_size - addr;
+			found = true;
+		}
 	}
+	if (found)
+		return size;
+
+	if (cb < d->control_block_base_phys)
+		return -EINVAL;
+	i = (cb - d->control_block_base_phys) / sizeof(struct bcm2708_dma_cb);
+	if (i >= d->frames)
+		return -EINVAL;
+	for (; i < d->frames; i++)
+		size += d->control_block_base[i].length;
 
 	return size;
 }
@@ -222,7 +251,8 @@ static enum dma_status bcm2708_dma_tx_status(struct dma_chan *chan,
 			bcm2708_dma_desc_size(to_bcm2708_dma_desc(&vd->tx));
 	} else if (c->desc && c->desc->vd.tx.cookie == cookie) {
 		struct bcm2708_desc *d = c->desc;
-		dma_addr_t pos;
+		dma_addr_t pos, cb;
+		ssize_t residue;
 
 		if (d->dir == DMA_MEM_TO_DEV)
 			pos = readl(c->chan_base + BCM2708_DMA_SOURCE_AD);
@@ -230,8 +260,19 @@ static enum dma_status bcm2708_dma_tx_status(struct dma_chan *chan,
 			pos = readl(c->chan_base + BCM2708_DMA_DEST_AD);
 		else
 			pos = 0;
+		cb = readl(c->chan_base + BCM2708_DMA_ADDR);
 
-		txstate->residue = bcm2708_dma_desc_size_pos(d, pos);
+		/*
+		 * Better no residue than a made up one: a cyclic client
+		 * would take it as the ring having wrapped.
+		 */
+		residue = bcm2708_dma_desc_size_pos(d, pos, cb);
+		if (residue < 0) {
+			txstate->residue = 0;
+			ret = DMA_ERROR;
+		} else {
+			txstate->residue = residue;
+		}
 	} else {
 		txstate->residue = 0;
 	}
@@ -246,8 +287,6 @@ static void bcm2708_dma_issue_pending(struct dma_chan *chan)
 	struct bcm2708_chan *c = to_bcm2708_dma_chan(chan);
 	unsigned long flags;
 
-	c->cyclic = true; /* Nothing else is implemented */
-
 	spin_lock_irqsave(&c->vc.lock, flags);
 	if (vchan_issue_pending(&c->vc) && !c->desc)
 		bcm2708_dma_start_desc(c);
@@ -255,16 +294,19 @@ static void bcm2708_dma_issue_pending(struct dma_chan *chan)
 	spin_unlock_irqrestore(&c->vc.lock, flags);
 }
 
-static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
-	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
-	size_t period_len, enum dma_transfer_direction direction,
-	unsigned long flags, void *context)
+/*
+ * Allocate a descriptor of @frames control blocks for a transfer in
+ * @direction and fill in everything but the memory addresses, the lengths
+ * and the links.
+ */
+static struct bcm2708_desc *bcm2708_dma_desc_alloc(struct bcm2708_chan *c,
+	enum dma_transfer_direction direction, unsigned frames)
 {
-	struct bcm2708_chan *c = to_bcm2708_dma_chan(chan);
+	struct dma_chan *chan = &c->vc.chan;
 	enum dma_slave_buswidth dev_width;
 	struct bcm2708_desc *d;
 	dma_addr_t dev_addr;
-	unsigned es, sync_type;
+	unsigned sync_type, slave_id;
 	unsigned frame;
 
 	/* Grab configuration */
@@ -282,13 +324,12 @@ static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
 	}
 
 	/* Bus width translates to the element size (ES) */
-	switch (dev_width) {
-	case DMA_SLAVE_BUSWIDTH_4_BYTES:
-		es = BCM2708_DMA_DATA_TYPE_S32;
-		break;
-	default:
+	if (dev_width != DMA_SLAVE_BUSWIDTH_4_BYTES)
 		return NULL;
-	}
+
+	slave_id = c->cfg.slave_id;
+	if (!slave_id)
+		slave_id = (unsigned long)chan->private;
 
 	/* Now allocate and setup the descriptor. */
 	d = kzalloc(sizeof(*d), GFP_NOWAIT);
@@ -296,7 +337,7 @@ static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
 		return NULL;
 
 	d->dir = direction;
-	d->frames = buf_len / period_len;
+	d->frames = frames;
 
 	/* Allocate memory for control blocks */
 	d->control_block_size = d->frames * sizeof(struct bcm2708_dma_cb);
@@ -309,36 +350,60 @@ static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
 		return NULL;
 	}
 
-	/*
-	 * Iterate over all frames, create a control block
-	 * for each frame and link them together.
-	 */
 	for (frame = 0; frame < d->frames; frame++) {
 		struct bcm2708_dma_cb *control_block =
 			&d->control_block_base[frame];
 
-		/* Setup adresses */
 		if (d->dir == DMA_DEV_TO_MEM) {
 			control_block->info = BCM2708_DMA_D_INC;
 			control_block->src = dev_addr;
-			control_block->dst = buf_addr + frame * period_len;
 		} else {
 			control_block->info = BCM2708_DMA_S_INC;
-			control_block->src = buf_addr + frame * period_len;
 			control_block->dst = dev_addr;
 		}
 
-		/* Enable interrupt */
-		control_block->info |= BCM2708_DMA_INT_EN;
-
 		/* Setup synchronization */
 		if (sync_type != 0)
 			control_block->info |= sync_type;
 
 		/* Setup DREQ channel */
-		if (c->cfg.slave_id != 0)
-			control_block->info |=
-				BCM2708_DMA_PER_MAP(c->cfg.slave_id);
+		if (slave_id != 0)
+			control_block->info |= BCM2708_DMA_PER_MAP(slave_id);
+	}
+
+	return d;
+}
+
+static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction direction,
+	unsigned long flags, void *context)
+{
+	struct bcm2708_chan *c = to_bcm2708_dma_chan(chan);
+	struct bcm2708_desc *d;
+	unsigned frame;
+
+	d = bcm2708_dma_desc_alloc(c, direction, buf_len / period_len);
+	if (!d)
+		return NULL;
+	d->cyclic = true;
+
+	/*
+	 * Iterate over all frames, create a control block
+	 * for each frame and link them together.
+	 */
+	for (frame = 0; frame < d->frames; frame++) {
+		struct bcm2708_dma_cb *control_block =
+			&d->control_block_base[frame];
+
+		/* Setup adresses */
+		if (d->dir == DMA_DEV_TO_MEM)
+			control_block->dst = buf_addr + frame * period_len;
+		else
+			control_block->src = buf_addr + frame * period_len;
+
+		/* Enable interrupt */
+		control_block->info |= BCM2708_DMA_INT_EN;
 
 		/* Length of a frame */
 		control_block->length = period_len;
@@ -346,8 +411,7 @@ static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
 
 		/*
 		 * Next block is the next frame.
-		 * This DMA engine driver currently only supports cyclic DMA.
-		 * Therefore, wrap around at number of frames.
+		 * Cyclic transfers wrap around at number of frames.
 		 */
 		control_block->next = d->control_block_base_phys +
 			sizeof(struct bcm2708_dma_cb)
@@ -357,6 +421,43 @@ static struct dma_async_tx_descriptor *bcm2708_dma_prep_dma_cyclic(
 	return vchan_tx_prep(&c->vc, &d->vd, flags);
 }
 
+static struct dma_async_tx_descriptor *bcm2708_dma_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_transfer_direction direction, unsigned long flags,
+	void *context)
+{
+	struct bcm2708_chan *c = to_bcm2708_dma_chan(chan);
+	struct bcm2708_desc *d;
+	struct scatterlist *sg;
+	unsigned frame;
+
+	d = bcm2708_dma_desc_alloc(c, direction, sg_len);
+	if (!d)
+		return NULL;
+
+	/* One control block per segment, the last one stops the channel */
+	for_each_sg(sgl, sg, sg_len, frame) {
+		struct bcm2708_dma_cb *control_block =
+			&d->control_block_base[frame];
+
+		if (d->dir == DMA_DEV_TO_MEM)
+			control_block->dst = sg_dma_address(sg);
+		else
+			control_block->src = sg_dma_address(sg);
+
+		control_block->length = sg_dma_len(sg);
+		d->size += control_block->length;
+
+		if (frame + 1 < sg_len)
+			control_block->next = d->control_block_base_phys +
+				sizeof(struct bcm2708_dma_cb) * (frame + 1);
+		else
+			control_block->info |= BCM2708_DMA_INT_EN;
+	}
+
+	return vchan_tx_prep(&c->vc, &d->vd, flags);
+}
+
 static int bcm2708_dma_slave_config(struct bcm2708_chan *c,
 		struct dma_slave_config *cfg)
 {
@@ -393,6 +494,10 @@ static int bcm2708_dma_terminate_all(struct bcm2708_chan *c)
 	 * c->desc is NULL and exit.)
 	 */
 	if (c->desc) {
+		/* The active descriptor is on none of the vchan lists */
+		list_add_tail(&c->desc->vd.node, &head);
+		if (c->vc.cyclic == &c->desc->vd)
+			c->vc.cyclic = NULL;
 		c->desc = NULL;
 		bcm_dma_abort(c->chan_base);
 
@@ -495,6 +600,7 @@ static int bcm2708_dma_probe(struct platform_device *pdev)
 	od->ddev.device_tx_status = bcm2708_dma_tx_status;
 	od->ddev.device_issue_pending = bcm2708_dma_issue_pending;
 	od->ddev.device_prep_dma_cyclic = bcm2708_dma_prep_dma_cyclic;
+	od->ddev.device_prep_slave_sg = bcm2708_dma_prep_slave_sg;
 	od->ddev.device_control = bcm2708_dma_control;
 	od->ddev.dev = &pdev->dev;
 	INIT_LIST_HEAD(&od->ddev.channels);
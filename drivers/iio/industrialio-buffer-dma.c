@@ -0,0 +1,691 @@
+/* The industrial I/O core - DMA based block buffer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The kfifo buffer takes one sample at a time from the driver and copies it
+ * twice, into the fifo and out to userspace. Drivers for converters that
+ * stream at high rates instead let the hardware fill whole blocks of memory,
+ * and the blocks are either copied out with read() or, with no copy at all,
+ * mapped into userspace and passed back and forth with the
+ * IIO_BUFFER_BLOCK_*_IOCTLs.
+ *
+ * A block moves between three lists of the queue: incoming while the buffer
+ * is disabled, active while the driver fills it and outgoing once it is
+ * done, until read() has consumed it or userspace has dequeued it.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/buffer_dma.h>
+
+/* read() splits the buffer length into this many blocks */
+#define IIO_DMA_BUFFER_FILEIO_BLOCKS	4
+
+/* Limits on the blocks userspace can allocate */
+#define IIO_DMA_BUFFER_MAX_BLOCKS	64
+#define IIO_DMA_BUFFER_MAX_BLOCK_SIZE	(16 * 1024 * 1024)
+
+static void iio_dma_buffer_block_release(struct kref *kref)
+{
+	struct iio_dma_buffer_block *block =
+		container_of(kref, struct iio_dma_buffer_block, kref);
+	struct iio_dma_buffer_queue *queue = block->queue;
+
+	dma_free_coherent(queue->dev, block->size, block->vaddr,
+			  block->phys_addr);
+	kfree(block);
+	iio_buffer_put(&queue->buffer);
+}
+
+static struct iio_dma_buffer_block *iio_dma_buffer_alloc_block(
+	struct iio_dma_buffer_queue *queue, size_t size, unsigned int id)
+{
+	struct iio_dma_buffer_block *block;
+
+	block = kzalloc(sizeof(*block), GFP_KERNEL);
+	if (!block)
+		return NULL;
+
+	block->vaddr = dma_alloc_coherent(queue->dev, size, &block->phys_addr,
+					  GFP_KERNEL);
+	if (!block->vaddr) {
+		kfree(block);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&block->head);
+	block->size = size;
+	block->queue = queue;
+	block->id = id;
+	block->state = IIO_BLOCK_STATE_DEQUEUED;
+	kref_init(&block->kref);
+
+	/* Mappings of the block may outlive the driver's reference. */
+	iio_buffer_get(&queue->buffer);
+
+	return block;
+}
+
+/* Called with the queue lock held and the buffer disabled. */
+static void iio_dma_buffer_free_blocks(struct iio_dma_buffer_queue *queue)
+{
+	unsigned int i;
+
+	spin_lock_irq(&queue->list_lock);
+	INIT_LIST_HEAD(&queue->incoming);
+	INIT_LIST_HEAD(&queue->outgoing);
+	spin_unlock_irq(&queue->list_lock);
+
+	for (i = 0; i < queue->num_blocks; i++)
+		kref_put(&queue->blocks[i]->kref, iio_dma_buffer_block_release);
+
+	kfree(queue->blocks);
+	queue->blocks = NULL;
+	queue->num_blocks = 0;
+	queue->block_size = 0;
+	queue->fileio_block = NULL;
+}
+
+static int iio_dma_buffer_alloc_blocks_locked(struct iio_dma_buffer_queue *queue,
+	size_t size, unsigned int count)
+{
+	unsigned int i;
+
+	iio_dma_buffer_free_blocks(queue);
+
+	queue->blocks = kcalloc(count, sizeof(*queue->blocks), GFP_KERNEL);
+	if (!queue->blocks)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		queue->blocks[i] = iio_dma_buffer_alloc_block(queue, size, i);
+		if (!queue->blocks[i])
+			break;
+	}
+	if (i == 0) {
+		kfree(queue->blocks);
+		queue->blocks = NULL;
+		return -ENOMEM;
+	}
+
+	queue->num_blocks = i;
+	queue->block_size = size;
+
+	return 0;
+}
+
+/*
+ * Hand a block to the driver if the buffer is enabled, or put it on the
+ * incoming list until it is. Called with the queue lock held.
+ */
+static int iio_dma_buffer_queue_block(struct iio_dma_buffer_queue *queue,
+	struct iio_dma_buffer_block *block)
+{
+	int ret;
+
+	block->bytes_used = 0;
+	block->timestamp = 0;
+
+	spin_lock_irq(&queue->list_lock);
+	if (!queue->enabled) {
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&block->head, &queue->incoming);
+		spin_unlock_irq(&queue->list_lock);
+		return 0;
+	}
+	block->state = IIO_BLOCK_STATE_ACTIVE;
+	list_add_tail(&block->head, &queue->active);
+	spin_unlock_irq(&queue->list_lock);
+
+	ret = queue->ops->submit(queue, block);
+	if (ret) {
+		/* Try again the next time the buffer is enabled. */
+		spin_lock_irq(&queue->list_lock);
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_move(&block->head, &queue->incoming);
+		spin_unlock_irq(&queue->list_lock);
+	}
+
+	return ret;
+}
+
+/**
+ * iio_dma_buffer_block_done() - complete a block
+ * @block: the block, with bytes_used and timestamp set
+ *
+ * Moves the block to the outgoing list and wakes up readers. May be called
+ * from interrupt context.
+ */
+void iio_dma_buffer_block_done(struct iio_dma_buffer_block *block)
+{
+	struct iio_dma_buffer_queue *queue = block->queue;
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->list_lock, flags);
+	block->state = IIO_BLOCK_STATE_DONE;
+	list_move_tail(&block->head, &queue->outgoing);
+	spin_unlock_irqrestore(&queue->list_lock, flags);
+
+	wake_up_interruptible_poll(&queue->buffer.pollq, POLLIN | POLLRDNORM);
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_block_done);
+
+static void __iio_dma_buffer_disable(struct iio_dma_buffer_queue *queue)
+{
+	struct iio_dma_buffer_block *block;
+
+	spin_lock_irq(&queue->list_lock);
+	queue->enabled = false;
+	spin_unlock_irq(&queue->list_lock);
+
+	queue->ops->abort(queue);
+
+	/* Whatever the driver still held comes back empty. */
+	spin_lock_irq(&queue->list_lock);
+	list_for_each_entry(block, &queue->active, head) {
+		block->bytes_used = 0;
+		block->state = IIO_BLOCK_STATE_DONE;
+	}
+	list_splice_tail_init(&queue->active, &queue->outgoing);
+	spin_unlock_irq(&queue->list_lock);
+
+	wake_up_interruptible_poll(&queue->buffer.pollq, POLLIN | POLLRDNORM);
+}
+
+int iio_dma_buffer_enable(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+	spin_lock_irq(&queue->list_lock);
+	queue->enabled = true;
+	spin_unlock_irq(&queue->list_lock);
+
+	for (;;) {
+		spin_lock_irq(&queue->list_lock);
+		block = list_first_entry_or_null(&queue->incoming,
+				struct iio_dma_buffer_block, head);
+		if (block)
+			list_del_init(&block->head);
+		spin_unlock_irq(&queue->list_lock);
+		if (!block)
+			break;
+
+		ret = iio_dma_buffer_queue_block(queue, block);
+		if (ret) {
+			__iio_dma_buffer_disable(queue);
+			break;
+		}
+	}
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_enable);
+
+int iio_dma_buffer_disable(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+
+	mutex_lock(&queue->lock);
+	__iio_dma_buffer_disable(queue);
+	mutex_unlock(&queue->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_disable);
+
+static struct iio_dma_buffer_block *iio_dma_buffer_dequeue(
+	struct iio_dma_buffer_queue *queue)
+{
+	struct iio_dma_buffer_block *block;
+
+	spin_lock_irq(&queue->list_lock);
+	block = list_first_entry_or_null(&queue->outgoing,
+			struct iio_dma_buffer_block, head);
+	if (block) {
+		list_del_init(&block->head);
+		block->state = IIO_BLOCK_STATE_DEQUEUED;
+	}
+	spin_unlock_irq(&queue->list_lock);
+
+	return block;
+}
+
+static int iio_dma_buffer_request_update(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	size_t size;
+	unsigned int i;
+	int ret = 0;
+
+	if (!buffer->bytes_per_datum || !buffer->length)
+		return -EINVAL;
+
+	mutex_lock(&queue->lock);
+
+	/* Blocks allocated by userspace stay as they are. */
+	if (queue->mmap_mode)
+		goto out_unlock;
+
+	size = DIV_ROUND_UP(buffer->bytes_per_datum * buffer->length,
+			    IIO_DMA_BUFFER_FILEIO_BLOCKS);
+	size = PAGE_ALIGN(size);
+	if (size != queue->block_size) {
+		ret = iio_dma_buffer_alloc_blocks_locked(queue, size,
+				IIO_DMA_BUFFER_FILEIO_BLOCKS);
+		if (ret)
+			goto out_unlock;
+	}
+
+	/* Start over with all blocks empty and queued. */
+	spin_lock_irq(&queue->list_lock);
+	INIT_LIST_HEAD(&queue->incoming);
+	INIT_LIST_HEAD(&queue->outgoing);
+	for (i = 0; i < queue->num_blocks; i++) {
+		queue->blocks[i]->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&queue->blocks[i]->head, &queue->incoming);
+	}
+	spin_unlock_irq(&queue->list_lock);
+	queue->fileio_block = NULL;
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static int iio_dma_buffer_read(struct iio_buffer *buffer, size_t n,
+			       char __user *user_buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret;
+
+	if (n < buffer->bytes_per_datum)
+		return -EINVAL;
+
+	mutex_lock(&queue->lock);
+
+	if (queue->mmap_mode) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	/* Skip over blocks that came back empty. */
+	while (!queue->fileio_block) {
+		block = iio_dma_buffer_dequeue(queue);
+		if (!block) {
+			ret = 0;
+			goto out_unlock;
+		}
+		if (block->bytes_used) {
+			queue->fileio_block = block;
+			queue->fileio_pos = 0;
+		} else {
+			iio_dma_buffer_queue_block(queue, block);
+		}
+	}
+
+	block = queue->fileio_block;
+	n = rounddown(n, buffer->bytes_per_datum);
+	n = min_t(size_t, n, block->bytes_used - queue->fileio_pos);
+
+	if (copy_to_user(user_buffer, block->vaddr + queue->fileio_pos, n)) {
+		ret = -EFAULT;
+		goto out_unlock;
+	}
+
+	queue->fileio_pos += n;
+	if (queue->fileio_pos == block->bytes_used) {
+		queue->fileio_block = NULL;
+		iio_dma_buffer_queue_block(queue, block);
+	}
+
+	ret = n;
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static bool iio_dma_buffer_data_available(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	bool available;
+
+	spin_lock_irq(&queue->list_lock);
+	available = queue->fileio_block || !list_empty(&queue->outgoing);
+	spin_unlock_irq(&queue->list_lock);
+
+	return available;
+}
+
+static int iio_dma_buffer_get_bytes_per_datum(struct iio_buffer *buffer)
+{
+	return buffer->bytes_per_datum;
+}
+
+static int iio_dma_buffer_set_bytes_per_datum(struct iio_buffer *buffer,
+					      size_t bpd)
+{
+	buffer->bytes_per_datum = bpd;
+	return 0;
+}
+
+static int iio_dma_buffer_get_length(struct iio_buffer *buffer)
+{
+	return buffer->length;
+}
+
+static int iio_dma_buffer_set_length(struct iio_buffer *buffer, int length)
+{
+	/* Avoid an invalid state */
+	if (length < IIO_DMA_BUFFER_FILEIO_BLOCKS)
+		length = IIO_DMA_BUFFER_FILEIO_BLOCKS;
+	buffer->length = length;
+	return 0;
+}
+
+static void iio_dma_buffer_fill_block(struct iio_dma_buffer_queue *queue,
+	struct iio_dma_buffer_block *block, struct iio_buffer_block *desc)
+{
+	desc->id = block->id;
+	desc->size = block->size;
+	desc->bytes_used = block->bytes_used;
+	desc->flags = block->timestamp ?
+		IIO_BUFFER_BLOCK_FLAG_TIMESTAMP_VALID : 0;
+	desc->offset = block->id * queue->block_size;
+	desc->reserved = 0;
+	desc->timestamp = block->timestamp;
+}
+
+static int iio_dma_buffer_alloc_blocks(struct iio_buffer *buffer,
+				       struct iio_buffer_block_alloc_req *req)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	int ret;
+
+	if (!req->size || req->size > IIO_DMA_BUFFER_MAX_BLOCK_SIZE ||
+	    !req->count)
+		return -EINVAL;
+
+	mutex_lock(&queue->lock);
+
+	if (queue->enabled) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	ret = iio_dma_buffer_alloc_blocks_locked(queue, PAGE_ALIGN(req->size),
+			min_t(u32, req->count, IIO_DMA_BUFFER_MAX_BLOCKS));
+	if (ret) {
+		queue->mmap_mode = false;
+		goto out_unlock;
+	}
+
+	/* The blocks start out owned by userspace. */
+	queue->mmap_mode = true;
+	req->size = queue->block_size;
+	req->count = queue->num_blocks;
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static int iio_dma_buffer_free_blocks_user(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+	if (queue->enabled) {
+		ret = -EBUSY;
+	} else if (queue->mmap_mode) {
+		/* read() gets its own blocks at the next enable */
+		iio_dma_buffer_free_blocks(queue);
+		queue->mmap_mode = false;
+	}
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static int iio_dma_buffer_query_block(struct iio_buffer *buffer,
+				      struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+	if (!queue->mmap_mode)
+		ret = -EBUSY;
+	else if (desc->id >= queue->num_blocks)
+		ret = -EINVAL;
+	else
+		iio_dma_buffer_fill_block(queue, queue->blocks[desc->id], desc);
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static int iio_dma_buffer_enqueue_block(struct iio_buffer *buffer,
+					struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret;
+
+	mutex_lock(&queue->lock);
+
+	if (!queue->mmap_mode) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+	if (desc->id >= queue->num_blocks) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block = queue->blocks[desc->id];
+	if (block->state != IIO_BLOCK_STATE_DEQUEUED) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	ret = iio_dma_buffer_queue_block(queue, block);
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static int iio_dma_buffer_dequeue_block(struct iio_buffer *buffer,
+					struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+	if (!queue->mmap_mode) {
+		ret = -EBUSY;
+	} else {
+		block = iio_dma_buffer_dequeue(queue);
+		if (block)
+			iio_dma_buffer_fill_block(queue, block, desc);
+		else
+			ret = -EAGAIN;
+	}
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static void iio_dma_buffer_vm_open(struct vm_area_struct *vma)
+{
+	struct iio_dma_buffer_block *block = vma->vm_private_data;
+
+	kref_get(&block->kref);
+}
+
+static void iio_dma_buffer_vm_close(struct vm_area_struct *vma)
+{
+	struct iio_dma_buffer_block *block = vma->vm_private_data;
+
+	kref_put(&block->kref, iio_dma_buffer_block_release);
+}
+
+static const struct vm_operations_struct iio_dma_buffer_vm_ops = {
+	.open = iio_dma_buffer_vm_open,
+	.close = iio_dma_buffer_vm_close,
+};
+
+static int iio_dma_buffer_mmap(struct iio_buffer *buffer,
+			       struct vm_area_struct *vma)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	int ret;
+
+	mutex_lock(&queue->lock);
+
+	if (!queue->mmap_mode) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+	if (offset % queue->block_size ||
+	    offset / queue->block_size >= queue->num_blocks) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block = queue->blocks[offset / queue->block_size];
+	if (vma->vm_end - vma->vm_start > block->size) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	/* The offset selected the block, map it from its start. */
+	vma->vm_pgoff = 0;
+	ret = dma_mmap_coherent(queue->dev, vma, block->vaddr,
+				block->phys_addr, vma->vm_end - vma->vm_start);
+	if (ret)
+		goto out_unlock;
+
+	vma->vm_private_data = block;
+	vma->vm_ops = &iio_dma_buffer_vm_ops;
+	kref_get(&block->kref);
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+static void iio_dma_buffer_release(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+
+	mutex_destroy(&queue->lock);
+	kfree(queue);
+}
+
+static IIO_BUFFER_ENABLE_ATTR;
+static IIO_BUFFER_LENGTH_ATTR;
+
+static struct attribute *iio_dma_buffer_attributes[] = {
+	&dev_attr_length.attr,
+	&dev_attr_enable.attr,
+	NULL,
+};
+
+static struct attribute_group iio_dma_buffer_attribute_group = {
+	.attrs = iio_dma_buffer_attributes,
+	.name = "buffer",
+};
+
+static const struct iio_buffer_access_funcs iio_dma_buffer_access_funcs = {
+	.read_first_n = iio_dma_buffer_read,
+	.data_available = iio_dma_buffer_data_available,
+	.request_update = iio_dma_buffer_request_update,
+	.get_bytes_per_datum = iio_dma_buffer_get_bytes_per_datum,
+	.set_bytes_per_datum = iio_dma_buffer_set_bytes_per_datum,
+	.get_length = iio_dma_buffer_get_length,
+	.set_length = iio_dma_buffer_set_length,
+	.release = iio_dma_buffer_release,
+
+	.alloc_blocks = iio_dma_buffer_alloc_blocks,
+	.free_blocks = iio_dma_buffer_free_blocks_user,
+	.query_block = iio_dma_buffer_query_block,
+	.enqueue_block = iio_dma_buffer_enqueue_block,
+	.dequeue_block = iio_dma_buffer_dequeue_block,
+	.mmap = iio_dma_buffer_mmap,
+};
+
+struct iio_buffer *iio_dma_buffer_allocate(struct device *dev,
+	const struct iio_dma_buffer_ops *ops, void *driver_data)
+{
+	struct iio_dma_buffer_queue *queue;
+
+	queue = kzalloc(sizeof(*queue), GFP_KERNEL);
+	if (!queue)
+		return NULL;
+
+	iio_buffer_init(&queue->buffer);
+	queue->buffer.attrs = &iio_dma_buffer_attribute_group;
+	queue->buffer.access = &iio_dma_buffer_access_funcs;
+	queue->buffer.length = PAGE_SIZE / sizeof(u16);
+
+	queue->dev = dev;
+	queue->ops = ops;
+	queue->driver_data = driver_data;
+
+	mutex_init(&queue->lock);
+	spin_lock_init(&queue->list_lock);
+	INIT_LIST_HEAD(&queue->incoming);
+	INIT_LIST_HEAD(&queue->active);
+	INIT_LIST_HEAD(&queue->outgoing);
+
+	return &queue->buffer;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_allocate);
+
+/**
+ * iio_dma_buffer_free() - free a DMA buffer
+ * @buffer: the buffer, disabled
+ *
+ * Blocks that are still mapped into userspace are freed when they are
+ * unmapped.
+ */
+void iio_dma_buffer_free(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+
+	mutex_lock(&queue->lock);
+	iio_dma_buffer_free_blocks(queue);
+	mutex_unlock(&queue->lock);
+
+	iio_buffer_put(buffer);
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_free);
+
+MODULE_LICENSE("GPL");
@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/uaccess.h>
 
 #include <linux/iio/iio.h>
 #include "iio_core.h"
@@ -120,6 +122,103 @@ void iio_buffer_wakeup_poll(struct iio_dev *indio_dev)
 	wake_up(&indio_dev->buffer->pollq);
 }
 
+/**
+ * iio_buffer_mmap() - chrdev mmap for block access to the buffer
+ */
+int iio_buffer_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct iio_dev *indio_dev = filp->private_data;
+	struct iio_buffer *rb = indio_dev->buffer;
+
+	if (!indio_dev->info)
+		return -ENODEV;
+
+	if (!rb || !rb->access->mmap)
+		return -ENODEV;
+
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	return rb->access->mmap(rb, vma);
+}
+
+static int iio_buffer_dequeue_block(struct iio_dev *indio_dev,
+				    struct file *filp,
+				    struct iio_buffer_block *block)
+{
+	struct iio_buffer *rb = indio_dev->buffer;
+	int ret;
+
+	do {
+		if (!iio_buffer_data_available(rb)) {
+			if (filp->f_flags & O_NONBLOCK)
+				return -EAGAIN;
+
+			ret = wait_event_interruptible(rb->pollq,
+					iio_buffer_data_available(rb) ||
+					indio_dev->info == NULL);
+			if (ret)
+				return ret;
+			if (indio_dev->info == NULL)
+				return -ENODEV;
+		}
+
+		ret = rb->access->dequeue_block(rb, block);
+	} while (ret == -EAGAIN && !(filp->f_flags & O_NONBLOCK));
+
+	return ret;
+}
+
+/**
+ * iio_buffer_ioctl() - chrdev ioctls for block access to the buffer
+ */
+long iio_buffer_ioctl(struct iio_dev *indio_dev, struct file *filp,
+		      unsigned int cmd, unsigned long arg)
+{
+	struct iio_buffer *rb = indio_dev->buffer;
+	void __user *argp = (void __user *)arg;
+	struct iio_buffer_block_alloc_req req;
+	struct iio_buffer_block block;
+	int ret;
+
+	if (!rb || !rb->access->alloc_blocks)
+		return -EINVAL;
+
+	switch (cmd) {
+	case IIO_BUFFER_BLOCK_ALLOC_IOCTL:
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+		ret = rb->access->alloc_blocks(rb, &req);
+		if (ret)
+			return ret;
+		if (copy_to_user(argp, &req, sizeof(req)))
+			return -EFAULT;
+		return 0;
+	case IIO_BUFFER_BLOCK_FREE_IOCTL:
+		return rb->access->free_blocks(rb);
+	case IIO_BUFFER_BLOCK_QUERY_IOCTL:
+		if (copy_from_user(&block, argp, sizeof(block)))
+			return -EFAULT;
+		ret = rb->access->query_block(rb, &block);
+		break;
+	case IIO_BUFFER_BLOCK_ENQUEUE_IOCTL:
+		if (copy_from_user(&block, argp, sizeof(block)))
+			return -EFAULT;
+		return rb->access->enqueue_block(rb, &block);
+	case IIO_BUFFER_BLOCK_DEQUEUE_IOCTL:
+		ret = iio_buffer_dequeue_block(indio_dev, filp, &block);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (ret)
+		return ret;
+	if (copy_to_user(argp, &block, sizeof(block)))
+		return -EFAULT;
+	return 0;
+}
+
 void iio_buffer_init(struct iio_buffer *buffer)
 {
 	INIT_LIST_HEAD(&buffer->demux_list);
@@ -32,6 +32,7 @@
 #define DRIVER_DESC		"USB Video Class driver"
 
 unsigned int uvc_clock_param = CLOCK_MONOTONIC;
+unsigned int uvc_async_param = 1;
 unsigned int uvc_no_drop_param;
 static unsigned int uvc_quirks_param = -1;
 unsigned int uvc_trace_param;
@@ -1641,6 +1642,8 @@ static void uvc_delete(struct uvc_device *dev)
 		usb_driver_release_interface(&uvc_driver.driver,
 			streaming->intf);
 		usb_put_intf(streaming->intf);
+		if (streaming->async_wq)
+			destroy_workqueue(streaming->async_wq);
 		kfree(streaming->format);
 		kfree(streaming->header.bmaControls);
 		kfree(streaming);
@@ -2041,6 +2044,8 @@ static int uvc_clock_param_set(const char *val, struct kernel_param *kp)
 	return 0;
 }
 
+module_param_named(async, uvc_async_param, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(async, "Copy video data in a worker (SMP only)");
 module_param_call(clock, uvc_clock_param_set, uvc_clock_param_get,
 		  &uvc_clock_param, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(clock, "Video buffers timestamp clock");
@@ -1052,20 +1052,32 @@ static int uvc_video_decode_start(struct uvc_streaming *stream,
 	return data[0];
 }
 
-static void uvc_video_decode_data(struct uvc_streaming *stream,
+static void uvc_video_decode_data(struct uvc_urb *uvc_urb,
 		struct uvc_buffer *buf, const __u8 *data, int len)
 {
+	struct uvc_copy_op *op;
 	unsigned int maxlen, nbytes;
 	void *mem;
 
 	if (len <= 0)
 		return;
 
-	/* Copy the video data to the buffer. */
+	/* Copy the video data to the buffer, or leave that to
+	 * uvc_video_copy_data_work() if the stream has a workqueue for it.
+	 */
 	maxlen = buf->length - buf->bytesused;
 	mem = buf->mem + buf->bytesused;
 	nbytes = min((unsigned int)len, maxlen);
-	memcpy(mem, data, nbytes);
+	if (uvc_urb->stream->async_wq) {
+		op = &uvc_urb->copy_operations[uvc_urb->async_operations++];
+		kref_get(&buf->ref);
+		op->buf = buf;
+		op->dst = mem;
+		op->src = data;
+		op->len = nbytes;
+	} else {
+		memcpy(mem, data, nbytes);
+	}
 	buf->bytesused += nbytes;
 
 	/* Complete the current frame if the buffer size was exceeded. */
@@ -1138,6 +1150,7 @@ static int uvc_video_encode_data(struct uvc_streaming *stream,
 static void uvc_video_decode_isoc(struct urb *urb, struct uvc_streaming *stream,
 	struct uvc_buffer *buf)
 {
+	struct uvc_urb *uvc_urb = urb->context;
 	u8 *mem;
 	int ret, i;
 
@@ -1165,7 +1178,7 @@ static void uvc_video_decode_isoc(struct urb *urb, struct uvc_streaming *stream,
 			continue;
 
 		/* Decode the payload data. */
-		uvc_video_decode_data(stream, buf, mem + ret,
+		uvc_video_decode_data(uvc_urb, buf, mem + ret,
 			urb->iso_frame_desc[i].actual_length - ret);
 
 		/* Process the header again. */
@@ -1186,6 +1199,7 @@ static void uvc_video_decode_isoc(struct urb *urb, struct uvc_streaming *stream,
 static void uvc_video_decode_bulk(struct urb *urb, struct uvc_streaming *stream,
 	struct uvc_buffer *buf)
 {
+	struct uvc_urb *uvc_urb = urb->context;
 	u8 *mem;
 	int len, ret;
 
@@ -1230,7 +1244,7 @@ static void uvc_video_decode_bulk(struct urb *urb, struct uvc_streaming *stream,
 
 	/* Process video data. */
 	if (!stream->bulk.skip_payload && buf != NULL)
-		uvc_video_decode_data(stream, buf, mem, len);
+		uvc_video_decode_data(uvc_urb, buf, mem, len);
 
 	/* Detect the payload end by a URB smaller than the maximum size (or
 	 * a payload size equal to the maximum) and process the header again.
@@ -1294,9 +1308,36 @@ static void uvc_video_encode_bulk(struct urb *urb, struct uvc_streaming *stream,
 	urb->transfer_buffer_length = stream->urb_size - len;
 }
 
+/*
+ * Copy the video data of a completed URB to the video buffers, release the
+ * buffers and resubmit the URB. Runs on the stream's ordered async_wq, so
+ * copies are done in URB completion order.
+ */
+static void uvc_video_copy_data_work(struct work_struct *work)
+{
+	struct uvc_urb *uvc_urb = container_of(work, struct uvc_urb, work);
+	struct uvc_copy_op *op;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < uvc_urb->async_operations; ++i) {
+		op = &uvc_urb->copy_operations[i];
+		memcpy(op->dst, op->src, op->len);
+		uvc_queue_buffer_release(op->buf);
+	}
+	uvc_urb->async_operations = 0;
+
+	/* The URB is poisoned when streaming stops. */
+	ret = usb_submit_urb(uvc_urb->urb, GFP_KERNEL);
+	if (ret < 0 && ret != -EPERM)
+		uvc_printk(KERN_ERR, "Failed to resubmit video URB (%d).\n",
+			ret);
+}
+
 static void uvc_video_complete(struct urb *urb)
 {
-	struct uvc_streaming *stream = urb->context;
+	struct uvc_urb *uvc_urb = urb->context;
+	struct uvc_streaming *stream = uvc_urb->stream;
 	struct uvc_video_queue *queue = &stream->queue;
 	struct uvc_buffer *buf = NULL;
 	unsigned long flags;
@@ -1328,6 +1369,12 @@ static void uvc_video_complete(struct urb *urb)
 
 	stream->decode(urb, stream, buf);
 
+	/* Resubmit once the copies queued by the decode are done. */
+	if (uvc_urb->async_operations) {
+		queue_work(stream->async_wq, &uvc_urb->work);
+		return;
+	}
+
 	if ((ret = usb_submit_urb(urb, GFP_ATOMIC)) < 0) {
 		uvc_printk(KERN_ERR, "Failed to resubmit video URB (%d).\n",
 			ret);
@@ -1425,14 +1472,24 @@ static void uvc_uninit_video(struct uvc_streaming *stream, int free_buffers)
 
 	uvc_video_stats_stop(stream);
 
+	/* Poison the URBs rather than kill them, as uvc_video_copy_data_work()
+	 * would otherwise resubmit those whose data it's still copying.
+	 */
+	for (i = 0; i < UVC_URBS; ++i) {
+		if (stream->uvc_urb[i].urb)
+			usb_poison_urb(stream->uvc_urb[i].urb);
+	}
+
+	if (stream->async_wq)
+		flush_workqueue(stream->async_wq);
+
 	for (i = 0; i < UVC_URBS; ++i) {
-		urb = stream->urb[i];
+		urb = stream->uvc_urb[i].urb;
 		if (urb == NULL)
 			continue;
 
-		usb_kill_urb(urb);
 		usb_free_urb(urb);
-		stream->urb[i] = NULL;
+		stream->uvc_urb[i].urb = NULL;
 	}
 
 	if (free_buffers)
@@ -1488,7 +1545,7 @@ static int uvc_init_video_isoc(struct uvc_streaming *stream,
 		}
 
 		urb->dev = stream->dev->udev;
-		urb->context = stream;
+		urb->context = &stream->uvc_urb[i];
 		urb->pipe = usb_rcvisocpipe(stream->dev->udev,
 				ep->desc.bEndpointAddress);
 #ifndef CONFIG_DMA_NONCOHERENT
@@ -1508,7 +1565,7 @@ static int uvc_init_video_isoc(struct uvc_streaming *stream,
 			urb->iso_frame_desc[j].length = psize;
 		}
 
-		stream->urb[i] = urb;
+		stream->uvc_urb[i].urb = urb;
 	}
 
 	return 0;
@@ -1555,13 +1612,13 @@ static int uvc_init_video_bulk(struct uvc_streaming *stream,
 
 		usb_fill_bulk_urb(urb, stream->dev->udev, pipe,
 			stream->urb_buffer[i], size, uvc_video_complete,
-			stream);
+			&stream->uvc_urb[i]);
 #ifndef CONFIG_DMA_NONCOHERENT
 		urb->transfer_flags = URB_NO_TRANSFER_DMA_MAP;
 		urb->transfer_dma = stream->urb_dma[i];
 #endif
 
-		stream->urb[i] = urb;
+		stream->uvc_urb[i].urb = urb;
 	}
 
 	return 0;
@@ -1652,7 +1709,7 @@ static int uvc_init_video(struct uvc_streaming *stream, gfp_t gfp_flags)
 
 	/* Submit the URBs. */
 	for (i = 0; i < UVC_URBS; ++i) {
-		ret = usb_submit_urb(stream->urb[i], gfp_flags);
+		ret = usb_submit_urb(stream->uvc_urb[i].urb, gfp_flags);
 		if (ret < 0) {
 			uvc_printk(KERN_ERR, "Failed to submit URB %u "
 					"(%d).\n", i, ret);
@@ -1755,6 +1812,20 @@ int uvc_video_init(struct uvc_streaming *stream)
 
 	atomic_set(&stream->active, 0);
 
+	for (i = 0; i < UVC_URBS; ++i) {
+		stream->uvc_urb[i].stream = stream;
+		INIT_WORK(&stream->uvc_urb[i].work, uvc_video_copy_data_work);
+	}
+
+	/* Copying the video data out of completed URBs in interrupt context
+	 * takes hundreds of MB/s of memcpy at high resolutions. Leave it to a
+	 * worker, which the scheduler can move to another CPU.
+	 */
+	if (uvc_async_param && num_online_cpus() > 1 &&
+	    stream->type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		stream->async_wq = alloc_ordered_workqueue("uvcvideo",
+							   WQ_HIGHPRI);
+
 	/* Initialize the video buffers queue. */
 	ret = uvc_queue_init(&stream->queue, stream->type, !uvc_no_drop_param);
 	if (ret)
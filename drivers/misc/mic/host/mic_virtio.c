@@ -328,6 +328,7 @@ static inline void mic_virtio_device_reset(struct mic_vdev *mvdev)
 		mvdev->mvr[i].vring.info->avail_idx = 0;
 		vrh->completed = 0;
 		vrh->last_avail_idx = 0;
+		vrh->avail_idx = 0;
 		vrh->last_used_idx = 0;
 	}
 
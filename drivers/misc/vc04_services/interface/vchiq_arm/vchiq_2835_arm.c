@@ -225,7 +225,7 @@ vchiq_copy_from_user(void *dst, const void *src, int size)
 	if ((uint32_t)src < TASK_SIZE) {
 		return copy_from_user(dst, src, size);
 	} else {
-		memcpy(dst, src, size);
+		memcpy_bulk(dst, src, size);
 		return 0;
 	}
 }
@@ -87,13 +87,20 @@
 #include <linux/crc32.h>
 #include <linux/math64.h>
 #include <linux/random.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 #include "ubi.h"
 
-static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
+/*
+ * The headers of the PEBs are read ahead in batches of
+ * UBI_SCAN_BATCH_PER_THREAD PEBs per reader thread. Up to UBI_SCAN_MAX_THREADS
+ * threads are used, but not more than there are online CPUs.
+ */
+#define UBI_SCAN_MAX_THREADS 8
+#define UBI_SCAN_BATCH_PER_THREAD 16
 
-/* Temporary variables used during scanning */
-static struct ubi_ec_hdr *ech;
-static struct ubi_vid_hdr *vidh;
+static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai,
+			 struct ubi_vid_hdr *vidh);
 
 /**
  * add_to_list - add physical eraseblock to a list.
@@ -801,28 +808,166 @@ out_unlock:
 }
 
 /**
- * scan_peb - scan and process UBI headers of a PEB.
+ * read_peb_hdrs - read the UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @h: the PEB to read, the results are stored here as well
+ */
+static void read_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *h)
+{
+	h->ec_err = h->vid_err = 0;
+	h->bad = ubi_io_is_bad(ubi, h->pnum);
+	if (h->bad)
+		return;
+
+	h->ec_err = ubi_io_read_ec_hdr(ubi, h->pnum, h->ech, 0);
+	if (h->ec_err < 0 || h->ec_err == UBI_IO_FF ||
+	    h->ec_err == UBI_IO_FF_BITFLIPS) {
+		h->vid_err = UBI_IO_FF;
+		return;
+	}
+
+	h->vid_err = ubi_io_read_vid_hdr(ubi, h->pnum, h->vidh, 0);
+}
+
+/**
+ * struct read_hdrs_work - a slice of PEBs read by one thread.
+ * @ubi: UBI device description object
+ * @hdrs: the first PEB of the slice
+ * @count: number of PEBs in the slice
+ */
+struct read_hdrs_work {
+	struct ubi_device *ubi;
+	struct ubi_peb_hdrs *hdrs;
+	int count;
+};
+
+static void read_hdrs_async(void *data, async_cookie_t cookie)
+{
+	struct read_hdrs_work *work = data;
+	int i;
+
+	for (i = 0; i < work->count; i++)
+		read_peb_hdrs(work->ubi, &work->hdrs[i]);
+}
+
+static int scan_threads(void)
+{
+	return clamp_t(int, num_online_cpus(), 1, UBI_SCAN_MAX_THREADS);
+}
+
+/**
+ * ubi_read_peb_hdrs - read the UBI headers of a batch of PEBs.
+ * @ubi: UBI device description object
+ * @hdrs: the PEBs to read, the results are stored here as well
+ * @count: number of entries in @hdrs
+ *
+ * The batch is split into slices which are read in parallel on systems with
+ * more than one CPU. Reading is mostly waiting for the flash and checking
+ * CRCs, so PEBs behind different chips or controllers are read concurrently
+ * and CRC checking overlaps with the flash I/O of the other threads.
+ */
+void ubi_read_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *hdrs,
+		       int count)
+{
+	ASYNC_DOMAIN_EXCLUSIVE(domain);
+	struct read_hdrs_work work[UBI_SCAN_MAX_THREADS];
+	int i, slice, threads = scan_threads();
+
+	slice = DIV_ROUND_UP(count, threads);
+	for (i = 0; i < threads && count > 0; i++) {
+		work[i].ubi = ubi;
+		work[i].hdrs = hdrs;
+		work[i].count = min(slice, count);
+		hdrs += work[i].count;
+		count -= work[i].count;
+
+		/* The last slice is read by the calling thread */
+		if (count > 0)
+			async_schedule_domain(read_hdrs_async, &work[i],
+					      &domain);
+		else
+			read_hdrs_async(&work[i], 0);
+	}
+
+	async_synchronize_full_domain(&domain);
+}
+
+/**
+ * ubi_alloc_peb_hdrs - allocate a batch of header buffers.
+ * @ubi: UBI device description object
+ * @count: the number of allocated entries is returned here
+ *
+ * The batch is sized for the number of threads 'ubi_read_peb_hdrs()' uses.
+ * Returns %NULL if memory could not be allocated.
+ */
+struct ubi_peb_hdrs *ubi_alloc_peb_hdrs(struct ubi_device *ubi, int *count)
+{
+	struct ubi_peb_hdrs *hdrs;
+	int i, n = scan_threads() * UBI_SCAN_BATCH_PER_THREAD;
+
+	hdrs = kcalloc(n, sizeof(*hdrs), GFP_KERNEL);
+	if (!hdrs)
+		return NULL;
+
+	for (i = 0; i < n; i++) {
+		hdrs[i].ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		hdrs[i].vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+		if (!hdrs[i].ech || !hdrs[i].vidh) {
+			ubi_free_peb_hdrs(ubi, hdrs, i + 1);
+			return NULL;
+		}
+	}
+
+	*count = n;
+	return hdrs;
+}
+
+/**
+ * ubi_free_peb_hdrs - free a batch of header buffers.
+ * @ubi: UBI device description object
+ * @hdrs: the batch to free
+ * @count: number of entries in @hdrs
+ */
+void ubi_free_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *hdrs,
+		       int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		kfree(hdrs[i].ech);
+		if (hdrs[i].vidh)
+			ubi_free_vid_hdr(ubi, hdrs[i].vidh);
+	}
+	kfree(hdrs);
+}
+
+/**
+ * scan_peb - process UBI headers of a PEB.
  * @ubi: UBI device description object
  * @ai: attaching information
- * @pnum: the physical eraseblock number
+ * @h: the headers of the PEB, read by 'ubi_read_peb_hdrs()'
  * @vid: The volume ID of the found volume will be stored in this pointer
  * @sqnum: The sqnum of the found volume will be stored in this pointer
  *
- * This function reads UBI headers of PEB @pnum, checks them, and adds
- * information about this PEB to the corresponding list or RB-tree in the
- * "attaching info" structure. Returns zero if the physical eraseblock was
- * successfully handled and a negative error code in case of failure.
+ * This function checks the UBI headers of PEB @h->pnum, and adds information
+ * about this PEB to the corresponding list or RB-tree in the "attaching info"
+ * structure. Returns zero if the physical eraseblock was successfully handled
+ * and a negative error code in case of failure.
  */
 static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		    int pnum, int *vid, unsigned long long *sqnum)
+		    const struct ubi_peb_hdrs *h, int *vid,
+		    unsigned long long *sqnum)
 {
+	struct ubi_ec_hdr *ech = h->ech;
+	struct ubi_vid_hdr *vidh = h->vidh;
 	long long uninitialized_var(ec);
-	int err, bitflips = 0, vol_id = -1, ec_err = 0;
+	int err, bitflips = 0, vol_id = -1, ec_err = 0, pnum = h->pnum;
 
 	dbg_bld("scan PEB %d", pnum);
+	ai->scanned_peb_count += 1;
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
+	err = h->bad;
 	if (err < 0)
 		return err;
 	else if (err) {
@@ -830,7 +975,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	err = h->ec_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -912,7 +1057,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
+	err = h->vid_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -998,7 +1143,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		switch (vidh->compat) {
 		case UBI_COMPAT_DELETE:
 			if (vol_id != UBI_FM_SB_VOLUME_ID
-			    && vol_id != UBI_FM_DATA_VOLUME_ID) {
+			    && vol_id != UBI_FM_DATA_VOLUME_ID
+			    && vol_id != UBI_FM_JOURNAL_VOLUME_ID) {
 				ubi_msg("\"delete\" compatible internal volume %d:%d found, will remove it",
 					vol_id, lnum);
 			}
@@ -1224,28 +1370,30 @@ static void destroy_ai(struct ubi_attach_info *ai)
 static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		    int start)
 {
-	int err, pnum;
+	int err, pnum, i, count, batch;
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+	struct ubi_peb_hdrs *hdrs;
 
-	err = -ENOMEM;
-
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
-		return err;
+	hdrs = ubi_alloc_peb_hdrs(ubi, &batch);
+	if (!hdrs)
+		return -ENOMEM;
 
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
+	for (pnum = start; pnum < ubi->peb_count; pnum += count) {
+		count = min(ubi->peb_count - pnum, batch);
+		for (i = 0; i < count; i++)
+			hdrs[i].pnum = pnum + i;
+		ubi_read_peb_hdrs(ubi, hdrs, count);
 
-	for (pnum = start; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+		for (i = 0; i < count; i++) {
+			cond_resched();
 
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, NULL, NULL);
-		if (err < 0)
-			goto out_vidh;
+			dbg_gen("process PEB %d", pnum + i);
+			err = scan_peb(ubi, ai, &hdrs[i], NULL, NULL);
+			if (err < 0)
+				goto out;
+		}
 	}
 
 	ubi_msg("scanning is finished");
@@ -1256,7 +1404,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	err = late_analysis(ubi, ai);
 	if (err)
-		goto out_vidh;
+		goto out;
 
 	/*
 	 * In case of unknown erase counter we use the mean erase counter
@@ -1281,19 +1429,10 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		if (aeb->ec == UBI_UNKNOWN)
 			aeb->ec = ai->mean_ec;
 
-	err = self_check_ai(ubi, ai);
-	if (err)
-		goto out_vidh;
-
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+	err = self_check_ai(ubi, ai, hdrs[0].vidh);
 
-	return 0;
-
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
+out:
+	ubi_free_peb_hdrs(ubi, hdrs, batch);
 	return err;
 }
 
@@ -1311,49 +1450,47 @@ out_ech:
  */
 static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info *ai)
 {
-	int err, pnum, fm_anchor = -1;
+	int err = 0, pnum, i, count, batch, fm_anchor = -1;
 	unsigned long long max_sqnum = 0;
+	struct ubi_peb_hdrs *hdrs;
 
-	err = -ENOMEM;
+	hdrs = ubi_alloc_peb_hdrs(ubi, &batch);
+	if (!hdrs)
+		return -ENOMEM;
 
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
-		goto out;
+	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum += count) {
+		count = min(UBI_FM_MAX_START - pnum, batch);
+		for (i = 0; i < count; i++)
+			hdrs[i].pnum = pnum + i;
+		ubi_read_peb_hdrs(ubi, hdrs, count);
 
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
+		for (i = 0; i < count; i++) {
+			int vol_id = -1;
+			unsigned long long sqnum = -1;
+			cond_resched();
 
-	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum++) {
-		int vol_id = -1;
-		unsigned long long sqnum = -1;
-		cond_resched();
+			dbg_gen("process PEB %d", pnum + i);
+			err = scan_peb(ubi, ai, &hdrs[i], &vol_id, &sqnum);
+			if (err < 0)
+				goto out;
 
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, &vol_id, &sqnum);
-		if (err < 0)
-			goto out_vidh;
-
-		if (vol_id == UBI_FM_SB_VOLUME_ID && sqnum > max_sqnum) {
-			max_sqnum = sqnum;
-			fm_anchor = pnum;
+			if (vol_id == UBI_FM_SB_VOLUME_ID &&
+			    sqnum > max_sqnum) {
+				max_sqnum = sqnum;
+				fm_anchor = pnum + i;
+			}
 		}
 	}
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+out:
+	ubi_free_peb_hdrs(ubi, hdrs, batch);
+	if (err)
+		return err;
 
 	if (fm_anchor < 0)
 		return UBI_NO_FASTMAP;
 
 	return ubi_scan_fastmap(ubi, ai, fm_anchor);
-
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
-out:
-	return err;
 }
 
 #endif
@@ -1394,6 +1531,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	ktime_t start = ktime_get();
 
 	ai = alloc_ai("ubi_aeb_slab_cache");
 	if (!ai)
@@ -1429,6 +1567,11 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (err)
 		goto out_ai;
 
+	ubi_msg("attached by %s in %lld ms, %d of %d PEBs scanned, %d threads",
+		ubi->fm ? "fastmap" : "scanning",
+		ktime_to_ms(ktime_sub(ktime_get(), start)),
+		ai->scanned_peb_count, ubi->peb_count, scan_threads());
+
 	ubi->bad_peb_count = ai->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
 	ubi->corr_peb_count = ai->corr_peb_count;
@@ -1489,11 +1632,13 @@ out_ai:
  * self_check_ai - check the attaching information.
  * @ubi: UBI device description object
  * @ai: attaching information
+ * @vidh: buffer to read VID headers into
  *
  * This function returns zero if the attaching information is all right, and a
  * negative error code if not or if an error occurred.
  */
-static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai)
+static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai,
+			 struct ubi_vid_hdr *vidh)
 {
 	int pnum, err, vols_found = 0;
 	struct rb_node *rb1, *rb2;
@@ -80,7 +80,7 @@ static int __initdata mtd_devs;
 static struct mtd_dev_param __initdata mtd_dev_param[UBI_MAX_DEVICES];
 #ifdef CONFIG_MTD_UBI_FASTMAP
 /* UBI module parameter to enable fastmap automatically on non-fastmap images */
-static bool fm_autoconvert;
+static bool fm_autoconvert = IS_ENABLED(CONFIG_MTD_UBI_FASTMAP_AUTOCONVERT);
 #endif
 /* Root UBI "class" object (corresponds to '/<sysfs>/class/ubi/') */
 struct class *ubi_class;
@@ -141,6 +141,12 @@ static struct device_attribute dev_bgt_enabled =
 	__ATTR(bgt_enabled, S_IRUGO, dev_attribute_show, NULL);
 static struct device_attribute dev_mtd_num =
 	__ATTR(mtd_num, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_stalls =
+	__ATTR(erase_stalls, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_stall_us =
+	__ATTR(erase_stall_us, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_stall_max_us =
+	__ATTR(erase_stall_max_us, S_IRUGO, dev_attribute_show, NULL);
 
 /**
  * ubi_volume_notify - send a volume change notification.
@@ -378,6 +384,12 @@ static ssize_t dev_attribute_show(struct device *dev,
 		ret = sprintf(buf, "%d\n", ubi->thread_enabled);
 	else if (attr == &dev_mtd_num)
 		ret = sprintf(buf, "%d\n", ubi->mtd->index);
+	else if (attr == &dev_erase_stalls)
+		ret = sprintf(buf, "%u\n", ubi->erase_stalls);
+	else if (attr == &dev_erase_stall_us)
+		ret = sprintf(buf, "%llu\n", ubi->erase_stall_us);
+	else if (attr == &dev_erase_stall_max_us)
+		ret = sprintf(buf, "%u\n", ubi->erase_stall_max_us);
 	else
 		ret = -EINVAL;
 
@@ -445,6 +457,15 @@ static int ubi_sysfs_init(struct ubi_device *ubi, int *ref)
 	if (err)
 		return err;
 	err = device_create_file(&ubi->dev, &dev_mtd_num);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_stalls);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_stall_us);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_stall_max_us);
 	return err;
 }
 
@@ -454,6 +475,9 @@ static int ubi_sysfs_init(struct ubi_device *ubi, int *ref)
  */
 static void ubi_sysfs_close(struct ubi_device *ubi)
 {
+	device_remove_file(&ubi->dev, &dev_erase_stall_max_us);
+	device_remove_file(&ubi->dev, &dev_erase_stall_us);
+	device_remove_file(&ubi->dev, &dev_erase_stalls);
 	device_remove_file(&ubi->dev, &dev_mtd_num);
 	device_remove_file(&ubi->dev, &dev_bgt_enabled);
 	device_remove_file(&ubi->dev, &dev_min_io_size);
@@ -368,11 +368,153 @@ static void unmap_peb(struct ubi_attach_info *ai, int pnum)
 }
 
 /**
- * scan_pool - scans a pool for changed (no longer empty PEBs).
+ * fm_journal_rec_size - size of a fastmap journal record.
+ * @ubi: UBI device object
+ * @max_pool_size: maximal size of the user pool
+ * @max_wl_pool_size: maximal size of the WL pool
+ */
+static int fm_journal_rec_size(struct ubi_device *ubi, int max_pool_size,
+			       int max_wl_pool_size)
+{
+	return ALIGN(sizeof(struct ubi_fm_journal) +
+		     (max_pool_size + max_wl_pool_size) * sizeof(__be32),
+		     ubi->min_io_size);
+}
+
+/**
+ * fm_journal_max_records - number of records a fastmap journal can hold.
+ * @ubi: UBI device object
+ * @rec_size: size of a record
+ */
+static int fm_journal_max_records(struct ubi_device *ubi, int rec_size)
+{
+	return min_t(int, ubi->leb_size / rec_size, UBI_FM_MAX_JOURNAL);
+}
+
+/**
+ * read_fm_journal - read the records of a fastmap journal.
+ * @ubi: UBI device object
+ * @fm: the fastmap the journal belongs to
+ * @pebs: the PEBs of all records are appended to this array
+ * @count: number of entries in @pebs, updated on return
+ * @seen: bitmap of PEBs already in @pebs, updated on return
+ * @journaled: bitmap of the PEBs added to @pebs
+ *
+ * Records are appended one after another, so the journal ends at the first
+ * record which is not valid. A record torn by a power cut was never relied
+ * upon, as no PEB of its pools is used before the record is written.
+ *
+ * Returns 0 on success, UBI_BAD_FASTMAP if the journal is unusable.
+ * < 0 indicates an internal error.
+ */
+static int read_fm_journal(struct ubi_device *ubi,
+			   struct ubi_fastmap_layout *fm, int *pebs, int *count,
+			   unsigned long *seen, unsigned long *journaled)
+{
+	struct ubi_fm_journal *fmj;
+	int rec_size, max_records, i, j, n, pnum, ret = 0;
+	__be32 crc, tmp_crc;
+
+	rec_size = fm_journal_rec_size(ubi, fm->max_pool_size,
+				       fm->max_wl_pool_size);
+	max_records = fm_journal_max_records(ubi, rec_size);
+
+	fmj = kmalloc(rec_size, GFP_KERNEL);
+	if (!fmj)
+		return -ENOMEM;
+
+	fm->journal_records = 0;
+	for (i = 0; i < max_records; i++) {
+		ret = ubi_io_read(ubi, fmj, fm->journal->pnum,
+				  ubi->leb_start + i * rec_size, rec_size);
+		if (ret && ret != UBI_IO_BITFLIPS && !mtd_is_eccerr(ret))
+			goto out;
+		if (mtd_is_eccerr(ret) ||
+		    be32_to_cpu(fmj->magic) != UBI_FM_JOURNAL_MAGIC)
+			continue;
+
+		tmp_crc = be32_to_cpu(fmj->data_crc);
+		fmj->data_crc = 0;
+		crc = crc32(UBI_CRC32_INIT, fmj, rec_size);
+		if (crc != tmp_crc)
+			continue;
+
+		n = be16_to_cpu(fmj->pool_size) +
+		    be16_to_cpu(fmj->wl_pool_size);
+		if (fm->journal_records != i || be32_to_cpu(fmj->seq) != i ||
+		    be16_to_cpu(fmj->pool_size) > fm->max_pool_size ||
+		    be16_to_cpu(fmj->wl_pool_size) > fm->max_wl_pool_size) {
+			ubi_err("bad fastmap journal record %i", i);
+			ret = UBI_BAD_FASTMAP;
+			goto out;
+		}
+
+		for (j = 0; j < n; j++) {
+			pnum = be32_to_cpu(fmj->pebs[j]);
+			if (pnum < 0 || pnum >= ubi->peb_count) {
+				ubi_err("bad PEB %i in fastmap journal", pnum);
+				ret = UBI_BAD_FASTMAP;
+				goto out;
+			}
+			if (test_and_set_bit(pnum, seen))
+				continue;
+			set_bit(pnum, journaled);
+			pebs[(*count)++] = pnum;
+		}
+		fm->journal_records++;
+	}
+	ret = 0;
+
+out:
+	kfree(fmj);
+	return ret;
+}
+
+/**
+ * forget_pebs - drop what a fastmap knows about a set of PEBs.
+ * @ai: UBI attach info object
+ * @used: list of used PEBs which are not assigned to a volume
+ * @pebs: bitmap of the PEBs to forget
+ *
+ * A PEB handed out through a journaled pool may have been free, used or about
+ * to be erased when the fastmap was written. Its current state is only known
+ * after scanning it like the PEBs of the fastmap pools.
+ */
+static void forget_pebs(struct ubi_attach_info *ai, struct list_head *used,
+			unsigned long *pebs)
+{
+	struct list_head *lists[] = { &ai->free, &ai->erase, used };
+	struct ubi_ainf_volume *av;
+	struct ubi_ainf_peb *aeb, *tmp_aeb;
+	struct rb_node *node, *node2, *next;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		list_for_each_entry_safe(aeb, tmp_aeb, lists[i], u.list) {
+			if (test_bit(aeb->pnum, pebs)) {
+				list_del(&aeb->u.list);
+				kmem_cache_free(ai->aeb_slab_cache, aeb);
+			}
+		}
+
+	ubi_rb_for_each_entry(node, av, &ai->volumes, rb) {
+		for (node2 = rb_first(&av->root); node2; node2 = next) {
+			next = rb_next(node2);
+			aeb = rb_entry(node2, struct ubi_ainf_peb, u.rb);
+			if (test_bit(aeb->pnum, pebs)) {
+				rb_erase(&aeb->u.rb, &av->root);
+				av->leb_count--;
+				kmem_cache_free(ai->aeb_slab_cache, aeb);
+			}
+		}
+	}
+}
+
+/**
+ * scan_pool_peb - checks a PEB of a pool for changes.
  * @ubi: UBI device object
  * @ai: attach info object
- * @pebs: an array of all PEB numbers in the to be scanned pool
- * @pool_size: size of the pool (number of entries in @pebs)
+ * @h: headers of the PEB
  * @max_sqnum: pointer to the maximal sequence number
  * @eba_orphans: list of PEBs which need to be scanned
  * @free: list of PEBs which are most likely free (and go into @ai->free)
@@ -380,127 +522,147 @@ static void unmap_peb(struct ubi_attach_info *ai, int pnum)
  * Returns 0 on success, if the pool is unusable UBI_BAD_FASTMAP is returned.
  * < 0 indicates an internal error.
  */
-static int scan_pool(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		     int *pebs, int pool_size, unsigned long long *max_sqnum,
-		     struct list_head *eba_orphans, struct list_head *free)
+static int scan_pool_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+			 struct ubi_peb_hdrs *h, unsigned long long *max_sqnum,
+			 struct list_head *eba_orphans, struct list_head *free)
 {
-	struct ubi_vid_hdr *vh;
-	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vh = h->vidh;
+	struct ubi_ec_hdr *ech = h->ech;
 	struct ubi_ainf_peb *new_aeb, *tmp_aeb;
-	int i, pnum, err, found_orphan, ret = 0;
+	int pnum = h->pnum, err, found_orphan, scrub = 0;
+	int image_seq;
 
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
-		return -ENOMEM;
-
-	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vh) {
-		kfree(ech);
-		return -ENOMEM;
+	if (h->bad) {
+		ubi_err("bad PEB in fastmap pool!");
+		return h->bad < 0 ? h->bad : UBI_BAD_FASTMAP;
 	}
 
-	dbg_bld("scanning fastmap pool: size = %i", pool_size);
+	err = h->ec_err;
+	if (err && err != UBI_IO_BITFLIPS) {
+		ubi_err("unable to read EC header! PEB:%i err:%i", pnum, err);
+		return err > 0 ? UBI_BAD_FASTMAP : err;
+	} else if (err == UBI_IO_BITFLIPS)
+		scrub = 1;
 
 	/*
-	 * Now scan all PEBs in the pool to find changes which have been made
-	 * after the creation of the fastmap
+	 * Older UBI implementations have image_seq set to zero, so
+	 * we shouldn't fail if image_seq == 0.
 	 */
-	for (i = 0; i < pool_size; i++) {
-		int scrub = 0;
-		int image_seq;
+	image_seq = be32_to_cpu(ech->image_seq);
 
-		pnum = be32_to_cpu(pebs[i]);
+	if (image_seq && (image_seq != ubi->image_seq)) {
+		ubi_err("bad image seq: 0x%x, expected: 0x%x",
+			be32_to_cpu(ech->image_seq), ubi->image_seq);
+		return UBI_BAD_FASTMAP;
+	}
 
-		if (ubi_io_is_bad(ubi, pnum)) {
-			ubi_err("bad PEB in fastmap pool!");
-			ret = UBI_BAD_FASTMAP;
-			goto out;
-		}
+	err = h->vid_err;
+	if (err == UBI_IO_FF || err == UBI_IO_FF_BITFLIPS) {
+		unsigned long long ec = be64_to_cpu(ech->ec);
+		unmap_peb(ai, pnum);
+		dbg_bld("Adding PEB to free: %i", pnum);
+		if (err == UBI_IO_FF_BITFLIPS)
+			add_aeb(ai, free, pnum, ec, 1);
+		else
+			add_aeb(ai, free, pnum, ec, 0);
+		return 0;
+	} else if (err == 0 || err == UBI_IO_BITFLIPS) {
+		dbg_bld("Found non empty PEB:%i in pool", pnum);
 
-		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
-		if (err && err != UBI_IO_BITFLIPS) {
-			ubi_err("unable to read EC header! PEB:%i err:%i",
-				pnum, err);
-			ret = err > 0 ? UBI_BAD_FASTMAP : err;
-			goto out;
-		} else if (ret == UBI_IO_BITFLIPS)
+		if (err == UBI_IO_BITFLIPS)
 			scrub = 1;
 
-		/*
-		 * Older UBI implementations have image_seq set to zero, so
-		 * we shouldn't fail if image_seq == 0.
-		 */
-		image_seq = be32_to_cpu(ech->image_seq);
-
-		if (image_seq && (image_seq != ubi->image_seq)) {
-			ubi_err("bad image seq: 0x%x, expected: 0x%x",
-				be32_to_cpu(ech->image_seq), ubi->image_seq);
-			ret = UBI_BAD_FASTMAP;
-			goto out;
+		found_orphan = 0;
+		list_for_each_entry(tmp_aeb, eba_orphans, u.list) {
+			if (tmp_aeb->pnum == pnum) {
+				found_orphan = 1;
+				break;
+			}
+		}
+		if (found_orphan) {
+			list_del(&tmp_aeb->u.list);
+			kmem_cache_free(ai->aeb_slab_cache, tmp_aeb);
 		}
 
-		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
-		if (err == UBI_IO_FF || err == UBI_IO_FF_BITFLIPS) {
-			unsigned long long ec = be64_to_cpu(ech->ec);
-			unmap_peb(ai, pnum);
-			dbg_bld("Adding PEB to free: %i", pnum);
-			if (err == UBI_IO_FF_BITFLIPS)
-				add_aeb(ai, free, pnum, ec, 1);
-			else
-				add_aeb(ai, free, pnum, ec, 0);
-			continue;
-		} else if (err == 0 || err == UBI_IO_BITFLIPS) {
-			dbg_bld("Found non empty PEB:%i in pool", pnum);
+		new_aeb = kmem_cache_alloc(ai->aeb_slab_cache, GFP_KERNEL);
+		if (!new_aeb)
+			return -ENOMEM;
 
-			if (err == UBI_IO_BITFLIPS)
-				scrub = 1;
+		new_aeb->ec = be64_to_cpu(ech->ec);
+		new_aeb->pnum = pnum;
+		new_aeb->lnum = be32_to_cpu(vh->lnum);
+		new_aeb->sqnum = be64_to_cpu(vh->sqnum);
+		new_aeb->copy_flag = vh->copy_flag;
+		new_aeb->scrub = scrub;
 
-			found_orphan = 0;
-			list_for_each_entry(tmp_aeb, eba_orphans, u.list) {
-				if (tmp_aeb->pnum == pnum) {
-					found_orphan = 1;
-					break;
-				}
-			}
-			if (found_orphan) {
-				list_del(&tmp_aeb->u.list);
-				kmem_cache_free(ai->aeb_slab_cache, tmp_aeb);
-			}
+		if (*max_sqnum < new_aeb->sqnum)
+			*max_sqnum = new_aeb->sqnum;
 
-			new_aeb = kmem_cache_alloc(ai->aeb_slab_cache,
-						   GFP_KERNEL);
-			if (!new_aeb) {
-				ret = -ENOMEM;
-				goto out;
-			}
+		err = process_pool_aeb(ubi, ai, vh, new_aeb);
+		if (err)
+			return err > 0 ? UBI_BAD_FASTMAP : err;
+	} else {
+		/* We are paranoid and fall back to scanning mode */
+		ubi_err("fastmap pool PEBs contains damaged PEBs!");
+		return err > 0 ? UBI_BAD_FASTMAP : err;
+	}
 
-			new_aeb->ec = be64_to_cpu(ech->ec);
-			new_aeb->pnum = pnum;
-			new_aeb->lnum = be32_to_cpu(vh->lnum);
-			new_aeb->sqnum = be64_to_cpu(vh->sqnum);
-			new_aeb->copy_flag = vh->copy_flag;
-			new_aeb->scrub = scrub;
+	return 0;
+}
 
-			if (*max_sqnum < new_aeb->sqnum)
-				*max_sqnum = new_aeb->sqnum;
+/**
+ * scan_pool - scans a pool for changed (no longer empty PEBs).
+ * @ubi: UBI device object
+ * @ai: attach info object
+ * @pebs: an array of all PEB numbers in the to be scanned pool
+ * @pool_size: size of the pool (number of entries in @pebs)
+ * @max_sqnum: pointer to the maximal sequence number
+ * @eba_orphans: list of PEBs which need to be scanned
+ * @free: list of PEBs which are most likely free (and go into @ai->free)
+ *
+ * The headers of the PEBs are read ahead in batches, see
+ * 'ubi_read_peb_hdrs()'.
+ *
+ * Returns 0 on success, if the pool is unusable UBI_BAD_FASTMAP is returned.
+ * < 0 indicates an internal error.
+ */
+static int scan_pool(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		     int *pebs, int pool_size, unsigned long long *max_sqnum,
+		     struct list_head *eba_orphans, struct list_head *free)
+{
+	struct ubi_peb_hdrs *hdrs;
+	int i, j, count, batch, ret = 0;
 
-			err = process_pool_aeb(ubi, ai, vh, new_aeb);
-			if (err) {
-				ret = err > 0 ? UBI_BAD_FASTMAP : err;
-				goto out;
-			}
-		} else {
-			/* We are paranoid and fall back to scanning mode */
-			ubi_err("fastmap pool PEBs contains damaged PEBs!");
-			ret = err > 0 ? UBI_BAD_FASTMAP : err;
-			goto out;
+	hdrs = ubi_alloc_peb_hdrs(ubi, &batch);
+	if (!hdrs)
+		return -ENOMEM;
+
+	dbg_bld("scanning fastmap pool: size = %i", pool_size);
+
+	/*
+	 * Now scan all PEBs in the pool to find changes which have been made
+	 * after the creation of the fastmap
+	 */
+	for (i = 0; i < pool_size; i += count) {
+		count = min(pool_size - i, batch);
+		for (j = 0; j < count; j++) {
+			hdrs[j].pnum = pebs[i + j];
+			/* scan_fast() has already counted the first PEBs */
+			if (hdrs[j].pnum >= UBI_FM_MAX_START)
+				ai->scanned_peb_count++;
 		}
+		ubi_read_peb_hdrs(ubi, hdrs, count);
 
+		for (j = 0; j < count; j++) {
+			ret = scan_pool_peb(ubi, ai, &hdrs[j], max_sqnum,
+					    eba_orphans, free);
+			if (ret)
+				goto out;
+		}
 	}
 
 out:
-	ubi_free_vid_hdr(ubi, vh);
-	kfree(ech);
+	ubi_free_peb_hdrs(ubi, hdrs, batch);
 	return ret;
 }
 
@@ -551,7 +713,9 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 	struct ubi_fm_ec *fmec;
 	struct ubi_fm_volhdr *fmvhdr;
 	struct ubi_fm_eba *fm_eba;
-	int ret, i, j, pool_size, wl_pool_size;
+	int ret, i, j, pool_size, wl_pool_size, npebs = 0;
+	int *pebs = NULL;
+	unsigned long *seen = NULL, *journaled = NULL;
 	size_t fm_pos = 0, fm_size = ubi->fm_size;
 	unsigned long long max_sqnum = 0;
 	void *fm_raw = ubi->fm_buf;
@@ -810,13 +974,43 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		kfree(ech);
 	}
 
-	ret = scan_pool(ubi, ai, fmpl1->pebs, pool_size, &max_sqnum,
-			&eba_orphans, &free);
-	if (ret)
+	/*
+	 * Scan the PEBs of both pools and of all journal records in one go,
+	 * each PEB only once.
+	 */
+	pebs = kmalloc((pool_size + wl_pool_size + UBI_FM_MAX_JOURNAL *
+			(fm->max_pool_size + fm->max_wl_pool_size)) *
+		       sizeof(int), GFP_KERNEL);
+	seen = kcalloc(BITS_TO_LONGS(ubi->peb_count), sizeof(long),
+		       GFP_KERNEL);
+	journaled = kcalloc(BITS_TO_LONGS(ubi->peb_count), sizeof(long),
+			    GFP_KERNEL);
+	if (!pebs || !seen || !journaled) {
+		ret = -ENOMEM;
 		goto fail;
+	}
+
+	for (i = 0; i < pool_size + wl_pool_size; i++) {
+		int pnum = i < pool_size ? be32_to_cpu(fmpl1->pebs[i]) :
+			   be32_to_cpu(fmpl2->pebs[i - pool_size]);
+
+		if (pnum < 0 || pnum >= ubi->peb_count) {
+			ubi_err("bad PEB %i in fastmap pool", pnum);
+			goto fail_bad;
+		}
+		if (!test_and_set_bit(pnum, seen))
+			pebs[npebs++] = pnum;
+	}
+
+	if (fm->journal) {
+		ret = read_fm_journal(ubi, fm, pebs, &npebs, seen, journaled);
+		if (ret)
+			goto fail;
+		forget_pebs(ai, &used, journaled);
+	}
 
-	ret = scan_pool(ubi, ai, fmpl2->pebs, wl_pool_size, &max_sqnum,
-			&eba_orphans, &free);
+	ret = scan_pool(ubi, ai, pebs, npebs, &max_sqnum, &eba_orphans,
+			&free);
 	if (ret)
 		goto fail;
 
@@ -837,14 +1031,20 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 	 * and we cannot fall back to scanning.
 	 */
 	if (WARN_ON(count_fastmap_pebs(ai) != ubi->peb_count -
-		    ai->bad_peb_count - fm->used_blocks))
+		    ai->bad_peb_count - fm->used_blocks - !!fm->journal))
 		goto fail_bad;
 
+	kfree(pebs);
+	kfree(seen);
+	kfree(journaled);
 	return 0;
 
 fail_bad:
 	ret = UBI_BAD_FASTMAP;
 fail:
+	kfree(pebs);
+	kfree(seen);
+	kfree(journaled);
 	list_for_each_entry_safe(tmp_aeb, _tmp_aeb, &used, u.list) {
 		list_del(&tmp_aeb->u.list);
 		kmem_cache_free(ai->aeb_slab_cache, tmp_aeb);
@@ -861,6 +1061,53 @@ fail:
 	return ret;
 }
 
+/**
+ * check_fm_journal - check the journal PEB of a fastmap.
+ * @ubi: UBI device object
+ * @fmsb: the fastmap super block
+ * @ech: buffer for the EC header
+ * @vh: buffer for the VID header
+ *
+ * The journal PEB must still carry the VID header written together with the
+ * fastmap. Otherwise it has been erased and reused, and the journaled pools
+ * are lost.
+ *
+ * Returns 0 on success, UBI_BAD_FASTMAP if the journal is unusable.
+ * < 0 indicates an internal error.
+ */
+static int check_fm_journal(struct ubi_device *ubi, struct ubi_fm_sb *fmsb,
+			    struct ubi_ec_hdr *ech, struct ubi_vid_hdr *vh)
+{
+	int ret, pnum = be32_to_cpu(fmsb->journal_loc);
+
+	if (pnum < 0 || pnum >= ubi->peb_count)
+		return UBI_BAD_FASTMAP;
+
+	ret = ubi_io_is_bad(ubi, pnum);
+	if (ret)
+		return ret > 0 ? UBI_BAD_FASTMAP : ret;
+
+	ret = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	if (ret && ret != UBI_IO_BITFLIPS) {
+		ubi_err("unable to read fastmap journal EC (PEB: %i)", pnum);
+		return ret > 0 ? UBI_BAD_FASTMAP : ret;
+	}
+
+	ret = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+	if (ret && ret != UBI_IO_BITFLIPS) {
+		ubi_err("unable to read fastmap journal (PEB: %i)", pnum);
+		return ret > 0 ? UBI_BAD_FASTMAP : ret;
+	}
+
+	if (be32_to_cpu(vh->vol_id) != UBI_FM_JOURNAL_VOLUME_ID ||
+	    vh->sqnum != fmsb->journal_sqnum) {
+		ubi_err("fastmap journal PEB %i has been reused", pnum);
+		return UBI_BAD_FASTMAP;
+	}
+
+	return 0;
+}
+
 /**
  * ubi_scan_fastmap - scan the fastmap.
  * @ubi: UBI device object
@@ -912,7 +1159,8 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		goto free_fm_sb;
 	}
 
-	if (fmsb->version != UBI_FM_FMT_VERSION) {
+	if (fmsb->version < UBI_FM_FMT_VERSION_MIN ||
+	    fmsb->version > UBI_FM_FMT_VERSION) {
 		ubi_err("bad fastmap version: %i, expected: %i",
 			fmsb->version, UBI_FM_FMT_VERSION);
 		ret = UBI_BAD_FASTMAP;
@@ -1038,6 +1286,21 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	fm->used_blocks = used_blocks;
 
+	if (fmsb2->version >= 2 &&
+	    be32_to_cpu(fmsb2->journal_loc) != UBI_FM_NO_JOURNAL) {
+		ret = check_fm_journal(ubi, fmsb2, ech, vh);
+		if (ret)
+			goto free_hdr;
+
+		fm->journal = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!fm->journal) {
+			ret = -ENOMEM;
+			goto free_hdr;
+		}
+		fm->journal->pnum = be32_to_cpu(fmsb2->journal_loc);
+		fm->journal->ec = be32_to_cpu(fmsb2->journal_ec);
+	}
+
 	ret = ubi_attach_fastmap(ubi, ai, fm);
 	if (ret) {
 		if (ret > 0)
@@ -1068,6 +1331,9 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	ubi_msg("attached by fastmap");
 	ubi_msg("fastmap pool size: %d", ubi->fm_pool.max_size);
 	ubi_msg("fastmap WL pool size: %d", ubi->fm_wl_pool.max_size);
+	if (fm->journal)
+		ubi_msg("fastmap journal: PEB %d, %d records",
+			fm->journal->pnum, fm->journal_records);
 	ubi->fm_disabled = 0;
 
 	ubi_free_vid_hdr(ubi, vh);
@@ -1083,6 +1349,8 @@ free_hdr:
 	kfree(ech);
 free_fm_sb:
 	kfree(fmsb);
+	if (fm->journal)
+		kmem_cache_free(ubi_wl_entry_slab, fm->journal);
 	kfree(fm);
 	goto out;
 }
@@ -1108,7 +1376,7 @@ static int ubi_write_fastmap(struct ubi_device *ubi,
 	struct rb_node *node;
 	struct ubi_wl_entry *wl_e;
 	struct ubi_volume *vol;
-	struct ubi_vid_hdr *avhdr, *dvhdr;
+	struct ubi_vid_hdr *avhdr, *dvhdr, *jvhdr = NULL;
 	struct ubi_work *ubi_wrk;
 	int ret, i, j, free_peb_count, used_peb_count, vol_count;
 	int scrub_peb_count, erase_peb_count;
@@ -1128,6 +1396,14 @@ static int ubi_write_fastmap(struct ubi_device *ubi,
 		goto out_kfree;
 	}
 
+	if (new_fm->journal) {
+		jvhdr = new_fm_vhdr(ubi, UBI_FM_JOURNAL_VOLUME_ID);
+		if (!jvhdr) {
+			ret = -ENOMEM;
+			goto out_kfree;
+		}
+	}
+
 	spin_lock(&ubi->volumes_lock);
 	spin_lock(&ubi->wl_lock);
 
@@ -1265,6 +1541,14 @@ static int ubi_write_fastmap(struct ubi_device *ubi,
 	avhdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	avhdr->lnum = 0;
 
+	if (new_fm->journal) {
+		jvhdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+		fmsb->journal_loc = cpu_to_be32(new_fm->journal->pnum);
+		fmsb->journal_ec = cpu_to_be32(new_fm->journal->ec);
+		fmsb->journal_sqnum = jvhdr->sqnum;
+	} else
+		fmsb->journal_loc = cpu_to_be32(UBI_FM_NO_JOURNAL);
+
 	spin_unlock(&ubi->wl_lock);
 	spin_unlock(&ubi->volumes_lock);
 
@@ -1297,6 +1581,16 @@ static int ubi_write_fastmap(struct ubi_device *ubi,
 		}
 	}
 
+	if (new_fm->journal) {
+		dbg_bld("writing fastmap journal header to PEB %i",
+			new_fm->journal->pnum);
+		ret = ubi_io_write_vid_hdr(ubi, new_fm->journal->pnum, jvhdr);
+		if (ret) {
+			ubi_err("unable to write vid_hdr to fastmap journal!");
+			goto out_kfree;
+		}
+	}
+
 	for (i = 0; i < new_fm->used_blocks; i++) {
 		ret = ubi_io_write(ubi, fm_raw + (i * ubi->leb_size),
 			new_fm->e[i]->pnum, ubi->leb_start, ubi->leb_size);
@@ -1315,6 +1609,8 @@ static int ubi_write_fastmap(struct ubi_device *ubi,
 out_kfree:
 	ubi_free_vid_hdr(ubi, avhdr);
 	ubi_free_vid_hdr(ubi, dvhdr);
+	if (jvhdr)
+		ubi_free_vid_hdr(ubi, jvhdr);
 out:
 	return ret;
 }
@@ -1536,6 +1832,30 @@ int ubi_update_fastmap(struct ubi_device *ubi)
 		new_fm->e[0]->ec = tmp_e->ec;
 	}
 
+	/*
+	 * The journal is optional, the new fastmap goes without one if there
+	 * is no free PEB left for it.
+	 */
+	new_fm->journal = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+	if (new_fm->journal) {
+		spin_lock(&ubi->wl_lock);
+		tmp_e = ubi_wl_get_fm_peb(ubi, 0);
+		spin_unlock(&ubi->wl_lock);
+
+		if (tmp_e) {
+			new_fm->journal->pnum = tmp_e->pnum;
+			new_fm->journal->ec = tmp_e->ec;
+		} else {
+			kmem_cache_free(ubi_wl_entry_slab, new_fm->journal);
+			new_fm->journal = NULL;
+		}
+	}
+
+	if (old_fm && old_fm->journal) {
+		ubi_wl_put_fm_peb(ubi, old_fm->journal, 0, 0);
+		old_fm->journal = NULL;
+	}
+
 	down_write(&ubi->work_sem);
 	down_write(&ubi->fm_sem);
 	ret = ubi_write_fastmap(ubi, new_fm);
@@ -1551,6 +1871,8 @@ out_unlock:
 	return ret;
 
 err:
+	if (new_fm->journal)
+		ubi_wl_put_fm_peb(ubi, new_fm->journal, 0, 0);
 	kfree(new_fm);
 
 	ubi_warn("Unable to write new fastmap, err=%i", ret);
@@ -1562,6 +1884,119 @@ err:
 			ubi_err("Unable to invalidiate current fastmap!");
 		else if (ret)
 			ret = 0;
+
+		if (old_fm->journal) {
+			ubi_wl_put_fm_peb(ubi, old_fm->journal, 0, 0);
+			old_fm->journal = NULL;
+		}
 	}
 	goto out_unlock;
 }
+
+/**
+ * write_fm_journal - append pool contents to the fastmap journal.
+ * @ubi: UBI device object
+ * @fm: the current fastmap
+ * @pool: the user pool to record
+ * @wl_pool: the WL pool to record
+ *
+ * Returns 0 on success, < 0 indicates an internal error.
+ */
+static int write_fm_journal(struct ubi_device *ubi,
+			    struct ubi_fastmap_layout *fm,
+			    struct ubi_fm_pool *pool,
+			    struct ubi_fm_pool *wl_pool)
+{
+	struct ubi_fm_journal *fmj;
+	int i, n = 0, ret, rec_size;
+
+	rec_size = fm_journal_rec_size(ubi, ubi->fm_pool.max_size,
+				       ubi->fm_wl_pool.max_size);
+	fmj = kzalloc(rec_size, GFP_KERNEL);
+	if (!fmj)
+		return -ENOMEM;
+
+	fmj->magic = cpu_to_be32(UBI_FM_JOURNAL_MAGIC);
+	fmj->seq = cpu_to_be32(fm->journal_records);
+	fmj->pool_size = cpu_to_be16(pool->size);
+	fmj->wl_pool_size = cpu_to_be16(wl_pool->size);
+
+	for (i = 0; i < pool->size; i++)
+		fmj->pebs[n++] = cpu_to_be32(pool->pebs[i]);
+	for (i = 0; i < wl_pool->size; i++)
+		fmj->pebs[n++] = cpu_to_be32(wl_pool->pebs[i]);
+
+	fmj->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, fmj, rec_size));
+
+	dbg_bld("writing fastmap journal record %i to PEB %i",
+		fm->journal_records, fm->journal->pnum);
+	ret = ubi_io_write(ubi, fmj, fm->journal->pnum,
+			   ubi->leb_start + fm->journal_records * rec_size,
+			   rec_size);
+	if (!ret)
+		fm->journal_records++;
+
+	kfree(fmj);
+	return ret;
+}
+
+/**
+ * ubi_update_fastmap_pools - will be called by UBI if a fastmap pool becomes
+ * empty.
+ * @ubi: UBI device object
+ *
+ * Refills the pools and appends their new contents to the journal of the
+ * current fastmap, which costs a single write instead of a whole new fastmap.
+ * A new fastmap is written if there is no journal or if it is full.
+ *
+ * The new pools are filled aside and only handed out once the journal record
+ * describing them is on flash, so that every PEB taken from a pool is known
+ * to read_fm_journal() after a power cut.
+ *
+ * Returns 0 on success, < 0 indicates an internal error.
+ */
+int ubi_update_fastmap_pools(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm;
+	struct ubi_fm_pool *pool, *wl_pool;
+	int ret;
+
+	pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	wl_pool = kmalloc(sizeof(*wl_pool), GFP_KERNEL);
+	if (!pool || !wl_pool) {
+		kfree(pool);
+		kfree(wl_pool);
+		return ubi_update_fastmap(ubi);
+	}
+
+	mutex_lock(&ubi->fm_mutex);
+
+	fm = ubi->fm;
+	if (ubi->ro_mode || ubi->fm_disabled || !fm || !fm->journal ||
+	    fm->journal_records >= fm_journal_max_records(ubi,
+			fm_journal_rec_size(ubi, ubi->fm_pool.max_size,
+					    ubi->fm_wl_pool.max_size))) {
+		mutex_unlock(&ubi->fm_mutex);
+		kfree(pool);
+		kfree(wl_pool);
+		return ubi_update_fastmap(ubi);
+	}
+
+	ubi_stage_pools(ubi, pool, wl_pool);
+	ret = write_fm_journal(ubi, fm, pool, wl_pool);
+	if (ret)
+		ubi_unstage_pools(ubi, pool, wl_pool);
+	else
+		ubi_publish_pools(ubi, pool, wl_pool);
+
+	mutex_unlock(&ubi->fm_mutex);
+	kfree(pool);
+	kfree(wl_pool);
+
+	if (ret) {
+		ubi_warn("unable to write fastmap journal, err=%i", ret);
+		return ubi_update_fastmap(ubi);
+	}
+
+	return 0;
+}
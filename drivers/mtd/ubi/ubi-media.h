@@ -379,15 +379,19 @@ struct ubi_vtbl_record {
 
 #define UBI_FM_SB_VOLUME_ID	(UBI_LAYOUT_VOLUME_ID + 1)
 #define UBI_FM_DATA_VOLUME_ID	(UBI_LAYOUT_VOLUME_ID + 2)
+#define UBI_FM_JOURNAL_VOLUME_ID	(UBI_LAYOUT_VOLUME_ID + 3)
 
 /* fastmap on-flash data structure format version */
-#define UBI_FM_FMT_VERSION	1
+#define UBI_FM_FMT_VERSION	2
+/* the oldest format version which can still be attached */
+#define UBI_FM_FMT_VERSION_MIN	1
 
 #define UBI_FM_SB_MAGIC		0x7B11D69F
 #define UBI_FM_HDR_MAGIC	0xD4B82EF7
 #define UBI_FM_VHDR_MAGIC	0xFA370ED1
 #define UBI_FM_POOL_MAGIC	0x67AF4D08
 #define UBI_FM_EBA_MAGIC	0xf0c040a8
+#define UBI_FM_JOURNAL_MAGIC	0x4A6F7572
 
 /* A fastmap supber block can be located between PEB 0 and
  * UBI_FM_MAX_START */
@@ -405,6 +409,13 @@ struct ubi_vtbl_record {
 
 #define UBI_FM_WL_POOL_SIZE	25
 
+/* A fastmap journal holds at most UBI_FM_MAX_JOURNAL records, every record
+ * adds up to two pools of PEBs which have to be scanned while attaching */
+#define UBI_FM_MAX_JOURNAL	8
+
+/* @journal_loc of a fastmap without journal */
+#define UBI_FM_NO_JOURNAL	0xFFFFFFFF
+
 /**
  * struct ubi_fm_sb - UBI fastmap super block
  * @magic: fastmap super block magic number (%UBI_FM_SB_MAGIC)
@@ -414,7 +425,11 @@ struct ubi_vtbl_record {
  * @block_loc: an array containing the location of all PEBs of the fastmap
  * @block_ec: the erase counter of each used PEB
  * @sqnum: highest sequence number value at the time while taking the fastmap
+ * @journal_loc: location of the journal PEB (%UBI_FM_NO_JOURNAL if none)
+ * @journal_ec: the erase counter of the journal PEB
+ * @journal_sqnum: sequence number of the VID header of the journal PEB
  *
+ * The journal fields are only valid for format version 2 and later.
  */
 struct ubi_fm_sb {
 	__be32 magic;
@@ -425,7 +440,10 @@ struct ubi_fm_sb {
 	__be32 block_loc[UBI_FM_MAX_BLOCKS];
 	__be32 block_ec[UBI_FM_MAX_BLOCKS];
 	__be64 sqnum;
-	__u8 padding2[32];
+	__be32 journal_loc;
+	__be32 journal_ec;
+	__be64 journal_sqnum;
+	__u8 padding2[16];
 } __packed;
 
 /**
@@ -512,4 +530,28 @@ struct ubi_fm_eba {
 	__be32 reserved_pebs;
 	__be32 pnum[0];
 } __packed;
+
+/**
+ * struct ubi_fm_journal - fastmap journal record
+ * @magic: journal record magic number (%UBI_FM_JOURNAL_MAGIC)
+ * @data_crc: CRC over the whole record with this field set to zero
+ * @seq: number of this record within the journal, starting at 0
+ * @pool_size: number of PEBs in the refilled user pool
+ * @wl_pool_size: number of PEBs in the refilled WL pool
+ * @pebs: the PEBs of the user pool followed by the PEBs of the WL pool
+ *
+ * Instead of writing a whole new fastmap every time the pools run empty, UBI
+ * appends one record per refill to the journal PEB of the current fastmap.
+ * Each record is padded to a multiple of the minimal I/O unit size, so that
+ * it can be written on its own. While attaching, the PEBs of all records are
+ * scanned just like the PEBs of the fastmap pools.
+ */
+struct ubi_fm_journal {
+	__be32 magic;
+	__be32 data_crc;
+	__be32 seq;
+	__be16 pool_size;
+	__be16 wl_pool_size;
+	__be32 pebs[0];
+} __packed;
 #endif /* !__UBI_MEDIA_H__ */
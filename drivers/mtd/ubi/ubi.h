@@ -223,6 +223,8 @@ struct ubi_volume_desc;
  * @used_blocks: number of used PEBs
  * @max_pool_size: maximal size of the user pool
  * @max_wl_pool_size: maximal size of the pool used by the WL sub-system
+ * @journal: the journal PEB of this fastmap (%NULL if there is none)
+ * @journal_records: number of records written to @journal
  */
 struct ubi_fastmap_layout {
 	struct ubi_wl_entry *e[UBI_FM_MAX_BLOCKS];
@@ -230,6 +232,8 @@ struct ubi_fastmap_layout {
 	int used_blocks;
 	int max_pool_size;
 	int max_wl_pool_size;
+	struct ubi_wl_entry *journal;
+	int journal_records;
 };
 
 /**
@@ -438,7 +442,7 @@ struct ubi_debug_info {
  * @pq_head: protection queue head
  * @wl_lock: protects the @used, @free, @pq, @pq_head, @lookuptbl, @move_from,
  *	     @move_to, @move_to_put @erase_pending, @wl_scheduled, @works,
- *	     @erroneous, and @erroneous_peb_count fields
+ *	     @erroneous, @erroneous_peb_count and the erase stall statistics
  * @move_mutex: serializes eraseblock moves
  * @work_sem: synchronizes the WL worker with use tasks
  * @wl_scheduled: non-zero if the wear-leveling was scheduled
@@ -452,6 +456,12 @@ struct ubi_debug_info {
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @last_user_io: time (in jiffies) of the last user read or write, used to
+ *                defer non-urgent background work until the device is idle
+ * @erase_stalls: how many times a PEB allocation had to wait for a pending
+ *                erasure to produce a free PEB
+ * @erase_stall_us: total time spent in these waits (in microseconds)
+ * @erase_stall_max_us: longest of these waits (in microseconds)
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -554,6 +564,10 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+	unsigned long last_user_io;
+	unsigned int erase_stalls;
+	unsigned long long erase_stall_us;
+	unsigned int erase_stall_max_us;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -675,6 +689,7 @@ struct ubi_ainf_volume {
  * @mean_ec: mean erase counter value
  * @ec_sum: a temporary variable used when calculating @mean_ec
  * @ec_count: a temporary variable used when calculating @mean_ec
+ * @scanned_peb_count: number of PEBs whose headers were read while attaching
  * @aeb_slab_cache: slab cache for &struct ubi_ainf_peb objects
  *
  * This data structure contains the result of attaching an MTD device and may
@@ -701,9 +716,31 @@ struct ubi_attach_info {
 	int mean_ec;
 	uint64_t ec_sum;
 	int ec_count;
+	int scanned_peb_count;
 	struct kmem_cache *aeb_slab_cache;
 };
 
+/**
+ * struct ubi_peb_hdrs - UBI headers of a PEB read ahead of attaching it.
+ * @pnum: physical eraseblock number
+ * @bad: result of 'ubi_io_is_bad()' for @pnum
+ * @ec_err: result of reading the EC header
+ * @vid_err: result of reading the VID header
+ * @ech: the EC header
+ * @vidh: the VID header
+ *
+ * @vid_err is %UBI_IO_FF if the VID header was not read because the EC header
+ * says that the PEB is empty.
+ */
+struct ubi_peb_hdrs {
+	int pnum;
+	int bad;
+	int ec_err;
+	int vid_err;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vidh;
+};
+
 /**
  * struct ubi_work - UBI work description data structure.
  * @list: a link in the list of pending works
@@ -750,6 +787,11 @@ struct ubi_ainf_peb *ubi_early_get_peb(struct ubi_device *ubi,
 				       struct ubi_attach_info *ai);
 int ubi_attach(struct ubi_device *ubi, int force_scan);
 void ubi_destroy_ai(struct ubi_attach_info *ai);
+struct ubi_peb_hdrs *ubi_alloc_peb_hdrs(struct ubi_device *ubi, int *count);
+void ubi_free_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *hdrs,
+		       int count);
+void ubi_read_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *hdrs,
+		       int count);
 
 /* vtbl.c */
 int ubi_change_vtbl_record(struct ubi_device *ubi, int idx,
@@ -816,6 +858,12 @@ int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *used_e,
 		      int lnum, int torture);
 int ubi_is_erase_work(struct ubi_work *wrk);
 void ubi_refill_pools(struct ubi_device *ubi);
+void ubi_stage_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		     struct ubi_fm_pool *wl_pool);
+void ubi_publish_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		       struct ubi_fm_pool *wl_pool);
+void ubi_unstage_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		       struct ubi_fm_pool *wl_pool);
 int ubi_ensure_anchor_pebs(struct ubi_device *ubi);
 
 /* io.c */
@@ -861,6 +909,7 @@ int ubi_compare_lebs(struct ubi_device *ubi, const struct ubi_ainf_peb *aeb,
 /* fastmap.c */
 size_t ubi_calc_fm_size(struct ubi_device *ubi);
 int ubi_update_fastmap(struct ubi_device *ubi);
+int ubi_update_fastmap_pools(struct ubi_device *ubi);
 int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		     int fm_anchor);
 
@@ -971,6 +1020,18 @@ static inline void ubi_ro_mode(struct ubi_device *ubi)
 	}
 }
 
+/**
+ * ubi_note_user_io - record user I/O activity.
+ * @ubi: UBI device description object
+ *
+ * The background thread postpones work which is not urgent while user I/O
+ * happens, see 'ubi_thread()'.
+ */
+static inline void ubi_note_user_io(struct ubi_device *ubi)
+{
+	ubi->last_user_io = jiffies;
+}
+
 /**
  * vol_id2idx - get table index by volume ID.
  * @ubi: UBI device description object
@@ -102,6 +102,7 @@
 #include <linux/crc32.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include "ubi.h"
 
 /* Number of physical eraseblocks reserved for wear-leveling purposes */
@@ -134,21 +135,36 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * Wear-leveling and erasures compete with user writes for the flash, so the
+ * background thread only runs them once no user I/O has been seen for
+ * %WL_IDLE_DELAY. Erasures are urgent while there are less than
+ * %WL_PREERASE_PEBS free physical eraseblocks, which keeps a pool of erased
+ * PEBs ready for user writes. Scrubbing and producing fastmap anchors are
+ * always urgent.
+ */
+#define WL_IDLE_DELAY (HZ / 10)
+#define WL_PREERASE_PEBS 8
+
 static int self_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int self_check_in_wl_tree(const struct ubi_device *ubi,
 				 struct ubi_wl_entry *e, struct rb_root *root);
 static int self_check_in_pq(const struct ubi_device *ubi,
 			    struct ubi_wl_entry *e);
+static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
+			int cancel);
+static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
+				int cancel);
 
 #ifdef CONFIG_MTD_UBI_FASTMAP
 /**
- * update_fastmap_work_fn - calls ubi_update_fastmap from a work queue
+ * update_fastmap_work_fn - calls ubi_update_fastmap_pools from a work queue
  * @wrk: the work description object
  */
 static void update_fastmap_work_fn(struct work_struct *wrk)
 {
 	struct ubi_device *ubi = container_of(wrk, struct ubi_device, fm_work);
-	ubi_update_fastmap(ubi);
+	ubi_update_fastmap_pools(ubi);
 }
 
 /**
@@ -167,6 +183,9 @@ static int ubi_is_fm_block(struct ubi_device *ubi, int pnum)
 		if (ubi->fm->e[i]->pnum == pnum)
 			return 1;
 
+	if (ubi->fm->journal && ubi->fm->journal->pnum == pnum)
+		return 1;
+
 	return 0;
 }
 #else
@@ -212,14 +231,63 @@ static void wl_tree_add(struct ubi_wl_entry *e, struct rb_root *root)
 	rb_insert_color(&e->u.rb, root);
 }
 
+/**
+ * work_is_urgent - check if a work has to be done even if the device is busy.
+ * @ubi: UBI device description object
+ * @wrk: the work to check
+ *
+ * Has to be called with @ubi->wl_lock held.
+ */
+static int work_is_urgent(struct ubi_device *ubi, struct ubi_work *wrk)
+{
+	if (wrk->func == &erase_worker)
+		return ubi->free_count < WL_PREERASE_PEBS;
+	if (wrk->func == &wear_leveling_worker)
+		return ubi->scrub.rb_node || wrk->anchor;
+	return 1;
+}
+
+/**
+ * next_work - find the next pending work to do.
+ * @ubi: UBI device description object
+ * @urgent: only consider urgent works
+ *
+ * Has to be called with @ubi->wl_lock held. Returns %NULL if there is no
+ * suitable work.
+ */
+static struct ubi_work *next_work(struct ubi_device *ubi, int urgent)
+{
+	struct ubi_work *wrk;
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (!urgent || work_is_urgent(ubi, wrk))
+			return wrk;
+	return NULL;
+}
+
+/**
+ * wl_idle_wait - get the time until the device counts as idle.
+ * @ubi: UBI device description object
+ *
+ * Returns the number of jiffies until user I/O will have paused for
+ * %WL_IDLE_DELAY, or zero if it already has.
+ */
+static long wl_idle_wait(struct ubi_device *ubi)
+{
+	long left = (long)(ubi->last_user_io + WL_IDLE_DELAY - jiffies);
+
+	return left > 0 ? left : 0;
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
+ * @urgent: only do a work if it is urgent
  *
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  */
-static int do_work(struct ubi_device *ubi)
+static int do_work(struct ubi_device *ubi, int urgent)
 {
 	int err;
 	struct ubi_work *wrk;
@@ -234,13 +302,13 @@ static int do_work(struct ubi_device *ubi)
 	 */
 	down_read(&ubi->work_sem);
 	spin_lock(&ubi->wl_lock);
-	if (list_empty(&ubi->works)) {
+	wrk = next_work(ubi, urgent);
+	if (!wrk) {
 		spin_unlock(&ubi->wl_lock);
 		up_read(&ubi->work_sem);
 		return 0;
 	}
 
-	wrk = list_entry(ubi->works.next, struct ubi_work, list);
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
@@ -276,7 +344,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
-		err = do_work(ubi);
+		err = do_work(ubi, 0);
 
 		spin_lock(&ubi->wl_lock);
 		if (err)
@@ -503,6 +571,8 @@ static int __wl_get_peb(struct ubi_device *ubi)
 {
 	int err;
 	struct ubi_wl_entry *e;
+	ktime_t start;
+	unsigned int us;
 
 retry:
 	if (!ubi->free.rb_node) {
@@ -512,9 +582,17 @@ retry:
 			return -ENOSPC;
 		}
 
+		start = ktime_get();
 		err = produce_free_peb(ubi);
 		if (err < 0)
 			return err;
+
+		us = ktime_us_delta(ktime_get(), start);
+		ubi->erase_stalls += 1;
+		ubi->erase_stall_us += us;
+		if (us > ubi->erase_stall_max_us)
+			ubi->erase_stall_max_us = us;
+		dbg_wl("waited %u us for a free PEB", us);
 		goto retry;
 	}
 
@@ -565,13 +643,11 @@ static void return_unused_pool_pebs(struct ubi_device *ubi,
  * refill_wl_pool - refills all the fastmap pool used by the
  * WL sub-system.
  * @ubi: UBI device description object
+ * @pool: the pool to fill, &ubi->fm_wl_pool or a staged copy of it
  */
-static void refill_wl_pool(struct ubi_device *ubi)
+static void refill_wl_pool(struct ubi_device *ubi, struct ubi_fm_pool *pool)
 {
 	struct ubi_wl_entry *e;
-	struct ubi_fm_pool *pool = &ubi->fm_wl_pool;
-
-	return_unused_pool_pebs(ubi, pool);
 
 	for (pool->size = 0; pool->size < pool->max_size; pool->size++) {
 		if (!ubi->free.rb_node ||
@@ -591,13 +667,11 @@ static void refill_wl_pool(struct ubi_device *ubi)
 /**
  * refill_wl_user_pool - refills all the fastmap pool used by ubi_wl_get_peb.
  * @ubi: UBI device description object
+ * @pool: the pool to fill, &ubi->fm_pool or a staged copy of it
  */
-static void refill_wl_user_pool(struct ubi_device *ubi)
+static void refill_wl_user_pool(struct ubi_device *ubi,
+				struct ubi_fm_pool *pool)
 {
-	struct ubi_fm_pool *pool = &ubi->fm_pool;
-
-	return_unused_pool_pebs(ubi, pool);
-
 	for (pool->size = 0; pool->size < pool->max_size; pool->size++) {
 		pool->pebs[pool->size] = __wl_get_peb(ubi);
 		if (pool->pebs[pool->size] < 0)
@@ -613,11 +687,79 @@ static void refill_wl_user_pool(struct ubi_device *ubi)
 void ubi_refill_pools(struct ubi_device *ubi)
 {
 	spin_lock(&ubi->wl_lock);
-	refill_wl_pool(ubi);
-	refill_wl_user_pool(ubi);
+	return_unused_pool_pebs(ubi, &ubi->fm_wl_pool);
+	refill_wl_pool(ubi, &ubi->fm_wl_pool);
+	return_unused_pool_pebs(ubi, &ubi->fm_pool);
+	refill_wl_user_pool(ubi, &ubi->fm_pool);
 	spin_unlock(&ubi->wl_lock);
 }
 
+/**
+ * ubi_stage_pools - takes the PEBs for the next fastmap pools.
+ * @ubi: UBI device description object
+ * @pool: receives the PEBs of the next user pool
+ * @wl_pool: receives the PEBs of the next WL pool
+ *
+ * Empties the current pools, returning their unused PEBs to the free tree,
+ * and fills @pool and @wl_pool instead, which nobody else can take PEBs
+ * from. Consumers find the pools empty and wait for the fastmap update in
+ * progress, which records the staged pools and then hands them over with
+ * ubi_publish_pools(), or gives them back with ubi_unstage_pools().
+ */
+void ubi_stage_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		     struct ubi_fm_pool *wl_pool)
+{
+	pool->max_size = ubi->fm_pool.max_size;
+	wl_pool->max_size = ubi->fm_wl_pool.max_size;
+
+	spin_lock(&ubi->wl_lock);
+	return_unused_pool_pebs(ubi, &ubi->fm_wl_pool);
+	ubi->fm_wl_pool.size = ubi->fm_wl_pool.used = 0;
+	return_unused_pool_pebs(ubi, &ubi->fm_pool);
+	ubi->fm_pool.size = ubi->fm_pool.used = 0;
+	refill_wl_pool(ubi, wl_pool);
+	refill_wl_user_pool(ubi, pool);
+	spin_unlock(&ubi->wl_lock);
+	pool->used = wl_pool->used = 0;
+}
+
+/**
+ * ubi_publish_pools - makes staged pools the current fastmap pools.
+ * @ubi: UBI device description object
+ * @pool: the staged user pool
+ * @wl_pool: the staged WL pool
+ */
+void ubi_publish_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		       struct ubi_fm_pool *wl_pool)
+{
+	spin_lock(&ubi->wl_lock);
+	memcpy(ubi->fm_wl_pool.pebs, wl_pool->pebs,
+	       wl_pool->size * sizeof(wl_pool->pebs[0]));
+	ubi->fm_wl_pool.used = 0;
+	ubi->fm_wl_pool.size = wl_pool->size;
+	memcpy(ubi->fm_pool.pebs, pool->pebs,
+	       pool->size * sizeof(pool->pebs[0]));
+	ubi->fm_pool.used = 0;
+	ubi->fm_pool.size = pool->size;
+	spin_unlock(&ubi->wl_lock);
+}
+
+/**
+ * ubi_unstage_pools - returns the PEBs of staged pools to the free tree.
+ * @ubi: UBI device description object
+ * @pool: the staged user pool
+ * @wl_pool: the staged WL pool
+ */
+void ubi_unstage_pools(struct ubi_device *ubi, struct ubi_fm_pool *pool,
+		       struct ubi_fm_pool *wl_pool)
+{
+	spin_lock(&ubi->wl_lock);
+	return_unused_pool_pebs(ubi, wl_pool);
+	return_unused_pool_pebs(ubi, pool);
+	spin_unlock(&ubi->wl_lock);
+	pool->size = wl_pool->size = 0;
+}
+
 /* ubi_wl_get_peb - works exaclty like __wl_get_peb but keeps track of
  * the fastmap pool.
  */
@@ -627,19 +769,24 @@ int ubi_wl_get_peb(struct ubi_device *ubi)
 	struct ubi_fm_pool *pool = &ubi->fm_pool;
 	struct ubi_fm_pool *wl_pool = &ubi->fm_wl_pool;
 
+again:
 	if (!pool->size || !wl_pool->size || pool->used == pool->size ||
 	    wl_pool->used == wl_pool->size)
-		ubi_update_fastmap(ubi);
+		ubi_update_fastmap_pools(ubi);
 
+	spin_lock(&ubi->wl_lock);
 	/* we got not a single free PEB */
-	if (!pool->size)
+	if (!pool->size) {
 		ret = -ENOSPC;
-	else {
-		spin_lock(&ubi->wl_lock);
+	} else if (pool->used == pool->size) {
+		/* emptied or staged meanwhile by another update */
+		spin_unlock(&ubi->wl_lock);
+		goto again;
+	} else {
 		ret = pool->pebs[pool->used++];
 		prot_queue_add(ubi, ubi->lookuptbl[ret]);
-		spin_unlock(&ubi->wl_lock);
 	}
+	spin_unlock(&ubi->wl_lock);
 
 	return ret;
 }
@@ -858,9 +1005,6 @@ static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 	up_read(&ubi->work_sem);
 }
 
-static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
-			int cancel);
-
 #ifdef CONFIG_MTD_UBI_FASTMAP
 /**
  * ubi_is_erase_work - checks whether a work is erase work.
@@ -1788,6 +1932,7 @@ static void tree_destroy(struct rb_root *root)
 int ubi_thread(void *u)
 {
 	int failures = 0;
+	long busy;
 	struct ubi_device *ubi = u;
 
 	ubi_msg("background thread \"%s\" started, PID %d",
@@ -1811,9 +1956,17 @@ int ubi_thread(void *u)
 			schedule();
 			continue;
 		}
+		busy = wl_idle_wait(ubi);
+		if (busy && !next_work(ubi, 1)) {
+			/* Wait for user I/O to pause or for urgent work */
+			set_current_state(TASK_INTERRUPTIBLE);
+			spin_unlock(&ubi->wl_lock);
+			schedule_timeout(busy);
+			continue;
+		}
 		spin_unlock(&ubi->wl_lock);
 
-		err = do_work(ubi);
+		err = do_work(ubi, !!busy);
 		if (err) {
 			ubi_err("%s: work failed with error code %d",
 				ubi->bgt_name, err);
@@ -1877,6 +2030,7 @@ int ubi_wl_init(struct ubi_device *ubi, struct ubi_attach_info *ai)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = ai->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	ubi->last_user_io = jiffies;
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	INIT_WORK(&ubi->fm_work, update_fastmap_work_fn);
 #endif
@@ -1962,7 +2116,8 @@ int ubi_wl_init(struct ubi_device *ubi, struct ubi_attach_info *ai)
 
 	if (ubi->fm)
 		ubi_assert(ubi->good_peb_count == \
-			   found_pebs + ubi->fm->used_blocks);
+			   found_pebs + ubi->fm->used_blocks +
+			   !!ubi->fm->journal);
 	else
 		ubi_assert(ubi->good_peb_count == found_pebs);
 
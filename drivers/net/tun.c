@@ -104,6 +104,11 @@ do {								\
 
 #define GOODCOPY_LEN 128
 
+/* Packets written with MSG_MORE may be held back and handed to the stack
+ * together, up to rx_batched at a time (ethtool -C rx-frames, off by
+ * default) and never more than this many. */
+#define TUN_RX_BATCH 64
+
 #define FLT_EXACT_COUNT 8
 struct tap_filter {
 	unsigned int    count;    /* Number of addrs. Zero means disabled */
@@ -193,6 +198,7 @@ struct tun_struct {
 	struct list_head disabled;
 	void *security;
 	u32 flow_count;
+	u32 rx_batched;
 };
 
 static inline u32 tun_hashfn(u32 rxhash)
@@ -432,6 +438,7 @@ static void tun_queue_purge(struct tun_file *tfile)
 {
 	skb_queue_purge(&tfile->sk.sk_receive_queue);
 	skb_queue_purge(&tfile->sk.sk_error_queue);
+	skb_queue_purge(&tfile->sk.sk_write_queue);
 }
 
 static void __tun_detach(struct tun_file *tfile, bool clean)
@@ -1009,10 +1016,52 @@ static struct sk_buff *tun_alloc_skb(struct tun_file *tfile,
 	return skb;
 }
 
+/* Hand a packet from user space to the stack. When batching is enabled and
+ * the writer tells us more packets follow, queue it on the otherwise unused
+ * write queue of the socket and receive the whole batch in one go with the
+ * last one: this saves raising and running the rx softirq for every
+ * packet. */
+static void tun_rx_batched(struct tun_struct *tun, struct tun_file *tfile,
+			   struct sk_buff *skb, bool more)
+{
+	struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+	struct sk_buff_head process_queue;
+	u32 rx_batched = ACCESS_ONCE(tun->rx_batched);
+	struct sk_buff *nskb;
+	bool rcv = false;
+
+	if (rx_batched < 2)
+		more = false;
+
+	if (!more && skb_queue_empty(queue)) {
+		netif_rx_ni(skb);
+		return;
+	}
+
+	spin_lock(&queue->lock);
+	if (!more || skb_queue_len(queue) >= rx_batched - 1) {
+		__skb_queue_head_init(&process_queue);
+		skb_queue_splice_tail_init(queue, &process_queue);
+		rcv = true;
+	} else {
+		__skb_queue_tail(queue, skb);
+	}
+	spin_unlock(&queue->lock);
+
+	if (rcv) {
+		local_bh_disable();
+		while ((nskb = __skb_dequeue(&process_queue)))
+			netif_receive_skb(nskb);
+		netif_receive_skb(skb);
+		local_bh_enable();
+	}
+}
+
 /* Get packet from user space buffer */
 static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 			    void *msg_control, const struct iovec *iv,
-			    size_t total_len, size_t count, int noblock)
+			    size_t total_len, size_t count, int noblock,
+			    bool more)
 {
 	struct tun_pi pi = { 0, cpu_to_be16(ETH_P_IP) };
 	struct sk_buff *skb;
@@ -1184,7 +1233,7 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 	skb_probe_transport_header(skb, 0);
 
 	rxhash = skb_get_hash(skb);
-	netif_rx_ni(skb);
+	tun_rx_batched(tun, tfile, skb, more);
 
 	tun->dev->stats.rx_packets++;
 	tun->dev->stats.rx_bytes += len;
@@ -1207,7 +1256,7 @@ static ssize_t tun_chr_aio_write(struct kiocb *iocb, const struct iovec *iv,
 	tun_debug(KERN_INFO, tun, "tun_chr_write %ld\n", count);
 
 	result = tun_get_user(tun, tfile, NULL, iv, iov_length(iv, count),
-			      count, file->f_flags & O_NONBLOCK);
+			      count, file->f_flags & O_NONBLOCK, false);
 
 	tun_put(tun);
 	return result;
@@ -1467,7 +1516,8 @@ static int tun_sendmsg(struct kiocb *iocb, struct socket *sock,
 	if (!tun)
 		return -EBADFD;
 	ret = tun_get_user(tun, tfile, m->msg_control, m->msg_iov, total_len,
-			   m->msg_iovlen, m->msg_flags & MSG_DONTWAIT);
+			   m->msg_iovlen, m->msg_flags & MSG_DONTWAIT,
+			   m->msg_flags & MSG_MORE);
 	tun_put(tun);
 	return ret;
 }
@@ -2331,11 +2381,36 @@ static void tun_set_msglevel(struct net_device *dev, u32 value)
 #endif
 }
 
+static int tun_get_coalesce(struct net_device *dev,
+			    struct ethtool_coalesce *ec)
+{
+	struct tun_struct *tun = netdev_priv(dev);
+
+	ec->rx_max_coalesced_frames = tun->rx_batched;
+
+	return 0;
+}
+
+static int tun_set_coalesce(struct net_device *dev,
+			    struct ethtool_coalesce *ec)
+{
+	struct tun_struct *tun = netdev_priv(dev);
+
+	if (ec->rx_max_coalesced_frames > TUN_RX_BATCH)
+		tun->rx_batched = TUN_RX_BATCH;
+	else
+		tun->rx_batched = ec->rx_max_coalesced_frames;
+
+	return 0;
+}
+
 static const struct ethtool_ops tun_ethtool_ops = {
 	.get_settings	= tun_get_settings,
 	.get_drvinfo	= tun_get_drvinfo,
 	.get_msglevel	= tun_get_msglevel,
 	.set_msglevel	= tun_set_msglevel,
+	.get_coalesce	= tun_get_coalesce,
+	.set_coalesce	= tun_set_coalesce,
 	.get_link	= ethtool_op_get_link,
 	.get_ts_info	= ethtool_op_get_ts_info,
 };
@@ -2388,6 +2463,33 @@ struct socket *tun_get_socket(struct file *file)
 }
 EXPORT_SYMBOL_GPL(tun_get_socket);
 
+/* Receive the packets held back by sendmsg() with MSG_MORE right away.  For
+ * writers that stop without sending the packet that would have ended the
+ * batch, e.g. on an error.  Does nothing for sockets other than ours. */
+void tun_rx_flush(struct socket *sock)
+{
+	struct sk_buff_head *queue;
+	struct sk_buff_head process_queue;
+	struct sk_buff *skb;
+
+	if (sock->ops != &tun_socket_ops)
+		return;
+	queue = &container_of(sock, struct tun_file, socket)->sk.sk_write_queue;
+	if (skb_queue_empty(queue))
+		return;
+
+	__skb_queue_head_init(&process_queue);
+	spin_lock(&queue->lock);
+	skb_queue_splice_tail_init(queue, &process_queue);
+	spin_unlock(&queue->lock);
+
+	local_bh_disable();
+	while ((skb = __skb_dequeue(&process_queue)))
+		netif_receive_skb(skb);
+	local_bh_enable();
+}
+EXPORT_SYMBOL_GPL(tun_rx_flush);
+
 module_init(tun_init);
 module_exit(tun_cleanup);
 MODULE_DESCRIPTION(DRV_DESCRIPTION);
@@ -64,6 +64,8 @@
  */
 #define	MAX_QUEUE_MEMORY	(60 * 1518)
 #define	RX_QLEN(dev)		((dev)->rx_qlen)
+#define	RX_QLEN_MIN		2
+#define	RX_SAMPLE_JIFFIES	(HZ / 10)
 #define	TX_QLEN(dev)		((dev)->tx_qlen)
 
 // reawaken network queue this soon after stopping; else watchdog barks
@@ -310,11 +312,8 @@ static void __usbnet_status_stop_force(struct usbnet *dev)
 	}
 }
 
-/* Passes this packet up the stack, updating its accounting.
- * Some link protocols batch packets, so their rx_fixup paths
- * can return clones as well as just modify the original skb.
- */
-void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+static void __usbnet_skb_return(struct usbnet *dev, struct sk_buff *skb,
+				bool napi)
 {
 	int	status;
 
@@ -334,11 +333,27 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	if (skb_defer_rx_timestamp(skb))
 		return;
 
+	if (napi) {
+		if (napi_gro_receive(&dev->napi, skb) == GRO_DROP)
+			netif_dbg(dev, rx_err, dev->net, "gro dropped\n");
+		return;
+	}
+
 	status = netif_rx (skb);
 	if (status != NET_RX_SUCCESS)
 		netif_dbg(dev, rx_err, dev->net,
 			  "netif_rx status %d\n", status);
 }
+
+/* Passes this packet up the stack, updating its accounting.
+ * Some link protocols batch packets, so their rx_fixup paths
+ * can return clones as well as just modify the original skb.
+ * Only to be called from rx_fixup(), which runs in usbnet_poll().
+ */
+void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+{
+	__usbnet_skb_return(dev, skb, true);
+}
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
 /* must be called if hard_mtu or rx_urb_size changed */
@@ -363,6 +378,9 @@ void usbnet_update_max_qlen(struct usbnet *dev)
 	default:
 		dev->rx_qlen = dev->tx_qlen = 4;
 	}
+
+	/* rx_adapt_qlen() moves rx_qlen up to twice that as traffic needs */
+	dev->rx_qlen_max = 2 * dev->rx_qlen;
 }
 EXPORT_SYMBOL_GPL(usbnet_update_max_qlen);
 
@@ -429,6 +447,17 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 	entry->state = state;
 	__skb_unlink(skb, list);
 	spin_unlock(&list->lock);
+
+	/* rx completions are handled by usbnet_poll() */
+	if (list == &dev->rxq) {
+		entry->done_time = local_clock();
+		spin_lock(&dev->rxq_done.lock);
+		__skb_queue_tail(&dev->rxq_done, skb);
+		spin_unlock_irqrestore(&dev->rxq_done.lock, flags);
+		napi_schedule(&dev->napi);
+		return old_state;
+	}
+
 	spin_lock(&dev->done.lock);
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
@@ -458,6 +487,41 @@ EXPORT_SYMBOL_GPL(usbnet_defer_kevent);
 
 static void rx_complete (struct urb *urb);
 
+/*
+ * rx skbs that never went up the stack -- those of failed URBs, and those
+ * rx_fixup() copied all the packets out of -- go back to rxq_pool for
+ * rx_submit() instead of being freed and allocated again.
+ */
+static void rx_recycle(struct usbnet *dev, struct sk_buff *skb)
+{
+	if (dev->rxq_pool.qlen >= RX_QLEN(dev) || skb_shared(skb) ||
+	    skb_cloned(skb) || skb_is_nonlinear(skb) || skb->pfmemalloc) {
+		dev_kfree_skb_any(skb);
+		return;
+	}
+
+	/* back to the state __netdev_alloc_skb_ip_align() left it in */
+	skb->data = skb->head + NET_SKB_PAD + NET_IP_ALIGN;
+	skb_reset_tail_pointer(skb);
+	skb->len = 0;
+	skb->ip_summed = CHECKSUM_NONE;
+	skb_queue_tail(&dev->rxq_pool, skb);
+}
+
+/* Free what usbnet_poll() didn't get to before napi_disable() */
+static void usbnet_purge_rx(struct usbnet *dev)
+{
+	struct sk_buff		*skb;
+	struct skb_data		*entry;
+
+	while ((skb = skb_dequeue(&dev->rxq_done))) {
+		entry = (struct skb_data *) skb->cb;
+		usb_free_urb(entry->urb);
+		dev_kfree_skb(skb);
+	}
+	skb_queue_purge(&dev->rxq_pool);
+}
+
 static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 {
 	struct sk_buff		*skb;
@@ -472,7 +536,14 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 		return -ENOLINK;
 	}
 
-	skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
+	skb = skb_dequeue(&dev->rxq_pool);
+	if (skb && skb_tailroom(skb) < size) {
+		/* rx_urb_size grew since it was recycled */
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	if (!skb)
+		skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
 	if (!skb) {
 		netif_dbg(dev, rx_err, dev->net, "no rx skb\n");
 		usbnet_defer_kevent (dev, EVENT_RX_MEMORY);
@@ -522,7 +593,7 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 	}
 	spin_unlock_irqrestore (&dev->rxq.lock, lockflags);
 	if (retval) {
-		dev_kfree_skb_any (skb);
+		rx_recycle(dev, skb);
 		usb_free_urb (urb);
 	}
 	return retval;
@@ -556,7 +627,7 @@ static inline void rx_process (struct usbnet *dev, struct sk_buff *skb)
 	}
 
 done:
-	skb_queue_tail(&dev->done, skb);
+	rx_recycle(dev, skb);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -576,6 +647,7 @@ static void rx_complete (struct urb *urb)
 	switch (urb_status) {
 	/* success */
 	case 0:
+		dev->rx_sample_bytes += urb->actual_length;
 		break;
 
 	/* stalls need manual reset. this is rare ... except that
@@ -639,10 +711,15 @@ block:
 
 	state = defer_bh(dev, skb, &dev->rxq, state);
 
+	/* nothing left queued to the host controller until resubmission */
+	if (!dev->rxq.qlen)
+		dev->rx_sample_starved++;
+
 	if (urb) {
 		if (netif_running (dev->net) &&
 		    !test_bit (EVENT_RX_HALT, &dev->flags) &&
-		    state != unlink_start) {
+		    state != unlink_start &&
+		    dev->rxq.qlen < RX_QLEN(dev)) {
 			rx_submit (dev, urb, GFP_ATOMIC);
 			usb_mark_last_busy(dev->udev);
 			return;
@@ -669,7 +746,7 @@ void usbnet_resume_rx(struct usbnet *dev)
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
 	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
+		__usbnet_skb_return(dev, skb, false);
 		num++;
 	}
 
@@ -807,6 +884,8 @@ int usbnet_stop (struct net_device *net)
 
 	usbnet_status_stop(dev);
 
+	napi_disable(&dev->napi);
+	usbnet_purge_rx(dev);
 	usbnet_purge_paused_rxq(dev);
 
 	/* deferred work (task, timer, softirq) must also stop.
@@ -899,6 +978,12 @@ int usbnet_open (struct net_device *net)
 	dev->pkt_err = 0;
 	clear_bit(EVENT_RX_KILL, &dev->flags);
 
+	dev->rx_sample_time = jiffies;
+	dev->rx_sample_bytes = 0;
+	dev->rx_sample_starved = 0;
+	dev->rx_sample_latency = 0;
+	napi_enable(&dev->napi);
+
 	// delay posting reads until we're fully open
 	tasklet_schedule (&dev->bh);
 	if (info->manage_power) {
@@ -1421,10 +1506,6 @@ static void usbnet_bh (unsigned long param)
 	while ((skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
-		case rx_done:
-			entry->state = rx_cleanup;
-			rx_process (dev, skb);
-			continue;
 		case tx_done:
 			kfree(entry->urb->sg);
 		case rx_cleanup:
@@ -1443,7 +1524,8 @@ static void usbnet_bh (unsigned long param)
 	 * only then can we forgo submitting anew
 	 */
 	if (waitqueue_active(&dev->wait)) {
-		if (dev->txq.qlen + dev->rxq.qlen + dev->done.qlen == 0)
+		if (dev->txq.qlen + dev->rxq.qlen + dev->done.qlen +
+		    dev->rxq_done.qlen == 0)
 			wake_up_all(&dev->wait);
 
 	// or are we maybe short a few urbs?
@@ -1469,6 +1551,85 @@ static void usbnet_bh (unsigned long param)
 	}
 }
 
+/*
+ * Size the rx queue from the traffic rather than for the worst case:
+ * deep enough to take what arrives at the measured rate while completed
+ * URBs wait for usbnet_poll(), doubled whenever the queue ran dry, and
+ * shrinking back one URB per sample once the traffic goes away.
+ */
+static void rx_adapt_qlen(struct usbnet *dev)
+{
+	unsigned long	elapsed = jiffies - dev->rx_sample_time;
+	unsigned int	qlen;
+	u64		bytes;
+
+	if (elapsed < RX_SAMPLE_JIFFIES)
+		return;
+
+	/* bytes arriving during the worst completion-to-poll latency */
+	bytes = div64_u64((u64)dev->rx_sample_bytes * dev->rx_sample_latency,
+			  (u64)jiffies_to_usecs(elapsed) * NSEC_PER_USEC);
+	qlen = DIV_ROUND_UP_ULL(bytes, dev->rx_urb_size) + 1;
+
+	if (dev->rx_sample_starved)
+		qlen = max_t(unsigned int, qlen, 2 * dev->rx_qlen);
+	else if (qlen < dev->rx_qlen)
+		qlen = dev->rx_qlen - 1;
+	qlen = clamp_t(unsigned int, qlen, RX_QLEN_MIN, dev->rx_qlen_max);
+
+	if (qlen != dev->rx_qlen)
+		netif_dbg(dev, rx_status, dev->net,
+			  "rx qlen %u -> %u (%u bytes, %u starved)\n",
+			  dev->rx_qlen, qlen, dev->rx_sample_bytes,
+			  dev->rx_sample_starved);
+	dev->rx_qlen = qlen;
+
+	dev->rx_sample_time = jiffies;
+	dev->rx_sample_bytes = 0;
+	dev->rx_sample_starved = 0;
+	dev->rx_sample_latency = 0;
+}
+
+/* NAPI poll: rx completions queued by defer_bh() */
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct usbnet		*dev = container_of(napi, struct usbnet, napi);
+	struct sk_buff		*skb;
+	struct skb_data		*entry;
+	u64			now = local_clock();
+	int			work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dev->rxq_done))) {
+		entry = (struct skb_data *) skb->cb;
+		if (now > entry->done_time &&
+		    now - entry->done_time > dev->rx_sample_latency)
+			dev->rx_sample_latency = now - entry->done_time;
+
+		if (entry->state == rx_done) {
+			entry->state = rx_cleanup;
+			rx_process(dev, skb);
+			work++;
+		} else {
+			usb_free_urb(entry->urb);
+			rx_recycle(dev, skb);
+		}
+	}
+
+	rx_adapt_qlen(dev);
+
+	if (work < budget) {
+		napi_complete(napi);
+		if (!skb_queue_empty(&dev->rxq_done))
+			napi_schedule(napi);
+	}
+
+	/* refill the rx queue, or wake up usbnet_terminate_urbs() */
+	if (dev->rxq.qlen < RX_QLEN(dev) || waitqueue_active(&dev->wait))
+		tasklet_schedule(&dev->bh);
+
+	return work;
+}
+
 
 /*-------------------------------------------------------------------------
  *
@@ -1510,6 +1671,9 @@ void usbnet_disconnect (struct usb_interface *intf)
 	usb_free_urb(dev->interrupt);
 	kfree(dev->padding_pkt);
 
+	/* rx URBs unlinked by usbnet_stop() may have completed since */
+	usbnet_purge_rx(dev);
+
 	free_netdev(net);
 }
 EXPORT_SYMBOL_GPL(usbnet_disconnect);
@@ -1588,6 +1752,9 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	skb_queue_head_init (&dev->txq);
 	skb_queue_head_init (&dev->done);
 	skb_queue_head_init(&dev->rxq_pause);
+	skb_queue_head_init(&dev->rxq_done);
+	skb_queue_head_init(&dev->rxq_pool);
+	netif_napi_add(net, &dev->napi, usbnet_poll, NAPI_POLL_WEIGHT);
 	dev->bh.func = usbnet_bh;
 	dev->bh.data = (unsigned long) dev;
 	INIT_WORK (&dev->kevent, kevent);
@@ -0,0 +1,270 @@
+/* Industrialio block buffer benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Captures from a device with a DMA block buffer for a while, either by
+ * mapping the blocks and passing them back and forth with the
+ * IIO_BUFFER_BLOCK_*_IOCTLs or with plain read()s, and reports the
+ * throughput. All scan elements of the device are enabled.
+ *
+ * With the simple dummy driver built with IIO_SIMPLE_DUMMY_DMA_BUFFER,
+ * the capture rate is set with its dma_rate and dma_burst module parameters
+ * and the scans it had to drop are reported too:
+ *
+ *   modprobe iio_dummy dma_rate=1000000 dma_burst=256
+ *   iio_block_bench -n iio_dummy_part_no -b 8 -s 65536 -t 10
+ *   iio_block_bench -n iio_dummy_part_no -s 65536 -t 10 -r -l 131072
+ *
+ * Command line parameters
+ * iio_block_bench -n <device_name> [-b blocks] [-s block_size] [-t seconds]
+ *		   [-r] [-l length]
+ * -r reads with read() instead, in chunks of block_size; the buffer then
+ * uses four blocks covering its length in scans, which -l sets.
+ */
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+#include <linux/iio/buffer_block.h>
+#include "iio_utils.h"
+
+/* keeps the compiler from dropping the reads of the samples */
+static volatile unsigned long checksum;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Enable every scan element of the device. */
+static int enable_scan_elements(const char *dev_dir_name)
+{
+	char *scan_el_dir;
+	const struct dirent *ent;
+	DIR *dp;
+	int len, ret = 0;
+
+	if (asprintf(&scan_el_dir, FORMAT_SCAN_ELEMENTS_DIR, dev_dir_name) < 0)
+		return -ENOMEM;
+	dp = opendir(scan_el_dir);
+	if (dp == NULL) {
+		ret = -errno;
+		goto error_free_name;
+	}
+	while (ent = readdir(dp), ent != NULL) {
+		len = strlen(ent->d_name);
+		if (len > 3 && strcmp(ent->d_name + len - 3, "_en") == 0) {
+			ret = write_sysfs_int((char *)ent->d_name, scan_el_dir,
+					      1);
+			if (ret < 0)
+				break;
+		}
+	}
+	closedir(dp);
+error_free_name:
+	free(scan_el_dir);
+	return ret;
+}
+
+static long long bench_mmap(int fd, unsigned int num_blocks, unsigned int size,
+			    double seconds, char *buf_dir_name)
+{
+	struct iio_buffer_block_alloc_req req = {
+		.size = size,
+		.count = num_blocks,
+	};
+	struct iio_buffer_block block;
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = POLLIN,
+	};
+	void **addrs;
+	long long bytes = 0;
+	double end;
+	unsigned int i;
+
+	if (ioctl(fd, IIO_BUFFER_BLOCK_ALLOC_IOCTL, &req) < 0) {
+		perror("Failed to allocate blocks");
+		return -1;
+	}
+	printf("%u blocks of %u bytes\n", req.count, req.size);
+
+	addrs = calloc(req.count, sizeof(*addrs));
+	if (!addrs)
+		return -1;
+	for (i = 0; i < req.count; i++) {
+		block.id = i;
+		if (ioctl(fd, IIO_BUFFER_BLOCK_QUERY_IOCTL, &block) < 0) {
+			perror("Failed to query block");
+			return -1;
+		}
+		addrs[i] = mmap(NULL, block.size, PROT_READ, MAP_SHARED, fd,
+				block.offset);
+		if (addrs[i] == MAP_FAILED) {
+			perror("Failed to map block");
+			return -1;
+		}
+		if (ioctl(fd, IIO_BUFFER_BLOCK_ENQUEUE_IOCTL, &block) < 0) {
+			perror("Failed to enqueue block");
+			return -1;
+		}
+	}
+
+	if (write_sysfs_int("enable", buf_dir_name, 1) < 0)
+		return -1;
+
+	end = now() + seconds;
+	while (now() < end) {
+		poll(&pfd, 1, 100);
+		while (ioctl(fd, IIO_BUFFER_BLOCK_DEQUEUE_IOCTL, &block) == 0) {
+			bytes += block.bytes_used;
+			/* touch the data, as a consumer would */
+			for (i = 0; i < block.bytes_used; i += 64)
+				checksum += ((unsigned char *)addrs[block.id])[i];
+			ioctl(fd, IIO_BUFFER_BLOCK_ENQUEUE_IOCTL, &block);
+		}
+	}
+
+	write_sysfs_int("enable", buf_dir_name, 0);
+
+	for (i = 0; i < req.count; i++)
+		munmap(addrs[i], req.size);
+	free(addrs);
+	ioctl(fd, IIO_BUFFER_BLOCK_FREE_IOCTL);
+
+	return bytes;
+}
+
+static long long bench_read(int fd, unsigned int size, double seconds,
+			    char *buf_dir_name)
+{
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = POLLIN,
+	};
+	long long bytes = 0;
+	ssize_t ret;
+	double end;
+	char *data;
+
+	data = malloc(size);
+	if (!data)
+		return -1;
+
+	if (write_sysfs_int("enable", buf_dir_name, 1) < 0)
+		return -1;
+
+	end = now() + seconds;
+	while (now() < end) {
+		poll(&pfd, 1, 100);
+		while ((ret = read(fd, data, size)) > 0)
+			bytes += ret;
+	}
+
+	write_sysfs_int("enable", buf_dir_name, 0);
+	free(data);
+
+	return bytes;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_blocks = 8, block_size = 65536;
+	double seconds = 10;
+	int use_read = 0, buf_len = 0;
+	char *device_name = NULL, *dev_dir_name, *buf_dir_name;
+	char *buffer_access;
+	long long bytes;
+	int dev_num, fd, c, ret;
+
+	while ((c = getopt(argc, argv, "n:b:s:t:rl:")) != -1) {
+		switch (c) {
+		case 'n':
+			device_name = optarg;
+			break;
+		case 'b':
+			num_blocks = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			block_size = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			seconds = strtod(optarg, NULL);
+			break;
+		case 'r':
+			use_read = 1;
+			break;
+		case 'l':
+			buf_len = strtoul(optarg, NULL, 10);
+			break;
+		case '?':
+			return -1;
+		}
+	}
+
+	if (device_name == NULL)
+		return -1;
+
+	dev_num = find_type_by_name(device_name, "iio:device");
+	if (dev_num < 0) {
+		printf("Failed to find the %s\n", device_name);
+		return -ENODEV;
+	}
+
+	if (asprintf(&dev_dir_name, "%siio:device%d", iio_dir, dev_num) < 0 ||
+	    asprintf(&buf_dir_name, "%s/buffer", dev_dir_name) < 0 ||
+	    asprintf(&buffer_access, "/dev/iio:device%d", dev_num) < 0)
+		return -ENOMEM;
+
+	ret = enable_scan_elements(dev_dir_name);
+	if (ret < 0) {
+		printf("Failed to enable the scan elements\n");
+		return ret;
+	}
+
+	fd = open(buffer_access, O_RDONLY | O_NONBLOCK);
+	if (fd == -1) {
+		printf("Failed to open %s\n", buffer_access);
+		return -errno;
+	}
+
+	if (use_read) {
+		if (buf_len && write_sysfs_int("length", buf_dir_name,
+					       buf_len) < 0)
+			return -1;
+		bytes = bench_read(fd, block_size, seconds, buf_dir_name);
+	} else {
+		bytes = bench_mmap(fd, num_blocks, block_size, seconds,
+				   buf_dir_name);
+	}
+	close(fd);
+	if (bytes < 0)
+		return -1;
+
+	printf("%s: %lld bytes in %.1f s, %.1f MB/s\n",
+	       use_read ? "read()" : "mmap", bytes, seconds,
+	       bytes / seconds / 1e6);
+
+	ret = read_sysfs_posint("dma_overruns", dev_dir_name);
+	if (ret >= 0)
+		printf("scans dropped by the device: %d\n", ret);
+
+	return 0;
+}
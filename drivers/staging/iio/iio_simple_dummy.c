@@ -375,6 +375,9 @@ static const struct iio_info iio_dummy_info = {
 	.read_event_value = &iio_simple_dummy_read_event_value,
 	.write_event_value = &iio_simple_dummy_write_event_value,
 #endif /* CONFIG_IIO_SIMPLE_DUMMY_EVENTS */
+#ifdef CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER
+	.attrs = &iio_simple_dummy_dma_attribute_group,
+#endif /* CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER */
 };
 
 /**
@@ -9,8 +9,11 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
 
 struct iio_dummy_accel_calibscale;
+struct iio_dma_buffer_block;
 
 /**
  * struct iio_dummy_state - device instance specific state.
@@ -24,6 +27,14 @@ struct iio_dummy_accel_calibscale;
  * @event_irq:			irq number for event line (faked)
  * @event_val:			cache for event theshold value
  * @event_en:			cache of whether event is enabled
+ * @dma_timer:			simulated DMA interrupt
+ * @dma_blocks:			blocks handed over by the DMA buffer
+ * @dma_block:			block currently being filled
+ * @dma_scan:			scan written for every sample
+ * @dma_period:			time between simulated DMA interrupts
+ * @dma_sample_ns:		time between scans
+ * @dma_burst:			scans written per simulated DMA interrupt
+ * @dma_overruns:		scans dropped for lack of a block
  */
 struct iio_dummy_state {
 	int dac_val;
@@ -38,6 +49,16 @@ struct iio_dummy_state {
 	int event_val;
 	bool event_en;
 #endif /* CONFIG_IIO_SIMPLE_DUMMY_EVENTS */
+#ifdef CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER
+	struct hrtimer dma_timer;
+	DECLARE_KFIFO(dma_blocks, struct iio_dma_buffer_block *, 64);
+	struct iio_dma_buffer_block *dma_block;
+	void *dma_scan;
+	ktime_t dma_period;
+	s64 dma_sample_ns;
+	unsigned int dma_burst;
+	unsigned long dma_overruns;
+#endif /* CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER */
 };
 
 #ifdef CONFIG_IIO_SIMPLE_DUMMY_EVENTS
@@ -104,7 +125,12 @@ enum iio_simple_dummy_scan_elements {
 	accelx,
 };
 
-#ifdef CONFIG_IIO_SIMPLE_DUMMY_BUFFER
+#ifdef CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER
+extern const struct attribute_group iio_simple_dummy_dma_attribute_group;
+#endif
+
+#if defined(CONFIG_IIO_SIMPLE_DUMMY_BUFFER) || \
+	defined(CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER)
 int iio_simple_dummy_configure_buffer(struct iio_dev *indio_dev,
 	const struct iio_chan_spec *channels, unsigned int num_channels);
 void iio_simple_dummy_unconfigure_buffer(struct iio_dev *indio_dev);
@@ -117,4 +143,4 @@ static inline int iio_simple_dummy_configure_buffer(struct iio_dev *indio_dev,
 static inline
 void iio_simple_dummy_unconfigure_buffer(struct iio_dev *indio_dev)
 {};
-#endif /* CONFIG_IIO_SIMPLE_DUMMY_BUFFER */
+#endif /* CONFIG_IIO_SIMPLE_DUMMY_BUFFER || CONFIG_IIO_SIMPLE_DUMMY_DMA_BUFFER */
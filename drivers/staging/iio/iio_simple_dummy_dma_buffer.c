@@ -0,0 +1,263 @@
+/**
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * DMA block buffer handling of the industrial I/O reference driver.
+ *
+ * Rather than a trigger per sample, a converter that streams at a high rate
+ * has its DMA controller fill whole blocks, with an interrupt per block or
+ * per burst of samples. Here an hrtimer stands in for the hardware: every
+ * tick it writes a burst of scans into the current block and completes the
+ * block when it is full. Samples for which no block is queued are counted
+ * as overruns, so userspace can see whether it keeps up.
+ *
+ * The rate and the burst length are module parameters, so this doubles as a
+ * benchmark of the buffer; see Documentation/iio_block_bench.c.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/dma-mapping.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/sysfs.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/buffer_dma.h>
+
+#include "iio_simple_dummy.h"
+
+static unsigned int dma_rate = 100000;
+module_param(dma_rate, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dma_rate, "scans per second captured into the DMA buffer");
+
+static unsigned int dma_burst = 64;
+module_param(dma_burst, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dma_burst, "scans written per simulated DMA interrupt");
+
+/* Some fake data */
+
+static const s16 fakedata[] = {
+	[voltage0] = 7,
+	[diffvoltage1m2] = -33,
+	[diffvoltage3m4] = -2,
+	[accelx] = 344,
+};
+
+/**
+ * iio_simple_dummy_dma_timer() - the simulated DMA interrupt
+ * @timer: the hrtimer in the device state
+ *
+ * Writes a burst of scans into the blocks the buffer has handed over and
+ * completes each block once no further scan fits.
+ */
+static enum hrtimer_restart iio_simple_dummy_dma_timer(struct hrtimer *timer)
+{
+	struct iio_dummy_state *st = container_of(timer, struct iio_dummy_state,
+						  dma_timer);
+	struct iio_dev *indio_dev = iio_priv_to_dev(st);
+	struct iio_dma_buffer_block *block;
+	s64 now = iio_get_time_ns();
+	unsigned int i;
+
+	for (i = 0; i < st->dma_burst; i++) {
+		if (!st->dma_block && !kfifo_get(&st->dma_blocks, &st->dma_block)) {
+			st->dma_overruns += st->dma_burst - i;
+			break;
+		}
+		block = st->dma_block;
+
+		/* the scans of a burst were taken one sample period apart */
+		if (indio_dev->scan_timestamp)
+			((s64 *)st->dma_scan)[indio_dev->scan_bytes /
+					      sizeof(s64) - 1] =
+				now - (s64)(st->dma_burst - 1 - i) *
+				st->dma_sample_ns;
+
+		memcpy(block->vaddr + block->bytes_used, st->dma_scan,
+		       indio_dev->scan_bytes);
+		block->bytes_used += indio_dev->scan_bytes;
+
+		if (block->bytes_used + indio_dev->scan_bytes > block->size) {
+			block->timestamp = now;
+			iio_dma_buffer_block_done(block);
+			st->dma_block = NULL;
+		}
+	}
+
+	hrtimer_forward_now(timer, st->dma_period);
+
+	return HRTIMER_RESTART;
+}
+
+static int iio_simple_dummy_dma_submit(struct iio_dma_buffer_queue *queue,
+				       struct iio_dma_buffer_block *block)
+{
+	struct iio_dummy_state *st = queue->driver_data;
+
+	/* The hardware equivalent is writing a DMA descriptor. */
+	if (!kfifo_put(&st->dma_blocks, block))
+		return -EBUSY;
+
+	return 0;
+}
+
+static void iio_simple_dummy_dma_abort(struct iio_dma_buffer_queue *queue)
+{
+	struct iio_dummy_state *st = queue->driver_data;
+
+	hrtimer_cancel(&st->dma_timer);
+
+	/* Hand over what has been captured into the current block. */
+	if (st->dma_block && st->dma_block->bytes_used) {
+		st->dma_block->timestamp = iio_get_time_ns();
+		iio_dma_buffer_block_done(st->dma_block);
+	}
+	st->dma_block = NULL;
+	kfifo_reset(&st->dma_blocks);
+}
+
+static const struct iio_dma_buffer_ops iio_simple_dummy_dma_ops = {
+	.submit = iio_simple_dummy_dma_submit,
+	.abort = iio_simple_dummy_dma_abort,
+};
+
+static int iio_simple_dummy_dma_postenable(struct iio_dev *indio_dev)
+{
+	struct iio_dummy_state *st = iio_priv(indio_dev);
+	unsigned int rate = max(dma_rate, 1U);
+	s16 *data;
+	int ret;
+	int i, j;
+
+	/* The fake device returns the same scan every sample period. */
+	kfree(st->dma_scan);
+	st->dma_scan = kzalloc(indio_dev->scan_bytes, GFP_KERNEL);
+	if (st->dma_scan == NULL)
+		return -ENOMEM;
+
+	data = st->dma_scan;
+	for (i = 0, j = 0;
+	     i < bitmap_weight(indio_dev->active_scan_mask,
+			       indio_dev->masklength);
+	     i++, j++) {
+		j = find_next_bit(indio_dev->active_scan_mask,
+				  indio_dev->masklength, j);
+		data[i] = fakedata[j];
+	}
+
+	st->dma_burst = clamp(dma_burst, 1U, rate);
+	st->dma_sample_ns = NSEC_PER_SEC / rate;
+	st->dma_period = ns_to_ktime((u64)st->dma_burst * NSEC_PER_SEC / rate);
+	st->dma_overruns = 0;
+	st->dma_block = NULL;
+	kfifo_reset(&st->dma_blocks);
+
+	ret = iio_dma_buffer_enable(indio_dev->buffer);
+	if (ret)
+		return ret;
+
+	hrtimer_start(&st->dma_timer, st->dma_period, HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+static int iio_simple_dummy_dma_predisable(struct iio_dev *indio_dev)
+{
+	return iio_dma_buffer_disable(indio_dev->buffer);
+}
+
+static const struct iio_buffer_setup_ops iio_simple_dummy_dma_setup_ops = {
+	.postenable = &iio_simple_dummy_dma_postenable,
+	.predisable = &iio_simple_dummy_dma_predisable,
+};
+
+static ssize_t iio_simple_dummy_show_overruns(struct device *dev,
+					      struct device_attribute *attr,
+					      char *buf)
+{
+	struct iio_dummy_state *st = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%lu\n", st->dma_overruns);
+}
+
+static IIO_DEVICE_ATTR(dma_overruns, S_IRUGO,
+		       iio_simple_dummy_show_overruns, NULL, 0);
+
+static struct attribute *iio_simple_dummy_dma_attributes[] = {
+	&iio_dev_attr_dma_overruns.dev_attr.attr,
+	NULL,
+};
+
+const struct attribute_group iio_simple_dummy_dma_attribute_group = {
+	.attrs = iio_simple_dummy_dma_attributes,
+};
+
+int iio_simple_dummy_configure_buffer(struct iio_dev *indio_dev,
+	const struct iio_chan_spec *channels, unsigned int num_channels)
+{
+	struct iio_dummy_state *st = iio_priv(indio_dev);
+	struct iio_buffer *buffer;
+	int ret;
+
+	/*
+	 * With hardware the blocks are allocated for the device doing the
+	 * DMA, e.g. the SPI controller. The IIO device itself stands in for
+	 * it here, so give it a DMA mask to allocate against.
+	 */
+	indio_dev->dev.coherent_dma_mask = DMA_BIT_MASK(32);
+	indio_dev->dev.dma_mask = &indio_dev->dev.coherent_dma_mask;
+
+	INIT_KFIFO(st->dma_blocks);
+	hrtimer_init(&st->dma_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	st->dma_timer.function = iio_simple_dummy_dma_timer;
+
+	buffer = iio_dma_buffer_allocate(&indio_dev->dev,
+					 &iio_simple_dummy_dma_ops, st);
+	if (buffer == NULL) {
+		ret = -ENOMEM;
+		goto error_ret;
+	}
+
+	iio_device_attach_buffer(indio_dev, buffer);
+
+	/* Enable timestamps by default */
+	buffer->scan_timestamp = true;
+
+	indio_dev->setup_ops = &iio_simple_dummy_dma_setup_ops;
+
+	/*
+	 * The samples are pushed by the (simulated) hardware, there is no
+	 * trigger involved.
+	 */
+	indio_dev->modes |= INDIO_BUFFER_HARDWARE;
+
+	ret = iio_buffer_register(indio_dev, channels, num_channels);
+	if (ret)
+		goto error_free_buffer;
+
+	return 0;
+
+error_free_buffer:
+	iio_dma_buffer_free(indio_dev->buffer);
+error_ret:
+	return ret;
+}
+
+/**
+ * iio_simple_dummy_unconfigure_buffer() - release buffer resources
+ * @indo_dev: device instance state
+ */
+void iio_simple_dummy_unconfigure_buffer(struct iio_dev *indio_dev)
+{
+	struct iio_dummy_state *st = iio_priv(indio_dev);
+
+	iio_buffer_unregister(indio_dev);
+	iio_dma_buffer_free(indio_dev->buffer);
+	kfree(st->dma_scan);
+}
@@ -70,6 +70,15 @@
 #define UART_DR_ERROR		(UART011_DR_OE|UART011_DR_BE|UART011_DR_PE|UART011_DR_FE)
 #define UART_DUMMY_DR_RX	(1 << 16)
 
+/*
+ * Without RX DMA the RX FIFO trigger level follows the receive rate: low
+ * for latency when the line is quiet, high for fewer interrupts when it is
+ * busy, but never so high that the FIFO could fill up within the interrupt
+ * latency we allow for.
+ */
+#define PL011_RX_LATENCY_US	250
+#define PL011_RX_WINDOW		(HZ / 10)
+
 /* There is by now at least one vendor with differing details, so handle it */
 struct vendor_data {
 	unsigned int		ifls;
@@ -78,6 +87,7 @@ struct vendor_data {
 	bool			oversampling;
 	bool			dma_threshold;
 	bool			cts_event_workaround;
+	bool			adaptive_rx_level;
 
 	unsigned int (*get_fifosize)(struct amba_device *dev);
 };
@@ -94,6 +104,7 @@ static struct vendor_data vendor_arm = {
 	.oversampling		= false,
 	.dma_threshold		= false,
 	.cts_event_workaround	= false,
+	.adaptive_rx_level	= true,
 	.get_fifosize		= get_fifosize_arm,
 };
 
@@ -109,6 +120,7 @@ static struct vendor_data vendor_st = {
 	.oversampling		= true,
 	.dma_threshold		= true,
 	.cts_event_workaround	= true,
+	.adaptive_rx_level	= false,
 	.get_fifosize		= get_fifosize_st,
 };
 
@@ -133,6 +145,10 @@ struct pl011_dmarx_data {
 	bool auto_poll_rate;
 	unsigned int poll_rate;
 	unsigned int poll_timeout;
+	bool			cyclic;
+	char			*ring;
+	dma_addr_t		ring_dma;
+	unsigned int		ring_tail;
 };
 
 struct pl011_dmatx_data {
@@ -158,8 +174,16 @@ struct uart_amba_port {
 	unsigned int		old_cr;		/* state during shutdown */
 	bool			autorts;
 	char			type[12];
+	unsigned int		baud;
+	unsigned int		rx_level;	/* RX trigger, IFLS encoding */
+	unsigned int		rx_level_max;
+	unsigned long		rx_window;	/* start of rate window */
+	unsigned int		rx_chars;	/* received in the window */
+	unsigned int		rx_overrun;
 #ifdef CONFIG_DMA_ENGINE
 	/* DMA stuff */
+	unsigned int		dma_width;	/* bytes per DR access */
+	dma_addr_t		dma_dr_addr;	/* DR for the DMA engine */
 	bool			using_tx_dma;
 	bool			using_rx_dma;
 	struct pl011_dmarx_data dmarx;
@@ -167,6 +191,43 @@ struct uart_amba_port {
 #endif
 };
 
+/*
+ * Inserts a received character into the TTY layer, with the error flags
+ * of the data register above the low byte.
+ */
+static void pl011_rx_char(struct uart_amba_port *uap, unsigned int ch)
+{
+	unsigned int flag = TTY_NORMAL;
+
+	if (unlikely(ch & UART_DR_ERROR)) {
+		if (ch & UART011_DR_BE) {
+			ch &= ~(UART011_DR_FE | UART011_DR_PE);
+			uap->port.icount.brk++;
+			if (uart_handle_break(&uap->port))
+				return;
+		} else if (ch & UART011_DR_PE)
+			uap->port.icount.parity++;
+		else if (ch & UART011_DR_FE)
+			uap->port.icount.frame++;
+		if (ch & UART011_DR_OE)
+			uap->port.icount.overrun++;
+
+		ch &= uap->port.read_status_mask;
+
+		if (ch & UART011_DR_BE)
+			flag = TTY_BREAK;
+		else if (ch & UART011_DR_PE)
+			flag = TTY_PARITY;
+		else if (ch & UART011_DR_FE)
+			flag = TTY_FRAME;
+	}
+
+	if (uart_handle_sysrq_char(&uap->port, ch & 255))
+		return;
+
+	uart_insert_char(&uap->port, ch, UART011_DR_OE, ch, flag);
+}
+
 /*
  * Reads up to 256 characters from the FIFO or until it's empty and
  * inserts them into the TTY layer. Returns the number of characters
@@ -175,7 +236,7 @@ struct uart_amba_port {
 static int pl011_fifo_to_tty(struct uart_amba_port *uap)
 {
 	u16 status, ch;
-	unsigned int flag, max_count = 256;
+	unsigned int max_count = 256;
 	int fifotaken = 0;
 
 	while (max_count--) {
@@ -186,37 +247,10 @@ static int pl011_fifo_to_tty(struct uart_amba_port *uap)
 		/* Take chars from the FIFO and update status */
 		ch = readw(uap->port.membase + UART01x_DR) |
 			UART_DUMMY_DR_RX;
-		flag = TTY_NORMAL;
 		uap->port.icount.rx++;
 		fifotaken++;
 
-		if (unlikely(ch & UART_DR_ERROR)) {
-			if (ch & UART011_DR_BE) {
-				ch &= ~(UART011_DR_FE | UART011_DR_PE);
-				uap->port.icount.brk++;
-				if (uart_handle_break(&uap->port))
-					continue;
-			} else if (ch & UART011_DR_PE)
-				uap->port.icount.parity++;
-			else if (ch & UART011_DR_FE)
-				uap->port.icount.frame++;
-			if (ch & UART011_DR_OE)
-				uap->port.icount.overrun++;
-
-			ch &= uap->port.read_status_mask;
-
-			if (ch & UART011_DR_BE)
-				flag = TTY_BREAK;
-			else if (ch & UART011_DR_PE)
-				flag = TTY_PARITY;
-			else if (ch & UART011_DR_FE)
-				flag = TTY_FRAME;
-		}
-
-		if (uart_handle_sysrq_char(&uap->port, ch & 255))
-			continue;
-
-		uart_insert_char(&uap->port, ch, UART011_DR_OE, ch, flag);
+		pl011_rx_char(uap, ch);
 	}
 
 	return fifotaken;
@@ -231,6 +265,7 @@ static int pl011_fifo_to_tty(struct uart_amba_port *uap)
 #ifdef CONFIG_DMA_ENGINE
 
 #define PL011_DMA_BUFFER_SIZE PAGE_SIZE
+#define PL011_DMA_RING_SIZE (4 * PL011_DMA_BUFFER_SIZE)
 
 static int pl011_sgbuf_init(struct dma_chan *chan, struct pl011_sgbuf *sg,
 	enum dma_data_direction dir)
@@ -260,13 +295,31 @@ static void pl011_sgbuf_free(struct dma_chan *chan, struct pl011_sgbuf *sg,
 	}
 }
 
+/*
+ * Inserts len bytes of received DMA data into the TTY layer. With 32-bit
+ * accesses each word holds a character and its error flags. Returns the
+ * number of bytes taken.
+ */
+static int pl011_dma_rx_insert(struct uart_amba_port *uap, char *buf,
+			       int len)
+{
+	u32 *word = (u32 *)buf;
+	int i;
+
+	if (uap->dma_width == 1)
+		return tty_insert_flip_string(&uap->port.state->port, buf, len);
+
+	for (i = 0; i < len / 4; i++)
+		pl011_rx_char(uap, word[i] & 0xfff);
+
+	return i * 4;
+}
+
 static void pl011_dma_probe_initcall(struct device *dev, struct uart_amba_port *uap)
 {
 	/* DMA is the sole user of the platform data right now */
 	struct amba_pl011_data *plat = dev_get_platdata(uap->port.dev);
 	struct dma_slave_config tx_conf = {
-		.dst_addr = uap->port.mapbase + UART01x_DR,
-		.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
 		.direction = DMA_MEM_TO_DEV,
 		.dst_maxburst = uap->fifosize >> 1,
 		.device_fc = false,
@@ -274,6 +327,17 @@ static void pl011_dma_probe_initcall(struct device *dev, struct uart_amba_port *
 	struct dma_chan *chan;
 	dma_cap_mask_t mask;
 
+	/* Some integrations only allow word accesses by their DMA engine */
+	uap->dma_width = plat && plat->dma_width == 4 ? 4 : 1;
+	tx_conf.dst_addr_width = uap->dma_width;
+
+	/* ... or see the UART at a bus address other than its physical one */
+	if (plat && plat->dma_dr_addr)
+		uap->dma_dr_addr = plat->dma_dr_addr;
+	else
+		uap->dma_dr_addr = uap->port.mapbase + UART01x_DR;
+	tx_conf.dst_addr = uap->dma_dr_addr;
+
 	chan = dma_request_slave_channel(dev, "tx");
 
 	if (!chan) {
@@ -315,8 +379,8 @@ static void pl011_dma_probe_initcall(struct device *dev, struct uart_amba_port *
 
 	if (chan) {
 		struct dma_slave_config rx_conf = {
-			.src_addr = uap->port.mapbase + UART01x_DR,
-			.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+			.src_addr = uap->dma_dr_addr,
+			.src_addr_width = uap->dma_width,
 			.direction = DMA_DEV_TO_MEM,
 			.src_maxburst = uap->fifosize >> 1,
 			.device_fc = false,
@@ -325,7 +389,12 @@ static void pl011_dma_probe_initcall(struct device *dev, struct uart_amba_port *
 		dmaengine_slave_config(chan, &rx_conf);
 		uap->dmarx.chan = chan;
 
-		if (plat && plat->dma_rx_poll_enable) {
+		/*
+		 * A cyclic transfer never completes, so its ring is flushed
+		 * by the period callbacks and the poll timer.
+		 */
+		uap->dmarx.cyclic = plat && plat->dma_rx_cyclic;
+		if (plat && (plat->dma_rx_poll_enable || plat->dma_rx_cyclic)) {
 			/* Set poll rate if specified. */
 			if (plat->dma_rx_poll_rate) {
 				uap->dmarx.auto_poll_rate = false;
@@ -348,8 +417,9 @@ static void pl011_dma_probe_initcall(struct device *dev, struct uart_amba_port *
 		} else
 			uap->dmarx.auto_poll_rate = false;
 
-		dev_info(uap->port.dev, "DMA channel RX %s\n",
-			 dma_chan_name(uap->dmarx.chan));
+		dev_info(uap->port.dev, "DMA channel RX %s%s\n",
+			 dma_chan_name(uap->dmarx.chan),
+			 uap->dmarx.cyclic ? " (cyclic)" : "");
 	}
 }
 
@@ -494,10 +564,19 @@ static int pl011_dma_tx_refill(struct uart_amba_port *uap)
 	count -= 1;
 
 	/* Else proceed to copy the TX chars to the DMA buffer and fire DMA */
-	if (count > PL011_DMA_BUFFER_SIZE)
-		count = PL011_DMA_BUFFER_SIZE;
+	if (count > PL011_DMA_BUFFER_SIZE / uap->dma_width)
+		count = PL011_DMA_BUFFER_SIZE / uap->dma_width;
 
-	if (xmit->tail < xmit->head)
+	if (uap->dma_width == 4) {
+		u32 *word = (u32 *)dmatx->buf;
+		unsigned int i, tail = xmit->tail;
+
+		/* One character in the low byte of each word */
+		for (i = 0; i < count; i++) {
+			word[i] = (unsigned char)xmit->buf[tail];
+			tail = (tail + 1) & (UART_XMIT_SIZE - 1);
+		}
+	} else if (xmit->tail < xmit->head)
 		memcpy(&dmatx->buf[0], &xmit->buf[xmit->tail], count);
 	else {
 		size_t first = UART_XMIT_SIZE - xmit->tail;
@@ -508,7 +587,7 @@ static int pl011_dma_tx_refill(struct uart_amba_port *uap)
 			memcpy(&dmatx->buf[first], &xmit->buf[0], second);
 	}
 
-	dmatx->sg.length = count;
+	dmatx->sg.length = count * uap->dma_width;
 
 	if (dma_map_sg(dma_dev->dev, &dmatx->sg, 1, DMA_TO_DEVICE) != 1) {
 		uap->dmatx.queued = false;
@@ -696,6 +775,162 @@ __acquires(&uap->port.lock)
 	}
 }
 
+/*
+ * Cyclic RX: on DMA engines that only do cyclic transfers well, one
+ * transfer into a ring runs from the first trigger until shutdown, and
+ * RXDMAE alone decides whether the UART feeds it.  Characters are taken
+ * from the ring at every period and poll timer tick, and on receive
+ * timeouts.  Once the line has been idle for poll_timeout the port goes
+ * back to interrupt mode without stopping the transfer.
+ */
+static void pl011_dma_rx_cyclic_callback(void *data);
+
+/*
+ * Takes everything written to the ring since the last flush and inserts
+ * it into the TTY layer. Called with the port lock held; returns the
+ * number of bytes taken from the ring.
+ */
+static unsigned int pl011_dma_rx_cyclic_flush(struct uart_amba_port *uap)
+{
+	struct pl011_dmarx_data *dmarx = &uap->dmarx;
+	struct dma_chan *rxchan = dmarx->chan;
+	unsigned int head, tail = dmarx->ring_tail;
+	unsigned int len, taken = 0;
+	struct dma_tx_state state;
+
+	/* Without a known position, leave the ring for the next flush */
+	if (rxchan->device->device_tx_status(rxchan, dmarx->cookie,
+					     &state) == DMA_ERROR)
+		return 0;
+	head = (PL011_DMA_RING_SIZE - state.residue) % PL011_DMA_RING_SIZE;
+	head &= ~(uap->dma_width - 1);
+	if (head == tail)
+		return 0;
+
+	len = (head - tail) % PL011_DMA_RING_SIZE;
+	if (head < tail) {
+		taken = pl011_dma_rx_insert(uap, dmarx->ring + tail,
+					    PL011_DMA_RING_SIZE - tail);
+		tail = 0;
+	}
+	taken += pl011_dma_rx_insert(uap, dmarx->ring + tail, head - tail);
+
+	/* The ring moves on regardless, what did not fit is lost */
+	if (taken < len) {
+		uap->port.icount.buf_overrun += (len - taken) / uap->dma_width;
+		dev_warn(uap->port.dev,
+			 "couldn't insert all characters (TTY is full?)\n");
+	}
+	uap->port.icount.rx += taken / uap->dma_width;
+	dmarx->ring_tail = head;
+
+	return len;
+}
+
+static int pl011_dma_rx_cyclic_start(struct uart_amba_port *uap)
+{
+	struct pl011_dmarx_data *dmarx = &uap->dmarx;
+	struct dma_async_tx_descriptor *desc;
+
+	if (!dmarx->cookie) {
+		desc = dmaengine_prep_dma_cyclic(dmarx->chan, dmarx->ring_dma,
+						 PL011_DMA_RING_SIZE,
+						 PL011_DMA_BUFFER_SIZE,
+						 DMA_DEV_TO_MEM,
+						 DMA_PREP_INTERRUPT);
+		if (!desc)
+			return -EBUSY;
+
+		desc->callback = pl011_dma_rx_cyclic_callback;
+		desc->callback_param = uap;
+		dmarx->ring_tail = 0;
+		dmarx->cookie = dmaengine_submit(desc);
+		dma_async_issue_pending(dmarx->chan);
+	}
+
+	uap->dmacr |= UART011_RXDMAE;
+	writew(uap->dmacr, uap->port.membase + UART011_DMACR);
+	dmarx->running = true;
+
+	uap->im &= ~UART011_RXIM;
+	writew(uap->im, uap->port.membase + UART011_IMSC);
+
+	return 0;
+}
+
+/* A period of the ring has been filled */
+static void pl011_dma_rx_cyclic_callback(void *data)
+{
+	struct uart_amba_port *uap = data;
+
+	spin_lock_irq(&uap->port.lock);
+	if (uap->dmarx.running && pl011_dma_rx_cyclic_flush(uap))
+		uap->dmarx.last_jiffies = jiffies;
+	spin_unlock_irq(&uap->port.lock);
+
+	tty_flip_buffer_push(&uap->port.state->port);
+}
+
+/*
+ * Stops the UART from feeding the ring, so that the ring and then the
+ * FIFO can be emptied in order. The read back makes sure the DMA request
+ * has dropped before the ring position is sampled.
+ */
+static void pl011_dma_rx_cyclic_drain(struct uart_amba_port *uap)
+{
+	uap->dmacr &= ~UART011_RXDMAE;
+	writew(uap->dmacr, uap->port.membase + UART011_DMACR);
+	readw(uap->port.membase + UART011_DMACR);
+
+	pl011_dma_rx_cyclic_flush(uap);
+	pl011_fifo_to_tty(uap);
+}
+
+/*
+ * A receive interrupt with the ring running: fewer characters than the
+ * DMA burst size are left in the FIFO. Called with the port lock held.
+ */
+static void pl011_dma_rx_cyclic_irq(struct uart_amba_port *uap)
+{
+	pl011_dma_rx_cyclic_drain(uap);
+	uap->dmarx.last_jiffies = jiffies;
+
+	uap->dmacr |= UART011_RXDMAE;
+	writew(uap->dmacr, uap->port.membase + UART011_DMACR);
+
+	spin_unlock(&uap->port.lock);
+	tty_flip_buffer_push(&uap->port.state->port);
+	spin_lock(&uap->port.lock);
+}
+
+static void pl011_dma_rx_cyclic_poll(struct uart_amba_port *uap)
+{
+	struct pl011_dmarx_data *dmarx = &uap->dmarx;
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&uap->port.lock, flags);
+	if (pl011_dma_rx_cyclic_flush(uap))
+		dmarx->last_jiffies = jiffies;
+
+	idle = jiffies_to_msecs(jiffies - dmarx->last_jiffies) >
+		dmarx->poll_timeout;
+	if (idle) {
+		/* The next character retriggers DMA from the RX interrupt */
+		pl011_dma_rx_cyclic_drain(uap);
+		dmarx->running = false;
+		uap->im |= UART011_RXIM;
+		writew(uap->im, uap->port.membase + UART011_IMSC);
+	}
+	spin_unlock_irqrestore(&uap->port.lock, flags);
+
+	tty_flip_buffer_push(&uap->port.state->port);
+
+	if (!idle)
+		mod_timer(&dmarx->timer,
+			  jiffies + msecs_to_jiffies(dmarx->poll_rate));
+}
+
 static void pl011_dma_rx_callback(void *data);
 
 static int pl011_dma_rx_trigger_dma(struct uart_amba_port *uap)
@@ -708,6 +943,9 @@ static int pl011_dma_rx_trigger_dma(struct uart_amba_port *uap)
 	if (!rxchan)
 		return -EIO;
 
+	if (dmarx->cyclic)
+		return pl011_dma_rx_cyclic_start(uap);
+
 	/* Start the RX DMA job */
 	sgbuf = uap->dmarx.use_buf_b ?
 		&uap->dmarx.sgbuf_b : &uap->dmarx.sgbuf_a;
@@ -775,10 +1013,10 @@ static void pl011_dma_rx_chars(struct uart_amba_port *uap,
 		 * Note that tty_insert_flip_buf() tries to take as many chars
 		 * as it can.
 		 */
-		dma_count = tty_insert_flip_string(port, sgbuf->buf + dmataken,
+		dma_count = pl011_dma_rx_insert(uap, sgbuf->buf + dmataken,
 				pending);
 
-		uap->port.icount.rx += dma_count;
+		uap->port.icount.rx += dma_count / uap->dma_width;
 		if (dma_count < pending)
 			dev_warn(uap->port.dev,
 				 "couldn't insert all characters (TTY is full?)\n");
@@ -829,6 +1067,11 @@ static void pl011_dma_rx_irq(struct uart_amba_port *uap)
 	struct dma_tx_state state;
 	enum dma_status dmastat;
 
+	if (dmarx->cyclic) {
+		pl011_dma_rx_cyclic_irq(uap);
+		return;
+	}
+
 	/*
 	 * Pause the transfer so we can trust the current counter,
 	 * do this before we pause the PL011 block, else we may
@@ -945,12 +1188,17 @@ static void pl011_dma_rx_poll(unsigned long args)
 	int dma_count;
 	struct dma_tx_state state;
 
+	if (dmarx->cyclic) {
+		pl011_dma_rx_cyclic_poll(uap);
+		return;
+	}
+
 	sgbuf = dmarx->use_buf_b ? &uap->dmarx.sgbuf_b : &uap->dmarx.sgbuf_a;
 	rxchan->device->device_tx_status(rxchan, dmarx->cookie, &state);
 	if (likely(state.residue < dmarx->last_residue)) {
 		dmataken = sgbuf->sg.length - dmarx->last_residue;
 		size = dmarx->last_residue - state.residue;
-		dma_count = tty_insert_flip_string(port, sgbuf->buf + dmataken,
+		dma_count = pl011_dma_rx_insert(uap, sgbuf->buf + dmataken,
 				size);
 		if (dma_count == size)
 			dmarx->last_residue =  state.residue;
@@ -997,12 +1245,24 @@ static void pl011_dma_startup(struct uart_amba_port *uap)
 	sg_init_one(&uap->dmatx.sg, uap->dmatx.buf, PL011_DMA_BUFFER_SIZE);
 
 	/* The DMA buffer is now the FIFO the TTY subsystem can use */
-	uap->port.fifosize = PL011_DMA_BUFFER_SIZE;
+	uap->port.fifosize = PL011_DMA_BUFFER_SIZE / uap->dma_width;
 	uap->using_tx_dma = true;
 
 	if (!uap->dmarx.chan)
 		goto skip_rx;
 
+	if (uap->dmarx.cyclic) {
+		uap->dmarx.ring = dma_alloc_coherent(uap->dmarx.chan->device->dev,
+				PL011_DMA_RING_SIZE, &uap->dmarx.ring_dma,
+				GFP_KERNEL);
+		if (!uap->dmarx.ring) {
+			dev_err(uap->port.dev, "failed to init DMA %s: %d\n",
+				"RX ring", -ENOMEM);
+			goto skip_rx;
+		}
+		goto rx_ready;
+	}
+
 	/* Allocate and map DMA RX buffers */
 	ret = pl011_sgbuf_init(uap->dmarx.chan, &uap->dmarx.sgbuf_a,
 			       DMA_FROM_DEVICE);
@@ -1022,6 +1282,7 @@ static void pl011_dma_startup(struct uart_amba_port *uap)
 		goto skip_rx;
 	}
 
+rx_ready:
 	uap->using_rx_dma = true;
 
 skip_rx:
@@ -1084,11 +1345,18 @@ static void pl011_dma_shutdown(struct uart_amba_port *uap)
 
 	if (uap->using_rx_dma) {
 		dmaengine_terminate_all(uap->dmarx.chan);
-		/* Clean up the RX DMA */
-		pl011_sgbuf_free(uap->dmarx.chan, &uap->dmarx.sgbuf_a, DMA_FROM_DEVICE);
-		pl011_sgbuf_free(uap->dmarx.chan, &uap->dmarx.sgbuf_b, DMA_FROM_DEVICE);
 		if (uap->dmarx.poll_rate)
 			del_timer_sync(&uap->dmarx.timer);
+		/* Clean up the RX DMA */
+		if (uap->dmarx.cyclic) {
+			dma_free_coherent(uap->dmarx.chan->device->dev,
+					  PL011_DMA_RING_SIZE, uap->dmarx.ring,
+					  uap->dmarx.ring_dma);
+			uap->dmarx.cookie = 0;
+		} else {
+			pl011_sgbuf_free(uap->dmarx.chan, &uap->dmarx.sgbuf_a, DMA_FROM_DEVICE);
+			pl011_sgbuf_free(uap->dmarx.chan, &uap->dmarx.sgbuf_b, DMA_FROM_DEVICE);
+		}
 		uap->using_rx_dma = false;
 	}
 }
@@ -1199,11 +1467,93 @@ static void pl011_enable_ms(struct uart_port *port)
 	writew(uap->im, uap->port.membase + UART011_IMSC);
 }
 
+/* RX FIFO trigger levels in eighths, indexed by their IFLS encoding */
+static const unsigned char pl011_rx_eighths[] = { 1, 2, 4, 6, 7 };
+
+static void pl011_set_rx_level(struct uart_amba_port *uap, unsigned int level)
+{
+	uap->rx_level = level;
+	writew((uap->vendor->ifls & ~UART011_IFLS_RX_MASK) | level << 3,
+	       uap->port.membase + UART011_IFLS);
+}
+
+/*
+ * Find the highest RX trigger level that leaves room in the FIFO for the
+ * characters arriving within PL011_RX_LATENCY_US at this baud rate, and
+ * restart the rate estimate from the vendor default level.
+ * Locking: called with port lock held and IRQs disabled.
+ */
+static void pl011_init_rx_level(struct uart_amba_port *uap, unsigned int baud)
+{
+	unsigned int margin = DIV_ROUND_UP(baud / 10 * PL011_RX_LATENCY_US,
+					   USEC_PER_SEC);
+	unsigned int level;
+
+	if (!uap->vendor->adaptive_rx_level || pl011_dma_rx_available(uap))
+		return;
+
+	for (level = ARRAY_SIZE(pl011_rx_eighths) - 1; level > 0; level--)
+		if (uap->fifosize - uap->fifosize *
+		    pl011_rx_eighths[level] / 8 >= margin)
+			break;
+
+	uap->baud = baud;
+	uap->rx_level_max = level;
+	uap->rx_window = jiffies;
+	uap->rx_chars = 0;
+	uap->rx_overrun = uap->port.icount.overrun;
+	pl011_set_rx_level(uap, min(level, (uap->vendor->ifls &
+					    UART011_IFLS_RX_MASK) >> 3));
+}
+
+/*
+ * Pick the RX trigger level for the receive rate seen over the last
+ * window. A busy line gets the highest safe level for the fewest
+ * interrupts, a quiet one the lowest for latency. An overrun lowers the
+ * ceiling until the next termios change.
+ * Locking: called with port lock held and IRQs disabled.
+ */
+static void pl011_adapt_rx_level(struct uart_amba_port *uap,
+				 unsigned int taken)
+{
+	unsigned long elapsed = jiffies - uap->rx_window;
+	unsigned long rate;
+	unsigned int level;
+
+	if (!uap->vendor->adaptive_rx_level || !uap->baud ||
+	    pl011_dma_rx_available(uap))
+		return;
+
+	uap->rx_chars += taken;
+	if (elapsed < PL011_RX_WINDOW)
+		return;
+
+	if (uap->port.icount.overrun != uap->rx_overrun &&
+	    uap->rx_level_max > 0)
+		uap->rx_level_max--;
+
+	/* Characters per second against the line rate of baud / 10 */
+	rate = (unsigned long)uap->rx_chars * HZ / elapsed;
+	if (rate * 10 >= uap->baud / 4)
+		level = uap->rx_level_max;
+	else if (rate * 10 >= uap->baud / 32)
+		level = min(uap->rx_level_max, 2U);
+	else
+		level = 0;
+
+	if (level != uap->rx_level)
+		pl011_set_rx_level(uap, level);
+
+	uap->rx_window = jiffies;
+	uap->rx_chars = 0;
+	uap->rx_overrun = uap->port.icount.overrun;
+}
+
 static void pl011_rx_chars(struct uart_amba_port *uap)
 __releases(&uap->port.lock)
 __acquires(&uap->port.lock)
 {
-	pl011_fifo_to_tty(uap);
+	pl011_adapt_rx_level(uap, pl011_fifo_to_tty(uap));
 
 	spin_unlock(&uap->port.lock);
 	tty_flip_buffer_push(&uap->port.state->port);
@@ -1740,6 +2090,7 @@ pl011_set_termios(struct uart_port *port, struct ktermios *termios,
 	 * Update the per-port timeout.
 	 */
 	uart_update_timeout(port, termios->c_cflag, baud);
+	pl011_init_rx_level(uap, baud);
 
 	port->read_status_mask = UART011_DR_OE | 255;
 	if (termios->c_iflag & INPCK)
@@ -141,10 +141,10 @@
  * a callback functions is needed.
  *
  * To provide maximum throughput, the driver uses a circular pipeline of
- * buffer heads (struct fsg_buffhd).  In principle the pipeline can be
- * arbitrarily long; in practice the benefits don't justify having more
- * than 2 stages (i.e., double buffering).  But it helps to think of the
- * pipeline as being a long one.  Each buffer head contains a bulk-in and
+ * buffer heads (struct fsg_buffhd).  The pipeline can be arbitrarily
+ * long; double buffering is enough when the backing file is fast, but a
+ * slow one needs more stages to keep several file I/Os in flight.  Each
+ * buffer head contains a bulk-in and
  * a bulk-out request pointer (since the buffer can be used for both
  * output and input -- directions always are given from the host's
  * point of view) as well as a pointer to the buffer and various state
@@ -161,6 +161,16 @@
  * (again possibly by USB I/O, during which it is marked BUSY) and
  * finally marked EMPTY again (possibly by a completion routine).
  *
+ * The backing file I/O of READ and WRITE commands is not done by the main
+ * thread itself but queued to a workqueue, one buffer head at a time for
+ * reads and a run of consecutive FULL buffer heads at a time for writes.
+ * While the I/O is in flight the buffer heads are marked FILE_IO, and the
+ * work function marks them FILE_DONE and wakes the main thread when it is
+ * complete.  Many reads can be in flight at once, so the latency of the
+ * backing file overlaps with itself and with the USB transfers.  Writes
+ * are issued one at a time, in order, but every buffer head that fills
+ * up while one is in flight goes into the next one.
+ *
  * A module parameter tells the driver to avoid stalling the bulk
  * endpoints wherever the transport specification allows.  This is
  * necessary for some UDCs like the SuperH, which cannot reliably clear a
@@ -208,10 +218,13 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/pagemap.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
+#include <linux/uio.h>
+#include <linux/workqueue.h>
 #include <linux/freezer.h>
 #include <linux/module.h>
 
@@ -306,6 +319,7 @@ struct fsg_common {
 	int			thread_wakeup_needed;
 	struct completion	thread_notifier;
 	struct task_struct	*thread_task;
+	struct workqueue_struct	*io_wq;		/* Backing file I/O */
 
 	/* Callback functions. */
 	const struct fsg_operations	*ops;
@@ -626,18 +640,118 @@ static int sleep_thread(struct fsg_common *common, bool can_freeze)
 }
 
 
+/*-------------------------------------------------------------------------*/
+
+/* Runs on common->io_wq; see start_file_io() */
+static void fsg_file_work(struct work_struct *work)
+{
+	struct fsg_buffhd	*bh = container_of(work, struct fsg_buffhd,
+						   file_work);
+	struct fsg_common	*common = bh->common;
+	struct file		*filp = common->curlun->filp;
+	struct iovec		iov[FSG_MAX_WRITE_BUFFERS];
+	struct fsg_buffhd	*b;
+	loff_t			file_offset = bh->file_offset;
+	mm_segment_t		old_fs;
+	ssize_t			rc;
+	unsigned int		i;
+
+	old_fs = get_fs();
+	set_fs(get_ds());
+	if (common->data_dir == DATA_DIR_FROM_HOST) {
+		for (i = 0, b = bh; i < bh->file_nbufs; ++i, b = b->next) {
+			iov[i].iov_base = (void __user *)b->buf;
+			iov[i].iov_len = b->file_amount;
+		}
+		rc = vfs_writev(filp, (const struct iovec __user *)iov,
+				bh->file_nbufs, &file_offset);
+	} else {
+		rc = vfs_read(filp, (char __user *)bh->buf,
+			      bh->file_amount, &file_offset);
+	}
+	set_fs(old_fs);
+
+	spin_lock_irq(&common->lock);
+	bh->file_result = rc;
+	smp_wmb();	/* the state is read without the lock */
+	for (i = 0, b = bh; i < bh->file_nbufs; ++i, b = b->next)
+		b->state = BUF_STATE_FILE_DONE;
+	wakeup_thread(common);
+	spin_unlock_irq(&common->lock);
+}
+
+/*
+ * Read into bh, or write nbufs buffers starting with bh, at file_offset.
+ * The amount for each buffer is in its file_amount.
+ */
+static void start_file_io(struct fsg_common *common, struct fsg_buffhd *bh,
+			  loff_t file_offset, unsigned int nbufs)
+{
+	struct fsg_buffhd	*b;
+	unsigned int		i;
+
+	bh->file_offset = file_offset;
+	bh->file_nbufs = nbufs;
+	spin_lock_irq(&common->lock);
+	for (i = 0, b = bh; i < nbufs; ++i, b = b->next)
+		b->state = BUF_STATE_FILE_IO;
+	spin_unlock_irq(&common->lock);
+	queue_work(common->io_wq, &bh->file_work);
+}
+
+/*
+ * Wait for the file I/O still in flight when a command ends early and
+ * throw away whatever it read.
+ */
+static void abort_file_io(struct fsg_common *common)
+{
+	int	i;
+
+	flush_workqueue(common->io_wq);
+	for (i = 0; i < common->fsg_num_buffers; ++i) {
+		struct fsg_buffhd *bh = &common->buffhds[i];
+
+		if (bh->state == BUF_STATE_FILE_DONE)
+			bh->state = BUF_STATE_EMPTY;
+	}
+}
+
+/*
+ * Hosts read a large file as a stream of READ commands of a few dozen
+ * kilobytes each, and between two of them the backing file would sit
+ * idle while the CSW and the next CBW cross the bus.  When a READ starts
+ * where the previous one ended, get the range that the next one will
+ * most likely ask for into the page cache in the meantime.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t file_offset,
+			      u32 amount)
+{
+	struct file	*filp = curlun->filp;
+	pgoff_t		index = file_offset >> PAGE_CACHE_SHIFT;
+	pgoff_t		end;
+
+	if (file_offset >= curlun->file_length)
+		return;
+	end = (min_t(loff_t, file_offset + amount, curlun->file_length) +
+	       PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	page_cache_sync_readahead(filp->f_mapping, &filp->f_ra, filp,
+				  index, end - index);
+}
+
+
 /*-------------------------------------------------------------------------*/
 
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
 	u32			lba;
-	struct fsg_buffhd	*bh;
+	struct fsg_buffhd	*bh, *next_bh;
 	int			rc;
-	u32			amount_left;
-	loff_t			file_offset, file_offset_tmp;
+	u32			amount_left, amount_to_queue;
+	loff_t			file_offset, queue_offset;
 	unsigned int		amount;
 	ssize_t			nread;
+	bool			sequential;
 
 	/*
 	 * Get the starting Logical Block Address and check that it's
@@ -669,30 +783,99 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	sequential = file_offset == curlun->next_read;
+	curlun->next_read = file_offset + amount_left;
+
+	/*
+	 * bh is the next buffer to be sent to the host and next_bh the
+	 * next one to be read into.
+	 */
+	bh = next_bh = common->next_buffhd_to_fill;
+	queue_offset = file_offset;
+	amount_to_queue = amount_left;
+
 	for (;;) {
 		/*
-		 * Figure out how much we need to read:
+		 * Queue reads into all the free buffers:
 		 * Try to read the remaining amount.
 		 * But don't read more than the buffer size.
 		 * And don't try to read past the end of the file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
-		amount = min((loff_t)amount,
-			     curlun->file_length - file_offset);
+		while (amount_to_queue > 0 &&
+		       next_bh->state == BUF_STATE_EMPTY) {
+			amount = min(amount_to_queue, FSG_BUFLEN);
+			amount = min((loff_t)amount,
+				     curlun->file_length - queue_offset);
+			if (amount == 0)
+				break;
 
-		/* Wait for the next buffer to become available */
-		bh = common->next_buffhd_to_fill;
-		while (bh->state != BUF_STATE_EMPTY) {
-			rc = sleep_thread(common, false);
-			if (rc)
-				return rc;
+			next_bh->file_amount = amount;
+			start_file_io(common, next_bh, queue_offset, 1);
+			queue_offset += amount;
+			amount_to_queue -= amount;
+			next_bh = next_bh->next;
+
+			if (amount_to_queue == 0 && sequential)
+				fsg_lun_readahead(curlun, queue_offset,
+						  common->data_size_from_cmnd);
+		}
+
+		/* Send the next buffer once its read has completed */
+		if (bh->state == BUF_STATE_FILE_DONE) {
+			smp_rmb();	/* read the result after the state */
+			amount = bh->file_amount;
+			nread = bh->file_result;
+			VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
+			      (unsigned long long)file_offset, (int)nread);
+
+			if (nread < 0) {
+				LDBG(curlun, "error in file read: %d\n",
+				     (int)nread);
+				nread = 0;
+			} else if (nread < amount) {
+				LDBG(curlun, "partial file read: %d/%u\n",
+				     (int)nread, amount);
+				nread = round_down(nread, curlun->blksize);
+			}
+			file_offset  += nread;
+			amount_left  -= nread;
+			common->residue -= nread;
+
+			/*
+			 * Except at the end of the transfer, nread will be
+			 * equal to the buffer size, which is divisible by the
+			 * bulk-in maxpacket size.
+			 */
+			bh->inreq->length = nread;
+			bh->state = BUF_STATE_FULL;
+
+			/* If an error occurred, report it and its position */
+			if (nread < amount) {
+				curlun->sense_data = SS_UNRECOVERED_READ_ERROR;
+				curlun->sense_data_info =
+					file_offset >> curlun->blkbits;
+				curlun->info_valid = 1;
+				break;
+			}
+
+			if (amount_left == 0)
+				break;		/* No more left to read */
+
+			/* Send this buffer and go read some more */
+			bh->inreq->zero = 0;
+			if (!start_in_transfer(common, bh))
+				/* Don't know what to do if common->fsg is NULL */
+				break;
+			bh = bh->next;
+			continue;
 		}
 
 		/*
 		 * If we were asked to read past the end of file,
 		 * end with an empty buffer.
 		 */
-		if (amount == 0) {
+		if (bh == next_bh && bh->state == BUF_STATE_EMPTY &&
+		    file_offset >= curlun->file_length) {
 			curlun->sense_data =
 					SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 			curlun->sense_data_info =
@@ -703,56 +886,18 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		/* Perform the read */
-		file_offset_tmp = file_offset;
-		nread = vfs_read(curlun->filp,
-				 (char __user *)bh->buf,
-				 amount, &file_offset_tmp);
-		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
-		      (unsigned long long)file_offset, (int)nread);
-		if (signal_pending(current))
-			return -EINTR;
-
-		if (nread < 0) {
-			LDBG(curlun, "error in file read: %d\n", (int)nread);
-			nread = 0;
-		} else if (nread < amount) {
-			LDBG(curlun, "partial file read: %d/%u\n",
-			     (int)nread, amount);
-			nread = round_down(nread, curlun->blksize);
-		}
-		file_offset  += nread;
-		amount_left  -= nread;
-		common->residue -= nread;
-
-		/*
-		 * Except at the end of the transfer, nread will be
-		 * equal to the buffer size, which is divisible by the
-		 * bulk-in maxpacket size.
-		 */
-		bh->inreq->length = nread;
-		bh->state = BUF_STATE_FULL;
-
-		/* If an error occurred, report it and its position */
-		if (nread < amount) {
-			curlun->sense_data = SS_UNRECOVERED_READ_ERROR;
-			curlun->sense_data_info =
-					file_offset >> curlun->blkbits;
-			curlun->info_valid = 1;
-			break;
+		/* Wait for something to happen */
+		rc = sleep_thread(common, false);
+		if (rc) {
+			abort_file_io(common);
+			common->next_buffhd_to_fill = bh;
+			return rc;
 		}
-
-		if (amount_left == 0)
-			break;		/* No more left to read */
-
-		/* Send this buffer and go read some more */
-		bh->inreq->zero = 0;
-		if (!start_in_transfer(common, bh))
-			/* Don't know what to do if common->fsg is NULL */
-			return -EIO;
-		common->next_buffhd_to_fill = bh->next;
 	}
 
+	/* Drop the reads queued beyond an error */
+	abort_file_io(common);
+	common->next_buffhd_to_fill = bh;
 	return -EIO;		/* No default reply */
 }
 
@@ -763,11 +908,11 @@ static int do_write(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
 	u32			lba;
-	struct fsg_buffhd	*bh;
-	int			get_some_more;
+	struct fsg_buffhd	*bh, *write_bh = NULL;
+	int			get_some_more, short_packet = 0;
 	u32			amount_left_to_req, amount_left_to_write;
-	loff_t			usb_offset, file_offset, file_offset_tmp;
-	unsigned int		amount;
+	loff_t			usb_offset, file_offset, end_offset;
+	unsigned int		amount, write_amount = 0, nbufs, i;
 	ssize_t			nwritten;
 	int			rc;
 
@@ -859,60 +1004,25 @@ static int do_write(struct fsg_common *common)
 			continue;
 		}
 
-		/* Write the received data to the backing file */
-		bh = common->next_buffhd_to_drain;
-		if (bh->state == BUF_STATE_EMPTY && !get_some_more)
-			break;			/* We stopped early */
-		if (bh->state == BUF_STATE_FULL) {
-			smp_rmb();
-			common->next_buffhd_to_drain = bh->next;
-			bh->state = BUF_STATE_EMPTY;
-
-			/* Did something go wrong with the transfer? */
-			if (bh->outreq->status != 0) {
-				curlun->sense_data = SS_COMMUNICATION_FAILURE;
-				curlun->sense_data_info =
-					file_offset >> curlun->blkbits;
-				curlun->info_valid = 1;
-				break;
-			}
-
-			amount = bh->outreq->actual;
-			if (curlun->file_length - file_offset < amount) {
-				LERROR(curlun,
-				       "write %u @ %llu beyond end %llu\n",
-				       amount, (unsigned long long)file_offset,
-				       (unsigned long long)curlun->file_length);
-				amount = curlun->file_length - file_offset;
-			}
-
-			/* Don't accept excess data.  The spec doesn't say
-			 * what to do in this case.  We'll ignore the error.
-			 */
-			amount = min(amount, bh->bulk_out_intended_length);
-
-			/* Don't write a partial block */
-			amount = round_down(amount, curlun->blksize);
-			if (amount == 0)
-				goto empty_write;
-
-			/* Perform the write */
-			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					     (char __user *)bh->buf,
-					     amount, &file_offset_tmp);
-			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
-			      (unsigned long long)file_offset, (int)nwritten);
-			if (signal_pending(current))
-				return -EINTR;		/* Interrupted! */
+		/* Collect the result of the write in flight */
+		bh = write_bh;
+		if (bh && bh->state == BUF_STATE_FILE_DONE) {
+			smp_rmb();	/* read the result after the state */
+			nwritten = bh->file_result;
+			VLDBG(curlun, "file write %u @ %llu -> %d\n",
+			      write_amount, (unsigned long long)file_offset,
+			      (int)nwritten);
+			for (i = bh->file_nbufs; i; --i, bh = bh->next)
+				bh->state = BUF_STATE_EMPTY;
+			write_bh = NULL;
 
 			if (nwritten < 0) {
 				LDBG(curlun, "error in file write: %d\n",
 				     (int)nwritten);
 				nwritten = 0;
-			} else if (nwritten < amount) {
+			} else if (nwritten < write_amount) {
 				LDBG(curlun, "partial file write: %d/%u\n",
-				     (int)nwritten, amount);
+				     (int)nwritten, write_amount);
 				nwritten = round_down(nwritten, curlun->blksize);
 			}
 			file_offset += nwritten;
@@ -920,7 +1030,7 @@ static int do_write(struct fsg_common *common)
 			common->residue -= nwritten;
 
 			/* If an error occurred, report it and its position */
-			if (nwritten < amount) {
+			if (nwritten < write_amount) {
 				curlun->sense_data = SS_WRITE_ERROR;
 				curlun->sense_data_info =
 					file_offset >> curlun->blkbits;
@@ -928,19 +1038,104 @@ static int do_write(struct fsg_common *common)
 				break;
 			}
 
- empty_write:
 			/* Did the host decide to stop early? */
-			if (bh->outreq->actual < bh->bulk_out_intended_length) {
+			if (short_packet) {
 				common->short_packet_received = 1;
 				break;
 			}
 			continue;
 		}
 
+		/*
+		 * Write the received data to the backing file, one write
+		 * at a time.  All the buffers that have filled up while the
+		 * previous write was in flight go into the next one.
+		 */
+		bh = common->next_buffhd_to_drain;
+		if (!write_bh && bh->state == BUF_STATE_EMPTY && !get_some_more)
+			break;			/* We stopped early */
+		if (!write_bh && bh->state == BUF_STATE_FULL) {
+			smp_rmb();
+
+			/* Did something go wrong with the transfer? */
+			if (bh->outreq->status != 0) {
+				common->next_buffhd_to_drain = bh->next;
+				bh->state = BUF_STATE_EMPTY;
+				curlun->sense_data = SS_COMMUNICATION_FAILURE;
+				curlun->sense_data_info =
+					file_offset >> curlun->blkbits;
+				curlun->info_valid = 1;
+				break;
+			}
+
+			write_bh = bh;
+			write_amount = 0;
+			nbufs = 0;
+			for (;;) {
+				end_offset = file_offset + write_amount;
+				amount = bh->outreq->actual;
+				if (curlun->file_length - end_offset < amount) {
+					LERROR(curlun,
+					       "write %u @ %llu beyond end %llu\n",
+					       amount,
+					       (unsigned long long)end_offset,
+					       (unsigned long long)
+							curlun->file_length);
+					amount = curlun->file_length -
+						 end_offset;
+				}
+
+				/*
+				 * Don't accept excess data.  The spec doesn't
+				 * say what to do in this case.  We'll ignore
+				 * the error.
+				 */
+				amount = min(amount,
+					     bh->bulk_out_intended_length);
+
+				/* Don't write a partial block */
+				amount = round_down(amount, curlun->blksize);
+				bh->file_amount = amount;
+				write_amount += amount;
+				++nbufs;
+
+				/* Did the host decide to stop early? */
+				if (bh->outreq->actual <
+				    bh->bulk_out_intended_length) {
+					short_packet = 1;
+					break;
+				}
+
+				if (nbufs == FSG_MAX_WRITE_BUFFERS ||
+				    bh->next->state != BUF_STATE_FULL)
+					break;
+				smp_rmb();
+				if (bh->next->outreq->status != 0)
+					break;		/* Leave it for later */
+				bh = bh->next;
+			}
+			common->next_buffhd_to_drain = bh->next;
+
+			if (write_amount == 0) {
+				for (bh = write_bh; nbufs; --nbufs, bh = bh->next)
+					bh->state = BUF_STATE_EMPTY;
+				write_bh = NULL;
+				if (short_packet) {
+					common->short_packet_received = 1;
+					break;
+				}
+				continue;
+			}
+			start_file_io(common, write_bh, file_offset, nbufs);
+			continue;
+		}
+
 		/* Wait for something to happen */
 		rc = sleep_thread(common, false);
-		if (rc)
+		if (rc) {
+			abort_file_io(common);
 			return rc;
+		}
 	}
 
 	return -EIO;		/* No default reply */
@@ -2656,10 +2851,11 @@ EXPORT_SYMBOL_GPL(fsg_common_put);
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(unsigned int fsg_num_buffers)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= FSG_MIN_NUM_BUFFERS &&
+	    fsg_num_buffers <= FSG_MAX_NUM_BUFFERS)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2, 4);
+	       fsg_num_buffers, FSG_MIN_NUM_BUFFERS, FSG_MAX_NUM_BUFFERS);
 	return -EINVAL;
 }
 
@@ -2725,6 +2921,8 @@ buffhds_first_it:
 		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
 		if (unlikely(!bh->buf))
 			goto error_release;
+		bh->common = common;
+		INIT_WORK(&bh->file_work, fsg_file_work);
 	} while (--i);
 	bh->next = buffhds;
 
@@ -3041,12 +3239,18 @@ EXPORT_SYMBOL_GPL(fsg_common_set_inquiry_string);
 
 int fsg_common_run_thread(struct fsg_common *common)
 {
+	common->io_wq = alloc_workqueue("file-storage", WQ_UNBOUND, 0);
+	if (!common->io_wq)
+		return -ENOMEM;
+
 	common->state = FSG_STATE_IDLE;
 	/* Tell the thread to start working */
 	common->thread_task =
 		kthread_create(fsg_main_thread, common, "file-storage");
 	if (IS_ERR(common->thread_task)) {
 		common->state = FSG_STATE_TERMINATED;
+		destroy_workqueue(common->io_wq);
+		common->io_wq = NULL;
 		return PTR_ERR(common->thread_task);
 	}
 
@@ -3067,6 +3271,8 @@ static void fsg_common_release(struct kref *ref)
 		raise_exception(common, FSG_STATE_EXIT);
 		wait_for_completion(&common->thread_notifier);
 	}
+	if (common->io_wq)
+		destroy_workqueue(common->io_wq);
 
 	if (likely(common->luns)) {
 		struct fsg_lun **lun_it = common->luns;
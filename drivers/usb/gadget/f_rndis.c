@@ -106,6 +106,10 @@ static unsigned int bitrate(struct usb_gadget *g)
 #define RNDIS_STATUS_INTERVAL_MS	32
 #define STATUS_BYTECOUNT		8	/* 8 bytes data */
 
+/* packet messages per bulk transfer, from and to the host */
+#define RNDIS_UL_MAX_PKTS_PER_XFER	3
+#define RNDIS_DL_MAX_PKTS_PER_XFER	10
+
 
 /* interface descriptor: */
 
@@ -371,14 +375,13 @@ static struct usb_gadget_strings *rndis_strings[] = {
 static struct sk_buff *rndis_add_header(struct gether *port,
 					struct sk_buff *skb)
 {
-	struct sk_buff *skb2;
-
-	skb2 = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type));
-	if (skb2)
-		rndis_add_hdr(skb2);
-
-	dev_kfree_skb_any(skb);
-	return skb2;
+	/* the header normally fits into the headroom; only copy if not */
+	if (skb_cow_head(skb, sizeof(struct rndis_packet_msg_type))) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+	rndis_add_hdr(skb);
+	return skb;
 }
 
 static void rndis_response_available(void *_rndis)
@@ -458,6 +461,11 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		pr_err("RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	/* the host announces in REMOTE_NDIS_INITIALIZE_MSG how large
+	 * transfers it takes from us
+	 */
+	rndis->port.dl_max_xfer_size = rndis_get_dl_max_xfer_size(rndis->config);
 }
 
 static int
@@ -959,6 +967,9 @@ static struct usb_function *rndis_alloc(struct usb_function_instance *fi)
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.wrap_sg = true;
+	rndis->port.ul_max_pkts_per_xfer = RNDIS_UL_MAX_PKTS_PER_XFER;
+	rndis->port.dl_max_pkts_per_xfer = RNDIS_DL_MAX_PKTS_PER_XFER;
 
 	rndis->port.func.name = "rndis";
 	/* descriptors are per-instance copies */
@@ -975,6 +986,7 @@ static struct usb_function *rndis_alloc(struct usb_function_instance *fi)
 		return ERR_PTR(status);
 	}
 	rndis->config = status;
+	rndis_set_max_pkt_xfer(rndis->config, RNDIS_UL_MAX_PKTS_PER_XFER);
 
 	return &rndis->port.func;
 }
@@ -2,6 +2,7 @@
 #define USB_STORAGE_COMMON_H
 
 #include <linux/device.h>
+#include <linux/workqueue.h>
 #include <linux/usb/storage.h>
 #include <scsi/scsi.h>
 #include <asm/unaligned.h>
@@ -102,6 +103,8 @@ struct fsg_lun {
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
 
+	loff_t		next_read;	/* Where a sequential READ goes next */
+
 	u32		sense_data;
 	u32		sense_data_info;
 	u32		unit_attention_data;
@@ -122,15 +125,24 @@ static inline bool fsg_lun_is_open(struct fsg_lun *curlun)
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
 
+/* Limits on the number of buffers and on the buffers written at once */
+#define FSG_MIN_NUM_BUFFERS	2
+#define FSG_MAX_NUM_BUFFERS	32
+#define FSG_MAX_WRITE_BUFFERS	8
+
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
 
 enum fsg_buffer_state {
 	BUF_STATE_EMPTY = 0,
 	BUF_STATE_FULL,
-	BUF_STATE_BUSY
+	BUF_STATE_BUSY,
+	BUF_STATE_FILE_IO,
+	BUF_STATE_FILE_DONE
 };
 
+struct fsg_common;
+
 struct fsg_buffhd {
 	void				*buf;
 	enum fsg_buffer_state		state;
@@ -147,6 +159,18 @@ struct fsg_buffhd {
 	int				inreq_busy;
 	struct usb_request		*outreq;
 	int				outreq_busy;
+
+	/*
+	 * Backing file I/O queued by the main thread.  A write covers
+	 * file_nbufs buffers starting with this one, each contributing
+	 * its own file_amount.
+	 */
+	struct fsg_common		*common;
+	struct work_struct		file_work;
+	loff_t				file_offset;
+	unsigned int			file_amount;
+	unsigned int			file_nbufs;
+	ssize_t				file_result;
 };
 
 enum fsg_state {
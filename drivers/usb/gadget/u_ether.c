@@ -21,6 +21,7 @@
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/if_vlan.h>
+#include <linux/scatterlist.h>
 
 #include "u_ether.h"
 
@@ -63,9 +64,16 @@ struct eth_dev {
 
 	struct sk_buff_head	rx_frames;
 
+	/* IN transfer being assembled from several frames, guarded
+	 * by req_lock; see tx_aggregate()
+	 */
+	struct sk_buff		*tx_agg;
+	unsigned		tx_agg_pkts;
+
 	unsigned		qmult;
 
 	unsigned		header_len;
+	unsigned		ul_max_pkts_per_xfer;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
 						struct sk_buff *skb,
@@ -87,6 +95,9 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* largest IN transfer assembled from several frames */
+#define TX_AGG_MAX	8192
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget, unsigned qmult)
 {
@@ -222,6 +233,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->ul_max_pkts_per_xfer > 1)
+		size *= dev->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -381,6 +394,7 @@ extra:
 
 		next = req->list.next;
 		list_del(&req->list);
+		kfree(req->sg);
 		usb_ep_free_request(ep, req);
 
 		if (next == list)
@@ -393,12 +407,20 @@ extra:
 
 static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 {
-	int	status;
+	struct usb_request	*req;
+	int			status;
 
 	spin_lock(&dev->req_lock);
 	status = prealloc(&dev->tx_reqs, link->in_ep, n);
 	if (status < 0)
 		goto fail;
+	/* IN transfers of non-linear skbs map their fragments directly */
+	if (dev->gadget->sg_supported)
+		list_for_each_entry(req, &dev->tx_reqs, list)
+			if (!req->sg)
+				req->sg = kmalloc(sizeof(struct scatterlist) *
+						  (MAX_SKB_FRAGS + 1),
+						  GFP_ATOMIC);
 	status = prealloc(&dev->rx_reqs, link->out_ep, n);
 	if (status < 0)
 		goto fail;
@@ -446,15 +468,51 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static int eth_tx_queue(struct eth_dev *dev, struct usb_ep *in,
+			struct usb_request *req, struct sk_buff *skb, bool agg,
+			bool irq);
+
+/* send an assembled IN transfer once a request is free */
+static void tx_flush(struct eth_dev *dev, struct usb_ep *in)
+{
+	struct usb_request	*req;
+	struct sk_buff		*skb;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	skb = dev->tx_agg;
+	if (!skb || list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	dev->tx_agg = NULL;
+	req = container_of(dev->tx_reqs.next, struct usb_request, list);
+	list_del(&req->list);
+	if (list_empty(&dev->tx_reqs))
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (eth_tx_queue(dev, in, req, skb, true, true)) {
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped++;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	}
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
+	int		status = req->status;
 
-	switch (req->status) {
+	switch (status) {
 	default:
 		dev->net->stats.tx_errors++;
-		VDBG(dev, "tx err %d\n", req->status);
+		VDBG(dev, "tx err %d\n", status);
 		/* FALLTHROUGH */
 	case -ECONNRESET:		/* unlink */
 	case -ESHUTDOWN:		/* disconnect etc */
@@ -470,25 +528,184 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	dev_kfree_skb_any(skb);
 
 	atomic_dec(&dev->tx_qlen);
+
+	/* frames held back while this transfer was in flight */
+	if (status != -ESHUTDOWN)
+		tx_flush(dev, ep);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+static void tx_agg_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct eth_dev	*dev = ep->driver_data;
+	unsigned	pkts = *(unsigned *)((struct sk_buff *)req->context)->cb;
+
+	/* tx_complete() counts one of them */
+	dev->net->stats.tx_packets += pkts - 1;
+	tx_complete(ep, req);
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/* append a wrapped frame to an assembled IN transfer */
+static void tx_agg_append(struct sk_buff *agg, struct sk_buff *skb)
+{
+	unsigned	len = ALIGN(skb->len, 8);
+	u8		*data = skb_put(agg, len);
+
+	/* RNDIS messages are padded so that each one starts aligned */
+	skb_copy_bits(skb, 0, data, skb->len);
+	memset(data + skb->len, 0, len - skb->len);
+	put_unaligned_le32(len, data + 4);
+	(*(unsigned *)agg->cb)++;
+}
+
+/*
+ * RNDIS lets one IN transfer carry several frames, up to limits set by
+ * the host.  While earlier transfers are still in flight, frames are
+ * copied into one larger transfer instead of queueing a request each;
+ * tx_complete() sends it as soon as the earlier transfer completes.
+ * With nothing in flight the frame goes out by itself, without a copy.
+ *
+ * Returns the skb to send now (the frame itself or a completed assembly,
+ * flagged through @agg) or NULL if the frame is held back.
+ */
+static struct sk_buff *tx_aggregate(struct eth_dev *dev, struct sk_buff *skb,
+				    unsigned max_pkts, unsigned max_size,
+				    bool *agg)
+{
+	struct sk_buff	*out = NULL;
+	unsigned	frame = ALIGN(dev->net->mtu + ETH_HLEN +
+				      dev->header_len, 8);
+	unsigned long	flags;
+
+	*agg = false;
+	max_size = min_t(unsigned, max_size, TX_AGG_MAX);
+	if (max_pkts < 2 || max_size < 2 * frame)
+		return skb;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!dev->tx_agg && !atomic_read(&dev->tx_qlen)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return skb;
+	}
+	if (dev->tx_agg && skb_tailroom(dev->tx_agg) < ALIGN(skb->len, 8)) {
+		/* no room left, send what we have */
+		out = dev->tx_agg;
+		dev->tx_agg = NULL;
+	}
+
+	if (!dev->tx_agg) {
+		dev->tx_agg = alloc_skb(max_size, GFP_ATOMIC);
+		if (!dev->tx_agg) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			if (out) {
+				dev_kfree_skb_any(skb);
+				dev->net->stats.tx_dropped++;
+				*agg = true;
+				return out;
+			}
+			return skb;
+		}
+		*(unsigned *)dev->tx_agg->cb = 0;
+	}
+
+	tx_agg_append(dev->tx_agg, skb);
+	if (!out && (*(unsigned *)dev->tx_agg->cb >= max_pkts ||
+		     skb_tailroom(dev->tx_agg) < frame ||
+		     !atomic_read(&dev->tx_qlen))) {
+		out = dev->tx_agg;
+		dev->tx_agg = NULL;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	*agg = out != NULL;
+	return out;
+}
+
+/*
+ * Queue an IN transfer for @skb, directly over the skb data or, for
+ * non-linear skbs, a scatterlist covering its fragments.  @agg flags
+ * an assembled transfer; @irq asks for a completion interrupt, which
+ * tx_aggregate() relies on to send the frames it holds back.
+ */
+static int eth_tx_queue(struct eth_dev *dev, struct usb_ep *in,
+			struct usb_request *req, struct sk_buff *skb, bool agg,
+			bool irq)
+{
+	int			length = skb->len;
+	int			retval;
+
+	req->context = skb;
+	req->complete = agg ? tx_agg_complete : tx_complete;
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (!agg && dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	/* the extra byte must come from the linear buffer */
+	if (skb_is_nonlinear(skb) && (length != skb->len || !req->sg) &&
+	    skb_linearize(skb))
+		return -ENOMEM;
+
+	if (skb_is_nonlinear(skb)) {
+		sg_init_table(req->sg, skb_shinfo(skb)->nr_frags + 1);
+		req->num_sgs = skb_to_sgvec(skb, req->sg, 0, skb->len);
+		req->buf = NULL;
+	} else {
+		req->num_sgs = 0;
+		req->buf = skb->data;
+	}
+	req->length = length;
+
+	/* throttle high/super speed IRQ rate back slightly */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = !irq &&
+				    (dev->gadget->speed == USB_SPEED_HIGH ||
+				     dev->gadget->speed == USB_SPEED_SUPER)
+			? ((atomic_read(&dev->tx_qlen) % dev->qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+	}
+	return retval;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
-	int			length = skb->len;
 	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		max_pkts = 0, max_size = 0;
+	bool			agg = false;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
@@ -527,6 +744,16 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	/*
+	 * The stack only hands us non-linear skbs along with checksum
+	 * offload, which USB doesn't have; fill in the checksum here.
+	 */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb)) {
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -554,56 +781,34 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		unsigned long	flags;
 
 		spin_lock_irqsave(&dev->lock, flags);
-		if (dev->port_usb)
-			skb = dev->wrap(dev->port_usb, skb);
+		if (dev->port_usb) {
+			/* framing code may only handle linear skbs */
+			if (!dev->port_usb->wrap_sg && skb_linearize(skb)) {
+				dev_kfree_skb_any(skb);
+				skb = NULL;
+			} else {
+				skb = dev->wrap(dev->port_usb, skb);
+			}
+			max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+			max_size = dev->port_usb->dl_max_xfer_size;
+		}
 		spin_unlock_irqrestore(&dev->lock, flags);
 		if (!skb)
 			goto drop;
 
-		length = skb->len;
-	}
-	req->buf = skb->data;
-	req->context = skb;
-	req->complete = tx_complete;
-
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
-	req->length = length;
-
-	/* throttle high/super speed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH ||
-				     dev->gadget->speed == USB_SPEED_SUPER)
-			? ((atomic_read(&dev->tx_qlen) % dev->qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
+		if (max_pkts > 1) {
+			skb = tx_aggregate(dev, skb, max_pkts, max_size, &agg);
+			if (!skb)
+				goto hold;
+		}
 	}
 
+	retval = eth_tx_queue(dev, in, req, skb, agg, max_pkts > 1);
 	if (retval) {
 		dev_kfree_skb_any(skb);
 drop:
 		dev->net->stats.tx_dropped++;
+hold:
 		spin_lock_irqsave(&dev->req_lock, flags);
 		if (list_empty(&dev->tx_reqs))
 			netif_start_queue(net);
@@ -798,6 +1003,8 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	dev->gadget = g;
 	SET_NETDEV_DEV(net, &g->dev);
 	SET_NETDEV_DEVTYPE(net, &gadget_type);
+	if (g->sg_supported)
+		net->features |= NETIF_F_SG | NETIF_F_HW_CSUM;
 
 	status = register_netdev(net);
 	if (status < 0) {
@@ -868,6 +1075,8 @@ int gether_register_netdev(struct net_device *net)
 		return -EINVAL;
 	dev = netdev_priv(net);
 	g = dev->gadget;
+	if (g->sg_supported)
+		net->features |= NETIF_F_SG | NETIF_F_HW_CSUM;
 	status = register_netdev(net);
 	if (status < 0) {
 		dev_dbg(&g->dev, "register_netdev failed, %d\n", status);
@@ -1065,8 +1274,10 @@ struct net_device *gether_connect(struct gether *link)
 		DBG(dev, "qlen %d\n", qlen(dev->gadget, dev->qmult));
 
 		dev->header_len = link->header_len;
+		dev->ul_max_pkts_per_xfer = link->ul_max_pkts_per_xfer;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
+		dev->net->needed_headroom = link->header_len;
 
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
@@ -1135,9 +1346,14 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		kfree(req->sg);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	if (dev->tx_agg) {
+		dev_kfree_skb_any(dev->tx_agg);
+		dev->tx_agg = NULL;
+	}
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in_ep->desc = NULL;
@@ -1159,6 +1375,7 @@ void gether_disconnect(struct gether *link)
 
 	/* finish forgetting about this USB link episode */
 	dev->header_len = 0;
+	dev->ul_max_pkts_per_xfer = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
 
@@ -21,7 +21,7 @@
 
 #include "gadget_chips.h"
 
-#define QMULT_DEFAULT 5
+#define QMULT_DEFAULT 10
 
 /*
  * dev_addr: initial value
@@ -74,6 +74,15 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	/* RNDIS can carry several frames per transfer: up to
+	 * ul_max_pkts_per_xfer from the host, and up to
+	 * dl_max_pkts_per_xfer in dl_max_xfer_size bytes to it
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+	/* wrap() copes with non-linear skbs */
+	bool				wrap_sg;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
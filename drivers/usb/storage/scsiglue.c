@@ -223,6 +223,22 @@ static int slave_configure(struct scsi_device *sdev)
 		if (!(us->fflags & US_FL_NEEDS_CAP16))
 			sdev->try_rc_10_first = 1;
 
+		/* Bulk-Only runs one command at a time, and the status of a
+		 * read can't be queued ahead of its data the way that of a
+		 * write can (see usb_stor_Bulk_transport()).  Read ahead
+		 * several maximum-size commands so that the next one is
+		 * always waiting when the previous one completes. */
+		if (us->transport == usb_stor_Bulk_transport) {
+			struct backing_dev_info *bdi =
+					&sdev->request_queue->backing_dev_info;
+			unsigned long ra_pages =
+					queue_max_sectors(sdev->request_queue) *
+					4 >> (PAGE_CACHE_SHIFT - 9);
+
+			if (bdi->ra_pages < ra_pages)
+				bdi->ra_pages = ra_pages;
+		}
+
 		/* assume SPC3 or latter devices support sense size > 18 */
 		if (sdev->scsi_level > SCSI_SPC_2)
 			us->fflags |= US_FL_SANE_SENSE;
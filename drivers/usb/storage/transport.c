@@ -47,6 +47,7 @@
 #include <linux/gfp.h>
 #include <linux/errno.h>
 #include <linux/export.h>
+#include <linux/module.h>
 
 #include <linux/usb/quirks.h>
 
@@ -63,6 +64,11 @@
 #include <linux/blkdev.h>
 #include "../../scsi/sd.h"
 
+static bool bulk_pipeline = 1;
+module_param(bulk_pipeline, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bulk_pipeline,
+		"queue the Bulk-Only status read along with the command");
+
 
 /***********************************************************************
  * Data transfer routines
@@ -85,6 +91,8 @@
  * to see if the current_urb needs to be stopped.  Likewise, the SG_ACTIVE
  * bit is tested to see if the current_sg scatter-gather request needs to be
  * stopped.  The timeout callback routine does much the same thing.
+ * The CSW_ACTIVE bit does the same for the csw_urb that the Bulk-Only
+ * transport queues ahead of the command.
  *
  * When a disconnect occurs, the DISCONNECTING bit in us->dflags is set to
  * prevent new URBs from being submitted, and usb_stor_stop_transport() is
@@ -905,6 +913,12 @@ void usb_stor_stop_transport(struct us_data *us)
 		usb_stor_dbg(us, "-- cancelling sg request\n");
 		usb_sg_cancel(&us->current_sg);
 	}
+
+	/* Likewise for a queued Bulk-Only status read. */
+	if (test_and_clear_bit(US_FLIDX_CSW_ACTIVE, &us->dflags)) {
+		usb_stor_dbg(us, "-- cancelling CSW URB\n");
+		usb_unlink_urb(us->csw_urb);
+	}
 }
 
 /*
@@ -1049,6 +1063,81 @@ int usb_stor_Bulk_max_lun(struct us_data *us)
 	return 0;
 }
 
+/* The queued CSW goes to the second half of us->iobuf, since the CBW in
+ * the first half may still be on its way out when the CSW arrives. */
+#define US_BULK_CSW_OFFSET	32
+
+/*
+ * Without a data stage or with a data-out stage, the CSW comes in on the
+ * other endpoint than the one the CBW and the data go out on.  Queue the
+ * CSW read before sending the CBW, so that the host controller fetches
+ * the status as soon as the device has it, instead of only after the data
+ * URBs have completed and the control thread has run again.  On USB 2
+ * hosts this saves a round trip per command for writes and the many
+ * commands without data.
+ *
+ * The spec doesn't allow more than one command in flight, and with a
+ * data-in stage the CSW would be on the same endpoint as the data, so
+ * this is as far as Bulk-Only overlaps.
+ */
+static int usb_stor_Bulk_queue_csw(struct us_data *us,
+		struct completion *csw_done)
+{
+	struct urb *urb = us->csw_urb;
+	int status;
+
+	/* don't submit URBs during abort processing */
+	if (test_bit(US_FLIDX_ABORTING, &us->dflags))
+		return -EIO;
+
+	init_completion(csw_done);
+	usb_fill_bulk_urb(urb, us->pusb_dev, us->recv_bulk_pipe,
+			us->iobuf + US_BULK_CSW_OFFSET, US_BULK_CS_WRAP_LEN,
+			usb_stor_blocking_completion, csw_done);
+	urb->transfer_flags = URB_NO_TRANSFER_DMA_MAP;
+	urb->transfer_dma = us->iobuf_dma + US_BULK_CSW_OFFSET;
+
+	status = usb_submit_urb(urb, GFP_NOIO);
+	if (status)
+		return status;
+	set_bit(US_FLIDX_CSW_ACTIVE, &us->dflags);
+
+	/* did an abort occur during the submission? */
+	if (test_bit(US_FLIDX_ABORTING, &us->dflags) &&
+			test_and_clear_bit(US_FLIDX_CSW_ACTIVE, &us->dflags)) {
+		usb_stor_dbg(us, "-- cancelling CSW URB\n");
+		usb_unlink_urb(urb);
+	}
+	return 0;
+}
+
+/* Wait for the queued CSW and copy it to where the unqueued one goes */
+static int usb_stor_Bulk_wait_csw(struct us_data *us,
+		struct completion *csw_done, unsigned int *act_len)
+{
+	struct urb *urb = us->csw_urb;
+	long timeleft;
+
+	timeleft = wait_for_completion_interruptible_timeout(csw_done,
+			MAX_SCHEDULE_TIMEOUT);
+	clear_bit(US_FLIDX_CSW_ACTIVE, &us->dflags);
+	if (timeleft <= 0) {
+		usb_stor_dbg(us, "Signal -- cancelling CSW URB\n");
+		usb_kill_urb(urb);
+	}
+
+	*act_len = urb->actual_length;
+	memcpy(us->iobuf, us->iobuf + US_BULK_CSW_OFFSET, urb->actual_length);
+	return interpret_urb_result(us, us->recv_bulk_pipe,
+			US_BULK_CS_WRAP_LEN, urb->status, urb->actual_length);
+}
+
+static void usb_stor_Bulk_cancel_csw(struct us_data *us)
+{
+	clear_bit(US_FLIDX_CSW_ACTIVE, &us->dflags);
+	usb_kill_urb(us->csw_urb);
+}
+
 int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 {
 	struct bulk_cb_wrap *bcb = (struct bulk_cb_wrap *) us->iobuf;
@@ -1057,6 +1146,8 @@ int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 	unsigned int residue;
 	int result;
 	int fake_sense = 0;
+	int csw_queued = 0;
+	struct completion csw_done;
 	unsigned int cswlen;
 	unsigned int cbwlen = US_BULK_CB_WRAP_LEN;
 
@@ -1081,6 +1172,13 @@ int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 	memset(bcb->CDB, 0, sizeof(bcb->CDB));
 	memcpy(bcb->CDB, srb->cmnd, bcb->Length);
 
+	/* queue the status read now if the data don't come in before it;
+	 * devices that need US_FL_GO_SLOW are left to the slow path */
+	if (bulk_pipeline && !(us->fflags & US_FL_GO_SLOW) &&
+			!(transfer_length &&
+			  srb->sc_data_direction == DMA_FROM_DEVICE))
+		csw_queued = !usb_stor_Bulk_queue_csw(us, &csw_done);
+
 	/* send it to out endpoint */
 	usb_stor_dbg(us, "Bulk Command S 0x%x T 0x%x L %d F %d Trg %d LUN %d CL %d\n",
 		     le32_to_cpu(bcb->Signature), bcb->Tag,
@@ -1090,8 +1188,11 @@ int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 	result = usb_stor_bulk_transfer_buf(us, us->send_bulk_pipe,
 				bcb, cbwlen, NULL);
 	usb_stor_dbg(us, "Bulk command transfer result=%d\n", result);
-	if (result != USB_STOR_XFER_GOOD)
+	if (result != USB_STOR_XFER_GOOD) {
+		if (csw_queued)
+			usb_stor_Bulk_cancel_csw(us);
 		return USB_STOR_TRANSPORT_ERROR;
+	}
 
 	/* DATA STAGE */
 	/* send/receive data payload, if there is any */
@@ -1107,8 +1208,11 @@ int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 				us->recv_bulk_pipe : us->send_bulk_pipe;
 		result = usb_stor_bulk_srb(us, pipe, srb);
 		usb_stor_dbg(us, "Bulk data transfer result 0x%x\n", result);
-		if (result == USB_STOR_XFER_ERROR)
+		if (result == USB_STOR_XFER_ERROR) {
+			if (csw_queued)
+				usb_stor_Bulk_cancel_csw(us);
 			return USB_STOR_TRANSPORT_ERROR;
+		}
 
 		/* If the device tried to send back more data than the
 		 * amount requested, the spec requires us to transfer
@@ -1126,7 +1230,10 @@ int usb_stor_Bulk_transport(struct scsi_cmnd *srb, struct us_data *us)
 
 	/* get CSW for device status */
 	usb_stor_dbg(us, "Attempting to get CSW...\n");
-	result = usb_stor_bulk_transfer_buf(us, us->recv_bulk_pipe,
+	if (csw_queued)
+		result = usb_stor_Bulk_wait_csw(us, &csw_done, &cswlen);
+	else
+		result = usb_stor_bulk_transfer_buf(us, us->recv_bulk_pipe,
 				bcs, US_BULK_CS_WRAP_LEN, &cswlen);
 
 	/* Some broken devices add unnecessary zero-length packets to the
@@ -756,6 +756,12 @@ static int usb_stor_acquire_resources(struct us_data *us)
 		return -ENOMEM;
 	}
 
+	us->csw_urb = usb_alloc_urb(0, GFP_KERNEL);
+	if (!us->csw_urb) {
+		usb_stor_dbg(us, "URB allocation failed\n");
+		return -ENOMEM;
+	}
+
 	/* Just before we start our control thread, initialize
 	 * the device if it needs initialization */
 	if (us->unusual_dev->initFunction) {
@@ -794,8 +800,9 @@ static void usb_stor_release_resources(struct us_data *us)
 		us->extra_destructor(us->extra);
 	}
 
-	/* Free the extra data and the URB */
+	/* Free the extra data and the URBs */
 	kfree(us->extra);
+	usb_free_urb(us->csw_urb);
 	usb_free_urb(us->current_urb);
 }
 
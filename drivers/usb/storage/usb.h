@@ -76,6 +76,7 @@ struct us_unusual_dev {
 #define US_FLIDX_SCAN_PENDING	6	/* scanning not yet done    */
 #define US_FLIDX_REDO_READ10	7	/* redo READ(10) command    */
 #define US_FLIDX_READ10_WORKED	8	/* previous READ(10) succeeded */
+#define US_FLIDX_CSW_ACTIVE	9	/* csw_urb is in use        */
 
 #define USB_STOR_STRING_LEN 32
 
@@ -139,6 +140,7 @@ struct us_data {
 
 	/* control and bulk communications data */
 	struct urb		*current_urb;	 /* USB requests	 */
+	struct urb		*csw_urb;	 /* queued Bulk status	 */
 	struct usb_ctrlrequest	*cr;		 /* control requests	 */
 	struct usb_sg_request	current_sg;	 /* scatter-gather req.  */
 	unsigned char		*iobuf;		 /* I/O buffer		 */
@@ -34,10 +34,19 @@ module_param(experimental_zcopytx, int, 0444);
 MODULE_PARM_DESC(experimental_zcopytx, "Enable Zero Copy TX;"
 		                       " 1 -Enable; 0 - Disable");
 
+static int separate_tx_worker = 1;
+module_param(separate_tx_worker, int, 0444);
+MODULE_PARM_DESC(separate_tx_worker, "Handle TX and RX on worker threads of"
+		 " their own; 1 - Enable; 0 - Disable");
+
 /* Max number of bytes transferred before requeueing the job.
  * Using this limit prevents one virtqueue from starving others. */
 #define VHOST_NET_WEIGHT 0x80000
 
+/* Max number of packets whose buffers are returned to the guest together,
+ * with a single interrupt. */
+#define VHOST_NET_BATCH 64
+
 /* MAX number of TX used buffers for outstanding zerocopy */
 #define VHOST_MAX_PEND 128
 #define VHOST_GOODCOPY_LEN 256
@@ -350,6 +359,8 @@ static void handle_tx(struct vhost_net *net)
 	struct socket *sock;
 	struct vhost_net_ubuf_ref *uninitialized_var(ubufs);
 	bool zcopy, zcopy_used;
+	bool held = false;
+	int nheads = 0;
 
 	mutex_lock(&vq->mutex);
 	sock = vq->private_data;
@@ -382,6 +393,13 @@ static void handle_tx(struct vhost_net *net)
 			break;
 		/* Nothing new?  Wait for eventfd to tell us they refilled. */
 		if (head == vq->num) {
+			if (nheads) {
+				vhost_add_used_and_signal_n(&net->dev, vq,
+							    vq->heads, nheads);
+				nheads = 0;
+			}
+			if (vhost_vq_busy_poll(&net->dev, vq, NULL))
+				continue;
 			if (unlikely(vhost_enable_notify(&net->dev, vq))) {
 				vhost_disable_notify(&net->dev, vq);
 				continue;
@@ -429,6 +447,13 @@ static void handle_tx(struct vhost_net *net)
 			msg.msg_control = NULL;
 			ubufs = NULL;
 		}
+		/* Let the backend hold on to the packet while the guest has
+		 * more for us, so that it can push them all at once. */
+		if (!zcopy && total_len + len < VHOST_NET_WEIGHT &&
+		    !vhost_vq_avail_empty(&net->dev, vq))
+			msg.msg_flags |= MSG_MORE;
+		else
+			msg.msg_flags &= ~MSG_MORE;
 		/* TODO: Check specific error and bomb out unless ENOBUFS? */
 		err = sock->ops->sendmsg(NULL, sock, &msg, len);
 		if (unlikely(err < 0)) {
@@ -443,10 +468,21 @@ static void handle_tx(struct vhost_net *net)
 		if (err != len)
 			pr_debug("Truncated TX packet: "
 				 " len %d != %zd\n", err, len);
-		if (!zcopy_used)
-			vhost_add_used_and_signal(&net->dev, vq, head, 0);
-		else
+		held = msg.msg_flags & MSG_MORE;
+		if (zcopy_used) {
 			vhost_zerocopy_signal_used(net, vq);
+		} else if (zcopy) {
+			vhost_add_used_and_signal(&net->dev, vq, head, 0);
+		} else {
+			/* Without zerocopy, heads is ours to batch in. */
+			vq->heads[nheads].id = head;
+			vq->heads[nheads].len = 0;
+			if (++nheads == VHOST_NET_BATCH) {
+				vhost_add_used_and_signal_n(&net->dev, vq,
+							    vq->heads, nheads);
+				nheads = 0;
+			}
+		}
 		total_len += len;
 		vhost_net_tx_packet(net);
 		if (unlikely(total_len >= VHOST_NET_WEIGHT)) {
@@ -454,6 +490,12 @@ static void handle_tx(struct vhost_net *net)
 			break;
 		}
 	}
+	/* Don't leave packets sent with MSG_MORE behind in the backend when
+	 * an error or a bad descriptor ended the batch early. */
+	if (held)
+		tun_rx_flush(sock);
+	if (nheads)
+		vhost_add_used_and_signal_n(&net->dev, vq, vq->heads, nheads);
 out:
 	mutex_unlock(&vq->mutex);
 }
@@ -476,6 +518,34 @@ static int peek_head_len(struct sock *sk)
 	return len;
 }
 
+static bool vhost_net_rx_ready(struct vhost_dev *dev,
+			       struct vhost_virtqueue *vq)
+{
+	struct socket *sock = vq->private_data;
+
+	return !skb_queue_empty(&sock->sk->sk_receive_queue);
+}
+
+/* Like peek_head_len, but busy polls the socket for a while if it is
+ * empty, after interrupting the guest for the buffers it got so far. */
+static int vhost_net_rx_peek_head_len(struct vhost_net *net,
+				      struct vhost_virtqueue *vq,
+				      struct sock *sk, int *unsignalled)
+{
+	int len = peek_head_len(sk);
+
+	if (len || !vq->busyloop_timeout)
+		return len;
+
+	if (*unsignalled) {
+		vhost_signal(&net->dev, vq);
+		*unsignalled = 0;
+	}
+	if (vhost_vq_busy_poll(&net->dev, vq, vhost_net_rx_ready))
+		len = peek_head_len(sk);
+	return len;
+}
+
 /* This is a multi-buffer version of vhost_get_desc, that works if
  *	vq has read descriptors only.
  * @vq		- the relevant virtqueue
@@ -574,6 +644,7 @@ static void handle_rx(struct vhost_net *net)
 	size_t vhost_hlen, sock_hlen;
 	size_t vhost_len, sock_len;
 	struct socket *sock;
+	int unsignalled = 0;
 
 	mutex_lock(&vq->mutex);
 	sock = vq->private_data;
@@ -588,7 +659,8 @@ static void handle_rx(struct vhost_net *net)
 		vq->log : NULL;
 	mergeable = vhost_has_feature(&net->dev, VIRTIO_NET_F_MRG_RXBUF);
 
-	while ((sock_len = peek_head_len(sock->sk))) {
+	while ((sock_len = vhost_net_rx_peek_head_len(net, vq, sock->sk,
+						      &unsignalled))) {
 		sock_len += sock_hlen;
 		vhost_len = sock_len + vhost_hlen;
 		headcount = get_rx_bufs(vq, vq->heads, vhost_len,
@@ -653,8 +725,12 @@ static void handle_rx(struct vhost_net *net)
 			vhost_discard_vq_desc(vq, headcount);
 			break;
 		}
-		vhost_add_used_and_signal_n(&net->dev, vq, vq->heads,
-					    headcount);
+		/* Interrupt the guest once per batch of packets. */
+		vhost_add_used_n(vq, vq->heads, headcount);
+		if (++unsignalled == VHOST_NET_BATCH) {
+			vhost_signal(&net->dev, vq);
+			unsignalled = 0;
+		}
 		if (unlikely(vq_log))
 			vhost_log_write(vq, vq_log, log, vhost_len);
 		total_len += vhost_len;
@@ -663,6 +739,8 @@ static void handle_rx(struct vhost_net *net)
 			break;
 		}
 	}
+	if (unsignalled)
+		vhost_signal(&net->dev, vq);
 out:
 	mutex_unlock(&vq->mutex);
 }
@@ -732,6 +810,14 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, POLLOUT, dev);
 	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, POLLIN, dev);
 
+	/* TX and RX only share the device: with a thread each, a guest
+	 * queue pair can keep two host CPUs busy. */
+	if (separate_tx_worker) {
+		vhost_work_set_worker(dev, &n->vqs[VHOST_NET_VQ_TX].vq.poll.work,
+				      1);
+		vhost_work_set_worker(dev, &n->poll[VHOST_NET_VQ_TX].work, 1);
+	}
+
 	f->private_data = n;
 
 	return 0;
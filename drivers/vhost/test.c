@@ -11,6 +11,7 @@
 #include <linux/vhost.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/workqueue.h>
 #include <linux/file.h>
@@ -23,6 +24,12 @@
  * Using this limit prevents one virtqueue from starving others. */
 #define VHOST_TEST_WEIGHT 0x80000
 
+/* Max number of buffers returned to the guest together, as vhost-net does;
+ * 1 returns each buffer on its own, for comparison. */
+static unsigned int used_batch = 64;
+module_param(used_batch, uint, 0644);
+MODULE_PARM_DESC(used_batch, "Buffers returned to the guest per interrupt");
+
 enum {
 	VHOST_TEST_VQ = 0,
 	VHOST_TEST_VQ_MAX = 1,
@@ -42,6 +49,7 @@ static void handle_vq(struct vhost_test *n)
 	int head;
 	size_t len, total_len = 0;
 	void *private;
+	unsigned int nheads = 0, max_heads;
 
 	mutex_lock(&vq->mutex);
 	private = vq->private_data;
@@ -51,6 +59,7 @@ static void handle_vq(struct vhost_test *n)
 	}
 
 	vhost_disable_notify(&n->dev, vq);
+	max_heads = clamp_t(unsigned int, used_batch, 1, UIO_MAXIOV);
 
 	for (;;) {
 		head = vhost_get_vq_desc(&n->dev, vq, vq->iov,
@@ -62,6 +71,13 @@ static void handle_vq(struct vhost_test *n)
 			break;
 		/* Nothing new?  Wait for eventfd to tell us they refilled. */
 		if (head == vq->num) {
+			if (nheads) {
+				vhost_add_used_and_signal_n(&n->dev, vq,
+							    vq->heads, nheads);
+				nheads = 0;
+			}
+			if (vhost_vq_busy_poll(&n->dev, vq, NULL))
+				continue;
 			if (unlikely(vhost_enable_notify(&n->dev, vq))) {
 				vhost_disable_notify(&n->dev, vq);
 				continue;
@@ -79,13 +95,21 @@ static void handle_vq(struct vhost_test *n)
 			vq_err(vq, "Unexpected 0 len for TX\n");
 			break;
 		}
-		vhost_add_used_and_signal(&n->dev, vq, head, 0);
+		vq->heads[nheads].id = head;
+		vq->heads[nheads].len = 0;
+		if (++nheads == max_heads) {
+			vhost_add_used_and_signal_n(&n->dev, vq, vq->heads,
+						    nheads);
+			nheads = 0;
+		}
 		total_len += len;
 		if (unlikely(total_len >= VHOST_TEST_WEIGHT)) {
 			vhost_poll_queue(&vq->poll);
 			break;
 		}
 	}
+	if (nheads)
+		vhost_add_used_and_signal_n(&n->dev, vq, vq->heads, nheads);
 
 	mutex_unlock(&vq->mutex);
 }
@@ -26,9 +26,20 @@
 #include <linux/kthread.h>
 #include <linux/cgroup.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
 
 #include "vhost.h"
 
+static unsigned int busyloop_timeout;
+module_param(busyloop_timeout, uint, 0644);
+MODULE_PARM_DESC(busyloop_timeout, "Default limit in us on busy polling"
+		 " an empty ring; 0 - Disable");
+
+/* Polling never adapts down to less than this fraction of the limit, so
+ * that it can still notice when buffers start coming in quickly again. */
+#define VHOST_BUSYLOOP_MIN_SHIFT 4
+
 enum {
 	VHOST_MEMORY_MAX_NREGIONS = 64,
 	VHOST_MEMORY_F_LOG = 0x1,
@@ -66,9 +77,29 @@ void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn)
 	init_waitqueue_head(&work->done);
 	work->flushing = 0;
 	work->queue_seq = work->done_seq = 0;
+	work->worker = NULL;
 }
 EXPORT_SYMBOL_GPL(vhost_work_init);
 
+/* Run the work on worker thread @index of the device rather than the first
+ * one. Works on different workers run in parallel, so they must not share
+ * state that is not protected by a lock of its own, e.g. the vq mutex.
+ * Must be called before the device gets an owner. */
+void vhost_work_set_worker(struct vhost_dev *dev, struct vhost_work *work,
+			   int index)
+{
+	BUG_ON(index >= VHOST_MAX_WORKERS || dev->mm);
+	work->worker = &dev->workers[index];
+	dev->nworkers = max(dev->nworkers, index + 1);
+}
+EXPORT_SYMBOL_GPL(vhost_work_set_worker);
+
+static struct vhost_worker *vhost_work_worker(struct vhost_dev *dev,
+					      struct vhost_work *work)
+{
+	return work->worker ? work->worker : &dev->workers[0];
+}
+
 /* Init poll structure */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
 		     unsigned long mask, struct vhost_dev *dev)
@@ -117,30 +148,31 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-static bool vhost_work_seq_done(struct vhost_dev *dev, struct vhost_work *work,
-				unsigned seq)
+static bool vhost_work_seq_done(struct vhost_worker *worker,
+				struct vhost_work *work, unsigned seq)
 {
 	int left;
 
-	spin_lock_irq(&dev->work_lock);
+	spin_lock_irq(&worker->work_lock);
 	left = seq - work->done_seq;
-	spin_unlock_irq(&dev->work_lock);
+	spin_unlock_irq(&worker->work_lock);
 	return left <= 0;
 }
 
 void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
 {
+	struct vhost_worker *worker = vhost_work_worker(dev, work);
 	unsigned seq;
 	int flushing;
 
-	spin_lock_irq(&dev->work_lock);
+	spin_lock_irq(&worker->work_lock);
 	seq = work->queue_seq;
 	work->flushing++;
-	spin_unlock_irq(&dev->work_lock);
-	wait_event(work->done, vhost_work_seq_done(dev, work, seq));
-	spin_lock_irq(&dev->work_lock);
+	spin_unlock_irq(&worker->work_lock);
+	wait_event(work->done, vhost_work_seq_done(worker, work, seq));
+	spin_lock_irq(&worker->work_lock);
 	flushing = --work->flushing;
-	spin_unlock_irq(&dev->work_lock);
+	spin_unlock_irq(&worker->work_lock);
 	BUG_ON(flushing < 0);
 }
 EXPORT_SYMBOL_GPL(vhost_work_flush);
@@ -155,16 +187,17 @@ EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
+	struct vhost_worker *worker = vhost_work_worker(dev, work);
 	unsigned long flags;
 
-	spin_lock_irqsave(&dev->work_lock, flags);
+	spin_lock_irqsave(&worker->work_lock, flags);
 	if (list_empty(&work->node)) {
-		list_add_tail(&work->node, &dev->work_list);
+		list_add_tail(&work->node, &worker->work_list);
 		work->queue_seq++;
-		spin_unlock_irqrestore(&dev->work_lock, flags);
-		wake_up_process(dev->worker);
+		spin_unlock_irqrestore(&worker->work_lock, flags);
+		wake_up_process(worker->task);
 	} else {
-		spin_unlock_irqrestore(&dev->work_lock, flags);
+		spin_unlock_irqrestore(&worker->work_lock, flags);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
@@ -190,6 +223,11 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vq->used_flags = 0;
 	vq->log_used = false;
 	vq->log_addr = -1ull;
+	vq->busyloop_timeout = busyloop_timeout;
+	vq->busyloop_ns = (u64)busyloop_timeout * NSEC_PER_USEC;
+	vq->busyloop_polls = 0;
+	vq->busyloop_hits = 0;
+	vq->busyloop_poll_ns = 0;
 	vq->private_data = NULL;
 	vq->log_base = NULL;
 	vq->error_ctx = NULL;
@@ -202,7 +240,8 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
+	struct vhost_dev *dev = worker->dev;
 	struct vhost_work *work = NULL;
 	unsigned uninitialized_var(seq);
 	mm_segment_t oldfs = get_fs();
@@ -214,7 +253,7 @@ static int vhost_worker(void *data)
 		/* mb paired w/ kthread_stop */
 		set_current_state(TASK_INTERRUPTIBLE);
 
-		spin_lock_irq(&dev->work_lock);
+		spin_lock_irq(&worker->work_lock);
 		if (work) {
 			work->done_seq = seq;
 			if (work->flushing)
@@ -222,18 +261,18 @@ static int vhost_worker(void *data)
 		}
 
 		if (kthread_should_stop()) {
-			spin_unlock_irq(&dev->work_lock);
+			spin_unlock_irq(&worker->work_lock);
 			__set_current_state(TASK_RUNNING);
 			break;
 		}
-		if (!list_empty(&dev->work_list)) {
-			work = list_first_entry(&dev->work_list,
+		if (!list_empty(&worker->work_list)) {
+			work = list_first_entry(&worker->work_list,
 						struct vhost_work, node);
 			list_del_init(&work->node);
 			seq = work->queue_seq;
 		} else
 			work = NULL;
-		spin_unlock_irq(&dev->work_lock);
+		spin_unlock_irq(&worker->work_lock);
 
 		if (work) {
 			__set_current_state(TASK_RUNNING);
@@ -303,9 +342,13 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->log_file = NULL;
 	dev->memory = NULL;
 	dev->mm = NULL;
-	spin_lock_init(&dev->work_lock);
-	INIT_LIST_HEAD(&dev->work_list);
-	dev->worker = NULL;
+	for (i = 0; i < VHOST_MAX_WORKERS; ++i) {
+		spin_lock_init(&dev->workers[i].work_lock);
+		INIT_LIST_HEAD(&dev->workers[i].work_list);
+		dev->workers[i].task = NULL;
+		dev->workers[i].dev = dev;
+	}
+	dev->nworkers = 1;
 
 	for (i = 0; i < dev->nvqs; ++i) {
 		vq = dev->vqs[i];
@@ -347,14 +390,33 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 static int vhost_attach_cgroups(struct vhost_dev *dev)
 {
 	struct vhost_attach_cgroups_struct attach;
+	int i;
 
 	attach.owner = current;
-	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_flush(dev, &attach.work);
+	for (i = 0; i < dev->nworkers; ++i) {
+		vhost_work_init(&attach.work, vhost_attach_cgroups_work);
+		attach.work.worker = &dev->workers[i];
+		vhost_work_queue(dev, &attach.work);
+		vhost_work_flush(dev, &attach.work);
+		if (attach.ret)
+			break;
+	}
 	return attach.ret;
 }
 
+static void vhost_dev_stop_workers(struct vhost_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < dev->nworkers; ++i) {
+		WARN_ON(!list_empty(&dev->workers[i].work_list));
+		if (dev->workers[i].task) {
+			kthread_stop(dev->workers[i].task);
+			dev->workers[i].task = NULL;
+		}
+	}
+}
+
 /* Caller should have device mutex */
 bool vhost_dev_has_owner(struct vhost_dev *dev)
 {
@@ -366,7 +428,7 @@ EXPORT_SYMBOL_GPL(vhost_dev_has_owner);
 long vhost_dev_set_owner(struct vhost_dev *dev)
 {
 	struct task_struct *worker;
-	int err;
+	int i, err;
 
 	/* Is there an owner already? */
 	if (vhost_dev_has_owner(dev)) {
@@ -376,28 +438,33 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	/* No owner, become one */
 	dev->mm = get_task_mm(current);
-	worker = kthread_create(vhost_worker, dev, "vhost-%d", current->pid);
-	if (IS_ERR(worker)) {
-		err = PTR_ERR(worker);
-		goto err_worker;
-	}
+	for (i = 0; i < dev->nworkers; ++i) {
+		if (i)
+			worker = kthread_create(vhost_worker, &dev->workers[i],
+						"vhost-%d-%d", current->pid, i);
+		else
+			worker = kthread_create(vhost_worker, &dev->workers[i],
+						"vhost-%d", current->pid);
+		if (IS_ERR(worker)) {
+			err = PTR_ERR(worker);
+			goto err_worker;
+		}
 
-	dev->worker = worker;
-	wake_up_process(worker);	/* avoid contributing to loadavg */
+		dev->workers[i].task = worker;
+		wake_up_process(worker);	/* avoid contributing to loadavg */
+	}
 
 	err = vhost_attach_cgroups(dev);
 	if (err)
-		goto err_cgroup;
+		goto err_worker;
 
 	err = vhost_dev_alloc_iovecs(dev);
 	if (err)
-		goto err_cgroup;
+		goto err_worker;
 
 	return 0;
-err_cgroup:
-	kthread_stop(worker);
-	dev->worker = NULL;
 err_worker:
+	vhost_dev_stop_workers(dev);
 	if (dev->mm)
 		mmput(dev->mm);
 	dev->mm = NULL;
@@ -466,11 +533,7 @@ void vhost_dev_cleanup(struct vhost_dev *dev, bool locked)
 					locked ==
 						lockdep_is_held(&dev->mutex)));
 	RCU_INIT_POINTER(dev->memory, NULL);
-	WARN_ON(!list_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+	vhost_dev_stop_workers(dev);
 	if (dev->mm)
 		mmput(dev->mm);
 	dev->mm = NULL;
@@ -634,6 +697,7 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 	struct vhost_vring_state s;
 	struct vhost_vring_file f;
 	struct vhost_vring_addr a;
+	struct vhost_vring_busyloop_stats stats;
 	u32 idx;
 	long r;
 
@@ -690,6 +754,34 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 		if (copy_to_user(argp, &s, sizeof s))
 			r = -EFAULT;
 		break;
+	case VHOST_SET_VRING_BUSYLOOP_TIMEOUT:
+		if (copy_from_user(&s, argp, sizeof s)) {
+			r = -EFAULT;
+			break;
+		}
+		if (s.num > USEC_PER_SEC) {
+			r = -EINVAL;
+			break;
+		}
+		vq->busyloop_timeout = s.num;
+		vq->busyloop_ns = (u64)s.num * NSEC_PER_USEC;
+		break;
+	case VHOST_GET_VRING_BUSYLOOP_TIMEOUT:
+		s.index = idx;
+		s.num = vq->busyloop_timeout;
+		if (copy_to_user(argp, &s, sizeof s))
+			r = -EFAULT;
+		break;
+	case VHOST_GET_VRING_BUSYLOOP_STATS:
+		memset(&stats, 0, sizeof stats);
+		stats.index = idx;
+		stats.timeout = div_u64(vq->busyloop_ns, NSEC_PER_USEC);
+		stats.polls = vq->busyloop_polls;
+		stats.hits = vq->busyloop_hits;
+		stats.poll_ns = vq->busyloop_poll_ns;
+		if (copy_to_user(argp, &stats, sizeof stats))
+			r = -EFAULT;
+		break;
 	case VHOST_SET_VRING_ADDR:
 		if (copy_from_user(&a, argp, sizeof a)) {
 			r = -EFAULT;
@@ -1208,26 +1300,35 @@ int vhost_get_vq_desc(struct vhost_dev *dev, struct vhost_virtqueue *vq,
 	u16 last_avail_idx;
 	int ret;
 
-	/* Check it isn't doing very strange things with descriptor numbers. */
 	last_avail_idx = vq->last_avail_idx;
-	if (unlikely(__get_user(vq->avail_idx, &vq->avail->idx))) {
-		vq_err(vq, "Failed to access avail idx at %p\n",
-		       &vq->avail->idx);
-		return -EFAULT;
-	}
 
-	if (unlikely((u16)(vq->avail_idx - last_avail_idx) > vq->num)) {
-		vq_err(vq, "Guest moved used index from %u to %u",
-		       last_avail_idx, vq->avail_idx);
-		return -EFAULT;
-	}
+	/* The guest exposes buffers in batches: only look at the avail index
+	 * again once we have used up what it said last time, rather than
+	 * pulling its cache line over for every descriptor. */
+	if (vq->avail_idx == last_avail_idx) {
+		if (unlikely(__get_user(vq->avail_idx, &vq->avail->idx))) {
+			vq_err(vq, "Failed to access avail idx at %p\n",
+			       &vq->avail->idx);
+			return -EFAULT;
+		}
 
-	/* If there's nothing new since last we looked, return invalid. */
-	if (vq->avail_idx == last_avail_idx)
-		return vq->num;
+		/* Check it isn't doing very strange things with descriptor
+		 * numbers. */
+		if (unlikely((u16)(vq->avail_idx - last_avail_idx) > vq->num)) {
+			vq_err(vq, "Guest moved used index from %u to %u",
+			       last_avail_idx, vq->avail_idx);
+			return -EFAULT;
+		}
 
-	/* Only get avail ring entries after they have been exposed by guest. */
-	smp_rmb();
+		/* If there's nothing new since last we looked, return
+		 * invalid. */
+		if (vq->avail_idx == last_avail_idx)
+			return vq->num;
+
+		/* Only get avail ring entries after they have been exposed by
+		 * guest. */
+		smp_rmb();
+	}
 
 	/* Grab the next descriptor number they're advertising, and increment
 	 * the index we've seen. */
@@ -1328,6 +1429,88 @@ void vhost_discard_vq_desc(struct vhost_virtqueue *vq, int n)
 }
 EXPORT_SYMBOL_GPL(vhost_discard_vq_desc);
 
+/* Whether the guest has no more buffers for us. Lets the caller tell the
+ * backend that more is coming, so that it can batch. */
+bool vhost_vq_avail_empty(struct vhost_dev *dev, struct vhost_virtqueue *vq)
+{
+	u16 avail_idx;
+
+	if (vq->avail_idx != vq->last_avail_idx)
+		return false;
+
+	if (unlikely(__get_user(avail_idx, &vq->avail->idx)))
+		return true;
+	if (unlikely((u16)(avail_idx - vq->last_avail_idx) > vq->num))
+		return true;
+
+	vq->avail_idx = avail_idx;
+	/* Only get avail ring entries after they have been exposed by guest. */
+	smp_rmb();
+	return vq->avail_idx == vq->last_avail_idx;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_avail_empty);
+
+static bool vhost_worker_has_work(struct vhost_dev *dev,
+				  struct vhost_work *work)
+{
+	return !list_empty(&vhost_work_worker(dev, work)->work_list);
+}
+
+/* The ring ran empty: rather than have the guest kick us for the next
+ * buffer, which costs it an exit and us a wakeup, spin for a while with
+ * notifications still disabled in case it comes soon. @ready tells whether
+ * there is work again; NULL means the guest added buffers. Polling stops
+ * early when something else wants the CPU or the worker.
+ *
+ * The time spent polling adapts within the limit set for the ring: it
+ * doubles when work tends to show up late in the poll, and halves when
+ * none shows up at all.
+ *
+ * Returns true if there is work. The caller should have returned the used
+ * buffers to the guest first, as it may be waiting for them. */
+bool vhost_vq_busy_poll(struct vhost_dev *dev, struct vhost_virtqueue *vq,
+			bool (*ready)(struct vhost_dev *,
+				      struct vhost_virtqueue *))
+{
+	u64 limit = (u64)vq->busyloop_timeout * NSEC_PER_USEC;
+	u64 start, now, spent;
+	bool hit = false, interrupted = false;
+
+	if (!limit)
+		return false;
+
+	start = now = local_clock();
+	for (;;) {
+		if (ready ? ready(dev, vq) : !vhost_vq_avail_empty(dev, vq)) {
+			hit = true;
+			break;
+		}
+		if (need_resched() ||
+		    vhost_worker_has_work(dev, &vq->poll.work)) {
+			interrupted = true;
+			break;
+		}
+		now = local_clock();
+		if (now - start >= vq->busyloop_ns)
+			break;
+		cpu_relax();
+	}
+	spent = now - start;
+
+	vq->busyloop_polls++;
+	vq->busyloop_poll_ns += spent;
+	if (hit) {
+		vq->busyloop_hits++;
+		if (spent * 2 > vq->busyloop_ns)
+			vq->busyloop_ns = min(vq->busyloop_ns * 2, limit);
+	} else if (!interrupted) {
+		vq->busyloop_ns = max(vq->busyloop_ns / 2,
+				      limit >> VHOST_BUSYLOOP_MIN_SHIFT);
+	}
+	return hit;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_busy_poll);
+
 /* After we've used one of their buffers, we tell them about it.  We'll then
  * want to notify the guest, using eventfd. */
 int vhost_add_used(struct vhost_virtqueue *vq, unsigned int head, int len)
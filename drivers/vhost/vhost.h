@@ -15,6 +15,7 @@
 struct vhost_device;
 
 struct vhost_work;
+struct vhost_worker;
 typedef void (*vhost_work_fn_t)(struct vhost_work *work);
 
 struct vhost_work {
@@ -24,6 +25,19 @@ struct vhost_work {
 	int			  flushing;
 	unsigned		  queue_seq;
 	unsigned		  done_seq;
+	/* NULL runs the work on the first worker of the device */
+	struct vhost_worker	 *worker;
+};
+
+/* Upper limit on the worker threads of a device. */
+#define VHOST_MAX_WORKERS 2
+
+/* A thread running the works queued to it, in order. */
+struct vhost_worker {
+	spinlock_t		  work_lock;
+	struct list_head	  work_list;
+	struct task_struct	 *task;
+	struct vhost_dev	 *dev;
 };
 
 /* Poll a file (eventfd or socket) */
@@ -38,6 +52,8 @@ struct vhost_poll {
 };
 
 void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn);
+void vhost_work_set_worker(struct vhost_dev *dev, struct vhost_work *work,
+			   int index);
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work);
 
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
@@ -100,6 +116,14 @@ struct vhost_virtqueue {
 	bool log_used;
 	u64 log_addr;
 
+	/* Busy polling, see vhost_vq_busy_poll(). The limit is in us,
+	 * the time we currently poll for in ns. */
+	unsigned int busyloop_timeout;
+	u64 busyloop_ns;
+	u64 busyloop_polls;
+	u64 busyloop_hits;
+	u64 busyloop_poll_ns;
+
 	struct iovec iov[UIO_MAXIOV];
 	struct iovec *indirect;
 	struct vring_used_elem *heads;
@@ -122,9 +146,8 @@ struct vhost_dev {
 	int nvqs;
 	struct file *log_file;
 	struct eventfd_ctx *log_ctx;
-	spinlock_t work_lock;
-	struct list_head work_list;
-	struct task_struct *worker;
+	struct vhost_worker workers[VHOST_MAX_WORKERS];
+	int nworkers;
 };
 
 void vhost_dev_init(struct vhost_dev *, struct vhost_virtqueue **vqs, int nvqs);
@@ -145,6 +168,10 @@ int vhost_get_vq_desc(struct vhost_dev *, struct vhost_virtqueue *,
 		      unsigned int *out_num, unsigned int *in_num,
 		      struct vhost_log *log, unsigned int *log_num);
 void vhost_discard_vq_desc(struct vhost_virtqueue *, int n);
+bool vhost_vq_avail_empty(struct vhost_dev *, struct vhost_virtqueue *);
+bool vhost_vq_busy_poll(struct vhost_dev *, struct vhost_virtqueue *,
+			bool (*ready)(struct vhost_dev *,
+				      struct vhost_virtqueue *));
 
 int vhost_init_used(struct vhost_virtqueue *);
 int vhost_add_used(struct vhost_virtqueue *, unsigned int head, int len);
@@ -27,25 +27,30 @@ static __printf(1,2) __cold void vringh_bad(const char *fmt, ...)
 }
 
 /* Returns vring->num if empty, -ve on error. */
-static inline int __vringh_get_head(const struct vringh *vrh,
+static inline int __vringh_get_head(struct vringh *vrh,
 				    int (*getu16)(u16 *val, const u16 *p),
 				    u16 *last_avail_idx)
 {
-	u16 avail_idx, i, head;
+	u16 i, head;
 	int err;
 
-	err = getu16(&avail_idx, &vrh->vring.avail->idx);
-	if (err) {
-		vringh_bad("Failed to access avail idx at %p",
-			   &vrh->vring.avail->idx);
-		return err;
-	}
+	/* Only read the avail index again once we're through the entries it
+	 * exposed last time. */
+	if (*last_avail_idx == vrh->avail_idx) {
+		err = getu16(&vrh->avail_idx, &vrh->vring.avail->idx);
+		if (err) {
+			vringh_bad("Failed to access avail idx at %p",
+				   &vrh->vring.avail->idx);
+			return err;
+		}
 
-	if (*last_avail_idx == avail_idx)
-		return vrh->vring.num;
+		if (*last_avail_idx == vrh->avail_idx)
+			return vrh->vring.num;
 
-	/* Only get avail ring entries after they have been exposed by guest. */
-	virtio_rmb(vrh->weak_barriers);
+		/* Only get avail ring entries after they have been exposed by
+		 * guest. */
+		virtio_rmb(vrh->weak_barriers);
+	}
 
 	i = *last_avail_idx & (vrh->vring.num - 1);
 
@@ -593,6 +598,7 @@ int vringh_init_user(struct vringh *vrh, u32 features,
 	vrh->weak_barriers = weak_barriers;
 	vrh->completed = 0;
 	vrh->last_avail_idx = 0;
+	vrh->avail_idx = 0;
 	vrh->last_used_idx = 0;
 	vrh->vring.num = num;
 	/* vring expects kernel addresses, but only used via accessors. */
@@ -852,6 +858,7 @@ int vringh_init_kern(struct vringh *vrh, u32 features,
 	vrh->weak_barriers = weak_barriers;
 	vrh->completed = 0;
 	vrh->last_avail_idx = 0;
+	vrh->avail_idx = 0;
 	vrh->last_used_idx = 0;
 	vrh->vring.num = num;
 	vrh->vring.desc = desc;
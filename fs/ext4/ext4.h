@@ -937,6 +937,16 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/*
+	 * Last transaction to change the inode in a way a fast commit of
+	 * its on-disk image cannot carry; valid while
+	 * EXT4_STATE_FC_INELIGIBLE is set. [i_raw_lock]
+	 */
+	tid_t i_fc_ineligible_tid;
+
+	/* Serialises updates and fast commit copies of the on-disk inode */
+	spinlock_t i_raw_lock;
+
 	/* Precomputed uuid+inum+igen checksum for seeding inode checksums */
 	__u32 i_csum_seed;
 };
@@ -982,6 +992,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_FAST_COMMIT		0x2000000 /* Fast commits for fsync */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1255,6 +1266,17 @@ struct ext4_sb_info {
 	unsigned int *s_mb_maxs;
 	unsigned int s_group_info_size;
 
+	/*
+	 * Free space index: initialized groups on per-order lists, by the
+	 * order of their largest free extent and of their average free
+	 * extent size, so the allocator can go straight to a suitable group.
+	 */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
+	struct list_head *s_mb_avg_fragment_size;
+	rwlock_t *s_mb_avg_fragment_size_locks;
+	atomic_t s_mb_uninit_groups;	/* non-full groups without a buddy */
+
 	/* tunables */
 	unsigned long s_stripe;
 	unsigned int s_mb_stream_request;
@@ -1263,6 +1285,8 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_optimize_scan;
+	unsigned int s_mb_linear_limit;
 	unsigned int s_max_dir_size_kb;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1276,6 +1300,7 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_index_hits;	/* groups found via the index */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -1398,6 +1423,7 @@ enum {
 	EXT4_STATE_MAY_INLINE_DATA,	/* may have in-inode data */
 	EXT4_STATE_ORDERED_MODE,	/* data=ordered mode */
 	EXT4_STATE_EXT_PRECACHED,	/* extents have been precached */
+	EXT4_STATE_FC_INELIGIBLE,	/* i_fc_ineligible_tid is valid */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -2032,6 +2058,11 @@ static inline  unsigned char get_dtype(struct super_block *sb, int filetype)
 	return ext4_filetype_table[filetype];
 }
 
+/* fast_commit.c */
+extern int ext4_fc_raw_inode_changes(struct inode *, struct ext4_inode *);
+extern int ext4_fc_commit(struct inode *, tid_t);
+extern int ext4_fc_replay(journal_t *, void *, unsigned int);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
@@ -2486,6 +2517,10 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_grpblk_t	bb_avg_fragment_size_order; /* order of avg frag */
+	ext4_group_t	bb_group;	/* group number */
+	struct list_head bb_largest_free_order_node;
+	struct list_head bb_avg_fragment_size_node;
 	struct          list_head bb_prealloc_list;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
@@ -2501,6 +2536,7 @@ struct ext4_group_info {
 #define EXT4_GROUP_INFO_WAS_TRIMMED_BIT		1
 #define EXT4_GROUP_INFO_BBITMAP_CORRUPT_BIT	2
 #define EXT4_GROUP_INFO_IBITMAP_CORRUPT_BIT	3
+#define EXT4_GROUP_INFO_UNINIT_COUNTED_BIT	4
 
 #define EXT4_MB_GRP_NEED_INIT(grp)	\
 	(test_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &((grp)->bb_state)))
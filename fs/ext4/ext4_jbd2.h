@@ -385,6 +385,29 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 	}
 }
 
+/*
+ * Record that the transaction of @handle changed @inode in a way that the
+ * fast commit of its on-disk image cannot reproduce on recovery, such as
+ * allocating blocks or linking it into a directory, so an fsync() has to
+ * commit that transaction in full.  The caller holds i_raw_lock.
+ */
+static inline void __ext4_fc_mark_ineligible(handle_t *handle,
+					     struct inode *inode)
+{
+	EXT4_I(inode)->i_fc_ineligible_tid = handle->h_transaction->t_tid;
+	ext4_set_inode_state(inode, EXT4_STATE_FC_INELIGIBLE);
+}
+
+static inline void ext4_fc_mark_ineligible(handle_t *handle,
+					   struct inode *inode)
+{
+	if (!inode || !ext4_handle_valid(handle))
+		return;
+	spin_lock(&EXT4_I(inode)->i_raw_lock);
+	__ext4_fc_mark_ineligible(handle, inode);
+	spin_unlock(&EXT4_I(inode)->i_raw_lock);
+}
+
 /* super.c */
 int ext4_force_commit(struct super_block *sb);
 
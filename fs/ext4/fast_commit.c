@@ -0,0 +1,166 @@
+/*
+ *  fs/ext4/fast_commit.c
+ *
+ * Fast commits of inode updates for fsync().
+ *
+ * Most fsync() calls on database and log files follow overwrites or
+ * appends into preallocated space, which change nothing but the inode
+ * itself: timestamps, i_size and the initialized state of extents in the
+ * inode's own extent root.  Instead of committing the whole running
+ * transaction, such an fsync() writes the on-disk image of the inode to
+ * the fast commit area of the journal, which takes a single block write.
+ * Recovery replays the log and then copies the logged images back into
+ * the inode table.
+ *
+ * This is only correct when the image does not depend on anything else
+ * changed by the running transaction.  Every change that ties the inode
+ * to other metadata (block and inode allocation, directory entries, the
+ * orphan list, xattr blocks, quota) marks the inode ineligible for that
+ * transaction, see ext4_fc_mark_ineligible(), and fsync() then commits
+ * the transaction as usual.
+ */
+
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/slab.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+
+/* Fast commit record: the inode number followed by the raw inode */
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__u8	fc_raw_inode[0];
+};
+
+static int ext4_fc_ineligible(struct inode *inode, tid_t tid)
+{
+	return ext4_test_inode_state(inode, EXT4_STATE_FC_INELIGIBLE) &&
+	       tid_geq(EXT4_I(inode)->i_fc_ineligible_tid, tid);
+}
+
+/*
+ * Return whether writing @inode out to @raw changes a field that refers to
+ * metadata outside the inode: the link count to directory entries, the
+ * deletion time (which doubles as the orphan list link) to the orphan
+ * list, the xattr block to its reference count and the owner to quota
+ * usage.  Called with i_raw_lock held.
+ */
+int ext4_fc_raw_inode_changes(struct inode *inode, struct ext4_inode *raw)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	uid_t i_uid = le16_to_cpu(raw->i_uid_low);
+	gid_t i_gid = le16_to_cpu(raw->i_gid_low);
+
+	if (!test_opt(inode->i_sb, NO_UID32)) {
+		i_uid |= le16_to_cpu(raw->i_uid_high) << 16;
+		i_gid |= le16_to_cpu(raw->i_gid_high) << 16;
+	}
+
+	return le16_to_cpu(raw->i_links_count) != inode->i_nlink ||
+	       le32_to_cpu(raw->i_dtime) != ei->i_dtime ||
+	       le32_to_cpu(raw->i_file_acl_lo) != (u32)ei->i_file_acl ||
+	       i_uid != i_uid_read(inode) || i_gid != i_gid_read(inode);
+}
+
+/*
+ * Make the changes of transaction @tid to @inode durable with a fast
+ * commit.  The file data must already have been written.  Returns -EAGAIN
+ * if the transaction has to be committed instead.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t tid)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
+	unsigned int len = sizeof(struct ext4_fc_inode) +
+			   EXT4_INODE_SIZE(inode->i_sb);
+	struct ext4_fc_inode *fc;
+	struct ext4_iloc iloc;
+	int ineligible;
+	int ret;
+
+	if (!test_opt(inode->i_sb, FAST_COMMIT) || !S_ISREG(inode->i_mode) ||
+	    ext4_fc_ineligible(inode, tid))
+		return -EAGAIN;
+
+	fc = kmalloc(len, GFP_NOFS);
+	if (!fc)
+		return -EAGAIN;
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		goto out_free;
+	ret = jbd2_fc_begin_commit(journal, tid);
+	if (ret)
+		goto out_brelse;
+
+	/*
+	 * The in-inode xattrs are written under xattr_sem, everything else
+	 * in the raw inode under i_raw_lock.  The eligibility check has to
+	 * see every mark made before the copied image was written.
+	 */
+	fc->fc_ino = cpu_to_le32(inode->i_ino);
+	down_read(&ei->xattr_sem);
+	spin_lock(&ei->i_raw_lock);
+	memcpy(fc->fc_raw_inode, ext4_raw_inode(&iloc),
+	       EXT4_INODE_SIZE(inode->i_sb));
+	ineligible = ext4_fc_ineligible(inode, tid);
+	spin_unlock(&ei->i_raw_lock);
+	up_read(&ei->xattr_sem);
+
+	if (!ineligible)
+		ret = jbd2_fc_write(journal, tid, fc, len);
+	jbd2_fc_end_commit(journal);
+	if (ineligible)
+		ret = -EAGAIN;
+out_brelse:
+	brelse(iloc.bh);
+out_free:
+	kfree(fc);
+	return ret ? -EAGAIN : 0;
+}
+
+/*
+ * Journal recovery callback: copy a logged inode image back into the
+ * inode table.  The journal replay has already brought the inode table
+ * and group descriptors up to date with the last committed transaction.
+ */
+int ext4_fc_replay(journal_t *journal, void *data, unsigned int len)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_inode *fc = data;
+	unsigned long ino = le32_to_cpu(fc->fc_ino);
+	int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	ext4_group_t group;
+	unsigned long offset;
+	ext4_fsblk_t block;
+
+	if (len != sizeof(*fc) + inode_size || ino < EXT4_FIRST_INO(sb) ||
+	    ino > le32_to_cpu(EXT4_SB(sb)->s_es->s_inodes_count)) {
+		ext4_msg(sb, KERN_ERR, "invalid fast commit record "
+			 "(inode %lu, length %u)", ino, len);
+		return -EIO;
+	}
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * inode_size;
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+	block = ext4_inode_table(sb, gdp) + (offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	bh = sb_bread(sb, block);
+	if (!bh) {
+		ext4_msg(sb, KERN_ERR, "unable to read inode table block "
+			 "%llu for fast commit replay", block);
+		return -EIO;
+	}
+
+	lock_buffer(bh);
+	memcpy(bh->b_data + (offset & (EXT4_BLOCK_SIZE(sb) - 1)),
+	       fc->fc_raw_inode, inode_size);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
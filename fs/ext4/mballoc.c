@@ -698,23 +698,86 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the matching list of the free space index.
+ * Called with the group locked.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
+	int new = -1;
 	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new = i;
 			break;
 		}
 	}
+
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	grp->bb_largest_free_order = new;
+	if (new >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[new]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[new]);
+	}
+}
+
+/*
+ * Order of an average free extent size (or of a request length) as used
+ * by the s_mb_avg_fragment_size lists.
+ */
+static int mb_avg_fragment_size_order(struct super_block *sb, ext4_grpblk_t len)
+{
+	int order = fls(len) - 1;
+
+	if (order < 0)
+		return 0;
+	if (order >= MB_NUM_ORDERS(sb))
+		order = MB_NUM_ORDERS(sb) - 1;
+	return order;
+}
+
+/*
+ * Move the group to the s_mb_avg_fragment_size list matching its current
+ * bb_free / bb_fragments. Called with the group locked.
+ */
+static void
+mb_update_avg_fragment_size(struct super_block *sb, struct ext4_group_info *grp)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_avg_fragment_size_order;
+	int new = -1;
+
+	if (grp->bb_free > 0 && grp->bb_fragments > 0)
+		new = mb_avg_fragment_size_order(sb,
+					grp->bb_free / grp->bb_fragments);
+
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[old]);
+		list_del_init(&grp->bb_avg_fragment_size_node);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[old]);
+	}
+	grp->bb_avg_fragment_size_order = new;
+	if (new >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[new]);
+		list_add_tail(&grp->bb_avg_fragment_size_node,
+			      &sbi->s_mb_avg_fragment_size[new]);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[new]);
+	}
 }
 
 static noinline_for_stack
@@ -762,8 +825,12 @@ void ext4_mb_generate_buddy(struct super_block *sb,
 		set_bit(EXT4_GROUP_INFO_BBITMAP_CORRUPT_BIT, &grp->bb_state);
 	}
 	mb_set_largest_free_order(sb, grp);
+	mb_update_avg_fragment_size(sb, grp);
 
-	clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state));
+	clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &grp->bb_state);
+	if (test_and_clear_bit(EXT4_GROUP_INFO_UNINIT_COUNTED_BIT,
+			       &grp->bb_state))
+		atomic_dec(&EXT4_SB(sb)->s_mb_uninit_groups);
 
 	period = get_cycles() - period;
 	spin_lock(&EXT4_SB(sb)->s_bal_lock);
@@ -1464,6 +1531,7 @@ static void mb_free_blocks(struct inode *inode, struct ext4_buddy *e4b,
 
 done:
 	mb_set_largest_free_order(sb, e4b->bd_info);
+	mb_update_avg_fragment_size(sb, e4b->bd_info);
 	mb_check_buddy(e4b);
 }
 
@@ -1588,6 +1656,7 @@ static int mb_mark_used(struct ext4_buddy *e4b, struct ext4_free_extent *ex)
 		e4b->bd_info->bb_counters[ord]++;
 	}
 	mb_set_largest_free_order(e4b->bd_sb, e4b->bd_info);
+	mb_update_avg_fragment_size(e4b->bd_sb, e4b->bd_info);
 
 	ext4_set_bits(e4b->bd_bitmap, ex->fe_start, len0);
 	mb_check_buddy(e4b);
@@ -2051,12 +2120,209 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Load the buddy of the group and scan it for criteria cr. Only an error
+ * loading the buddy is returned; whether something was found is left in
+ * ac->ac_status.
+ */
+static int ext4_mb_scan_group(struct ext4_allocation_context *ac,
+			      ext4_group_t group, int cr,
+			      struct ext4_buddy *e4b)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int err;
+
+	/* This now checks without needing the buddy page */
+	if (!ext4_mb_good_group(ac, group, cr))
+		return 0;
+
+	err = ext4_mb_load_buddy(sb, group, e4b);
+	if (err)
+		return err;
+
+	ext4_lock_group(sb, group);
+
+	/*
+	 * We need to check again after locking the
+	 * block group
+	 */
+	if (!ext4_mb_good_group(ac, group, cr)) {
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(e4b);
+		return 0;
+	}
+
+	ac->ac_groups_scanned++;
+	if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
+		ext4_mb_simple_scan_group(ac, e4b);
+	else if (cr == 1 && sbi->s_stripe &&
+			!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+		ext4_mb_scan_aligned(ac, e4b);
+	else
+		ext4_mb_complex_scan_group(ac, e4b);
+
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(e4b);
+
+	return 0;
+}
+
+/* Has ext4_mb_scan_indexed() already tried the group in this pass? */
+static bool ext4_mb_group_tried(ext4_group_t group,
+				const ext4_group_t *tried, int ntried)
+{
+	int i;
+
+	for (i = 0; i < ntried; i++)
+		if (tried[i] == group)
+			return true;
+	return false;
+}
+
+/*
+ * Criteria 0: find a group whose largest free extent is at least
+ * 2^ac_2order, starting with the smallest such order. Returns ngroups if
+ * the index has no suitable group.
+ */
+static ext4_group_t
+ext4_mb_find_largest_free_group(struct ext4_allocation_context *ac,
+				ext4_group_t ngroups,
+				const ext4_group_t *tried, int ntried)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct ext4_group_info *grp;
+	ext4_group_t group = ngroups;
+	int i;
+
+	for (i = ac->ac_2order; i < MB_NUM_ORDERS(ac->ac_sb); i++) {
+		if (list_empty(&sbi->s_mb_largest_free_orders[i]))
+			continue;
+		read_lock(&sbi->s_mb_largest_free_orders_locks[i]);
+		list_for_each_entry(grp, &sbi->s_mb_largest_free_orders[i],
+				    bb_largest_free_order_node) {
+			/*
+			 * The group is indexed just before its NEED_INIT
+			 * bit is cleared; don't let ext4_mb_good_group()
+			 * try to initialize it under our spinlock.
+			 */
+			if (grp->bb_group >= ngroups ||
+			    EXT4_MB_GRP_NEED_INIT(grp) ||
+			    ext4_mb_group_tried(grp->bb_group, tried, ntried))
+				continue;
+			if (ext4_mb_good_group(ac, grp->bb_group, 0)) {
+				group = grp->bb_group;
+				break;
+			}
+		}
+		read_unlock(&sbi->s_mb_largest_free_orders_locks[i]);
+		if (group < ngroups)
+			break;
+	}
+	return group;
+}
+
+/*
+ * Criteria 1: find a group whose average free extent is at least as long
+ * as the request. Returns ngroups if the index has no suitable group.
+ */
+static ext4_group_t
+ext4_mb_find_avg_fragment_group(struct ext4_allocation_context *ac,
+				ext4_group_t ngroups,
+				const ext4_group_t *tried, int ntried)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct ext4_group_info *grp;
+	ext4_group_t group = ngroups;
+	int i;
+
+	for (i = mb_avg_fragment_size_order(ac->ac_sb, ac->ac_g_ex.fe_len);
+	     i < MB_NUM_ORDERS(ac->ac_sb); i++) {
+		if (list_empty(&sbi->s_mb_avg_fragment_size[i]))
+			continue;
+		read_lock(&sbi->s_mb_avg_fragment_size_locks[i]);
+		list_for_each_entry(grp, &sbi->s_mb_avg_fragment_size[i],
+				    bb_avg_fragment_size_node) {
+			/* See ext4_mb_find_largest_free_group() */
+			if (grp->bb_group >= ngroups ||
+			    EXT4_MB_GRP_NEED_INIT(grp) ||
+			    ext4_mb_group_tried(grp->bb_group, tried, ntried))
+				continue;
+			if (ext4_mb_good_group(ac, grp->bb_group, 1)) {
+				group = grp->bb_group;
+				break;
+			}
+		}
+		read_unlock(&sbi->s_mb_avg_fragment_size_locks[i]);
+		if (group < ngroups)
+			break;
+	}
+	return group;
+}
+
+/*
+ * Can criteria cr be served from the free space index? Criteria 2 and 3
+ * accept almost any group, so those are always scanned linearly.
+ */
+static bool ext4_mb_use_index(struct ext4_allocation_context *ac, int cr)
+{
+	struct super_block *sb = ac->ac_sb;
+
+	if (!EXT4_SB(sb)->s_mb_optimize_scan)
+		return false;
+	if (cr == 0)
+		return ac->ac_2order < MB_NUM_ORDERS(sb);
+	return cr == 1;
+}
+
+/*
+ * Scan the groups the free space index offers for criteria cr. All
+ * initialized groups are indexed; groups whose buddy hasn't been built
+ * yet are left to the linear scan.
+ */
+static int ext4_mb_scan_indexed(struct ext4_allocation_context *ac, int cr,
+				ext4_group_t ngroups, struct ext4_buddy *e4b)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	ext4_group_t group, tried[MB_INDEX_MAX_TRIES];
+	int tries;
+	int err;
+
+	for (tries = 0; tries < MB_INDEX_MAX_TRIES; tries++) {
+		if (cr == 0)
+			group = ext4_mb_find_largest_free_group(ac, ngroups,
+								tried, tries);
+		else
+			group = ext4_mb_find_avg_fragment_group(ac, ngroups,
+								tried, tries);
+		if (group >= ngroups)
+			break;
+
+		err = ext4_mb_scan_group(ac, group, cr, e4b);
+		if (err)
+			return err;
+		if (ac->ac_status != AC_STATUS_CONTINUE) {
+			if (sbi->s_mb_stats)
+				atomic_inc(&sbi->s_bal_index_hits);
+			break;
+		}
+		/*
+		 * Lost a race for the group; don't pick it again in
+		 * this pass, or two such groups would take turns.
+		 */
+		tried[tries] = group;
+	}
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
 	int cr;
 	int err = 0;
+	bool indexed;
+	unsigned int linear_limit;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
 	struct ext4_buddy e4b;
@@ -2121,6 +2387,8 @@ repeat:
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
+		indexed = ext4_mb_use_index(ac, cr);
+		linear_limit = ACCESS_ONCE(sbi->s_mb_linear_limit);
 
 		for (i = 0; i < ngroups; group++, i++) {
 			cond_resched();
@@ -2131,37 +2399,31 @@ repeat:
 			if (group >= ngroups)
 				group = 0;
 
-			/* This now checks without needing the buddy page */
-			if (!ext4_mb_good_group(ac, group, cr))
-				continue;
-
-			err = ext4_mb_load_buddy(sb, group, &e4b);
-			if (err)
-				goto out;
-
-			ext4_lock_group(sb, group);
-
 			/*
-			 * We need to check again after locking the
-			 * block group
+			 * After the first few groups near the goal, ask the
+			 * free space index. If it has nothing, only groups
+			 * that aren't indexed yet and have free space remain
+			 * worth a look.
 			 */
-			if (!ext4_mb_good_group(ac, group, cr)) {
-				ext4_unlock_group(sb, group);
-				ext4_mb_unload_buddy(&e4b);
-				continue;
+			if (indexed && i >= linear_limit) {
+				if (i == linear_limit) {
+					err = ext4_mb_scan_indexed(ac, cr,
+							ngroups, &e4b);
+					if (err)
+						goto out;
+					if (ac->ac_status != AC_STATUS_CONTINUE)
+						break;
+				}
+				if (!atomic_read(&sbi->s_mb_uninit_groups))
+					break;
+				if (!test_bit(EXT4_GROUP_INFO_UNINIT_COUNTED_BIT,
+					&ext4_get_group_info(sb, group)->bb_state))
+					continue;
 			}
 
-			ac->ac_groups_scanned++;
-			if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
-				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
-			else
-				ext4_mb_complex_scan_group(ac, &e4b);
-
-			ext4_unlock_group(sb, group);
-			ext4_mb_unload_buddy(&e4b);
+			err = ext4_mb_scan_group(ac, group, cr, &e4b);
+			if (err)
+				goto out;
 
 			if (ac->ac_status != AC_STATUS_CONTINUE)
 				break;
@@ -2397,10 +2659,26 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 			ext4_free_group_clusters(sb, desc);
 	}
 
+	/*
+	 * Full groups are never initialized by the allocator, so they
+	 * don't count as unindexed: the linear pass has nothing to find
+	 * there. Their free count can only grow through the buddy, which
+	 * initializes them.
+	 */
+	if (meta_group_info[i]->bb_free) {
+		set_bit(EXT4_GROUP_INFO_UNINIT_COUNTED_BIT,
+			&(meta_group_info[i]->bb_state));
+		atomic_inc(&sbi->s_mb_uninit_groups);
+	}
+
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_avg_fragment_size_order = -1;
+	meta_group_info[i]->bb_group = group;
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_avg_fragment_size_node);
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2550,6 +2828,30 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	i = MB_NUM_ORDERS(sb);
+	sbi->s_mb_largest_free_orders =
+		kmalloc(i * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc(i * sizeof(rwlock_t), GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size =
+		kmalloc(i * sizeof(struct list_head), GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size_locks =
+		kmalloc(i * sizeof(rwlock_t), GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks ||
+	    !sbi->s_mb_avg_fragment_size ||
+	    !sbi->s_mb_avg_fragment_size_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+		INIT_LIST_HEAD(&sbi->s_mb_avg_fragment_size[i]);
+		rwlock_init(&sbi->s_mb_avg_fragment_size_locks[i]);
+	}
+	atomic_set(&sbi->s_mb_uninit_groups, 0);
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2577,6 +2879,8 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
+	sbi->s_mb_linear_limit = MB_DEFAULT_LINEAR_LIMIT;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2635,6 +2939,14 @@ out_free_locality_groups:
 out_free_groupinfo_slab:
 	ext4_groupinfo_destroy_slabs();
 out:
+	kfree(sbi->s_mb_avg_fragment_size_locks);
+	sbi->s_mb_avg_fragment_size_locks = NULL;
+	kfree(sbi->s_mb_avg_fragment_size);
+	sbi->s_mb_avg_fragment_size = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2690,6 +3002,10 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		ext4_kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_avg_fragment_size_locks);
+	kfree(sbi->s_mb_avg_fragment_size);
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	kfree(sbi->s_mb_largest_free_orders);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	if (sbi->s_buddy_cache)
@@ -2708,6 +3024,9 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_bal_2orders),
 				atomic_read(&sbi->s_bal_breaks),
 				atomic_read(&sbi->s_mb_lost_chunks));
+		ext4_msg(sb, KERN_INFO,
+		       "mballoc: %u groups found via the free space index",
+				atomic_read(&sbi->s_bal_index_hits));
 		ext4_msg(sb, KERN_INFO,
 		       "mballoc: %lu generated and it took %Lu",
 				sbi->s_mb_buddies_generated,
@@ -4361,6 +4680,7 @@ ext4_fsblk_t ext4_mb_new_blocks(handle_t *handle,
 	sbi = EXT4_SB(sb);
 
 	trace_ext4_request_blocks(ar);
+	ext4_fc_mark_ineligible(handle, ar->inode);
 
 	/* Allow to use superuser reservation for quota file */
 	if (IS_NOQUOTA(ar->inode))
@@ -4621,6 +4941,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 		else
 			block = bh->b_blocknr;
 	}
+	ext4_fc_mark_ineligible(handle, inode);
 
 	sbi = EXT4_SB(sb);
 	if (!(flags & EXT4_FREE_BLOCKS_VALIDATED) &&
@@ -89,6 +89,28 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * use the free space index to pick groups for criteria 0 and 1
+ * instead of scanning them linearly
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/*
+ * number of groups, starting at the goal, that are still scanned
+ * linearly before consulting the free space index; keeps allocations
+ * close to their goal when there is space nearby
+ */
+#define MB_DEFAULT_LINEAR_LIMIT		4
+
+/*
+ * number of groups tried from the free space index before falling back
+ * to a linear scan (only reached when racing with other allocators)
+ */
+#define MB_INDEX_MAX_TRIES		8
+
+/* number of orders tracked in the buddy and the free space index */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
 
 struct ext4_free_data {
 	/* MUST be the first member */
@@ -2569,6 +2569,9 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	J_ASSERT((S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 		  S_ISLNK(inode->i_mode)) || inode->i_nlink == 0);
 
+	/* The orphan list is rooted in the superblock */
+	ext4_fc_mark_ineligible(handle, inode);
+
 	BUFFER_TRACE(EXT4_SB(sb)->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, EXT4_SB(sb)->s_sbh);
 	if (err)
@@ -2635,6 +2638,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 	if (list_empty(&ei->i_orphan))
 		goto out;
 
+	ext4_fc_mark_ineligible(handle, inode);
 	ino_next = NEXT_ORPHAN(inode);
 	prev = ei->i_orphan.prev;
 	sbi = EXT4_SB(inode->i_sb);
@@ -3062,6 +3066,10 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old_dir) || IS_DIRSYNC(new_dir))
 		ext4_handle_sync(handle);
 
+	/* A fast commit of either inode would not carry the new name */
+	ext4_fc_mark_ineligible(handle, old_inode);
+	ext4_fc_mark_ineligible(handle, new_inode);
+
 	if (S_ISDIR(old_inode->i_mode)) {
 		if (new_inode) {
 			retval = -ENOTEMPTY;
@@ -68,6 +68,7 @@ static void ext4_mark_recovery_complete(struct super_block *sb,
 					struct ext4_super_block *es);
 static void ext4_clear_journal_err(struct super_block *sb,
 				   struct ext4_super_block *es);
+static void ext4_setup_fast_commit(struct super_block *sb);
 static int ext4_sync_fs(struct super_block *sb, int wait);
 static int ext4_sync_fs_nojournal(struct super_block *sb, int wait);
 static int ext4_remount(struct super_block *sb, int *flags, char *data);
@@ -895,6 +896,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	spin_lock_init(&ei->i_completed_io_lock);
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	spin_lock_init(&ei->i_raw_lock);
 	atomic_set(&ei->i_ioend_count, 0);
 	atomic_set(&ei->i_unwritten, 0);
 	INIT_WORK(&ei->i_rsv_conversion_work, ext4_end_io_rsv_work);
@@ -1162,7 +1164,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
-	Opt_max_dir_size_kb,
+	Opt_max_dir_size_kb, Opt_fast_commit, Opt_nofast_commit,
 };
 
 static const match_table_t tokens = {
@@ -1238,6 +1240,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
 	{Opt_max_dir_size_kb, "max_dir_size_kb=%u"},
+	{Opt_fast_commit, "fast_commit"},
+	{Opt_nofast_commit, "nofast_commit"},
 	{Opt_removed, "check=none"},	/* mount option from ext2/3 */
 	{Opt_removed, "nocheck"},	/* mount option from ext2/3 */
 	{Opt_removed, "reservation"},	/* mount option from ext2/3 */
@@ -1382,6 +1386,9 @@ static const struct mount_opts {
 	{Opt_journal_async_commit, (EXT4_MOUNT_JOURNAL_ASYNC_COMMIT |
 				    EXT4_MOUNT_JOURNAL_CHECKSUM),
 	 MOPT_EXT4_ONLY | MOPT_SET},
+	{Opt_fast_commit, EXT4_MOUNT_FAST_COMMIT, MOPT_EXT4_ONLY | MOPT_SET},
+	{Opt_nofast_commit, EXT4_MOUNT_FAST_COMMIT,
+	 MOPT_EXT4_ONLY | MOPT_CLEAR},
 	{Opt_noload, EXT4_MOUNT_NOLOAD, MOPT_NO_EXT2 | MOPT_SET},
 	{Opt_err_panic, EXT4_MOUNT_ERRORS_PANIC, MOPT_SET | MOPT_CLEAR_ERR},
 	{Opt_err_ro, EXT4_MOUNT_ERRORS_RO, MOPT_SET | MOPT_CLEAR_ERR},
@@ -2622,6 +2629,8 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_optimize_scan, s_mb_optimize_scan);
+EXT4_RW_ATTR_SBI_UI(mb_linear_limit, s_mb_linear_limit);
 EXT4_DEPRECATED_ATTR(max_writeback_mb_bump, 128);
 EXT4_RW_ATTR_SBI_UI(extent_max_zeroout_kb, s_extent_max_zeroout_kb);
 EXT4_ATTR(trigger_fs_error, 0200, NULL, trigger_test_error);
@@ -2645,6 +2654,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_optimize_scan),
+	ATTR_LIST(mb_linear_limit),
 	ATTR_LIST(max_writeback_mb_bump),
 	ATTR_LIST(extent_max_zeroout_kb),
 	ATTR_LIST(trigger_fs_error),
@@ -3996,6 +4007,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	set_task_ioprio(sbi->s_journal->j_task, journal_ioprio);
 
 	sbi->s_journal->j_commit_callback = ext4_journal_commit_callback;
+	ext4_setup_fast_commit(sb);
 
 	/*
 	 * The journal may have updated the bg summary counts, so we
@@ -4247,6 +4259,7 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	journal->j_commit_interval = sbi->s_commit_interval;
 	journal->j_min_batch_time = sbi->s_min_batch_time;
 	journal->j_max_batch_time = sbi->s_max_batch_time;
+	journal->j_fc_replay = ext4_fc_replay;
 
 	write_lock(&journal->j_state_lock);
 	if (test_opt(sb, BARRIER))
@@ -4260,6 +4273,51 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	write_unlock(&journal->j_state_lock);
 }
 
+/*
+ * Reserve the fast commit area in the journal if fast commits were asked
+ * for, and remove it otherwise, so that the incompat feature bit it needs
+ * is only ever set by an explicit fast_commit mount and goes away on the
+ * next read-write mount without it.  Both need a writable, empty journal,
+ * so this only happens at mount time.
+ */
+static void ext4_setup_fast_commit(struct super_block *sb)
+{
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	int err;
+
+	if (sb->s_flags & MS_RDONLY)
+		return;
+	if (!test_opt(sb, FAST_COMMIT)) {
+		if (!journal->j_fc_blocks)
+			return;
+		err = jbd2_fc_release(journal);
+		if (err)
+			ext4_msg(sb, KERN_WARNING, "can't remove fast commit "
+				 "area from journal (err %d)", err);
+		else
+			ext4_msg(sb, KERN_INFO, "removed fast commit area "
+				 "from journal");
+		return;
+	}
+	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA) {
+		ext4_msg(sb, KERN_WARNING, "fast_commit is not supported "
+			 "with data=journal");
+		clear_opt(sb, FAST_COMMIT);
+		return;
+	}
+	if (journal->j_fc_blocks)
+		return;
+	err = jbd2_fc_init(journal, JBD2_DEFAULT_FC_BLOCKS);
+	if (err) {
+		ext4_msg(sb, KERN_WARNING, "can't set up fast commit area "
+			 "in journal (err %d), fast_commit disabled", err);
+		clear_opt(sb, FAST_COMMIT);
+		return;
+	}
+	ext4_msg(sb, KERN_INFO, "added fast commit area to journal; "
+		 "mount with nofast_commit to remove it");
+}
+
 static journal_t *ext4_get_journal(struct super_block *sb,
 				   unsigned int journal_inum)
 {
@@ -4815,6 +4873,16 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		}
 	}
 
+	/* The fast commit area can only be added while the journal is empty */
+	if (test_opt(sb, FAST_COMMIT) &&
+	    !(old_opts.s_mount_opt & EXT4_MOUNT_FAST_COMMIT) &&
+	    sbi->s_journal && !sbi->s_journal->j_fc_blocks) {
+		ext4_msg(sb, KERN_ERR, "fast_commit can only be enabled "
+			 "at mount time");
+		err = -EINVAL;
+		goto restore_opts;
+	}
+
 	if (sbi->s_mount_flags & EXT4_MF_FS_ABORTED)
 		ext4_abort(sb, "Abort forced by user");
 
@@ -4929,6 +4997,8 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	}
 
 	ext4_setup_system_zone(sb);
+	if (sbi->s_journal)
+		ext4_setup_fast_commit(sb);
 	if (sbi->s_journal == NULL && !(old_sb_flags & MS_RDONLY))
 		ext4_commit_super(sb, 1);
 
@@ -1108,6 +1108,8 @@ restart_loop:
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
+	/* Fast commit records for this transaction are now superseded */
+	journal->j_fc_off = 0;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
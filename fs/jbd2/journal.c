@@ -43,6 +43,8 @@
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
+#include <linux/crc32.h>
+#include <linux/blkdev.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -102,6 +104,8 @@ EXPORT_SYMBOL(jbd2_inode_cache);
 
 static void __journal_abort_soft (journal_t *journal, int errno);
 static int jbd2_journal_create_slab(size_t slab_size);
+static void journal_fc_setup(journal_t *journal);
+static void jbd2_write_superblock(journal_t *journal, int write_op);
 
 #ifdef CONFIG_JBD2_DEBUG
 void __jbd2_debug(int level, const char *file, const char *func,
@@ -754,6 +758,237 @@ wait_commit:
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Fast commits
+ *
+ * An fsync() normally has to commit the whole running transaction.  A
+ * client that can describe everything the fsync() needs in a few bytes
+ * (ext4 logs the on-disk inode) may instead append a record to the fast
+ * commit area, which costs a single block write.  The records only
+ * extend the last committed transaction: recovery replays the log as
+ * usual and then hands the client each record tagged with the next
+ * transaction ID, in the order they were written.  The client must fall
+ * back to jbd2_complete_transaction() whenever the records alone would
+ * leave the filesystem inconsistent after such a replay.
+ */
+
+/*
+ * Resize the fast commit area to @blocks blocks, zero removing it.  The
+ * area is recorded in the journal superblock, so this is only possible
+ * while the journal is empty, i.e. before the first transaction starts.
+ */
+static int journal_fc_resize(journal_t *journal, unsigned long blocks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	int err = 0;
+
+	mutex_lock(&journal->j_checkpoint_mutex);
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_checkpoint_transactions ||
+	    journal->j_head != journal->j_first) {
+		err = -EBUSY;
+	} else {
+		if (blocks)
+			sb->s_feature_incompat |=
+				cpu_to_be32(JBD2_FEATURE_INCOMPAT_FC_AREA);
+		else
+			sb->s_feature_incompat &=
+				~cpu_to_be32(JBD2_FEATURE_INCOMPAT_FC_AREA);
+		sb->s_fc_area_blks = cpu_to_be32(blocks);
+		journal_fc_setup(journal);
+		journal->j_head = journal->j_tail = journal->j_first;
+		journal->j_free = journal->j_last - journal->j_first;
+		journal->j_max_transaction_buffers =
+			(journal->j_maxlen - journal->j_fc_blocks) / 4;
+	}
+	write_unlock(&journal->j_state_lock);
+	if (!err)
+		jbd2_write_superblock(journal, WRITE_FUA);
+	mutex_unlock(&journal->j_checkpoint_mutex);
+	return err;
+}
+
+/*
+ * Set up the fast commit area of @blocks blocks at the end of the journal.
+ * This sets an incompat feature: kernels that don't know it refuse the
+ * journal until jbd2_fc_release() removes the area again.  Journals that
+ * already have one keep its size.
+ */
+int jbd2_fc_init(journal_t *journal, unsigned long blocks)
+{
+	if (journal->j_fc_blocks)
+		return 0;
+	if (!blocks)
+		return -EINVAL;
+	if (journal->j_last - journal->j_first < JBD2_MIN_JOURNAL_BLOCKS + blocks)
+		return -ENOSPC;
+	if (!jbd2_journal_check_available_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FC_AREA))
+		return -EINVAL;
+
+	return journal_fc_resize(journal, blocks);
+}
+EXPORT_SYMBOL(jbd2_fc_init);
+
+/*
+ * Give the fast commit area back to the log and clear its feature bit.
+ * Like jbd2_fc_init(), this needs an empty journal: records in the area
+ * are only meaningful until the next commit, and recovery has already
+ * replayed them by the time a client can call this.
+ */
+int jbd2_fc_release(journal_t *journal)
+{
+	if (!journal->j_fc_blocks)
+		return 0;
+
+	return journal_fc_resize(journal, 0);
+}
+EXPORT_SYMBOL(jbd2_fc_release);
+
+__u32 jbd2_fc_csum(journal_t *journal, void *block)
+{
+	struct jbd2_fc_header *fc = block;
+	__be32 old = fc->fc_checksum;
+	__u32 csum;
+
+	fc->fc_checksum = 0;
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal, JBD2_FEATURE_INCOMPAT_CSUM_V2))
+		csum = jbd2_chksum(journal, journal->j_csum_seed, block,
+				   journal->j_blocksize);
+	else
+		csum = crc32_be(~0, block, journal->j_blocksize);
+	fc->fc_checksum = old;
+	return csum;
+}
+
+/*
+ * Start a fast commit on behalf of transaction @tid.  Returns 0 with the
+ * fast commit area locked if @tid is the running transaction and nothing
+ * else is being committed; a transaction that is still being committed
+ * is waited for first, as records are only valid on top of it.  On any
+ * error the caller has to commit @tid the regular way.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	tid_t committing;
+	int err;
+
+	if (!journal->j_fc_blocks)
+		return -EOPNOTSUPP;
+again:
+	mutex_lock(&journal->j_fc_mutex);
+	read_lock(&journal->j_state_lock);
+	if (is_journal_aborted(journal))
+		err = -EROFS;
+	else if (!journal->j_running_transaction ||
+		 journal->j_running_transaction->t_tid != tid)
+		err = -EALREADY;
+	else if (journal->j_flags & JBD2_FLUSHED)
+		/* An empty log is not scanned on recovery */
+		err = -EAGAIN;
+	else if (journal->j_fc_off >= journal->j_fc_blocks)
+		err = -ENOSPC;
+	else if (journal->j_committing_transaction) {
+		committing = journal->j_committing_transaction->t_tid;
+		read_unlock(&journal->j_state_lock);
+		mutex_unlock(&journal->j_fc_mutex);
+		err = jbd2_log_wait_commit(journal, committing);
+		if (err)
+			return err;
+		goto again;
+	} else
+		err = 0;
+	read_unlock(&journal->j_state_lock);
+	if (err)
+		mutex_unlock(&journal->j_fc_mutex);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+/*
+ * Write one fast commit record of @len bytes for transaction @tid and wait
+ * for it to reach stable storage, together with all data written before.
+ * Must be called between jbd2_fc_begin_commit() and jbd2_fc_end_commit().
+ */
+int jbd2_fc_write(journal_t *journal, tid_t tid, const void *data,
+		  unsigned int len)
+{
+	struct jbd2_fc_header *fc;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	unsigned long off;
+	int write_op = WRITE_SYNC;
+	int err;
+
+	if (len > journal->j_blocksize - sizeof(*fc))
+		return -E2BIG;
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_fc_off >= journal->j_fc_blocks) {
+		write_unlock(&journal->j_state_lock);
+		return -ENOSPC;
+	}
+	off = journal->j_fc_off++;
+	write_unlock(&journal->j_state_lock);
+
+	err = jbd2_journal_bmap(journal, journal->j_fc_first + off, &blocknr);
+	if (err)
+		return err;
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	/*
+	 * The cache flush makes the file data and the earlier records durable
+	 * before this one; with an external journal the filesystem device has
+	 * to be flushed separately.
+	 */
+	if (journal->j_flags & JBD2_BARRIER) {
+		write_op = WRITE_SYNC | WRITE_FLUSH_FUA;
+		if (journal->j_fs_dev != journal->j_dev) {
+			err = blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS,
+						 NULL);
+			if (err)
+				goto out;
+		}
+	}
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	fc = (struct jbd2_fc_header *)bh->b_data;
+	fc->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	fc->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	fc->fc_header.h_sequence = cpu_to_be32(tid);
+	fc->fc_len = cpu_to_be32(len);
+	memcpy(fc + 1, data, len);
+	fc->fc_checksum = cpu_to_be32(jbd2_fc_csum(journal, bh->b_data));
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(write_op, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		err = -EIO;
+	else {
+		spin_lock(&journal->j_history_lock);
+		journal->j_stats.ts_fast_commits++;
+		spin_unlock(&journal->j_history_lock);
+	}
+out:
+	brelse(bh);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_write);
+
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	mutex_unlock(&journal->j_fc_mutex);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
 /*
  * Log buffer allocation routines:
  */
@@ -955,6 +1190,9 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 		   "each up to %u blocks\n",
 		   s->stats->ts_tid, s->stats->ts_requested,
 		   s->journal->j_max_transaction_buffers);
+	if (s->journal->j_fc_blocks)
+		seq_printf(seq, "%lu fast commits, up to %lu per transaction\n",
+			   s->stats->ts_fast_commits, s->journal->j_fc_blocks);
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -1084,6 +1322,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_reserved);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	mutex_init(&journal->j_fc_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1280,7 +1519,7 @@ static int journal_reset(journal_t *journal)
 	unsigned long long first, last;
 
 	first = be32_to_cpu(sb->s_first);
-	last = be32_to_cpu(sb->s_maxlen);
+	last = be32_to_cpu(sb->s_maxlen) - journal->j_fc_blocks;
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD2: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1299,7 +1538,9 @@ static int journal_reset(journal_t *journal)
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
 	journal->j_commit_request = journal->j_commit_sequence;
 
-	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
+	journal->j_max_transaction_buffers =
+		(journal->j_maxlen - journal->j_fc_blocks) / 4;
+	journal->j_fc_off = 0;
 
 	/*
 	 * As a special case, if the on-disk copy is already marked as needing
@@ -1522,6 +1763,16 @@ static int journal_get_superblock(journal_t *journal)
 		goto out;
 	}
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FC_AREA) &&
+	    be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS +
+	    be32_to_cpu(sb->s_fc_area_blks) > journal->j_maxlen) {
+		printk(KERN_WARNING
+			"JBD2: Invalid fast commit area size: %u\n",
+			be32_to_cpu(sb->s_fc_area_blks));
+		goto out;
+	}
+
 	if (JBD2_HAS_COMPAT_FEATURE(journal, JBD2_FEATURE_COMPAT_CHECKSUM) &&
 	    JBD2_HAS_INCOMPAT_FEATURE(journal, JBD2_FEATURE_INCOMPAT_CSUM_V2)) {
 		/* Can't have checksum v1 and v2 on at the same time! */
@@ -1566,6 +1817,23 @@ out:
 	return err;
 }
 
+/*
+ * The fast commit area, if there is one, takes the blocks at the end of
+ * the journal away from the log.
+ */
+static void journal_fc_setup(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+
+	journal->j_fc_blocks = 0;
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FC_AREA))
+		journal->j_fc_blocks = be32_to_cpu(sb->s_fc_area_blks);
+	journal->j_last = be32_to_cpu(sb->s_maxlen) - journal->j_fc_blocks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+}
+
 /*
  * Load the on-disk journal superblock and read the key fields into the
  * journal_t.
@@ -1585,7 +1853,7 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail_sequence = be32_to_cpu(sb->s_sequence);
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
-	journal->j_last = be32_to_cpu(sb->s_maxlen);
+	journal_fc_setup(journal);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
 	return 0;
@@ -36,6 +36,7 @@ struct recovery_info
 	int		nr_replays;
 	int		nr_revokes;
 	int		nr_revoke_hits;
+	int		nr_fc_replays;
 };
 
 enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
@@ -43,6 +44,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int replay_fc_records(journal_t *journal, struct recovery_info *info);
 
 #ifdef __KERNEL__
 
@@ -194,6 +196,48 @@ static int jbd2_descr_block_csum_verify(journal_t *j,
 	return provided == cpu_to_be32(calculated);
 }
 
+/*
+ * Hand the fast commit records written on behalf of the transaction after
+ * the last one in the log to the client.  The area is filled from its
+ * start for every transaction, so the records end at the first block that
+ * is not a valid record of that transaction.
+ */
+static int replay_fc_records(journal_t *journal, struct recovery_info *info)
+{
+	struct jbd2_fc_header *fc;
+	struct buffer_head *bh;
+	unsigned long off;
+	unsigned int len;
+	int err = 0;
+
+	if (!journal->j_fc_replay)
+		return 0;
+
+	for (off = 0; off < journal->j_fc_blocks; off++) {
+		err = jread(&bh, journal, journal->j_fc_first + off);
+		if (err)
+			break;
+		fc = (struct jbd2_fc_header *)bh->b_data;
+		len = be32_to_cpu(fc->fc_len);
+		if (fc->fc_header.h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    fc->fc_header.h_blocktype != cpu_to_be32(JBD2_FC_BLOCK) ||
+		    be32_to_cpu(fc->fc_header.h_sequence) !=
+		    info->end_transaction ||
+		    len > journal->j_blocksize - sizeof(*fc) ||
+		    be32_to_cpu(fc->fc_checksum) !=
+		    jbd2_fc_csum(journal, bh->b_data)) {
+			brelse(bh);
+			break;
+		}
+		err = journal->j_fc_replay(journal, fc + 1, len);
+		brelse(bh);
+		if (err)
+			break;
+		info->nr_fc_replays++;
+	}
+	return err;
+}
+
 /*
  * Count the number of in-use tags in a journal descriptor block.
  */
@@ -273,12 +317,16 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err)
+		err = replay_fc_records(journal, &info);
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
 		  err, info.start_transaction, info.end_transaction);
 	jbd_debug(1, "JBD2: Replayed %d and revoked %d/%d blocks\n",
 		  info.nr_replays, info.nr_revoke_hits, info.nr_revokes);
+	jbd_debug(1, "JBD2: Replayed %d fast commit records\n",
+		  info.nr_fc_replays);
 
 	/* Restart the log at the next transaction ID, thus invalidating
 	 * any existing commit records in the log. */
@@ -275,7 +275,7 @@ void ubifs_dump_inode(struct ubifs_info *c, const struct inode *inode)
 		return;
 
 	pr_err("List of directory entries:\n");
-	ubifs_assert(!mutex_is_locked(&c->tnc_mutex));
+	ubifs_assert(!rwsem_is_locked(&c->tnc_sem));
 
 	lowest_dent_key(c, &key, inode->i_ino);
 	while (1) {
@@ -1296,7 +1296,7 @@ static int dbg_check_znode(struct ubifs_info *c, struct ubifs_zbranch *zbr)
 		if (zp && !ubifs_zn_dirty(zp)) {
 			/*
 			 * The dirty flag is atomic and is cleared outside the
-			 * TNC mutex, so znode's dirty flag may now have
+			 * TNC lock, so znode's dirty flag may now have
 			 * been cleared. The child is always cleared before the
 			 * parent, so we just need to check again.
 			 */
@@ -1473,7 +1473,7 @@ int dbg_check_tnc(struct ubifs_info *c, int extra)
 	if (!dbg_is_chk_index(c))
 		return 0;
 
-	ubifs_assert(mutex_is_locked(&c->tnc_mutex));
+	ubifs_assert(rwsem_is_locked(&c->tnc_sem));
 	if (!c->zroot.znode)
 		return 0;
 
@@ -1565,7 +1565,7 @@ int dbg_walk_index(struct ubifs_info *c, dbg_leaf_callback leaf_cb,
 	struct ubifs_zbranch *zbr;
 	struct ubifs_znode *znode, *child;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	/* If the root indexing node is not in TNC - pull it */
 	if (!c->zroot.znode) {
 		c->zroot.znode = ubifs_load_znode(c, &c->zroot, NULL, 0);
@@ -1665,7 +1665,7 @@ int dbg_walk_index(struct ubifs_info *c, dbg_leaf_callback leaf_cb,
 		}
 	}
 
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return 0;
 
 out_dump:
@@ -1676,7 +1676,7 @@ out_dump:
 	ubifs_msg("dump of znode at LEB %d:%d", zbr->lnum, zbr->offs);
 	ubifs_dump_znode(c, znode);
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2755,9 +2755,9 @@ static ssize_t dfs_file_write(struct file *file, const char __user *u,
 		return count;
 	}
 	if (file->f_path.dentry == d->dfs_dump_tnc) {
-		mutex_lock(&c->tnc_mutex);
+		down_write(&c->tnc_sem);
 		ubifs_dump_tnc(c);
-		mutex_unlock(&c->tnc_mutex);
+		up_write(&c->tnc_sem);
 		return count;
 	}
 
@@ -702,6 +702,108 @@ out_err:
 	return -EINVAL;
 }
 
+/**
+ * struct bu_page - a page populated by a bulk-read worker.
+ * @work: decompression work
+ * @c: UBIFS file-system description object
+ * @bu: bulk-read information
+ * @page: locked page to populate
+ * @n: first zbranch slot which may belong to @page
+ * @err: populate_page() result
+ */
+struct bu_page {
+	struct work_struct work;
+	struct ubifs_info *c;
+	struct bu_info *bu;
+	struct page *page;
+	int n;
+	int err;
+};
+
+static void bu_page_work(struct work_struct *work)
+{
+	struct bu_page *bp = container_of(work, struct bu_page, work);
+
+	bp->err = populate_page(bp->c, bp->page, bp->bu, &bp->n);
+}
+
+/**
+ * bulk_read_parallel - populate bulk-read pages on all CPUs.
+ * @c: UBIFS file-system description object
+ * @bu: bulk-read information
+ * @mapping: address space of the file
+ * @offset: index of the first page of the bulk-read
+ * @page_cnt: number of pages covered by the bulk-read
+ * @end_index: index of the last page of the file
+ *
+ * Decompressing the data nodes is what dominates a bulk-read of a compressed
+ * file once they are in memory, so the pages after the first one are handed
+ * to unbound workers and decompressed concurrently. Each page finds its own
+ * data nodes, starting from the first zbranch slot not covered by the
+ * previous pages. The workers use @bu, so this function waits for all of
+ * them before it returns. It returns the number of pages processed
+ * (including the first one), or %0 if the pages have to be populated one by
+ * one instead.
+ */
+static int bulk_read_parallel(struct ubifs_info *c, struct bu_info *bu,
+			      struct address_space *mapping, pgoff_t offset,
+			      int page_cnt, pgoff_t end_index)
+{
+	struct ubifs_data_node *dn = bu->buf;
+	struct bu_page *bp;
+	int page_idx, i, cnt = 0, n = 0, err = 0;
+	unsigned int page_block;
+
+	if (page_cnt < 3 || num_online_cpus() < 2 || !bu->cnt ||
+	    le16_to_cpu(dn->compr_type) == UBIFS_COMPR_NONE)
+		return 0;
+
+	bp = kcalloc(page_cnt, sizeof(struct bu_page), GFP_NOFS | __GFP_NOWARN);
+	if (!bp)
+		return 0;
+
+	for (page_idx = 1; page_idx < page_cnt; page_idx++) {
+		pgoff_t page_offset = offset + page_idx;
+		struct page *page;
+
+		if (page_offset > end_index)
+			break;
+		page = find_or_create_page(mapping, page_offset,
+					   GFP_NOFS | __GFP_COLD);
+		if (!page)
+			break;
+
+		page_block = page_offset << UBIFS_BLOCKS_PER_PAGE_SHIFT;
+		while (n < bu->cnt &&
+		       key_block(c, &bu->zbranch[n].key) < page_block)
+			n += 1;
+
+		bp[cnt].c = c;
+		bp[cnt].bu = bu;
+		bp[cnt].page = page;
+		bp[cnt].n = n;
+		if (!PageUptodate(page)) {
+			INIT_WORK(&bp[cnt].work, bu_page_work);
+			queue_work(system_unbound_wq, &bp[cnt].work);
+		}
+		cnt += 1;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (bp[i].work.func)
+			flush_work(&bp[i].work);
+		if (bp[i].err)
+			err = bp[i].err;
+		unlock_page(bp[i].page);
+		page_cache_release(bp[i].page);
+	}
+	kfree(bp);
+
+	if (err)
+		ubifs_warn("ignoring error %d in bulk-read", err);
+	return page_idx;
+}
+
 /**
  * ubifs_do_bulk_read - do bulk-read.
  * @c: UBIFS file-system description object
@@ -775,6 +877,11 @@ static int ubifs_do_bulk_read(struct ubifs_info *c, struct bu_info *bu,
 		goto out_free;
 	end_index = ((isize - 1) >> PAGE_CACHE_SHIFT);
 
+	page_idx = bulk_read_parallel(c, bu, mapping, offset, page_cnt,
+				      end_index);
+	if (page_idx)
+		goto out_last;
+
 	for (page_idx = 1; page_idx < page_cnt; page_idx++) {
 		pgoff_t page_offset = offset + page_idx;
 		struct page *page;
@@ -793,6 +900,7 @@ static int ubifs_do_bulk_read(struct ubifs_info *c, struct bu_info *bu,
 			break;
 	}
 
+out_last:
 	ui->last_page_read = offset + page_idx - 1;
 
 out_free:
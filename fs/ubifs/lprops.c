@@ -1261,7 +1261,7 @@ out:
  * and other negative error codes in case of other errors. This function is
  * called while the file system is locked (because of commit start), so no
  * additional locking is required. Note that locking the LPT mutex would cause
- * a circular lock dependency with the TNC mutex.
+ * a circular lock dependency with the TNC lock.
  */
 int dbg_check_lprops(struct ubifs_info *c)
 {
@@ -307,7 +307,7 @@ static struct ubifs_znode *dirty_cow_znode(struct ubifs_info *c,
  * Note, this function does not add the @node object to LNC directly, but
  * allocates a copy of the object and adds the copy to LNC. The reason for this
  * is that @node has been allocated outside of the TNC subsystem and will be
- * used with @c->tnc_mutex unlock upon return from the TNC subsystem. But LNC
+ * used with @c->tnc_sem unlock upon return from the TNC subsystem. But LNC
  * may be changed at any time, e.g. freed by the shrinker.
  */
 static int lnc_add(struct ubifs_info *c, struct ubifs_zbranch *zbr,
@@ -1431,11 +1431,19 @@ int ubifs_tnc_locate(struct ubifs_info *c, const union ubifs_key *key,
 		     void *node, int *lnum, int *offs)
 {
 	int found, n, err, safely = 0, gc_seq1;
+	int shared = !is_hash_key(c, key);
 	struct ubifs_znode *znode;
 	struct ubifs_zbranch zbr, *zt;
 
+	/*
+	 * Only the leaf node cache needs the TNC exclusively, so lookups of
+	 * keys which do not use it may run concurrently.
+	 */
 again:
-	mutex_lock(&c->tnc_mutex);
+	if (shared)
+		down_read(&c->tnc_sem);
+	else
+		down_write(&c->tnc_sem);
 	found = ubifs_lookup_level0(c, key, &znode, &n);
 	if (!found) {
 		err = -ENOENT;
@@ -1449,10 +1457,10 @@ again:
 		*lnum = zt->lnum;
 		*offs = zt->offs;
 	}
-	if (is_hash_key(c, key)) {
+	if (!shared) {
 		/*
 		 * In this case the leaf node cache gets used, so we pass the
-		 * address of the zbranch and keep the mutex locked
+		 * address of the zbranch and keep the TNC locked
 		 */
 		err = tnc_read_node_nm(c, zt, node);
 		goto out;
@@ -1461,10 +1469,10 @@ again:
 		err = ubifs_tnc_read_node(c, zt, node);
 		goto out;
 	}
-	/* Drop the TNC mutex prematurely and race with garbage collection */
+	/* Drop the TNC lock prematurely and race with garbage collection */
 	zbr = znode->zbranch[n];
 	gc_seq1 = c->gc_seq;
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 
 	if (ubifs_get_wbuf(c, zbr.lnum)) {
 		/* We do not GC journal heads */
@@ -1476,7 +1484,7 @@ again:
 	if (err <= 0 || maybe_leb_gced(c, zbr.lnum, gc_seq1)) {
 		/*
 		 * The node may have been GC'ed out from under us so try again
-		 * while keeping the TNC mutex locked.
+		 * while keeping the TNC locked.
 		 */
 		safely = 1;
 		goto again;
@@ -1484,7 +1492,10 @@ again:
 	return 0;
 
 out:
-	mutex_unlock(&c->tnc_mutex);
+	if (shared)
+		up_read(&c->tnc_sem);
+	else
+		up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -1512,7 +1523,7 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 	bu->blk_cnt = 0;
 	bu->eof = 0;
 
-	mutex_lock(&c->tnc_mutex);
+	down_read(&c->tnc_sem);
 	/* Find first key */
 	err = ubifs_lookup_level0(c, &bu->key, &znode, &n);
 	if (err < 0)
@@ -1591,7 +1602,7 @@ out:
 		err = 0;
 	}
 	bu->gc_seq = c->gc_seq;
-	mutex_unlock(&c->tnc_mutex);
+	up_read(&c->tnc_sem);
 	if (err)
 		return err;
 	/*
@@ -1796,7 +1807,7 @@ static int do_lookup_nm(struct ubifs_info *c, const union ubifs_key *key,
 	struct ubifs_znode *znode;
 
 	dbg_tnck(key, "name '%.*s' key ", nm->len, nm->name);
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	found = ubifs_lookup_level0(c, key, &znode, &n);
 	if (!found) {
 		err = -ENOENT;
@@ -1820,7 +1831,7 @@ static int do_lookup_nm(struct ubifs_info *c, const union ubifs_key *key,
 	err = tnc_read_node_nm(c, &znode->zbranch[n], node);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2153,7 +2164,7 @@ int ubifs_tnc_add(struct ubifs_info *c, const union ubifs_key *key, int lnum,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnck(key, "%d:%d, len %d, key ", lnum, offs, len);
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (!found) {
@@ -2177,7 +2188,7 @@ int ubifs_tnc_add(struct ubifs_info *c, const union ubifs_key *key, int lnum,
 		err = found;
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 
 	return err;
 }
@@ -2202,7 +2213,7 @@ int ubifs_tnc_replace(struct ubifs_info *c, const union ubifs_key *key,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnck(key, "old LEB %d:%d, new LEB %d:%d, len %d, key ", old_lnum,
 		 old_offs, lnum, offs, len);
 	found = lookup_level0_dirty(c, key, &znode, &n);
@@ -2263,7 +2274,7 @@ int ubifs_tnc_replace(struct ubifs_info *c, const union ubifs_key *key,
 		err = dbg_check_tnc(c, 0);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2285,7 +2296,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnck(key, "LEB %d:%d, name '%.*s', key ",
 		 lnum, offs, nm->len, nm->name);
 	found = lookup_level0_dirty(c, key, &znode, &n);
@@ -2348,7 +2359,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 			struct qstr noname = { .name = "" };
 
 			err = dbg_check_tnc(c, 0);
-			mutex_unlock(&c->tnc_mutex);
+			up_write(&c->tnc_sem);
 			if (err)
 				return err;
 			return ubifs_tnc_remove_nm(c, key, &noname);
@@ -2358,7 +2369,7 @@ int ubifs_tnc_add_nm(struct ubifs_info *c, const union ubifs_key *key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2489,7 +2500,7 @@ int ubifs_tnc_remove(struct ubifs_info *c, const union ubifs_key *key)
 	int found, n, err = 0;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnck(key, "key ");
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (found < 0) {
@@ -2502,7 +2513,7 @@ int ubifs_tnc_remove(struct ubifs_info *c, const union ubifs_key *key)
 		err = dbg_check_tnc(c, 0);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2520,7 +2531,7 @@ int ubifs_tnc_remove_nm(struct ubifs_info *c, const union ubifs_key *key,
 	int n, err;
 	struct ubifs_znode *znode;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	dbg_tnck(key, "%.*s, key ", nm->len, nm->name);
 	err = lookup_level0_dirty(c, key, &znode, &n);
 	if (err < 0)
@@ -2551,7 +2562,7 @@ int ubifs_tnc_remove_nm(struct ubifs_info *c, const union ubifs_key *key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2591,7 +2602,7 @@ int ubifs_tnc_remove_range(struct ubifs_info *c, union ubifs_key *from_key,
 	struct ubifs_znode *znode;
 	union ubifs_key *key;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	while (1) {
 		/* Find first level 0 znode that contains keys to remove */
 		err = ubifs_lookup_level0(c, from_key, &znode, &n);
@@ -2653,7 +2664,7 @@ int ubifs_tnc_remove_range(struct ubifs_info *c, union ubifs_key *from_key,
 out_unlock:
 	if (!err)
 		err = dbg_check_tnc(c, 0);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -2759,7 +2770,7 @@ struct ubifs_dent_node *ubifs_tnc_next_ent(struct ubifs_info *c,
 	dbg_tnck(key, "%s ", nm->name ? (char *)nm->name : "(lowest)");
 	ubifs_assert(is_hash_key(c, key));
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	err = ubifs_lookup_level0(c, key, &znode, &n);
 	if (unlikely(err < 0))
 		goto out_unlock;
@@ -2818,13 +2829,13 @@ struct ubifs_dent_node *ubifs_tnc_next_ent(struct ubifs_info *c,
 	if (unlikely(err))
 		goto out_free;
 
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return dent;
 
 out_free:
 	kfree(dent);
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return ERR_PTR(err);
 }
 
@@ -3199,7 +3210,7 @@ int ubifs_tnc_has_node(struct ubifs_info *c, union ubifs_key *key, int level,
 {
 	int err;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	if (is_idx) {
 		err = is_idx_node_in_tnc(c, key, level, lnum, offs);
 		if (err < 0)
@@ -3216,7 +3227,7 @@ int ubifs_tnc_has_node(struct ubifs_info *c, union ubifs_key *key, int level,
 		err = is_leaf_node_in_tnc(c, key, lnum, offs);
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -3240,7 +3251,7 @@ int ubifs_dirty_idx_node(struct ubifs_info *c, union ubifs_key *key, int level,
 	struct ubifs_znode *znode;
 	int err = 0;
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	znode = lookup_znode(c, key, level, lnum, offs);
 	if (!znode)
 		goto out_unlock;
@@ -3255,7 +3266,7 @@ int ubifs_dirty_idx_node(struct ubifs_info *c, union ubifs_key *key, int level,
 	}
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
 
@@ -3287,7 +3298,7 @@ int dbg_check_inode_size(struct ubifs_info *c, const struct inode *inode,
 	data_key_init(c, &from_key, inode->i_ino, block);
 	highest_data_key(c, &to_key, inode->i_ino);
 
-	mutex_lock(&c->tnc_mutex);
+	down_write(&c->tnc_sem);
 	err = ubifs_lookup_level0(c, &from_key, &znode, &n);
 	if (err < 0)
 		goto out_unlock;
@@ -3316,12 +3327,12 @@ out_dump:
 	ubifs_err("inode %lu has size %lld, but there are data at offset %lld",
 		  (unsigned long)inode->i_ino, size,
 		  ((loff_t)block) << UBIFS_BLOCK_SHIFT);
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	ubifs_dump_inode(c, inode);
 	dump_stack();
 	return -EINVAL;
 
 out_unlock:
-	mutex_unlock(&c->tnc_mutex);
+	up_write(&c->tnc_sem);
 	return err;
 }
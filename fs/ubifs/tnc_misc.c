@@ -402,6 +402,10 @@ out_dump:
  * This function loads znode pointed to by @zbr into the TNC cache and
  * returns pointer to it in case of success and a negative error code in case
  * of failure.
+ *
+ * Lookups holding @c->tnc_sem for reading may race to load the same znode,
+ * so loading is serialized by @c->tnc_load_mutex and the znode is returned
+ * if somebody else has loaded it meanwhile.
  */
 struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 				     struct ubifs_zbranch *zbr,
@@ -410,14 +414,22 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 	int err;
 	struct ubifs_znode *znode;
 
-	ubifs_assert(!zbr->znode);
+	mutex_lock(&c->tnc_load_mutex);
+	if (zbr->znode) {
+		znode = zbr->znode;
+		mutex_unlock(&c->tnc_load_mutex);
+		return znode;
+	}
+
 	/*
 	 * A slab cache is not presently used for znodes because the znode size
 	 * depends on the fanout which is stored in the superblock.
 	 */
 	znode = kzalloc(c->max_znode_sz, GFP_NOFS);
-	if (!znode)
+	if (!znode) {
+		mutex_unlock(&c->tnc_load_mutex);
 		return ERR_PTR(-ENOMEM);
+	}
 
 	err = read_znode(c, zbr->lnum, zbr->offs, zbr->len, znode);
 	if (err)
@@ -433,14 +445,19 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 	 */
 	atomic_long_inc(&ubifs_clean_zn_cnt);
 
-	zbr->znode = znode;
 	znode->parent = parent;
 	znode->time = get_seconds();
 	znode->iip = iip;
 
+	/* Lookups walk the tree without @c->tnc_load_mutex */
+	smp_wmb();
+	zbr->znode = znode;
+	mutex_unlock(&c->tnc_load_mutex);
+
 	return znode;
 
 out:
+	mutex_unlock(&c->tnc_load_mutex);
 	kfree(znode);
 	return ERR_PTR(err);
 }
@@ -332,12 +332,19 @@ enum {
  * UBIFS_COMPR_NONE: no compression
  * UBIFS_COMPR_LZO: LZO compression
  * UBIFS_COMPR_ZLIB: ZLIB compression
+ * UBIFS_COMPR_ZSTD: ZSTD compression, reserved, not supported
+ * UBIFS_COMPR_LZ4: LZ4 compression
  * UBIFS_COMPR_TYPES_CNT: count of supported compression types
+ *
+ * The values are stored on the media. 3 is ZSTD in other UBIFS
+ * implementations; it is only known here so such nodes are refused.
  */
 enum {
 	UBIFS_COMPR_NONE,
 	UBIFS_COMPR_LZO,
 	UBIFS_COMPR_ZLIB,
+	UBIFS_COMPR_ZSTD,
+	UBIFS_COMPR_LZ4,
 	UBIFS_COMPR_TYPES_CNT,
 };
 
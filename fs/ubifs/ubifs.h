@@ -400,7 +400,7 @@ struct ubifs_inode {
 	unsigned int dirty:1;
 	unsigned int xattr:1;
 	unsigned int bulk_read:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
 	struct mutex ui_mutex;
 	spinlock_t ui_lock;
 	loff_t synced_i_size;
@@ -936,7 +936,7 @@ struct ubifs_mount_opts {
 	unsigned int bulk_read:2;
 	unsigned int chk_data_crc:2;
 	unsigned int override_compr:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
 };
 
 /**
@@ -1023,8 +1023,11 @@ struct ubifs_debug_info;
  * @default_compr: default compression algorithm (%UBIFS_COMPR_LZO, etc)
  * @rw_incompat: the media is not R/W compatible
  *
- * @tnc_mutex: protects the Tree Node Cache (TNC), @zroot, @cnext, @enext, and
- *             @calc_idx_sz
+ * @tnc_sem: protects the Tree Node Cache (TNC), @zroot, @cnext, @enext, and
+ *           @calc_idx_sz; lookups which do not use the leaf node cache hold it
+ *           for reading, everything else for writing
+ * @tnc_load_mutex: serializes loading of znodes by lookups which hold
+ *                  @tnc_sem for reading
  * @zroot: zbranch which points to the root index node and znode
  * @cnext: next znode to commit
  * @enext: next znode to commit to empty space
@@ -1261,10 +1264,11 @@ struct ubifs_info {
 	unsigned int space_fixup:1;
 	unsigned int no_chk_data_crc:1;
 	unsigned int bulk_read:1;
-	unsigned int default_compr:2;
+	unsigned int default_compr:3;
 	unsigned int rw_incompat:1;
 
-	struct mutex tnc_mutex;
+	struct rw_semaphore tnc_sem;
+	struct mutex tnc_load_mutex;
 	struct ubifs_zbranch zroot;
 	struct ubifs_znode *cnext;
 	struct ubifs_znode *enext;
@@ -140,6 +140,7 @@
 #define UART011_IFLS_RX4_8	(2 << 3)
 #define UART011_IFLS_RX6_8	(3 << 3)
 #define UART011_IFLS_RX7_8	(4 << 3)
+#define UART011_IFLS_RX_MASK	(7 << 3)
 #define UART011_IFLS_TX1_8	(0 << 0)
 #define UART011_IFLS_TX2_8	(1 << 0)
 #define UART011_IFLS_TX4_8	(2 << 0)
@@ -206,6 +207,9 @@ struct amba_pl011_data {
 	bool dma_rx_poll_enable;
 	unsigned int dma_rx_poll_rate;
 	unsigned int dma_rx_poll_timeout;
+	bool dma_rx_cyclic;
+	unsigned int dma_width;	/* bytes per DR access, 1 (default) or 4 */
+	dma_addr_t dma_dr_addr;	/* DR as the DMA engine sees it, 0 for mapbase */
         void (*init) (void);
 	void (*exit) (void);
 };
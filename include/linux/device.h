@@ -710,6 +710,11 @@ struct acpi_dev_node {
  *
  * @offline_disabled: If set, the device is permanently online.
  * @offline:	Set after successful invocation of bus type's .offline().
+ * @async_probe: If set, the device is probed asynchronously when its driver
+ *		registers, concurrently with other such devices.
+ * @probe_after: Optional NULL terminated array of devices whose pending
+ *		asynchronous probes have to finish before this device's
+ *		asynchronous probe starts.
  *
  * At the lowest level, every device in a Linux system is represented by an
  * instance of struct device. The device structure contains the information
@@ -785,6 +790,8 @@ struct device {
 
 	bool			offline_disabled:1;
 	bool			offline:1;
+	bool			async_probe:1;
+	struct device		**probe_after;
 };
 
 static inline struct device *kobj_to_dev(struct kobject *kobj)
@@ -19,6 +19,7 @@
 
 #if defined(CONFIG_TUN) || defined(CONFIG_TUN_MODULE)
 struct socket *tun_get_socket(struct file *);
+void tun_rx_flush(struct socket *sock);
 #else
 #include <linux/err.h>
 #include <linux/errno.h>
@@ -28,5 +29,8 @@ static inline struct socket *tun_get_socket(struct file *f)
 {
 	return ERR_PTR(-EINVAL);
 }
+static inline void tun_rx_flush(struct socket *sock)
+{
+}
 #endif /* CONFIG_TUN */
 #endif /* __IF_TUN_H */
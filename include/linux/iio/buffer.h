@@ -11,11 +11,13 @@
 #define _IIO_BUFFER_GENERIC_H_
 #include <linux/sysfs.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/buffer_block.h>
 #include <linux/kref.h>
 
 #ifdef CONFIG_IIO_BUFFER
 
 struct iio_buffer;
+struct vm_area_struct;
 
 /**
  * struct iio_buffer_access_funcs - access functions for buffers.
@@ -31,6 +33,14 @@ struct iio_buffer;
  * @set_length:		set number of datums in buffer
  * @release:		called when the last reference to the buffer is dropped,
  *			should free all resources allocated by the buffer.
+ * @alloc_blocks:	allocate blocks to be mapped to userspace, switching the
+ *			buffer from read() to block access.
+ * @free_blocks:	free the blocks, switching back to read() access.
+ * @query_block:	fill in the descriptor of the block with the given id.
+ * @enqueue_block:	hand a block to the buffer to be filled.
+ * @dequeue_block:	take the oldest filled block from the buffer, or return
+ *			-EAGAIN if there is none.
+ * @mmap:		map a block into userspace.
  *
  * The purpose of this structure is to make the buffer element
  * modular as event for a given driver, different usecases may require
@@ -55,6 +65,17 @@ struct iio_buffer_access_funcs {
 	int (*set_length)(struct iio_buffer *buffer, int length);
 
 	void (*release)(struct iio_buffer *buffer);
+
+	int (*alloc_blocks)(struct iio_buffer *buffer,
+			    struct iio_buffer_block_alloc_req *req);
+	int (*free_blocks)(struct iio_buffer *buffer);
+	int (*query_block)(struct iio_buffer *buffer,
+			   struct iio_buffer_block *block);
+	int (*enqueue_block)(struct iio_buffer *buffer,
+			     struct iio_buffer_block *block);
+	int (*dequeue_block)(struct iio_buffer *buffer,
+			     struct iio_buffer_block *block);
+	int (*mmap)(struct iio_buffer *buffer, struct vm_area_struct *vma);
 };
 
 /**
@@ -0,0 +1,55 @@
+/* The industrial I/O - block buffer interface to userspace
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+#ifndef _IIO_BUFFER_BLOCK_H_
+#define _IIO_BUFFER_BLOCK_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct iio_buffer_block_alloc_req - request to allocate buffer blocks
+ * @size:	size of each block in bytes, rounded up to a page by the kernel
+ * @count:	number of blocks wanted; on return the number allocated
+ *
+ * Blocks are numbered from 0 to count - 1, in the order of their offsets.
+ */
+struct iio_buffer_block_alloc_req {
+	__u32	size;
+	__u32	count;
+};
+
+/* The timestamp of the block is valid */
+#define IIO_BUFFER_BLOCK_FLAG_TIMESTAMP_VALID	(1 << 0)
+
+/**
+ * struct iio_buffer_block - descriptor of a buffer block
+ * @id:		number of the block
+ * @size:	size of the block in bytes
+ * @bytes_used:	number of bytes of sample data in a dequeued block
+ * @flags:	IIO_BUFFER_BLOCK_FLAG_* of a dequeued block
+ * @offset:	offset to pass to mmap() to map the block
+ * @reserved:	must be zero
+ * @timestamp:	time the last sample in a dequeued block was captured
+ */
+struct iio_buffer_block {
+	__u32	id;
+	__u32	size;
+	__u32	bytes_used;
+	__u32	flags;
+	__u32	offset;
+	__u32	reserved;
+	__s64	timestamp;
+};
+
+#define IIO_BUFFER_BLOCK_ALLOC_IOCTL \
+	_IOWR('i', 0xa0, struct iio_buffer_block_alloc_req)
+#define IIO_BUFFER_BLOCK_FREE_IOCTL	_IO('i', 0xa1)
+#define IIO_BUFFER_BLOCK_QUERY_IOCTL	_IOWR('i', 0xa2, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_ENQUEUE_IOCTL	_IOW('i', 0xa3, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_DEQUEUE_IOCTL	_IOR('i', 0xa4, struct iio_buffer_block)
+
+#endif
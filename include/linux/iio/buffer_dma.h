@@ -0,0 +1,148 @@
+/* The industrial I/O core - DMA based block buffer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+#ifndef __LINUX_IIO_BUFFER_DMA_H__
+#define __LINUX_IIO_BUFFER_DMA_H__
+
+#include <linux/list.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/iio/buffer.h>
+
+struct device;
+struct iio_dma_buffer_queue;
+
+/**
+ * enum iio_dma_buffer_block_state - state of a block
+ * @IIO_BLOCK_STATE_DEQUEUED:	idle, or owned by userspace
+ * @IIO_BLOCK_STATE_QUEUED:	waiting for the buffer to be enabled
+ * @IIO_BLOCK_STATE_ACTIVE:	handed to the driver to be filled
+ * @IIO_BLOCK_STATE_DONE:	filled, waiting to be dequeued
+ */
+enum iio_dma_buffer_block_state {
+	IIO_BLOCK_STATE_DEQUEUED,
+	IIO_BLOCK_STATE_QUEUED,
+	IIO_BLOCK_STATE_ACTIVE,
+	IIO_BLOCK_STATE_DONE,
+};
+
+/**
+ * struct iio_dma_buffer_block - block of a DMA buffer
+ * @head:		[INTERN] entry in the queue list the block is on
+ * @size:		[INTERN] size of the block in bytes
+ * @bytes_used:		[DRIVER] bytes of sample data in the block, set by the
+ *			driver before completing it
+ * @timestamp:		[DRIVER] capture time of the last sample in the block,
+ *			or 0 if the driver has none
+ * @vaddr:		[DRIVER] kernel address of the block memory
+ * @phys_addr:		[DRIVER] DMA address of the block memory
+ * @queue:		[DRIVER] queue the block belongs to
+ * @kref:		[INTERN] held by the queue and by each userspace mapping
+ * @id:			[INTERN] index of the block in the queue
+ * @state:		[INTERN] one of enum iio_dma_buffer_block_state
+ */
+struct iio_dma_buffer_block {
+	struct list_head head;
+	size_t size;
+	size_t bytes_used;
+	s64 timestamp;
+	void *vaddr;
+	dma_addr_t phys_addr;
+	struct iio_dma_buffer_queue *queue;
+	struct kref kref;
+	unsigned int id;
+	enum iio_dma_buffer_block_state state;
+};
+
+/**
+ * struct iio_dma_buffer_ops - DMA buffer driver callbacks
+ * @submit:	start filling a block. Called with the queue lock held, in
+ *		the order the blocks were enqueued. The driver completes
+ *		the block with iio_dma_buffer_block_done(), from any
+ *		context.
+ * @abort:	stop the hardware. Once this returns, the driver must not
+ *		complete any more blocks; the ones it still held are
+ *		returned empty.
+ */
+struct iio_dma_buffer_ops {
+	int (*submit)(struct iio_dma_buffer_queue *queue,
+		      struct iio_dma_buffer_block *block);
+	void (*abort)(struct iio_dma_buffer_queue *queue);
+};
+
+/**
+ * struct iio_dma_buffer_queue - DMA buffer
+ * @buffer:		[INTERN] the generic buffer
+ * @dev:		[INTERN] device the block memory is allocated for
+ * @ops:		[INTERN] driver callbacks
+ * @driver_data:	[DRIVER] private data of the driver
+ * @lock:		[INTERN] serializes userspace access and enable/disable
+ * @list_lock:		[INTERN] protects the block lists and states
+ * @incoming:		[INTERN] blocks waiting for the buffer to be enabled
+ * @active:		[INTERN] blocks handed to the driver
+ * @outgoing:		[INTERN] filled blocks
+ * @enabled:		[INTERN] whether blocks are handed to the driver
+ * @mmap_mode:		[INTERN] blocks were allocated by userspace
+ * @blocks:		[INTERN] all blocks of the queue
+ * @num_blocks:		[INTERN] number of entries in @blocks
+ * @block_size:		[INTERN] size of each block
+ * @fileio_block:	[INTERN] block being consumed by read()
+ * @fileio_pos:		[INTERN] read() position in @fileio_block
+ */
+struct iio_dma_buffer_queue {
+	struct iio_buffer buffer;
+	struct device *dev;
+	const struct iio_dma_buffer_ops *ops;
+	void *driver_data;
+
+	struct mutex lock;
+	spinlock_t list_lock;
+	struct list_head incoming;
+	struct list_head active;
+	struct list_head outgoing;
+	bool enabled;
+	bool mmap_mode;
+
+	struct iio_dma_buffer_block **blocks;
+	unsigned int num_blocks;
+	size_t block_size;
+
+	struct iio_dma_buffer_block *fileio_block;
+	size_t fileio_pos;
+};
+
+static inline struct iio_dma_buffer_queue *iio_buffer_to_queue(
+	struct iio_buffer *buffer)
+{
+	return container_of(buffer, struct iio_dma_buffer_queue, buffer);
+}
+
+/**
+ * iio_dma_buffer_allocate() - allocate a DMA buffer
+ * @dev:		device that does the DMA
+ * @ops:		driver callbacks
+ * @driver_data:	stored in the queue for the callbacks
+ *
+ * The buffer is read with read() by default, from blocks the size of a
+ * quarter of the buffer length. Userspace can instead allocate blocks of its
+ * own and mmap() them with the IIO_BUFFER_BLOCK_*_IOCTLs.
+ */
+struct iio_buffer *iio_dma_buffer_allocate(struct device *dev,
+	const struct iio_dma_buffer_ops *ops, void *driver_data);
+void iio_dma_buffer_free(struct iio_buffer *buffer);
+
+/*
+ * To be called from the postenable and predisable setup ops of the driver,
+ * they start and stop handing blocks to the driver.
+ */
+int iio_dma_buffer_enable(struct iio_buffer *buffer);
+int iio_dma_buffer_disable(struct iio_buffer *buffer);
+
+void iio_dma_buffer_block_done(struct iio_dma_buffer_block *block);
+
+#endif
@@ -69,6 +69,7 @@ extern void *jbd2_alloc(size_t size, gfp_t flags);
 extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
+#define JBD2_DEFAULT_FC_BLOCKS	256
 
 #ifdef __KERNEL__
 
@@ -125,6 +126,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -173,6 +175,20 @@ struct commit_header {
 	__be32		h_commit_nsec;
 };
 
+/*
+ * Fast commit block: a self-contained record of client data logged on
+ * behalf of the running transaction h_sequence without committing it.
+ * The fast commit area is a fixed range of s_fc_area_blks blocks at the
+ * end of the journal, filled from its start each time a transaction
+ * commits.  fc_checksum is crc32c(uuid+block) with checksum v2, crc32_be
+ * of the block otherwise, computed with the field itself zeroed.
+ */
+struct jbd2_fc_header {
+	journal_header_t fc_header;
+	__be32		fc_len;		/* Bytes of client data that follow */
+	__be32		fc_checksum;
+};
+
 /*
  * The block tag: used to describe a single buffer in the journal.
  * t_blocknr_high is only used if INCOMPAT_64BIT is set, so this
@@ -260,7 +276,10 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+/* 0x0054 */
+	__u32	s_padding[41];
+/* 0x00F8 */
+	__be32	s_fc_area_blks;		/* Blocks in the fast commit area */
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -284,6 +303,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
+#define JBD2_FEATURE_INCOMPAT_FC_AREA		0x00000040
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
@@ -291,7 +311,8 @@ typedef struct journal_superblock_s
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V2)
+					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
+					JBD2_FEATURE_INCOMPAT_FC_AREA)
 
 #ifdef __KERNEL__
 
@@ -658,6 +679,7 @@ struct transaction_run_stats_s {
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	unsigned long		ts_requested;
+	unsigned long		ts_fast_commits;
 	struct transaction_run_stats_s run;
 };
 
@@ -739,6 +761,11 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_fc_first: The block number of the first block of the fast commit area
+ * @j_fc_blocks: Number of blocks in the fast commit area, zero if none
+ * @j_fc_off: Next free block of the fast commit area
+ * @j_fc_mutex: Serialises fast commits
+ * @j_fc_replay: Client callback replaying fast commit records on recovery
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -971,6 +998,27 @@ struct journal_s
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
+	/*
+	 * Fast commit area: the last j_fc_blocks blocks of the journal,
+	 * beyond j_last.  j_fc_off is the next block to be written for the
+	 * running transaction and drops back to zero whenever a transaction
+	 * commits. [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_blocks;
+	unsigned long		j_fc_off;
+
+	/* Serialises writers of the fast commit area */
+	struct mutex		j_fc_mutex;
+
+	/*
+	 * Called during recovery for each valid fast commit record of the
+	 * transaction following the last one in the log, in the order the
+	 * records were written.
+	 */
+	int			(*j_fc_replay)(journal_t *journal, void *data,
+					       unsigned int len);
+
 	/*
 	 * An opaque pointer to fs-private information.  ext3 puts its
 	 * superblock pointer here
@@ -1026,6 +1074,7 @@ int jbd2_journal_get_log_tail(journal_t *journal, tid_t *tid,
 			      unsigned long *block);
 void __jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
 void jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
+__u32 jbd2_fc_csum(journal_t *journal, void *block);
 
 /* Commit management */
 extern void jbd2_journal_commit_transaction(journal_t *);
@@ -1155,6 +1204,11 @@ extern void	   jbd2_journal_ack_err    (journal_t *);
 extern int	   jbd2_journal_clear_err  (journal_t *);
 extern int	   jbd2_journal_bmap(journal_t *, unsigned long, unsigned long long *);
 extern int	   jbd2_journal_force_commit(journal_t *);
+extern int	   jbd2_fc_init(journal_t *, unsigned long);
+extern int	   jbd2_fc_release(journal_t *);
+extern int	   jbd2_fc_begin_commit(journal_t *, tid_t);
+extern int	   jbd2_fc_write(journal_t *, tid_t, const void *, unsigned int);
+extern void	   jbd2_fc_end_commit(journal_t *);
 extern int	   jbd2_journal_force_commit_nested(journal_t *);
 extern int	   jbd2_journal_file_inode(handle_t *handle, struct jbd2_inode *inode);
 extern int	   jbd2_journal_begin_ordered_truncate(journal_t *journal,
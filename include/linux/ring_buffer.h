@@ -86,6 +86,15 @@ void ring_buffer_discard_commit(struct ring_buffer *buffer,
 struct ring_buffer *
 __ring_buffer_alloc(unsigned long size, unsigned flags, struct lock_class_key *key);
 
+/*
+ * Same as above, but each sub-buffer is (PAGE_SIZE << order) bytes instead
+ * of a single page. Larger sub-buffers allow events bigger than a page and
+ * make writers cross sub-buffer boundaries less often.
+ */
+struct ring_buffer *
+__ring_buffer_alloc_order(unsigned long size, unsigned flags, int order,
+			  struct lock_class_key *key);
+
 /*
  * Because the ring buffer is generic, if other users of the ring buffer get
  * traced by ftrace, it can produce lockdep warnings. We need to keep each
@@ -97,6 +106,12 @@ __ring_buffer_alloc(unsigned long size, unsigned flags, struct lock_class_key *k
 	__ring_buffer_alloc((size), (flags), &__key);	\
 })
 
+#define ring_buffer_alloc_order(size, flags, order)			\
+({									\
+	static struct lock_class_key __key;				\
+	__ring_buffer_alloc_order((size), (flags), (order), &__key);	\
+})
+
 void ring_buffer_wait(struct ring_buffer *buffer, int cpu);
 int ring_buffer_poll_wait(struct ring_buffer *buffer, int cpu,
 			  struct file *filp, poll_table *poll_table);
@@ -117,6 +132,25 @@ int ring_buffer_unlock_commit(struct ring_buffer *buffer,
 int ring_buffer_write(struct ring_buffer *buffer,
 		      unsigned long length, void *data);
 
+/*
+ * ring_buffer_lock_reserve_batch reserves @nr events back to back with a
+ *   single reservation, and ring_buffer_unlock_commit_batch commits them
+ *   all at once. All events of a batch share the time stamp of the first.
+ *
+ * Example use:
+ *
+ *  if (!ring_buffer_lock_reserve_batch(buffer, lengths, events, nr)) {
+ *    for (i = 0; i < nr; i++)
+ *      fill(ring_buffer_event_data(events[i]));
+ *    ring_buffer_unlock_commit_batch(buffer, events, nr);
+ *  }
+ */
+int ring_buffer_lock_reserve_batch(struct ring_buffer *buffer,
+				   unsigned long *lengths,
+				   struct ring_buffer_event **events, int nr);
+int ring_buffer_unlock_commit_batch(struct ring_buffer *buffer,
+				    struct ring_buffer_event **events, int nr);
+
 struct ring_buffer_event *
 ring_buffer_peek(struct ring_buffer *buffer, int cpu, u64 *ts,
 		 unsigned long *lost_events);
@@ -138,6 +172,8 @@ void ring_buffer_iter_reset(struct ring_buffer_iter *iter);
 int ring_buffer_iter_empty(struct ring_buffer_iter *iter);
 
 unsigned long ring_buffer_size(struct ring_buffer *buffer, int cpu);
+size_t ring_buffer_subbuf_size(struct ring_buffer *buffer);
+unsigned long ring_buffer_max_event_size(struct ring_buffer *buffer);
 
 void ring_buffer_reset_cpu(struct ring_buffer *buffer, int cpu);
 void ring_buffer_reset(struct ring_buffer *buffer);
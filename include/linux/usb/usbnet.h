@@ -35,6 +35,7 @@ struct usbnet {
 	unsigned char		suspend_count;
 	unsigned char		pkt_cnt, pkt_err;
 	unsigned short		rx_qlen, tx_qlen;
+	unsigned short		rx_qlen_max;
 	unsigned		can_dma_sg:1;
 
 	/* i/o info: pipes etc */
@@ -58,11 +59,20 @@ struct usbnet {
 	struct sk_buff_head	txq;
 	struct sk_buff_head	done;
 	struct sk_buff_head	rxq_pause;
+	struct sk_buff_head	rxq_done;	/* for usbnet_poll() */
+	struct sk_buff_head	rxq_pool;	/* recycled rx skbs */
 	struct urb		*interrupt;
 	unsigned		interrupt_count;
 	struct mutex		interrupt_mutex;
 	struct usb_anchor	deferred;
 	struct tasklet_struct	bh;
+	struct napi_struct	napi;
+
+	/* rx traffic since rx_sample_time, for sizing the rx queue */
+	unsigned long		rx_sample_time;
+	unsigned int		rx_sample_bytes;
+	unsigned int		rx_sample_starved;
+	u64			rx_sample_latency;
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -221,6 +231,7 @@ struct skb_data {	/* skb->cb is one of these */
 	struct usbnet		*dev;
 	enum skb_state		state;
 	size_t			length;
+	u64			done_time;	/* rx: queued for usbnet_poll() */
 };
 
 extern int usbnet_open(struct net_device *net);
@@ -39,6 +39,9 @@ struct vringh {
 	/* Last available index we saw (ie. where we're up to). */
 	u16 last_avail_idx;
 
+	/* Avail index the guest published when we last looked. */
+	u16 avail_idx;
+
 	/* Last index we used. */
 	u16 last_used_idx;
 
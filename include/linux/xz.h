@@ -213,6 +213,20 @@ XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max);
  */
 XZ_EXTERN enum xz_ret xz_dec_run(struct xz_dec *s, struct xz_buf *b);
 
+/**
+ * xz_dec_run_parallel() - Run the XZ decoder, possibly on several CPUs
+ * @s:          Decoder state allocated using xz_dec_init()
+ * @b:          Input and output buffers
+ *
+ * Like xz_dec_run(), but in single-call mode and with CONFIG_XZ_DEC_PARALLEL,
+ * LZMA2 streams that reset the dictionary in the middle of a block (as
+ * written by multithreaded encoders) have their independent parts decoded
+ * concurrently on the unbound workqueue. The caller must be able to sleep.
+ * In multi-call mode, or if the stream has nothing to decode in parallel,
+ * this is the same as xz_dec_run().
+ */
+XZ_EXTERN enum xz_ret xz_dec_run_parallel(struct xz_dec *s, struct xz_buf *b);
+
 /**
  * xz_dec_reset() - Reset an already allocated decoder state
  * @s:          Decoder state allocated using xz_dec_init()
@@ -54,6 +54,20 @@ typedef uLong (*check_func) (uLong check, const Byte *buf,
 #define NMAX 5552
 /* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
 
+/*
+ * Architectures can take over the bulk of the checksum, see
+ * <asm/adler32.h>.  Not in the pre-boot decompressors (STATIC), which
+ * only inflate raw deflate streams anyway.
+ */
+#if defined(CONFIG_ZLIB_ADLER32_NEON) && !defined(STATIC)
+#include <asm/adler32.h>
+#else
+static inline uInt arch_adler32(uLong *adler, const Byte *buf, uInt len)
+{
+    return 0;
+}
+#endif
+
 #define DO1(buf,i)  {s1 += buf[i]; s2 += s1;}
 #define DO2(buf,i)  DO1(buf,i); DO1(buf,i+1);
 #define DO4(buf,i)  DO2(buf,i); DO2(buf,i+2);
@@ -79,12 +93,19 @@ static inline uLong zlib_adler32(uLong adler,
 				 const Byte *buf,
 				 uInt len)
 {
-    unsigned long s1 = adler & 0xffff;
-    unsigned long s2 = (adler >> 16) & 0xffff;
+    unsigned long s1;
+    unsigned long s2;
     int k;
 
     if (buf == NULL) return 1L;
 
+    k = arch_adler32(&adler, buf, len);
+    buf += k;
+    len -= k;
+
+    s1 = adler & 0xffff;
+    s2 = (adler >> 16) & 0xffff;
+
     while (len > 0) {
         k = len < NMAX ? len : NMAX;
         len -= k;
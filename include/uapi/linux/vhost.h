@@ -47,6 +47,18 @@ struct vhost_vring_addr {
 	__u64 log_guest_addr;
 };
 
+struct vhost_vring_busyloop_stats {
+	unsigned int index;
+	/* Time in microseconds the worker currently polls for */
+	unsigned int timeout;
+	/* Times the worker polled the ring */
+	__u64 polls;
+	/* Polls that found work */
+	__u64 hits;
+	/* Total time spent polling, in nanoseconds */
+	__u64 poll_ns;
+};
+
 struct vhost_memory_region {
 	__u64 guest_phys_addr;
 	__u64 memory_size; /* bytes */
@@ -113,6 +125,18 @@ struct vhost_memory {
 /* Set eventfd to signal an error */
 #define VHOST_SET_VRING_ERR _IOW(VHOST_VIRTIO, 0x22, struct vhost_vring_file)
 
+/* Limit in microseconds on the time the worker busy polls an empty ring for
+ * new buffers, with guest notifications disabled, before it waits for a
+ * kick. Within the limit the time adapts to how soon buffers show up.
+ * 0 disables polling. */
+#define VHOST_SET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x23,	\
+					      struct vhost_vring_state)
+#define VHOST_GET_VRING_BUSYLOOP_TIMEOUT _IOWR(VHOST_VIRTIO, 0x24,	\
+					       struct vhost_vring_state)
+/* Get the polling statistics of the ring */
+#define VHOST_GET_VRING_BUSYLOOP_STATS _IOWR(VHOST_VIRTIO, 0x25,	\
+					     struct vhost_vring_busyloop_stats)
+
 /* VHOST_NET specific defines */
 
 /* Attach virtio net ring to a raw socket, or tap device.
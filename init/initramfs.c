@@ -18,6 +18,10 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/async.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -421,6 +425,329 @@ static unsigned my_inptr;   /* index of next byte to be processed in inbuf */
 
 #include <linux/decompress/generic.h>
 
+static __initdata bool initramfs_async = true;
+
+static int __init initramfs_async_setup(char *str)
+{
+	strtobool(str, &initramfs_async);
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+/*
+ * Pipelined unpacking
+ *
+ * Each compressed segment is decompressed by a thread of its own, which
+ * queues the output in chunks for the cpio extraction running in the
+ * caller of unpack_to_rootfs().  Extraction stays in archive order, so
+ * later segments still override earlier ones exactly as before.
+ *
+ * Where a segment ends is only known once it has been decompressed, so
+ * the archive is scanned for the magic numbers of compressed streams and
+ * the segments starting there are decompressed ahead on the remaining
+ * CPUs.  Such a segment is used when the previous one turns out to end
+ * at its start; output that does not begin with a cpio header marks a
+ * false match and stops its decompression.
+ */
+
+#define SEG_CHUNK_SIZE	(64 << 10)
+#define SEG_QUEUE_MAX	(1 << 20)	/* queued output of the current segment */
+#define SEG_MAX_AHEAD	32		/* candidate segment starts tracked */
+
+struct seg_chunk {
+	struct list_head list;
+	unsigned len;
+	char data[];
+};
+
+struct seg {
+	struct list_head list;
+	char *start;
+	decompress_fn decompress;
+	const char *compress_name;
+	int pos;			/* input consumed by the decompressor */
+	int res;
+	char *message;
+	unsigned long out;		/* decompressed bytes */
+	unsigned long queued;		/* decompressed bytes not yet extracted */
+	struct list_head chunks;
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	bool active;			/* being extracted */
+	bool rejected;			/* output is not a cpio archive */
+	bool abort;
+	bool finished;
+	struct completion exited;
+	ktime_t begin, end;
+};
+
+static __initdata bool seg_pipeline;
+static __initdata LIST_HEAD(seg_list);
+static __initdata char *seg_base, *seg_end;
+static __initdata char *seg_cand[SEG_MAX_AHEAD];
+static __initdata int seg_nr_cand, seg_next_cand;
+static __initdata int seg_ahead;
+static __initdata unsigned long seg_ahead_max;
+static __initdata int seg_nr;
+
+static int __init seg_flush(void *bufv, unsigned len)
+{
+	struct seg *seg = kthread_data(current);
+	char *buf = bufv;
+	struct seg_chunk *chunk;
+	unsigned done, n;
+
+	if (!seg->out) {
+		spin_lock(&seg->lock);
+		if (!seg->active && memcmp(buf, "0707", min(len, 4U)))
+			seg->rejected = true;
+		spin_unlock(&seg->lock);
+		if (seg->rejected)
+			return -1;
+	}
+
+	for (done = 0; done < len; done += n) {
+		n = min_t(unsigned, len - done, SEG_CHUNK_SIZE);
+		wait_event(seg->wait, seg->abort || seg->queued <
+			   (seg->active ? SEG_QUEUE_MAX : seg_ahead_max));
+		if (seg->abort)
+			return -1;
+		chunk = kmalloc(sizeof(*chunk) + n, GFP_KERNEL);
+		if (!chunk) {
+			if (!seg->message)
+				seg->message = "can't allocate decompression buffer";
+			return -1;
+		}
+		chunk->len = n;
+		memcpy(chunk->data, buf + done, n);
+		spin_lock(&seg->lock);
+		list_add_tail(&chunk->list, &seg->chunks);
+		seg->queued += n;
+		spin_unlock(&seg->lock);
+		wake_up(&seg->wait);
+	}
+	seg->out += len;
+	return len;
+}
+
+static void __init seg_error(char *x)
+{
+	struct seg *seg = kthread_data(current);
+
+	if (!seg->message)
+		seg->message = x;
+}
+
+static int __init seg_decoder(void *data)
+{
+	struct seg *seg = data;
+	int res;
+
+	res = seg->decompress(seg->start, seg_end - seg->start, NULL,
+			      seg_flush, NULL, &seg->pos, seg_error);
+	spin_lock(&seg->lock);
+	seg->res = res;
+	seg->end = ktime_get();
+	seg->finished = true;
+	spin_unlock(&seg->lock);
+	wake_up(&seg->wait);
+	/*
+	 * Once seg->exited completes, unpacking can finish and the init
+	 * sections may be freed, so don't return through __init code.
+	 */
+	complete_and_exit(&seg->exited, 0);
+}
+
+static struct seg * __init seg_start(char *start, bool active)
+{
+	struct task_struct *task;
+	struct seg *seg, *next;
+
+	seg = kzalloc(sizeof(*seg), GFP_KERNEL);
+	if (!seg)
+		return NULL;
+	seg->start = start;
+	seg->decompress = decompress_method(start, seg_end - start,
+					    &seg->compress_name);
+	seg->active = active;
+	INIT_LIST_HEAD(&seg->chunks);
+	spin_lock_init(&seg->lock);
+	init_waitqueue_head(&seg->wait);
+	init_completion(&seg->exited);
+	seg->begin = ktime_get();
+
+	task = kthread_run(seg_decoder, seg, "initramfs/%d", seg_nr);
+	if (IS_ERR(task)) {
+		kfree(seg);
+		return NULL;
+	}
+	seg_nr++;
+
+	/* keep seg_list sorted by start */
+	list_for_each_entry(next, &seg_list, list)
+		if (next->start > start)
+			break;
+	list_add_tail(&seg->list, &next->list);
+	return seg;
+}
+
+static void __init seg_free(struct seg *seg)
+{
+	struct seg_chunk *chunk, *tmp;
+
+	seg->abort = true;
+	wake_up(&seg->wait);
+	wait_for_completion(&seg->exited);
+	list_for_each_entry_safe(chunk, tmp, &seg->chunks, list)
+		kfree(chunk);
+	list_del(&seg->list);
+	kfree(seg);
+}
+
+/* Whether a complete stream header of a configured format starts at p */
+static bool __init seg_magic(const unsigned char *p, unsigned long left)
+{
+	static const unsigned char xz[] = { 0xfd, '7', 'z', 'X', 'Z', 0 };
+	static const unsigned char lzo[] = { 0x89, 'L', 'Z', 'O', 0, '\r', '\n',
+					     0x1a, '\n' };
+	static const unsigned char lz4[] = { 0x02, 0x21, 0x4c, 0x18 };
+	static const unsigned char bzip2[] = { '1', 'A', 'Y', '&', 'S', 'Y' };
+
+	if (left < 10)
+		return false;
+	switch (p[0]) {
+	case 037:
+		/* deflate, no reserved flags */
+		if (p[1] != 0213 || p[2] != 8 || (p[3] & 0xe0))
+			return false;
+		break;
+	case 'B':
+		if (p[1] != 'Z' || p[2] != 'h' || p[3] < '1' || p[3] > '9' ||
+		    memcmp(p + 4, bzip2, sizeof(bzip2)))
+			return false;
+		break;
+	case 0xfd:
+		if (memcmp(p, xz, sizeof(xz)))
+			return false;
+		break;
+	case 0x89:
+		if (memcmp(p, lzo, sizeof(lzo)))
+			return false;
+		break;
+	case 0x02:
+		if (memcmp(p, lz4, sizeof(lz4)))
+			return false;
+		break;
+	default:
+		/* lzma has no magic to speak of, it is never decoded ahead */
+		return false;
+	}
+	return decompress_method(p, left, NULL) != NULL;
+}
+
+static void __init seg_scan(char *buf)
+{
+	unsigned char *p;
+
+	seg_nr_cand = seg_next_cand = 0;
+	for (p = buf; p < (unsigned char *)seg_end; p++) {
+		if (!seg_magic(p, (unsigned char *)seg_end - p))
+			continue;
+		seg_cand[seg_nr_cand++] = (char *)p;
+		if (seg_nr_cand == SEG_MAX_AHEAD)
+			break;
+	}
+}
+
+/* Start decompressing the candidate segments after buf */
+static void __init seg_speculate(char *buf)
+{
+	struct seg *seg;
+	int running = 0;
+
+	list_for_each_entry(seg, &seg_list, list)
+		if (seg->start > buf && !seg->finished)
+			running++;
+	while (running < seg_ahead && seg_next_cand < seg_nr_cand) {
+		char *start = seg_cand[seg_next_cand++];
+
+		if (start <= buf)
+			continue;
+		if (!seg_start(start, false))
+			break;
+		running++;
+	}
+}
+
+/*
+ * Decompress the segment at buf like decompress() would with flush_buffer
+ * as the output callback, but on another CPU.
+ */
+static int __init unpack_segment(char *buf, decompress_fn decompress,
+				 const char *compress_name)
+{
+	struct seg_chunk *chunk;
+	struct seg *seg, *tmp;
+	bool ahead = false;
+	ktime_t begin = ktime_get();
+	int res;
+
+	list_for_each_entry_safe(seg, tmp, &seg_list, list) {
+		if (seg->start > buf)
+			break;
+		if (seg->start == buf) {
+			spin_lock(&seg->lock);
+			if (!seg->rejected)
+				seg->active = ahead = true;
+			spin_unlock(&seg->lock);
+			if (ahead) {
+				wake_up(&seg->wait);
+				break;
+			}
+		}
+		seg_free(seg);
+	}
+	if (!ahead) {
+		seg = seg_start(buf, true);
+		if (!seg)
+			return decompress(buf, seg_end - buf, NULL, flush_buffer,
+					  NULL, &my_inptr, error);
+	}
+	seg_speculate(buf);
+
+	for (;;) {
+		wait_event(seg->wait, !list_empty(&seg->chunks) || seg->finished);
+		spin_lock(&seg->lock);
+		chunk = list_first_entry_or_null(&seg->chunks,
+						 struct seg_chunk, list);
+		if (chunk) {
+			list_del(&chunk->list);
+			seg->queued -= chunk->len;
+		}
+		spin_unlock(&seg->lock);
+		if (!chunk)
+			break;
+		wake_up(&seg->wait);
+		if (flush_buffer(chunk->data, chunk->len) < 0) {
+			seg->abort = true;
+			wake_up(&seg->wait);
+		}
+		kfree(chunk);
+	}
+
+	if (seg->message)
+		error(seg->message);
+	my_inptr = seg->pos;
+	res = seg->res;
+	printk(KERN_INFO "initramfs: %s segment at %ld: %u -> %lu bytes, "
+	       "decompressed in %lld us%s, unpacked after %lld us\n",
+	       compress_name, (long)(buf - seg_base),
+	       my_inptr, seg->out, ktime_us_delta(seg->end, seg->begin),
+	       ahead ? " ahead" : "", ktime_us_delta(ktime_get(), begin));
+	seg_free(seg);
+	return res;
+}
+
 static char * __init unpack_to_rootfs(char *buf, unsigned len)
 {
 	int written, res;
@@ -435,6 +762,22 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 	if (!header_buf || !symlink_buf || !name_buf)
 		panic("can't allocate buffers");
 
+	seg_pipeline = initramfs_async && num_online_cpus() > 1;
+	if (seg_pipeline) {
+		seg_base = buf;
+		seg_end = buf + len;
+		seg_ahead = max(num_online_cpus() - 2, 1U);
+		/* in pages first, bytes may not fit with highmem */
+		seg_ahead_max = totalram_pages / 16 / seg_ahead;
+		if (seg_ahead_max > ULONG_MAX >> PAGE_SHIFT)
+			seg_ahead_max = ULONG_MAX;
+		else
+			seg_ahead_max <<= PAGE_SHIFT;
+		seg_ahead_max = max_t(unsigned long, SEG_QUEUE_MAX,
+				      seg_ahead_max);
+		seg_scan(buf + 1);
+	}
+
 	state = Start;
 	this_header = 0;
 	message = NULL;
@@ -456,8 +799,12 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 		this_header = 0;
 		decompress = decompress_method(buf, len, &compress_name);
 		if (decompress) {
-			res = decompress(buf, len, NULL, flush_buffer, NULL,
-				   &my_inptr, error);
+			if (seg_pipeline)
+				res = unpack_segment(buf, decompress,
+						     compress_name);
+			else
+				res = decompress(buf, len, NULL, flush_buffer,
+						 NULL, &my_inptr, error);
 			if (res)
 				error("decompressor failed");
 		} else if (compress_name) {
@@ -475,6 +822,8 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 		buf += my_inptr;
 		len -= my_inptr;
 	}
+	while (!list_empty(&seg_list))
+		seg_free(list_first_entry(&seg_list, struct seg, list));
 	dir_utime();
 	kfree(name_buf);
 	kfree(symlink_buf);
@@ -579,8 +928,13 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+static async_cookie_t initramfs_cookie;
+static DECLARE_COMPLETION(initramfs_unpacked);
+static __initdata bool initramfs_async_initrd;
+
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
 {
+	ktime_t begin = ktime_get();
 	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
 	if (err)
 		panic("%s", err); /* Failed to decompress INTERNAL initramfs */
@@ -616,12 +970,68 @@ static int __init populate_rootfs(void)
 			printk(KERN_EMERG "Initramfs unpacking failed: %s\n", err);
 		free_initrd();
 #endif
+	}
+	printk(KERN_INFO "initramfs: unpacked in %lld us\n",
+	       ktime_us_delta(ktime_get(), begin));
+	complete_all(&initramfs_unpacked);
+}
+
+/*
+ * Wait until populate_rootfs() has finished unpacking into rootfs.  Called
+ * by everything that looks up files there before init runs: the init
+ * sequence itself, usermode helpers and the firmware loader.  Returns at
+ * once after that, and also before populate_rootfs() has started, when
+ * rootfs has nothing to wait for.
+ */
+void wait_for_initramfs(void)
+{
+	ktime_t begin;
+
+	if (!initramfs_cookie || completion_done(&initramfs_unpacked))
+		return;
+	begin = ktime_get();
+	wait_for_completion(&initramfs_unpacked);
+	printk(KERN_INFO "initramfs: %s waited %lld us for unpacking\n",
+	       current->comm, ktime_us_delta(ktime_get(), begin));
+}
+EXPORT_SYMBOL_GPL(wait_for_initramfs);
+
+static int __init populate_rootfs(void)
+{
+	/*
+	 * Unpack in the background and let the remaining initcalls run
+	 * meanwhile; most of them do not need anything from rootfs.
+	 */
+	if (initramfs_async) {
+		/*
+		 * initramfs_load_default_modules() does what the synchronous
+		 * path does below once kernel_init_freeable() has waited for
+		 * us: usermode helpers must not be waited for from an async
+		 * function.
+		 */
+		initramfs_async_initrd = initrd_start;
+		initramfs_cookie = async_schedule(do_populate_rootfs, NULL);
+	} else {
+		bool have_initrd = initrd_start;
+
+		do_populate_rootfs(NULL, 0);
 		/*
 		 * Try loading default modules from initramfs.  This gives
 		 * us a chance to load before device_initcalls.
 		 */
-		load_default_modules();
+		if (have_initrd)
+			load_default_modules();
 	}
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
+
+/*
+ * Try loading default modules from an initrd that was unpacked in the
+ * background.  Called by kernel_init_freeable() after wait_for_initramfs().
+ */
+void __init initramfs_load_default_modules(void)
+{
+	if (initramfs_async_initrd)
+		load_default_modules();
+}
@@ -909,6 +909,10 @@ static noinline void __init kernel_init_freeable(void)
 
 	do_basic_setup();
 
+	/* The initramfs may still be unpacking in the background */
+	wait_for_initramfs();
+	initramfs_load_default_modules();
+
 	/* Open the /dev/console on the rootfs, this should never fail */
 	if (sys_open((const char __user *) "/dev/console", O_RDWR, 0) < 0)
 		pr_err("Warning: unable to open an initial console.\n");
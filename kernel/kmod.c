@@ -38,6 +38,7 @@
 #include <linux/suspend.h>
 #include <linux/rwsem.h>
 #include <linux/ptrace.h>
+#include <linux/initrd.h>
 #include <linux/async.h>
 #include <asm/uaccess.h>
 
@@ -239,6 +240,8 @@ static int ____call_usermodehelper(void *data)
 
 	commit_creds(new);
 
+	/* During boot the helper may live in the initramfs */
+	wait_for_initramfs();
 	retval = do_execve(getname_kernel(sub_info->path),
 			   (const char __user *const __user *)sub_info->argv,
 			   (const char __user *const __user *)sub_info->envp);
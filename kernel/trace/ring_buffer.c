@@ -356,6 +356,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 order;		/* order of the data page */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -374,6 +375,14 @@ struct buffer_page {
 #define RB_WRITE_MASK		0xfffff
 #define RB_WRITE_INTCNT		(1 << 20)
 
+/*
+ * Writers (and the interrupts nesting on top of them) may push the
+ * write index past the end of a sub-buffer before moving to the next
+ * one. Keep sub-buffers small enough that this never spills into the
+ * updater count.
+ */
+#define RB_MAX_SUBBUF_SIZE	((RB_WRITE_MASK + 1) / 8)
+
 static void rb_init_page(struct buffer_data_page *bpage)
 {
 	local_set(&bpage->commit, 0);
@@ -397,7 +406,7 @@ size_t ring_buffer_page_len(void *page)
  */
 static void free_buffer_page(struct buffer_page *bpage)
 {
-	free_page((unsigned long)bpage->page);
+	free_pages((unsigned long)bpage->page, bpage->order);
 	kfree(bpage);
 }
 
@@ -413,8 +422,11 @@ static inline int test_time_stamp(u64 delta)
 
 #define BUF_PAGE_SIZE (PAGE_SIZE - BUF_PAGE_HDR_SIZE)
 
-/* Max payload is BUF_PAGE_SIZE - header (8bytes) */
-#define BUF_MAX_DATA_SIZE (BUF_PAGE_SIZE - (sizeof(u32) * 2))
+/* Data size of a sub-buffer made of (PAGE_SIZE << order) bytes */
+#define BUF_SUBBUF_SIZE(order) ((PAGE_SIZE << (order)) - BUF_PAGE_HDR_SIZE)
+
+/* Max payload is the sub-buffer data size - header (8bytes) */
+#define BUF_MAX_DATA_SIZE(subbuf_size) ((subbuf_size) - (sizeof(u32) * 2))
 
 int ring_buffer_print_page_header(struct trace_seq *s)
 {
@@ -494,6 +506,9 @@ struct ring_buffer_per_cpu {
 struct ring_buffer {
 	unsigned			flags;
 	int				cpus;
+	unsigned			subbuf_order;
+	unsigned			subbuf_size;	/* data bytes per sub-buffer */
+	unsigned			max_data_size;
 	atomic_t			record_disabled;
 	atomic_t			resize_disabled;
 	cpumask_var_t			cpumask;
@@ -1107,7 +1122,8 @@ static int rb_check_pages(struct ring_buffer_per_cpu *cpu_buffer)
 	return 0;
 }
 
-static int __rb_allocate_pages(int nr_pages, struct list_head *pages, int cpu)
+static int __rb_allocate_pages(int nr_pages, struct list_head *pages, int cpu,
+			       unsigned order)
 {
 	int i;
 	struct buffer_page *bpage, *tmp;
@@ -1127,8 +1143,9 @@ static int __rb_allocate_pages(int nr_pages, struct list_head *pages, int cpu)
 
 		list_add(&bpage->list, pages);
 
+		bpage->order = order;
 		page = alloc_pages_node(cpu_to_node(cpu),
-					GFP_KERNEL | __GFP_NORETRY, 0);
+					GFP_KERNEL | __GFP_NORETRY, order);
 		if (!page)
 			goto free_pages;
 		bpage->page = page_address(page);
@@ -1153,7 +1170,8 @@ static int rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
 
 	WARN_ON(!nr_pages);
 
-	if (__rb_allocate_pages(nr_pages, &pages, cpu_buffer->cpu))
+	if (__rb_allocate_pages(nr_pages, &pages, cpu_buffer->cpu,
+				cpu_buffer->buffer->subbuf_order))
 		return -ENOMEM;
 
 	/*
@@ -1202,7 +1220,8 @@ rb_allocate_cpu_buffer(struct ring_buffer *buffer, int nr_pages, int cpu)
 	rb_check_bpage(cpu_buffer, bpage);
 
 	cpu_buffer->reader_page = bpage;
-	page = alloc_pages_node(cpu_to_node(cpu), GFP_KERNEL, 0);
+	bpage->order = buffer->subbuf_order;
+	page = alloc_pages_node(cpu_to_node(cpu), GFP_KERNEL, bpage->order);
 	if (!page)
 		goto fail_free_reader;
 	bpage->page = page_address(page);
@@ -1258,22 +1277,31 @@ static int rb_cpu_notify(struct notifier_block *self,
 #endif
 
 /**
- * __ring_buffer_alloc - allocate a new ring_buffer
+ * __ring_buffer_alloc_order - allocate a new ring_buffer
  * @size: the size in bytes per cpu that is needed.
  * @flags: attributes to set for the ring buffer.
+ * @order: each sub-buffer is made of 2^order pages.
  *
  * Currently the only flag that is available is the RB_FL_OVERWRITE
  * flag. This flag means that the buffer will overwrite old data
  * when the buffer wraps. If this flag is not set, the buffer will
  * drop data when the tail hits the head.
+ *
+ * Events may be as large as a sub-buffer (minus its header), so an
+ * @order greater than zero allows events bigger than a page.
  */
-struct ring_buffer *__ring_buffer_alloc(unsigned long size, unsigned flags,
-					struct lock_class_key *key)
+struct ring_buffer *__ring_buffer_alloc_order(unsigned long size,
+					      unsigned flags, int order,
+					      struct lock_class_key *key)
 {
 	struct ring_buffer *buffer;
 	int bsize;
 	int cpu, nr_pages;
 
+	if (order < 0 || order >= MAX_ORDER ||
+	    (PAGE_SIZE << order) > RB_MAX_SUBBUF_SIZE)
+		return NULL;
+
 	/* keep it in its own cache line */
 	buffer = kzalloc(ALIGN(sizeof(*buffer), cache_line_size()),
 			 GFP_KERNEL);
@@ -1283,7 +1311,11 @@ struct ring_buffer *__ring_buffer_alloc(unsigned long size, unsigned flags,
 	if (!alloc_cpumask_var(&buffer->cpumask, GFP_KERNEL))
 		goto fail_free_buffer;
 
-	nr_pages = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
+	buffer->subbuf_order = order;
+	buffer->subbuf_size = BUF_SUBBUF_SIZE(order);
+	buffer->max_data_size = BUF_MAX_DATA_SIZE(buffer->subbuf_size);
+
+	nr_pages = DIV_ROUND_UP(size, buffer->subbuf_size);
 	buffer->flags = flags;
 	buffer->clock = trace_clock_local;
 	buffer->reader_lock_key = key;
@@ -1347,6 +1379,21 @@ struct ring_buffer *__ring_buffer_alloc(unsigned long size, unsigned flags,
 	kfree(buffer);
 	return NULL;
 }
+EXPORT_SYMBOL_GPL(__ring_buffer_alloc_order);
+
+/**
+ * __ring_buffer_alloc - allocate a new ring_buffer
+ * @size: the size in bytes per cpu that is needed.
+ * @flags: attributes to set for the ring buffer.
+ *
+ * Allocates a ring buffer made of single page sub-buffers.
+ * See __ring_buffer_alloc_order().
+ */
+struct ring_buffer *__ring_buffer_alloc(unsigned long size, unsigned flags,
+					struct lock_class_key *key)
+{
+	return __ring_buffer_alloc_order(size, flags, 0, key);
+}
 EXPORT_SYMBOL_GPL(__ring_buffer_alloc);
 
 /**
@@ -1487,7 +1534,8 @@ rb_remove_pages(struct ring_buffer_per_cpu *cpu_buffer, unsigned int nr_pages)
 			 * Increment overrun to account for the lost events.
 			 */
 			local_add(page_entries, &cpu_buffer->overrun);
-			local_sub(BUF_PAGE_SIZE, &cpu_buffer->entries_bytes);
+			local_sub(cpu_buffer->buffer->subbuf_size,
+				  &cpu_buffer->entries_bytes);
 		}
 
 		/*
@@ -1609,7 +1657,7 @@ static void update_pages_handler(struct work_struct *work)
  * @size: the new size.
  * @cpu_id: the cpu buffer to resize
  *
- * Minimum size is 2 * BUF_PAGE_SIZE.
+ * Minimum size is two sub-buffers.
  *
  * Returns 0 on success and < 0 on failure.
  */
@@ -1631,14 +1679,14 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	    !cpumask_test_cpu(cpu_id, buffer->cpumask))
 		return size;
 
-	size = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
-	size *= BUF_PAGE_SIZE;
+	size = DIV_ROUND_UP(size, buffer->subbuf_size);
+	size *= buffer->subbuf_size;
 
 	/* we need a minimum of two pages */
-	if (size < BUF_PAGE_SIZE * 2)
-		size = BUF_PAGE_SIZE * 2;
+	if (size < buffer->subbuf_size * 2)
+		size = buffer->subbuf_size * 2;
 
-	nr_pages = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
+	nr_pages = DIV_ROUND_UP(size, buffer->subbuf_size);
 
 	/*
 	 * Don't succeed if resizing is disabled, as a reader might be
@@ -1669,7 +1717,8 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 			 */
 			INIT_LIST_HEAD(&cpu_buffer->new_pages);
 			if (__rb_allocate_pages(cpu_buffer->nr_pages_to_update,
-						&cpu_buffer->new_pages, cpu)) {
+						&cpu_buffer->new_pages, cpu,
+						buffer->subbuf_order)) {
 				/* not enough memory for new pages */
 				err = -ENOMEM;
 				goto out_err;
@@ -1733,7 +1782,8 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 		INIT_LIST_HEAD(&cpu_buffer->new_pages);
 		if (cpu_buffer->nr_pages_to_update > 0 &&
 			__rb_allocate_pages(cpu_buffer->nr_pages_to_update,
-					    &cpu_buffer->new_pages, cpu_id)) {
+					    &cpu_buffer->new_pages, cpu_id,
+					    buffer->subbuf_order)) {
 			err = -ENOMEM;
 			goto out_err;
 		}
@@ -1861,12 +1911,20 @@ rb_commit_index(struct ring_buffer_per_cpu *cpu_buffer)
 	return rb_page_commit(cpu_buffer->commit_page);
 }
 
+/* Mask of the offset within a sub-buffer (sub-buffers are size aligned) */
+static inline unsigned long
+rb_subbuf_mask(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	return (PAGE_SIZE << cpu_buffer->buffer->subbuf_order) - 1;
+}
+
 static inline unsigned
-rb_event_index(struct ring_buffer_event *event)
+rb_event_index(struct ring_buffer_per_cpu *cpu_buffer,
+	       struct ring_buffer_event *event)
 {
 	unsigned long addr = (unsigned long)event;
 
-	return (addr & ~PAGE_MASK) - BUF_PAGE_HDR_SIZE;
+	return (addr & rb_subbuf_mask(cpu_buffer)) - BUF_PAGE_HDR_SIZE;
 }
 
 static inline int
@@ -1876,8 +1934,8 @@ rb_event_is_commit(struct ring_buffer_per_cpu *cpu_buffer,
 	unsigned long addr = (unsigned long)event;
 	unsigned long index;
 
-	index = rb_event_index(event);
-	addr &= PAGE_MASK;
+	index = rb_event_index(cpu_buffer, event);
+	addr &= ~rb_subbuf_mask(cpu_buffer);
 
 	return cpu_buffer->commit_page->page == (void *)addr &&
 		rb_commit_index(cpu_buffer) == index;
@@ -1963,12 +2021,13 @@ static void rb_inc_iter(struct ring_buffer_iter *iter)
 
 /* Slow path, do not inline */
 static noinline struct ring_buffer_event *
-rb_add_time_stamp(struct ring_buffer_event *event, u64 delta)
+rb_add_time_stamp(struct ring_buffer_per_cpu *cpu_buffer,
+		  struct ring_buffer_event *event, u64 delta)
 {
 	event->type_len = RINGBUF_TYPE_TIME_EXTEND;
 
 	/* Not the first event on the page? */
-	if (rb_event_index(event)) {
+	if (rb_event_index(cpu_buffer, event)) {
 		event->time_delta = delta & TS_MASK;
 		event->array[0] = delta >> TS_SHIFT;
 	} else {
@@ -1980,6 +2039,18 @@ rb_add_time_stamp(struct ring_buffer_event *event, u64 delta)
 	return skip_time_extend(event);
 }
 
+/* Encode the size of a data event, @length includes the event header */
+static inline void
+rb_event_set_length(struct ring_buffer_event *event, unsigned length)
+{
+	length -= RB_EVNT_HDR_SIZE;
+	if (length > RB_MAX_SMALL_DATA || RB_FORCE_8BYTE_ALIGNMENT) {
+		event->type_len = 0;
+		event->array[0] = length;
+	} else
+		event->type_len = DIV_ROUND_UP(length, RB_ALIGNMENT);
+}
+
 /**
  * rb_update_event - update event type and data
  * @event: the even to update
@@ -2005,18 +2076,13 @@ rb_update_event(struct ring_buffer_per_cpu *cpu_buffer,
 	 * add it to the start of the resevered space.
 	 */
 	if (unlikely(add_timestamp)) {
-		event = rb_add_time_stamp(event, delta);
+		event = rb_add_time_stamp(cpu_buffer, event, delta);
 		length -= RB_LEN_TIME_EXTEND;
 		delta = 0;
 	}
 
 	event->time_delta = delta;
-	length -= RB_EVNT_HDR_SIZE;
-	if (length > RB_MAX_SMALL_DATA || RB_FORCE_8BYTE_ALIGNMENT) {
-		event->type_len = 0;
-		event->array[0] = length;
-	} else
-		event->type_len = DIV_ROUND_UP(length, RB_ALIGNMENT);
+	rb_event_set_length(event, length);
 }
 
 /*
@@ -2065,7 +2131,8 @@ rb_handle_head_page(struct ring_buffer_per_cpu *cpu_buffer,
 		 * the counters.
 		 */
 		local_add(entries, &cpu_buffer->overrun);
-		local_sub(BUF_PAGE_SIZE, &cpu_buffer->entries_bytes);
+		local_sub(cpu_buffer->buffer->subbuf_size,
+			  &cpu_buffer->entries_bytes);
 
 		/*
 		 * The entries will be zeroed out when we move the
@@ -2199,19 +2266,20 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	      struct buffer_page *tail_page,
 	      unsigned long tail, unsigned long length)
 {
+	unsigned long bsize = cpu_buffer->buffer->subbuf_size;
 	struct ring_buffer_event *event;
 
 	/*
 	 * Only the event that crossed the page boundary
 	 * must fill the old tail_page with padding.
 	 */
-	if (tail >= BUF_PAGE_SIZE) {
+	if (tail >= bsize) {
 		/*
 		 * If the page was filled, then we still need
 		 * to update the real_end. Reset it to zero
 		 * and the reader will ignore it.
 		 */
-		if (tail == BUF_PAGE_SIZE)
+		if (tail == bsize)
 			tail_page->real_end = 0;
 
 		local_sub(length, &tail_page->write);
@@ -2222,7 +2290,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	kmemcheck_annotate_bitfield(event, bitfield);
 
 	/* account for padding bytes */
-	local_add(BUF_PAGE_SIZE - tail, &cpu_buffer->entries_bytes);
+	local_add(bsize - tail, &cpu_buffer->entries_bytes);
 
 	/*
 	 * Save the original length to the meta data.
@@ -2242,7 +2310,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	 * If we are less than the minimum size, we don't need to
 	 * worry about it.
 	 */
-	if (tail > (BUF_PAGE_SIZE - RB_EVNT_MIN_SIZE)) {
+	if (tail > (bsize - RB_EVNT_MIN_SIZE)) {
 		/* No room for any events */
 
 		/* Mark the rest of the page with padding */
@@ -2254,13 +2322,13 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	}
 
 	/* Put in a discarded event */
-	event->array[0] = (BUF_PAGE_SIZE - tail) - RB_EVNT_HDR_SIZE;
+	event->array[0] = (bsize - tail) - RB_EVNT_HDR_SIZE;
 	event->type_len = RINGBUF_TYPE_PADDING;
 	/* time delta must be non zero */
 	event->time_delta = 1;
 
 	/* Set write to end of buffer */
-	length = (tail + length) - BUF_PAGE_SIZE;
+	length = (tail + length) - bsize;
 	local_sub(length, &tail_page->write);
 }
 
@@ -2376,7 +2444,7 @@ rb_move_tail(struct ring_buffer_per_cpu *cpu_buffer,
 static struct ring_buffer_event *
 __rb_reserve_next(struct ring_buffer_per_cpu *cpu_buffer,
 		  unsigned long length, u64 ts,
-		  u64 delta, int add_timestamp)
+		  u64 delta, int add_timestamp, int nr)
 {
 	struct buffer_page *tail_page;
 	struct ring_buffer_event *event;
@@ -2405,7 +2473,7 @@ __rb_reserve_next(struct ring_buffer_per_cpu *cpu_buffer,
 		delta = 0;
 
 	/* See if we shot pass the end of this buffer page */
-	if (unlikely(write > BUF_PAGE_SIZE))
+	if (unlikely(write > cpu_buffer->buffer->subbuf_size))
 		return rb_move_tail(cpu_buffer, length, tail,
 				    tail_page, ts);
 
@@ -2415,7 +2483,7 @@ __rb_reserve_next(struct ring_buffer_per_cpu *cpu_buffer,
 	kmemcheck_annotate_bitfield(event, bitfield);
 	rb_update_event(cpu_buffer, event, length, add_timestamp, delta);
 
-	local_inc(&tail_page->entries);
+	local_add(nr, &tail_page->entries);
 
 	/*
 	 * If this is the first commit on the page, then update
@@ -2439,10 +2507,10 @@ rb_try_to_discard(struct ring_buffer_per_cpu *cpu_buffer,
 	unsigned long index;
 	unsigned long addr;
 
-	new_index = rb_event_index(event);
+	new_index = rb_event_index(cpu_buffer, event);
 	old_index = new_index + rb_event_ts_length(event);
 	addr = (unsigned long)event;
-	addr &= PAGE_MASK;
+	addr &= ~rb_subbuf_mask(cpu_buffer);
 
 	bpage = cpu_buffer->tail_page;
 
@@ -2508,10 +2576,15 @@ static inline void rb_end_commit(struct ring_buffer_per_cpu *cpu_buffer)
 	}
 }
 
+/*
+ * Reserve @length bytes (event headers included) that will hold @nr
+ * events. The space is set up as a single event that the caller
+ * splits up when @nr is greater than one.
+ */
 static struct ring_buffer_event *
-rb_reserve_next_event(struct ring_buffer *buffer,
-		      struct ring_buffer_per_cpu *cpu_buffer,
-		      unsigned long length)
+rb_reserve_next_events(struct ring_buffer *buffer,
+		       struct ring_buffer_per_cpu *cpu_buffer,
+		       unsigned long length, int nr)
 {
 	struct ring_buffer_event *event;
 	u64 ts, delta;
@@ -2536,7 +2609,6 @@ rb_reserve_next_event(struct ring_buffer *buffer,
 	}
 #endif
 
-	length = rb_calculate_event_length(length);
  again:
 	add_timestamp = 0;
 	delta = 0;
@@ -2581,7 +2653,7 @@ rb_reserve_next_event(struct ring_buffer *buffer,
 	}
 
 	event = __rb_reserve_next(cpu_buffer, length, ts,
-				  delta, add_timestamp);
+				  delta, add_timestamp, nr);
 	if (unlikely(PTR_ERR(event) == -EAGAIN))
 		goto again;
 
@@ -2595,6 +2667,15 @@ rb_reserve_next_event(struct ring_buffer *buffer,
 	return NULL;
 }
 
+static inline struct ring_buffer_event *
+rb_reserve_next_event(struct ring_buffer *buffer,
+		      struct ring_buffer_per_cpu *cpu_buffer,
+		      unsigned long length)
+{
+	return rb_reserve_next_events(buffer, cpu_buffer,
+				      rb_calculate_event_length(length), 1);
+}
+
 #ifdef CONFIG_TRACING
 
 /*
@@ -2720,7 +2801,7 @@ ring_buffer_lock_reserve(struct ring_buffer *buffer, unsigned long length)
 	if (atomic_read(&cpu_buffer->record_disabled))
 		goto out;
 
-	if (length > BUF_MAX_DATA_SIZE)
+	if (length > buffer->max_data_size)
 		goto out;
 
 	event = rb_reserve_next_event(buffer, cpu_buffer, length);
@@ -2753,7 +2834,7 @@ rb_update_write_stamp(struct ring_buffer_per_cpu *cpu_buffer,
 		 * A commit event that is first on a page
 		 * updates the write timestamp with the page stamp
 		 */
-		if (!rb_event_index(event))
+		if (!rb_event_index(cpu_buffer, event))
 			cpu_buffer->write_stamp =
 				cpu_buffer->commit_page->page->time_stamp;
 		else if (event->type_len == RINGBUF_TYPE_TIME_EXTEND) {
@@ -2819,6 +2900,140 @@ int ring_buffer_unlock_commit(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_unlock_commit);
 
+/**
+ * ring_buffer_lock_reserve_batch - reserve several events at once
+ * @buffer: the ring buffer to reserve from
+ * @lengths: the length of the data of each event (excluding event header)
+ * @events: filled in with the @nr reserved events
+ * @nr: the number of events to reserve
+ *
+ * This is like calling ring_buffer_lock_reserve() @nr times, except
+ * that the space for all the events is taken with a single reservation,
+ * and the recursion and commit accounting is only done once. This
+ * saves a lot for callers producing bursts of events.
+ *
+ * All the events of a batch are laid out back to back in the same
+ * sub-buffer and share the time stamp of the first one. The events
+ * must not be discarded individually.
+ *
+ * Must be paired with ring_buffer_unlock_commit_batch, unless an
+ * error is returned. On error, nothing has been allocated or locked.
+ *
+ * Returns 0 on success, -EINVAL if the batch does not fit in a
+ * sub-buffer and -EBUSY if the events could not be reserved.
+ */
+int ring_buffer_lock_reserve_batch(struct ring_buffer *buffer,
+				   unsigned long *lengths,
+				   struct ring_buffer_event **events, int nr)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct ring_buffer_event *event;
+	unsigned long total = 0;
+	unsigned length;
+	int cpu;
+	int i;
+
+	if (nr <= 0)
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		if (lengths[i] > buffer->max_data_size)
+			return -EINVAL;
+		total += rb_calculate_event_length(lengths[i]);
+	}
+
+	/* Leave room for a time extend in front of the batch */
+	if (total > buffer->max_data_size)
+		return -EINVAL;
+
+	if (ring_buffer_flags != RB_BUFFERS_ON)
+		return -EBUSY;
+
+	preempt_disable_notrace();
+
+	if (atomic_read(&buffer->record_disabled))
+		goto out_nocheck;
+
+	if (trace_recursive_lock())
+		goto out_nocheck;
+
+	cpu = raw_smp_processor_id();
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		goto out;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	if (atomic_read(&cpu_buffer->record_disabled))
+		goto out;
+
+	event = rb_reserve_next_events(buffer, cpu_buffer, total, nr);
+	if (!event)
+		goto out;
+
+	/*
+	 * The first event (and its time extend, if any) carries the time
+	 * delta, the events following it have a zero delta.
+	 */
+	events[0] = event;
+	if (event->type_len == RINGBUF_TYPE_TIME_EXTEND)
+		event = skip_time_extend(event);
+
+	for (i = 0; i < nr; i++) {
+		length = rb_calculate_event_length(lengths[i]);
+		if (i) {
+			kmemcheck_annotate_bitfield(event, bitfield);
+			event->time_delta = 0;
+			events[i] = event;
+		}
+		rb_event_set_length(event, length);
+		event = (void *)event + length;
+	}
+
+	return 0;
+
+ out:
+	trace_recursive_unlock();
+
+ out_nocheck:
+	preempt_enable_notrace();
+	return -EBUSY;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_lock_reserve_batch);
+
+/**
+ * ring_buffer_unlock_commit_batch - commit a batch of reserved events
+ * @buffer: The buffer to commit to
+ * @events: The events returned by ring_buffer_lock_reserve_batch
+ * @nr: The number of events in the batch
+ *
+ * This commits all the events of the batch to the ring buffer, and
+ * releases any locks held.
+ *
+ * Must be paired with ring_buffer_lock_reserve_batch.
+ */
+int ring_buffer_unlock_commit_batch(struct ring_buffer *buffer,
+				    struct ring_buffer_event **events, int nr)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int cpu = raw_smp_processor_id();
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	/* rb_commit() accounts for the first one */
+	local_add(nr - 1, &cpu_buffer->entries);
+	rb_commit(cpu_buffer, events[0]);
+
+	rb_wakeups(buffer, cpu_buffer);
+
+	trace_recursive_unlock();
+
+	preempt_enable_notrace();
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unlock_commit_batch);
+
 static inline void rb_event_discard(struct ring_buffer_event *event)
 {
 	if (event->type_len == RINGBUF_TYPE_TIME_EXTEND)
@@ -2846,7 +3061,7 @@ rb_decrement_entry(struct ring_buffer_per_cpu *cpu_buffer,
 	struct buffer_page *bpage = cpu_buffer->commit_page;
 	struct buffer_page *start;
 
-	addr &= PAGE_MASK;
+	addr &= ~rb_subbuf_mask(cpu_buffer);
 
 	/* Do the likely case first */
 	if (likely(bpage->page == (void *)addr)) {
@@ -2970,7 +3185,7 @@ int ring_buffer_write(struct ring_buffer *buffer,
 	if (atomic_read(&cpu_buffer->record_disabled))
 		goto out;
 
-	if (length > BUF_MAX_DATA_SIZE)
+	if (length > buffer->max_data_size)
 		goto out;
 
 	event = rb_reserve_next_event(buffer, cpu_buffer, length);
@@ -4113,10 +4328,33 @@ unsigned long ring_buffer_size(struct ring_buffer *buffer, int cpu)
 	if (!cpumask_test_cpu(cpu, buffer->cpumask))
 		return 0;
 
-	return BUF_PAGE_SIZE * buffer->buffers[cpu]->nr_pages;
+	return buffer->subbuf_size * buffer->buffers[cpu]->nr_pages;
 }
 EXPORT_SYMBOL_GPL(ring_buffer_size);
 
+/**
+ * ring_buffer_subbuf_size - return the size of a sub-buffer (in bytes)
+ * @buffer: The ring buffer.
+ *
+ * This is the size of the pages handed out by ring_buffer_alloc_read_page,
+ * header included.
+ */
+size_t ring_buffer_subbuf_size(struct ring_buffer *buffer)
+{
+	return PAGE_SIZE << buffer->subbuf_order;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_subbuf_size);
+
+/**
+ * ring_buffer_max_event_size - return the largest event payload (in bytes)
+ * @buffer: The ring buffer.
+ */
+unsigned long ring_buffer_max_event_size(struct ring_buffer *buffer)
+{
+	return buffer->max_data_size;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_max_event_size);
+
 static void
 rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -4302,6 +4540,9 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	if (buffer_a->subbuf_order != buffer_b->subbuf_order)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (ring_buffer_flags != RB_BUFFERS_ON)
@@ -4356,6 +4597,9 @@ EXPORT_SYMBOL_GPL(ring_buffer_swap_cpu);
  * @buffer: the buffer to allocate for.
  * @cpu: the cpu buffer to allocate.
  *
+ * The page is as big as a sub-buffer of @buffer, see
+ * ring_buffer_subbuf_size().
+ *
  * This function is used in conjunction with ring_buffer_read_page.
  * When reading a full page from the ring buffer, these functions
  * can be used to speed up the process. The calling function should
@@ -4373,7 +4617,8 @@ void *ring_buffer_alloc_read_page(struct ring_buffer *buffer, int cpu)
 	struct page *page;
 
 	page = alloc_pages_node(cpu_to_node(cpu),
-				GFP_KERNEL | __GFP_NORETRY, 0);
+				GFP_KERNEL | __GFP_NORETRY,
+				buffer->subbuf_order);
 	if (!page)
 		return NULL;
 
@@ -4394,7 +4639,7 @@ EXPORT_SYMBOL_GPL(ring_buffer_alloc_read_page);
  */
 void ring_buffer_free_read_page(struct ring_buffer *buffer, void *data)
 {
-	free_page((unsigned long)data);
+	free_pages((unsigned long)data, buffer->subbuf_order);
 }
 EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
 
@@ -4541,7 +4786,7 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	} else {
 		/* update the entry counter */
 		cpu_buffer->read += rb_page_entries(reader);
-		cpu_buffer->read_bytes += BUF_PAGE_SIZE;
+		cpu_buffer->read_bytes += buffer->subbuf_size;
 
 		/* swap the pages */
 		rb_init_page(bpage);
@@ -4572,7 +4817,7 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 		/* If there is room at the end of the page to save the
 		 * missed events, then record it there.
 		 */
-		if (BUF_PAGE_SIZE - commit >= sizeof(missed_events)) {
+		if (buffer->subbuf_size - commit >= sizeof(missed_events)) {
 			memcpy(&bpage->data[commit], &missed_events,
 			       sizeof(missed_events));
 			local_add(RB_MISSED_STORED, &bpage->commit);
@@ -4584,8 +4829,8 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	/*
 	 * This page may be off to user land. Zero it out here.
 	 */
-	if (commit < BUF_PAGE_SIZE)
-		memset(&bpage->data[commit], 0, BUF_PAGE_SIZE - commit);
+	if (commit < buffer->subbuf_size)
+		memset(&bpage->data[commit], 0, buffer->subbuf_size - commit);
 
  out_unlock:
 	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
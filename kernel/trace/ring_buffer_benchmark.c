@@ -23,6 +23,9 @@ struct rb_page {
 /* number of events for writer to wake up the reader */
 static int wakeup_interval = 100;
 
+/* max events reserved at once by the producer */
+#define MAX_BATCH	64
+
 static int reader_finish;
 static struct completion read_start;
 static struct completion read_done;
@@ -40,6 +43,14 @@ static int write_iteration = 50;
 module_param(write_iteration, uint, 0644);
 MODULE_PARM_DESC(write_iteration, "# of writes between timestamp readings");
 
+static int batch = 1;
+module_param(batch, uint, 0444);
+MODULE_PARM_DESC(batch, "# of events reserved and committed at once (max 64)");
+
+static int subbuf_order;
+module_param(subbuf_order, uint, 0444);
+MODULE_PARM_DESC(subbuf_order, "order of the pages making up a sub-buffer");
+
 static int producer_nice = 19;
 static int consumer_nice = 19;
 
@@ -110,14 +121,16 @@ static enum event_status read_page(int cpu)
 	if (!bpage)
 		return EVENT_DROPPED;
 
-	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
+	ret = ring_buffer_read_page(buffer, &bpage,
+				    ring_buffer_subbuf_size(buffer), cpu, 1);
 	if (ret >= 0) {
 		rpage = bpage;
 		/* The commit may have missed event flags set, clear them */
 		commit = local_read(&rpage->commit) & 0xfffff;
 		for (i = 0; i < commit && !kill_test; i += inc) {
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			if (i >= (ring_buffer_subbuf_size(buffer) -
+				  offsetof(struct rb_page, data))) {
 				KILL_TEST();
 				break;
 			}
@@ -211,6 +224,31 @@ static void ring_buffer_consumer(void)
 	complete(&read_done);
 }
 
+static void ring_buffer_write_batch(unsigned long *hit, unsigned long *missed)
+{
+	struct ring_buffer_event *events[MAX_BATCH];
+	unsigned long lengths[MAX_BATCH];
+	int *entry;
+	int cpu;
+	int i;
+
+	for (i = 0; i < batch; i++)
+		lengths[i] = 10;
+
+	if (ring_buffer_lock_reserve_batch(buffer, lengths, events, batch)) {
+		*missed += batch;
+		return;
+	}
+
+	cpu = smp_processor_id();
+	for (i = 0; i < batch; i++) {
+		entry = ring_buffer_event_data(events[i]);
+		*entry = cpu;
+	}
+	ring_buffer_unlock_commit_batch(buffer, events, batch);
+	*hit += batch;
+}
+
 static void ring_buffer_producer(void)
 {
 	struct timeval start_tv;
@@ -235,6 +273,10 @@ static void ring_buffer_producer(void)
 		int i;
 
 		for (i = 0; i < write_iteration; i++) {
+			if (batch > 1) {
+				ring_buffer_write_batch(&hit, &missed);
+				continue;
+			}
 			event = ring_buffer_lock_reserve(buffer, 10);
 			if (!event) {
 				missed++;
@@ -311,6 +353,8 @@ static void ring_buffer_producer(void)
 	    producer_nice == 19 && consumer_nice == 19)
 		trace_printk("WARNING!!! This test is running at lowest priority.\n");
 
+	trace_printk("Batch:    %d events per commit\n", batch);
+	trace_printk("Sub-buffer size: %zu\n", ring_buffer_subbuf_size(buffer));
 	trace_printk("Time:     %lld (usecs)\n", time);
 	trace_printk("Overruns: %lld\n", overruns);
 	if (disable_reader)
@@ -420,8 +464,12 @@ static int __init ring_buffer_benchmark_init(void)
 {
 	int ret;
 
+	if (batch < 1 || batch > MAX_BATCH)
+		return -EINVAL;
+
 	/* make a one meg buffer in overwite mode */
-	buffer = ring_buffer_alloc(1000000, RB_FL_OVERWRITE);
+	buffer = ring_buffer_alloc_order(1000000, RB_FL_OVERWRITE,
+					 subbuf_order);
 	if (!buffer)
 		return -ENOMEM;
 
@@ -32,6 +32,10 @@
 #include <linux/sched.h>
 #include "crc32defs.h"
 
+#ifdef CONFIG_CRC32_ARCH_FOLD
+#include <asm/crc32.h>
+#endif
+
 #if CRC_LE_BITS > 8
 # define tole(x) ((__force u32) __constant_cpu_to_le32(x))
 #else
@@ -250,24 +254,51 @@ static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
 	return crc;
 }
 
+/*
+ * crc32_le_bulk() - crc32_le_generic() that lets the architecture fold
+ * large buffers first, see <asm/crc32.h>.  The folded remainder and
+ * whatever is left over are finished with the table code.
+ */
+static inline u32 __pure crc32_le_bulk(u32 crc, unsigned char const *p,
+				       size_t len, const u32 (*tab)[256],
+				       u32 polynomial)
+{
+#ifdef CONFIG_CRC32_ARCH_FOLD
+	u8 folded[16];
+	size_t n;
+
+	if (polynomial == CRCPOLY_LE)
+		n = arch_crc32_le_fold(crc, p, len, folded);
+	else
+		n = arch_crc32c_le_fold(crc, p, len, folded);
+	if (n) {
+		crc = crc32_le_generic(0, folded, sizeof(folded), tab,
+				       polynomial);
+		p += n;
+		len -= n;
+	}
+#endif
+	return crc32_le_generic(crc, p, len, tab, polynomial);
+}
+
 #if CRC_LE_BITS == 1
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+	return crc32_le_bulk(crc, p, len, NULL, CRCPOLY_LE);
 }
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
 {
-	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+	return crc32_le_bulk(crc, p, len, NULL, CRC32C_POLY_LE);
 }
 #else
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-	return crc32_le_generic(crc, p, len,
+	return crc32_le_bulk(crc, p, len,
 			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
 }
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
 {
-	return crc32_le_generic(crc, p, len,
+	return crc32_le_bulk(crc, p, len,
 			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
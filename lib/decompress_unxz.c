@@ -111,6 +111,11 @@
 #ifndef XZ_PREBOOT
 #	include <linux/slab.h>
 #	include <linux/xz.h>
+#	ifdef CONFIG_XZ_DEC_PARALLEL
+#		define XZ_WHOLE
+#		include <linux/mm.h>
+#		include <asm/unaligned.h>
+#	endif
 #else
 /*
  * Use the internal CRC32 code instead of kernel's CRC32 module, which
@@ -240,13 +245,160 @@ void *memmove(void *dest, const void *src, size_t size)
 /* Size of the input and output buffers in multi-call mode */
 #define XZ_IOBUF_SIZE 4096
 
+#ifdef XZ_WHOLE
+/*
+ * Smallest uncompressed size for which an image that is in memory as a
+ * whole is decompressed into a single buffer, so that independent parts
+ * of it can be decoded on several CPUs.
+ */
+#define XZ_WHOLE_MIN (1 << 20)
+
+/* Decode a multibyte integer of the .xz format (at most nine bytes). */
+static bool INIT unxz_vli(const uint8_t *buf, size_t size, size_t *pos,
+			  uint64_t *vli)
+{
+	unsigned int shift = 0;
+	uint8_t byte;
+
+	*vli = 0;
+
+	do {
+		if (*pos >= size || shift > 56)
+			return false;
+
+		byte = buf[(*pos)++];
+		*vli |= (uint64_t)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	return true;
+}
+
+/*
+ * If in[0..in_size) holds exactly one .xz stream, possibly followed by
+ * Stream Padding, return the uncompressed size recorded in its Index.
+ * Otherwise return zero. Nothing here needs to be trusted: the decoder
+ * still checks the Index against the decoded Blocks.
+ */
+static size_t INIT unxz_size(const uint8_t *in, size_t in_size)
+{
+	const uint8_t *footer;
+	uint64_t records;
+	uint64_t unpadded;
+	uint64_t uncompressed;
+	uint64_t blocks = 0;
+	uint64_t out = 0;
+	size_t index_pos;
+	size_t index_end;
+	size_t pos;
+
+	/* Stream Padding is a multiple of four null bytes. */
+	while (in_size >= 24 && (in[in_size - 4] | in[in_size - 3]
+			| in[in_size - 2] | in[in_size - 1]) == 0)
+		in_size -= 4;
+
+	/* Stream Header and Stream Footer are twelve bytes each. */
+	if (in_size < 24 || in_size % 4 != 0)
+		return 0;
+
+	footer = in + in_size - 12;
+	if (footer[10] != 'Y' || footer[11] != 'Z')
+		return 0;
+
+	pos = ((size_t)get_unaligned_le32(footer + 4) + 1) * 4;
+	if (pos > in_size - 24)
+		return 0;
+
+	/* Index Indicator, Number of Records, the Records, Padding, CRC32 */
+	index_pos = in_size - 12 - pos;
+	index_end = in_size - 12 - 4;
+	pos = index_pos;
+
+	if (in[pos++] != 0x00 || !unxz_vli(in, index_end, &pos, &records))
+		return 0;
+
+	while (records-- > 0) {
+		if (!unxz_vli(in, index_end, &pos, &unpadded)
+				|| !unxz_vli(in, index_end, &pos, &uncompressed))
+			return 0;
+
+		if (unpadded > in_size || uncompressed > SIZE_MAX - out)
+			return 0;
+
+		blocks += (unpadded + 3) & ~(uint64_t)3;
+		out += uncompressed;
+	}
+
+	/* The Blocks must fill the space between Stream Header and Index. */
+	if (blocks != index_pos - 12)
+		return 0;
+
+	return out;
+}
+
+/*
+ * Decompress an image that is in memory as a whole into a single buffer
+ * with xz_dec_run_parallel(), and hand all of it to flush() at once.
+ * Return 1 without having called flush() if the image isn't suitable or
+ * doesn't decode, so that the caller goes through the multi-call decoder,
+ * which also reports the errors.
+ */
+static int INIT unxz_whole(unsigned char *in, int in_size,
+			   int (*flush)(void *src, unsigned int size),
+			   int *in_used, void (*error)(char *x))
+{
+	struct xz_buf b;
+	struct xz_dec *s;
+	size_t size;
+	int ret = 1;
+
+	size = unxz_size(in, in_size);
+	if (size < XZ_WHOLE_MIN || size > INT_MAX
+			|| (size >> PAGE_SHIFT) > totalram_pages / 4)
+		return 1;
+
+	s = xz_dec_init(XZ_SINGLE, 0);
+	if (s == NULL)
+		return 1;
+
+	b.out = large_malloc(size);
+	if (b.out == NULL)
+		goto out_end;
+
+	b.in = in;
+	b.in_pos = 0;
+	b.in_size = in_size;
+	b.out_pos = 0;
+	b.out_size = size;
+
+	if (xz_dec_run_parallel(s, &b) == XZ_STREAM_END) {
+		if (in_used != NULL)
+			*in_used = b.in_pos;
+
+		ret = 0;
+		if (flush(b.out, b.out_pos) != (int)b.out_pos) {
+			error("XZ-compressed data is corrupt");
+			ret = -1;
+		}
+	}
+
+	large_free(b.out);
+out_end:
+	xz_dec_end(s);
+	return ret;
+}
+#endif
+
 /*
  * This function implements the API defined in <linux/decompress/generic.h>.
  *
  * This wrapper will automatically choose single-call or multi-call mode
  * of the native XZ decoder API. The single-call mode can be used only when
  * both input and output buffers are available as a single chunk, i.e. when
- * fill() and flush() won't be used.
+ * fill() and flush() won't be used. With CONFIG_XZ_DEC_PARALLEL, an input
+ * that is available as a single chunk is also decoded in single-call mode
+ * when flush() is used and the uncompressed size can be found in the
+ * Index, see unxz_whole().
  */
 STATIC int INIT unxz(unsigned char *in, int in_size,
 		     int (*fill)(void *dest, unsigned int size),
@@ -266,6 +418,15 @@ STATIC int INIT unxz(unsigned char *in, int in_size,
 	if (in_used != NULL)
 		*in_used = 0;
 
+#ifdef XZ_WHOLE
+	if (in != NULL && fill == NULL && flush != NULL) {
+		int whole = unxz_whole(in, in_size, flush, in_used, error);
+
+		if (whole <= 0)
+			return whole;
+	}
+#endif
+
 	if (fill == NULL && flush == NULL)
 		s = xz_dec_init(XZ_SINGLE, 0);
 	else
@@ -297,7 +458,11 @@ STATIC int INIT unxz(unsigned char *in, int in_size,
 	b.out_pos = 0;
 
 	if (fill == NULL && flush == NULL) {
+#ifdef XZ_WHOLE
+		ret = xz_dec_run_parallel(s, &b);
+#else
 		ret = xz_dec_run(s, &b);
+#endif
 	} else {
 		do {
 			if (b.in_pos == b.in_size && fill != NULL) {
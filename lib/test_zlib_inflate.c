@@ -0,0 +1,219 @@
+/*
+ * zlib inflate benchmark.
+ *
+ * Deflates a fixed, pseudo-randomly generated corpus once at load time
+ * and then times inflating it again, checking the output and the zlib
+ * Adler-32 trailer on every pass.  The corpus mixes text-like data,
+ * structured binary records and incompressible bytes, roughly what
+ * squashfs and initramfs images contain.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+
+static unsigned int iterations = 20;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of timed inflate passes per corpus");
+
+static unsigned int corpus_kb = 256;
+module_param(corpus_kb, uint, 0444);
+MODULE_PARM_DESC(corpus_kb, "Size of each corpus in KiB");
+
+static const char * const words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"struct", "static", "return", "unsigned", "long", "int", "void",
+	"kernel", "page", "inode", "buffer", "device", "driver", "lock",
+	"if", "else", "while", "NULL", "error", "count", "length", "data",
+};
+
+enum corpus_type {
+	CORPUS_TEXT,
+	CORPUS_RECORDS,
+	CORPUS_RANDOM,
+	NR_CORPUS,
+};
+
+static const char * const corpus_names[NR_CORPUS] = {
+	[CORPUS_TEXT]		= "text",
+	[CORPUS_RECORDS]	= "records",
+	[CORPUS_RANDOM]		= "random",
+};
+
+static void fill_corpus(enum corpus_type type, u8 *buf, size_t len)
+{
+	struct rnd_state rnd;
+	size_t pos = 0;
+
+	prandom_seed_state(&rnd, 0x7a6c6962ULL + type);
+
+	switch (type) {
+	case CORPUS_TEXT:
+		while (pos < len) {
+			u32 r = prandom_u32_state(&rnd);
+			const char *w = words[r % ARRAY_SIZE(words)];
+			size_t n = min(strlen(w), len - pos);
+
+			memcpy(buf + pos, w, n);
+			pos += n;
+			if (pos < len)
+				buf[pos++] = (r >> 8) % 11 ? ' ' : '\n';
+		}
+		break;
+	case CORPUS_RECORDS:
+		/* 32 byte records with slowly changing fields */
+		while (pos < len) {
+			u32 rec[8];
+			size_t n = min(sizeof(rec), len - pos);
+			int i;
+
+			rec[0] = pos / sizeof(rec);
+			rec[1] = 0x81a4;
+			rec[2] = 1000 + (prandom_u32_state(&rnd) & 3);
+			rec[3] = prandom_u32_state(&rnd) & 0xfff;
+			for (i = 4; i < 8; i++)
+				rec[i] = rec[0] * 4096 + i;
+			memcpy(buf + pos, rec, n);
+			pos += n;
+		}
+		break;
+	default:
+		prandom_bytes_state(&rnd, buf, len);
+		break;
+	}
+}
+
+static int deflate_corpus(const u8 *src, size_t len, u8 *dst, size_t *dlen)
+{
+	z_stream strm = { };
+	int ret;
+
+	strm.workspace = vzalloc(zlib_deflate_workspacesize(MAX_WBITS,
+							    MAX_MEM_LEVEL));
+	if (!strm.workspace)
+		return -ENOMEM;
+
+	ret = zlib_deflateInit(&strm, Z_DEFAULT_COMPRESSION);
+	if (ret == Z_OK) {
+		strm.next_in = src;
+		strm.avail_in = len;
+		strm.next_out = dst;
+		strm.avail_out = *dlen;
+		ret = zlib_deflate(&strm, Z_FINISH);
+		*dlen = strm.total_out;
+		zlib_deflateEnd(&strm);
+	}
+	vfree(strm.workspace);
+
+	return ret == Z_STREAM_END ? 0 : -EINVAL;
+}
+
+static int inflate_corpus(z_stream *strm, const u8 *src, size_t len,
+			  u8 *dst, size_t dlen)
+{
+	int ret;
+
+	ret = zlib_inflateInit(strm);
+	if (ret != Z_OK)
+		return -EINVAL;
+
+	strm->next_in = src;
+	strm->avail_in = len;
+	strm->next_out = dst;
+	strm->avail_out = dlen;
+	ret = zlib_inflate(strm, Z_FINISH);
+	zlib_inflateEnd(strm);
+
+	return ret == Z_STREAM_END && strm->total_out == dlen ? 0 : -EINVAL;
+}
+
+static int __init bench_corpus(enum corpus_type type, z_stream *strm,
+			       u8 *raw, u8 *packed, u8 *out, size_t len)
+{
+	size_t plen = len + len / 1000 + 64;
+	ktime_t start;
+	u64 ns, mbps;
+	unsigned int i;
+	int ret;
+
+	fill_corpus(type, raw, len);
+	ret = deflate_corpus(raw, len, packed, &plen);
+	if (ret) {
+		pr_err("%s: deflate failed\n", corpus_names[type]);
+		return ret;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		memset(out, 0, 64);
+		ret = inflate_corpus(strm, packed, plen, out, len);
+		if (ret || memcmp(out, raw, len)) {
+			pr_err("%s: inflate mismatch on pass %u\n",
+			       corpus_names[type], i);
+			return -EINVAL;
+		}
+		cond_resched();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* output bytes per microsecond is MB/s */
+	mbps = div64_u64((u64)len * iterations * 1000, ns ?: 1);
+	pr_info("%-8s %7zu -> %7zu bytes, %u passes in %llu us, %llu MB/s\n",
+		corpus_names[type], len, plen, iterations,
+		div_u64(ns, 1000), mbps);
+	return 0;
+}
+
+static int __init test_zlib_inflate_init(void)
+{
+	size_t len = (size_t)corpus_kb * 1024;
+	z_stream strm = { };
+	u8 *raw, *packed, *out;
+	int type, ret = -ENOMEM;
+
+	if (!len || !iterations)
+		return -EINVAL;
+
+	raw = vmalloc(len);
+	packed = vmalloc(len + len / 1000 + 64);
+	out = vmalloc(len);
+	strm.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!raw || !packed || !out || !strm.workspace)
+		goto out;
+
+	for (type = 0; type < NR_CORPUS; type++) {
+		ret = bench_corpus(type, &strm, raw, packed, out, len);
+		if (ret)
+			break;
+	}
+
+out:
+	vfree(strm.workspace);
+	vfree(out);
+	vfree(packed);
+	vfree(raw);
+	/* nothing to keep around: fail the load so it can be rerun */
+	return ret ? ret : -EAGAIN;
+}
+
+static void __exit test_zlib_inflate_exit(void)
+{
+}
+
+module_init(test_zlib_inflate_init);
+module_exit(test_zlib_inflate_exit);
+
+MODULE_DESCRIPTION("zlib inflate benchmark");
+MODULE_LICENSE("GPL");
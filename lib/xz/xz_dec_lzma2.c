@@ -25,6 +25,18 @@
  */
 #define LZMA_IN_REQUIRED 21
 
+/*
+ * Shortest match that dict_repeat() copies with memcpy() instead of one
+ * byte at a time when the source and destination don't overlap.
+ */
+#define DICT_REPEAT_MEMCPY_MIN 16
+
+/*
+ * Smallest total uncompressed size of an LZMA2 stream for which it is
+ * worth decoding its independent segments on several CPUs.
+ */
+#define LZMA2_PARALLEL_MIN (1 << 20)
+
 /*
  * Dictionary (history buffer)
  *
@@ -248,6 +260,15 @@ struct lzma2_dec {
 	 * before the first LZMA chunk.
 	 */
 	bool need_props;
+
+#ifdef XZ_DEC_PARALLEL
+	/*
+	 * True while xz_dec_run_parallel() runs, which allows decoding
+	 * independent segments on several CPUs. Never set in the helper
+	 * decoders of lzma2_parallel().
+	 */
+	bool parallel;
+#endif
 };
 
 struct xz_dec_lzma2 {
@@ -358,12 +379,26 @@ static bool dict_repeat(struct dictionary *dict, uint32_t *len, uint32_t dist)
 	if (dist >= dict->pos)
 		back += dict->end;
 
+	/*
+	 * Long matches whose source doesn't overlap the destination and
+	 * doesn't wrap around the end of the circular buffer can be copied
+	 * in one go. Shorter or overlapping ones (runs of a repeated byte
+	 * or pattern) need the byte-by-byte loop.
+	 */
+	if (left >= DICT_REPEAT_MEMCPY_MIN && dist < dict->pos
+			&& dist >= left - 1) {
+		memcpy(dict->buf + dict->pos, dict->buf + back, left);
+		dict->pos += left;
+		goto out;
+	}
+
 	do {
 		dict->buf[dict->pos++] = dict->buf[back++];
 		if (back == dict->end)
 			back = 0;
 	} while (--left > 0);
 
+out:
 	if (dict->full < dict->pos)
 		dict->full = dict->pos;
 
@@ -515,6 +550,31 @@ static __always_inline int rc_bit(struct rc_dec *rc, uint16_t *prob)
 	return bit;
 }
 
+/*
+ * Decode one bit without branching on its value. The bits of literals and
+ * of the various bittrees are close to random, so the branch in rc_bit()
+ * mispredicts about half of the time there. Here the result is turned into
+ * a mask and both outcomes are blended instead. rc_bit() is still better
+ * for the well-predicted decisions like is_match and is_rep.
+ */
+static __always_inline uint32_t rc_bit_nb(struct rc_dec *rc, uint16_t *prob)
+{
+	uint32_t p = *prob;
+	uint32_t bound;
+	uint32_t mask;
+
+	rc_normalize(rc);
+	bound = (rc->range >> RC_BIT_MODEL_TOTAL_BITS) * p;
+	mask = (uint32_t)0 - (rc->code >= bound);
+
+	rc->range = (bound & ~mask) | ((rc->range - bound) & mask);
+	rc->code -= bound & mask;
+	*prob = p + (((RC_BIT_MODEL_TOTAL - p) >> RC_MOVE_BITS) & ~mask)
+			- ((p >> RC_MOVE_BITS) & mask);
+
+	return mask & 1;
+}
+
 /* Decode a bittree starting from the most significant bit. */
 static __always_inline uint32_t rc_bittree(struct rc_dec *rc,
 					   uint16_t *probs, uint32_t limit)
@@ -522,10 +582,7 @@ static __always_inline uint32_t rc_bittree(struct rc_dec *rc,
 	uint32_t symbol = 1;
 
 	do {
-		if (rc_bit(rc, &probs[symbol]))
-			symbol = (symbol << 1) + 1;
-		else
-			symbol <<= 1;
+		symbol = (symbol << 1) + rc_bit_nb(rc, &probs[symbol]);
 	} while (symbol < limit);
 
 	return symbol;
@@ -538,14 +595,12 @@ static __always_inline void rc_bittree_reverse(struct rc_dec *rc,
 {
 	uint32_t symbol = 1;
 	uint32_t i = 0;
+	uint32_t bit;
 
 	do {
-		if (rc_bit(rc, &probs[symbol])) {
-			symbol = (symbol << 1) + 1;
-			*dest += 1 << i;
-		} else {
-			symbol <<= 1;
-		}
+		bit = rc_bit_nb(rc, &probs[symbol]);
+		symbol = (symbol << 1) + bit;
+		*dest += bit << i;
 	} while (++i < limit);
 }
 
@@ -577,38 +632,41 @@ static uint16_t *lzma_literal_probs(struct xz_dec_lzma2 *s)
 	return s->lzma.literal[low + high];
 }
 
-/* Decode a literal (one 8-bit byte) */
-static void lzma_literal(struct xz_dec_lzma2 *s)
+/*
+ * Decode a literal (one 8-bit byte). A literal is always exactly eight
+ * bits, so both loops run a fixed number of times and use rc_bit_nb() to
+ * keep the unpredictable bits off the branch predictor.
+ */
+static __always_inline void lzma_literal(struct xz_dec_lzma2 *s,
+					 struct rc_dec *rc)
 {
 	uint16_t *probs;
 	uint32_t symbol;
 	uint32_t match_byte;
 	uint32_t match_bit;
 	uint32_t offset;
+	uint32_t bit;
 	uint32_t i;
 
 	probs = lzma_literal_probs(s);
+	symbol = 1;
 
 	if (lzma_state_is_literal(s->lzma.state)) {
-		symbol = rc_bittree(&s->rc, probs, 0x100);
+		for (i = 0; i < 8; ++i)
+			symbol = (symbol << 1) + rc_bit_nb(rc, &probs[symbol]);
 	} else {
-		symbol = 1;
 		match_byte = dict_get(&s->dict, s->lzma.rep0) << 1;
 		offset = 0x100;
 
-		do {
+		for (i = 0; i < 8; ++i) {
 			match_bit = match_byte & offset;
 			match_byte <<= 1;
-			i = offset + match_bit + symbol;
+			bit = rc_bit_nb(rc, &probs[offset + match_bit + symbol]);
+			symbol = (symbol << 1) + bit;
 
-			if (rc_bit(&s->rc, &probs[i])) {
-				symbol = (symbol << 1) + 1;
-				offset &= match_bit;
-			} else {
-				symbol <<= 1;
-				offset &= ~match_bit;
-			}
-		} while (symbol < 0x100);
+			/* offset &= bit ? match_bit : ~match_bit */
+			offset &= match_bit ^ (bit - 1);
+		}
 	}
 
 	dict_put(&s->dict, (uint8_t)symbol);
@@ -616,18 +674,20 @@ static void lzma_literal(struct xz_dec_lzma2 *s)
 }
 
 /* Decode the length of the match into s->lzma.len. */
-static void lzma_len(struct xz_dec_lzma2 *s, struct lzma_len_dec *l,
-		     uint32_t pos_state)
+static __always_inline void lzma_len(struct xz_dec_lzma2 *s,
+				     struct rc_dec *rc,
+				     struct lzma_len_dec *l,
+				     uint32_t pos_state)
 {
 	uint16_t *probs;
 	uint32_t limit;
 
-	if (!rc_bit(&s->rc, &l->choice)) {
+	if (!rc_bit(rc, &l->choice)) {
 		probs = l->low[pos_state];
 		limit = LEN_LOW_SYMBOLS;
 		s->lzma.len = MATCH_LEN_MIN;
 	} else {
-		if (!rc_bit(&s->rc, &l->choice2)) {
+		if (!rc_bit(rc, &l->choice2)) {
 			probs = l->mid[pos_state];
 			limit = LEN_MID_SYMBOLS;
 			s->lzma.len = MATCH_LEN_MIN + LEN_LOW_SYMBOLS;
@@ -639,11 +699,12 @@ static void lzma_len(struct xz_dec_lzma2 *s, struct lzma_len_dec *l,
 		}
 	}
 
-	s->lzma.len += rc_bittree(&s->rc, probs, limit) - limit;
+	s->lzma.len += rc_bittree(rc, probs, limit) - limit;
 }
 
 /* Decode a match. The distance will be stored in s->lzma.rep0. */
-static void lzma_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
+static void lzma_match(struct xz_dec_lzma2 *s, struct rc_dec *rc,
+		       uint32_t pos_state)
 {
 	uint16_t *probs;
 	uint32_t dist_slot;
@@ -655,10 +716,10 @@ static void lzma_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
 	s->lzma.rep2 = s->lzma.rep1;
 	s->lzma.rep1 = s->lzma.rep0;
 
-	lzma_len(s, &s->lzma.match_len_dec, pos_state);
+	lzma_len(s, rc, &s->lzma.match_len_dec, pos_state);
 
 	probs = s->lzma.dist_slot[lzma_get_dist_state(s->lzma.len)];
-	dist_slot = rc_bittree(&s->rc, probs, DIST_SLOTS) - DIST_SLOTS;
+	dist_slot = rc_bittree(rc, probs, DIST_SLOTS) - DIST_SLOTS;
 
 	if (dist_slot < DIST_MODEL_START) {
 		s->lzma.rep0 = dist_slot;
@@ -670,12 +731,12 @@ static void lzma_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
 			s->lzma.rep0 <<= limit;
 			probs = s->lzma.dist_special + s->lzma.rep0
 					- dist_slot - 1;
-			rc_bittree_reverse(&s->rc, probs,
+			rc_bittree_reverse(rc, probs,
 					&s->lzma.rep0, limit);
 		} else {
-			rc_direct(&s->rc, &s->lzma.rep0, limit - ALIGN_BITS);
+			rc_direct(rc, &s->lzma.rep0, limit - ALIGN_BITS);
 			s->lzma.rep0 <<= ALIGN_BITS;
-			rc_bittree_reverse(&s->rc, s->lzma.dist_align,
+			rc_bittree_reverse(rc, s->lzma.dist_align,
 					&s->lzma.rep0, ALIGN_BITS);
 		}
 	}
@@ -685,22 +746,23 @@ static void lzma_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
  * Decode a repeated match. The distance is one of the four most recently
  * seen matches. The distance will be stored in s->lzma.rep0.
  */
-static void lzma_rep_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
+static void lzma_rep_match(struct xz_dec_lzma2 *s, struct rc_dec *rc,
+			   uint32_t pos_state)
 {
 	uint32_t tmp;
 
-	if (!rc_bit(&s->rc, &s->lzma.is_rep0[s->lzma.state])) {
-		if (!rc_bit(&s->rc, &s->lzma.is_rep0_long[
+	if (!rc_bit(rc, &s->lzma.is_rep0[s->lzma.state])) {
+		if (!rc_bit(rc, &s->lzma.is_rep0_long[
 				s->lzma.state][pos_state])) {
 			lzma_state_short_rep(&s->lzma.state);
 			s->lzma.len = 1;
 			return;
 		}
 	} else {
-		if (!rc_bit(&s->rc, &s->lzma.is_rep1[s->lzma.state])) {
+		if (!rc_bit(rc, &s->lzma.is_rep1[s->lzma.state])) {
 			tmp = s->lzma.rep1;
 		} else {
-			if (!rc_bit(&s->rc, &s->lzma.is_rep2[s->lzma.state])) {
+			if (!rc_bit(rc, &s->lzma.is_rep2[s->lzma.state])) {
 				tmp = s->lzma.rep2;
 			} else {
 				tmp = s->lzma.rep3;
@@ -715,13 +777,22 @@ static void lzma_rep_match(struct xz_dec_lzma2 *s, uint32_t pos_state)
 	}
 
 	lzma_state_long_rep(&s->lzma.state);
-	lzma_len(s, &s->lzma.rep_len_dec, pos_state);
+	lzma_len(s, rc, &s->lzma.rep_len_dec, pos_state);
 }
 
-/* LZMA decoder core */
+/*
+ * LZMA decoder core
+ *
+ * The range decoder is kept in a local copy for the duration of the loop
+ * so that the compiler can keep range, code and in_pos in registers
+ * instead of reloading them through s after every store to the
+ * probability arrays or the dictionary.
+ */
 static bool lzma_main(struct xz_dec_lzma2 *s)
 {
+	struct rc_dec rc = s->rc;
 	uint32_t pos_state;
+	bool ret = true;
 
 	/*
 	 * If the dictionary was reached during the previous call, try to
@@ -734,20 +805,23 @@ static bool lzma_main(struct xz_dec_lzma2 *s)
 	 * Decode more LZMA symbols. One iteration may consume up to
 	 * LZMA_IN_REQUIRED - 1 bytes.
 	 */
-	while (dict_has_space(&s->dict) && !rc_limit_exceeded(&s->rc)) {
+	while (dict_has_space(&s->dict) && !rc_limit_exceeded(&rc)) {
 		pos_state = s->dict.pos & s->lzma.pos_mask;
 
-		if (!rc_bit(&s->rc, &s->lzma.is_match[
+		if (!rc_bit(&rc, &s->lzma.is_match[
 				s->lzma.state][pos_state])) {
-			lzma_literal(s);
+			lzma_literal(s, &rc);
 		} else {
-			if (rc_bit(&s->rc, &s->lzma.is_rep[s->lzma.state]))
-				lzma_rep_match(s, pos_state);
+			if (rc_bit(&rc, &s->lzma.is_rep[s->lzma.state]))
+				lzma_rep_match(s, &rc, pos_state);
 			else
-				lzma_match(s, pos_state);
+				lzma_match(s, &rc, pos_state);
 
-			if (!dict_repeat(&s->dict, &s->lzma.len, s->lzma.rep0))
-				return false;
+			if (!dict_repeat(&s->dict, &s->lzma.len,
+					s->lzma.rep0)) {
+				ret = false;
+				break;
+			}
 		}
 	}
 
@@ -755,9 +829,10 @@ static bool lzma_main(struct xz_dec_lzma2 *s)
 	 * Having the range decoder always normalized when we are outside
 	 * this function makes it easier to correctly handle end of the chunk.
 	 */
-	rc_normalize(&s->rc);
+	rc_normalize(&rc);
 
-	return true;
+	s->rc = rc;
+	return ret;
 }
 
 /*
@@ -924,6 +999,264 @@ static bool lzma2_lzma(struct xz_dec_lzma2 *s, struct xz_buf *b)
 	return true;
 }
 
+#ifdef XZ_DEC_PARALLEL
+/*
+ * Parallel decoding of independent segments
+ *
+ * A chunk that resets the dictionary (control byte 0x01 or >= 0xE0) also
+ * resets the LZMA state and properties, so nothing decoded before it is
+ * needed to decode it and the chunks that follow it. Encoders that
+ * compress a large block on several threads (e.g. the multithreaded
+ * LZMA2 encoder of 7-Zip) produce exactly this: one dictionary reset per
+ * thread. When the caller asked for it with xz_dec_run_parallel(), the
+ * whole LZMA2 stream of a block is in the input buffer and its
+ * uncompressed data fits into the output buffer, the segments between
+ * the dictionary resets are decoded concurrently, each by its own
+ * single-call decoder writing directly into its own part of b->out.
+ * This allocates memory and waits for the workers, so it is never done
+ * on behalf of xz_dec_run(), which must be usable in atomic context.
+ * Everything else is left to the normal sequential decoder.
+ */
+struct lzma2_segment {
+	/* Position of the first control byte of the segment in b->in */
+	size_t in_pos;
+	size_t in_size;
+
+	/* Position of the uncompressed data relative to b->out_pos */
+	size_t out_pos;
+	size_t out_size;
+};
+
+struct lzma2_parallel {
+	const uint8_t *in;
+	uint8_t *out;
+	uint32_t dict_size;
+
+	/* Index of the next segment to be decoded */
+	atomic_t next;
+
+	/* Set if decoding any of the segments failed */
+	atomic_t failed;
+
+	uint32_t count;
+	struct lzma2_segment seg[];
+};
+
+struct lzma2_worker {
+	struct work_struct work;
+	struct lzma2_parallel *p;
+	struct xz_dec_lzma2 dec;
+};
+
+/*
+ * Walk the LZMA2 chunk headers from b->in_pos up to the end marker and
+ * split the chunks into segments, each starting with a dictionary reset.
+ * If seg is NULL, the segments are only counted. On success, the number
+ * of segments is returned, the position of the end marker is stored in
+ * *in_end and the total uncompressed size in *out_total. Zero is returned
+ * if the stream doesn't fit in the buffers or the headers look invalid;
+ * the sequential decoder will then handle (and diagnose) it.
+ */
+static uint32_t lzma2_segments(const struct xz_buf *b,
+			       struct lzma2_segment *seg,
+			       size_t *in_end, size_t *out_total)
+{
+	const size_t out_max = b->out_size - b->out_pos;
+	size_t pos = b->in_pos;
+	size_t out = 0;
+	uint32_t count = 0;
+	uint32_t control;
+	uint32_t header;
+	uint32_t uncompressed;
+	uint32_t compressed;
+
+	while (pos < b->in_size) {
+		control = b->in[pos];
+
+		if (control == 0x00) {
+			if (count > 0 && seg != NULL) {
+				seg[count - 1].in_size
+						= pos - seg[count - 1].in_pos;
+				seg[count - 1].out_size
+						= out - seg[count - 1].out_pos;
+			}
+
+			*in_end = pos;
+			*out_total = out;
+			return count;
+		}
+
+		if (control >= 0x80)
+			header = control >= 0xC0 ? 6 : 5;
+		else if (control <= 0x02)
+			header = 3;
+		else
+			return 0;
+
+		if (b->in_size - pos < header)
+			return 0;
+
+		compressed = ((uint32_t)b->in[pos + 1] << 8)
+				+ b->in[pos + 2] + 1;
+		uncompressed = compressed;
+
+		if (control >= 0x80) {
+			uncompressed = ((control & 0x1F) << 16) + compressed;
+			compressed = ((uint32_t)b->in[pos + 3] << 8)
+					+ b->in[pos + 4] + 1;
+		}
+
+		if (control >= 0xE0 || control == 0x01) {
+			if (seg != NULL) {
+				if (count > 0) {
+					seg[count - 1].in_size = pos
+						- seg[count - 1].in_pos;
+					seg[count - 1].out_size = out
+						- seg[count - 1].out_pos;
+				}
+
+				seg[count].in_pos = pos;
+				seg[count].out_pos = out;
+			}
+
+			++count;
+		} else if (count == 0) {
+			return 0;
+		}
+
+		if (b->in_size - pos - header < compressed
+				|| out_max - out < uncompressed)
+			return 0;
+
+		pos += header + compressed;
+		out += uncompressed;
+	}
+
+	return 0;
+}
+
+/* Decode one segment with a fresh single-call decoder. */
+static bool lzma2_decode_segment(struct xz_dec_lzma2 *s,
+				 const struct lzma2_parallel *p,
+				 const struct lzma2_segment *seg)
+{
+	struct xz_buf b = {
+		.in = p->in + seg->in_pos,
+		.in_pos = 0,
+		.in_size = seg->in_size,
+		.out = p->out + seg->out_pos,
+		.out_pos = 0,
+		.out_size = seg->out_size,
+	};
+
+	s->dict.mode = XZ_SINGLE;
+	s->dict.size = p->dict_size;
+	s->lzma.len = 0;
+	s->lzma2.sequence = SEQ_CONTROL;
+	s->lzma2.need_dict_reset = true;
+	s->lzma2.parallel = false;
+	s->temp.size = 0;
+
+	/*
+	 * The segment has no end marker, so a successful decode stops
+	 * with XZ_OK between two chunks after consuming all the input.
+	 */
+	return xz_dec_lzma2_run(s, &b) == XZ_OK
+			&& s->lzma2.sequence == SEQ_CONTROL
+			&& b.in_pos == b.in_size && b.out_pos == b.out_size;
+}
+
+/* Decode segments until there are none left. */
+static void lzma2_parallel_run(struct lzma2_worker *w)
+{
+	struct lzma2_parallel *p = w->p;
+	uint32_t i;
+
+	while ((i = atomic_inc_return(&p->next) - 1) < p->count) {
+		if (atomic_read(&p->failed))
+			break;
+
+		if (!lzma2_decode_segment(&w->dec, p, &p->seg[i]))
+			atomic_set(&p->failed, 1);
+	}
+}
+
+static void lzma2_parallel_work(struct work_struct *work)
+{
+	lzma2_parallel_run(container_of(work, struct lzma2_worker, work));
+}
+
+/*
+ * Try to decode the LZMA2 stream starting at b->in_pos on several CPUs.
+ * On success, the input is consumed up to the end marker, which is left
+ * for xz_dec_lzma2_run() to read. If the stream isn't suitable or memory
+ * cannot be allocated, nothing is done and true is returned so that the
+ * caller decodes it sequentially. False is returned only if a segment
+ * was found to be corrupt.
+ */
+static bool lzma2_parallel(struct xz_dec_lzma2 *s, struct xz_buf *b)
+{
+	struct lzma2_parallel *p;
+	struct lzma2_worker *w;
+	size_t in_end;
+	size_t out_total;
+	uint32_t count;
+	uint32_t workers;
+	uint32_t i;
+	bool ret;
+
+	count = lzma2_segments(b, NULL, &in_end, &out_total);
+	if (count < 2 || out_total < LZMA2_PARALLEL_MIN)
+		return true;
+
+	workers = min_t(uint32_t, count, num_online_cpus());
+	if (workers < 2)
+		return true;
+
+	p = kmalloc(sizeof(*p) + count * sizeof(p->seg[0]), GFP_KERNEL);
+	if (p == NULL)
+		return true;
+
+	w = vmalloc(workers * sizeof(*w));
+	if (w == NULL) {
+		kfree(p);
+		return true;
+	}
+
+	p->in = b->in;
+	p->out = b->out + b->out_pos;
+	p->dict_size = s->dict.size;
+	p->count = count;
+	atomic_set(&p->next, 0);
+	atomic_set(&p->failed, 0);
+	lzma2_segments(b, p->seg, &in_end, &out_total);
+
+	for (i = 0; i < workers; ++i) {
+		w[i].p = p;
+		if (i > 0) {
+			INIT_WORK(&w[i].work, lzma2_parallel_work);
+			queue_work(system_unbound_wq, &w[i].work);
+		}
+	}
+
+	lzma2_parallel_run(&w[0]);
+
+	for (i = 1; i < workers; ++i)
+		flush_work(&w[i].work);
+
+	ret = !atomic_read(&p->failed);
+	if (ret) {
+		b->in_pos = in_end;
+		b->out_pos += out_total;
+		s->lzma2.need_dict_reset = false;
+	}
+
+	vfree(w);
+	kfree(p);
+	return ret;
+}
+#endif
+
 /*
  * Take care of the LZMA2 control layer, and forward the job of actual LZMA
  * decoding or copying of uncompressed chunks to other functions.
@@ -967,6 +1300,12 @@ XZ_EXTERN enum xz_ret xz_dec_lzma2_run(struct xz_dec_lzma2 *s,
 			 * Values that don't match anything described above
 			 * are invalid and we return XZ_DATA_ERROR.
 			 */
+#ifdef XZ_DEC_PARALLEL
+			if (s->lzma2.need_dict_reset && s->lzma2.parallel) {
+				if (!lzma2_parallel(s, b))
+					return XZ_DATA_ERROR;
+			}
+#endif
 			tmp = b->in[b->in_pos++];
 
 			if (tmp == 0x00)
@@ -1122,6 +1461,10 @@ XZ_EXTERN struct xz_dec_lzma2 *xz_dec_lzma2_create(enum xz_mode mode,
 		s->dict.allocated = 0;
 	}
 
+#ifdef XZ_DEC_PARALLEL
+	s->lzma2.parallel = false;
+#endif
+
 	return s;
 }
 
@@ -1162,6 +1505,14 @@ XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s, uint8_t props)
 	return XZ_OK;
 }
 
+#ifdef XZ_DEC_PARALLEL
+XZ_EXTERN void xz_dec_lzma2_set_parallel(struct xz_dec_lzma2 *s,
+					 bool parallel)
+{
+	s->lzma2.parallel = parallel;
+}
+#endif
+
 XZ_EXTERN void xz_dec_lzma2_end(struct xz_dec_lzma2 *s)
 {
 	if (DEC_IS_MULTI(s->dict.mode))
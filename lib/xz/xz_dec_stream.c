@@ -767,6 +767,26 @@ XZ_EXTERN enum xz_ret xz_dec_run(struct xz_dec *s, struct xz_buf *b)
 	return ret;
 }
 
+#ifndef XZ_PREBOOT
+XZ_EXTERN enum xz_ret xz_dec_run_parallel(struct xz_dec *s, struct xz_buf *b)
+{
+#ifdef XZ_DEC_PARALLEL
+	enum xz_ret ret;
+
+	if (!DEC_IS_SINGLE(s->mode))
+		return xz_dec_run(s, b);
+
+	xz_dec_lzma2_set_parallel(s->lzma2, true);
+	ret = xz_dec_run(s, b);
+	xz_dec_lzma2_set_parallel(s->lzma2, false);
+
+	return ret;
+#else
+	return xz_dec_run(s, b);
+#endif
+}
+#endif
+
 XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max)
 {
 	struct xz_dec *s = kmalloc(sizeof(*s), GFP_KERNEL);
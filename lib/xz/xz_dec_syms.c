@@ -13,6 +13,7 @@
 EXPORT_SYMBOL(xz_dec_init);
 EXPORT_SYMBOL(xz_dec_reset);
 EXPORT_SYMBOL(xz_dec_run);
+EXPORT_SYMBOL(xz_dec_run_parallel);
 EXPORT_SYMBOL(xz_dec_end);
 
 MODULE_DESCRIPTION("XZ decompressor");
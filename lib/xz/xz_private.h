@@ -37,6 +37,12 @@
 #		ifdef CONFIG_XZ_DEC_SPARC
 #			define XZ_DEC_SPARC
 #		endif
+#		ifdef CONFIG_XZ_DEC_PARALLEL
+#			define XZ_DEC_PARALLEL
+#			include <linux/atomic.h>
+#			include <linux/cpumask.h>
+#			include <linux/workqueue.h>
+#		endif
 #		define memeq(a, b, size) (memcmp(a, b, size) == 0)
 #		define memzero(buf, size) memset(buf, 0, size)
 #	endif
@@ -58,6 +64,14 @@
 #	define XZ_DEC_DYNALLOC
 #endif
 
+/*
+ * Parallel decoding uses single-call decoders for the independent
+ * segments of the LZMA2 stream.
+ */
+#if defined(XZ_DEC_PARALLEL) && !defined(XZ_DEC_SINGLE)
+#	undef XZ_DEC_PARALLEL
+#endif
+
 /*
  * The DEC_IS_foo(mode) macros are used in "if" statements. If only some
  * of the supported modes are enabled, these macros will evaluate to true or
@@ -122,6 +136,15 @@ XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s,
 XZ_EXTERN enum xz_ret xz_dec_lzma2_run(struct xz_dec_lzma2 *s,
 				       struct xz_buf *b);
 
+#ifdef XZ_DEC_PARALLEL
+/*
+ * Allow or disallow decoding independent segments of the LZMA2 stream on
+ * several CPUs. Only for xz_dec_run_parallel(), see there.
+ */
+XZ_EXTERN void xz_dec_lzma2_set_parallel(struct xz_dec_lzma2 *s,
+					 bool parallel);
+#endif
+
 /* Free the memory allocated for the LZMA2 decoder. */
 XZ_EXTERN void xz_dec_lzma2_end(struct xz_dec_lzma2 *s);
 
@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -48,6 +49,105 @@ get_unaligned16(const unsigned short *p)
 #  define UP_UNALIGNED(a) get_unaligned16(++(a))
 #endif
 
+/* the next sizeof(long) input bytes, least significant first */
+static inline unsigned long load_le_long(const unsigned char *p)
+{
+#if BITS_PER_LONG == 64
+	return get_unaligned_le64(p);
+#else
+	return get_unaligned_le32(p);
+#endif
+}
+
+/*
+   Top the bit buffer up to at least BITS_PER_LONG - 8 bits with a single
+   load, taking only as many whole bytes as fit.  The bits of the next,
+   partially loaded byte are left above the valid ones; they are the same
+   bits the byte will contribute when it is taken, which is why the byte
+   at a time refills below use |= rather than +=.
+ */
+#define REFILL() \
+	do { \
+		hold |= load_le_long(in + OFF) << bits; \
+		in += (BITS_PER_LONG - 1 - bits) >> 3; \
+		bits |= BITS_PER_LONG - 8; \
+	} while (0)
+
+/*
+   Copy a match of len >= 3 bytes from dist bytes back in the output, where
+   dist may be less than len.  Words, or halfwords for short distances, are
+   copied as long as a whole one fits without overlapping its own source.
+ */
+static inline unsigned char *copy_direct(unsigned char *out,
+					 unsigned char *from,
+					 unsigned dist, unsigned len)
+{
+	unsigned short *sout;
+	unsigned long loops;
+
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+	if (dist >= sizeof(unsigned long)) {
+		while (len >= sizeof(unsigned long)) {
+			put_unaligned(get_unaligned((unsigned long *)(from + OFF)),
+				      (unsigned long *)(out + OFF));
+			out += sizeof(unsigned long);
+			from += sizeof(unsigned long);
+			len -= sizeof(unsigned long);
+		}
+		while (len--)
+			PUP(out) = PUP(from);
+		return out;
+	}
+#endif
+	if (dist >= len && len >= 32) {
+		/* long and not overlapping */
+		memcpy(out + OFF, from + OFF, len);
+		return out + len;
+	}
+
+	/* minimum length is three */
+	/* Align out addr */
+	if (!((long)(out - 1 + OFF) & 1)) {
+		PUP(out) = PUP(from);
+		len--;
+	}
+	sout = (unsigned short *)(out - OFF);
+	if (dist > 2) {
+		unsigned short *sfrom;
+
+		sfrom = (unsigned short *)(from - OFF);
+		loops = len >> 1;
+		do
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+		    PUP(sout) = PUP(sfrom);
+#else
+		    PUP(sout) = UP_UNALIGNED(sfrom);
+#endif
+		while (--loops);
+		out = (unsigned char *)sout + OFF;
+		from = (unsigned char *)sfrom + OFF;
+	} else { /* dist == 1 or dist == 2 */
+		unsigned short pat16;
+
+		pat16 = *(sout-1+OFF);
+		if (dist == 1) {
+			union uu mm;
+			/* copy one char pattern to both bytes */
+			mm.us = pat16;
+			mm.b[0] = mm.b[1];
+			pat16 = mm.us;
+		}
+		loops = len >> 1;
+		do
+		    PUP(sout) = pat16;
+		while (--loops);
+		out = (unsigned char *)sout + OFF;
+	}
+	if (len & 1)
+		PUP(out) = PUP(from);
+	return out;
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -59,8 +159,8 @@ get_unaligned16(const unsigned short *p)
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE
+        strm->avail_out >= INFLATE_FAST_MIN_LEFT
         start >= strm->avail_out
         state->bits < 8
 
@@ -76,7 +176,9 @@ get_unaligned16(const unsigned short *p)
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      checking for available input while decoding.  The word sized refill
+      at the top of the loop looks up to eight bytes ahead though, hence
+      INFLATE_FAST_MIN_HAVE.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
@@ -116,10 +218,10 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
     in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_LEFT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -137,12 +239,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -157,7 +254,7 @@ void inflate_fast(z_streamp strm, unsigned start)
             op &= 15;                           /* number of extra bits */
             if (op) {
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                 }
                 len += (unsigned)hold & ((1U << op) - 1);
@@ -165,9 +262,9 @@ void inflate_fast(z_streamp strm, unsigned start)
                 bits -= op;
             }
             if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
             }
             this = dcode[hold & dmask];
@@ -180,10 +277,10 @@ void inflate_fast(z_streamp strm, unsigned start)
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                     if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
+                        hold |= (unsigned long)(PUP(in)) << bits;
                         bits += 8;
                     }
                 }
@@ -258,50 +355,8 @@ void inflate_fast(z_streamp strm, unsigned start)
                     }
                 }
                 else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
                     from = out - dist;          /* copy direct from output */
-		    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2) {
-			unsigned short *sfrom;
-
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
-			    PUP(sout) = PUP(sfrom);
-#else
-			    PUP(sout) = UP_UNALIGNED(sfrom);
-#endif
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
-
-			pat16 = *(sout-1+OFF);
-			if (dist == 1) {
-				union uu mm;
-				/* copy one char pattern to both bytes */
-				mm.us = pat16;
-				mm.b[0] = mm.b[1];
-				pat16 = mm.us;
-			}
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                    out = copy_direct(out, from, dist, len);
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -329,7 +384,7 @@ void inflate_fast(z_streamp strm, unsigned start)
         }
     } while (in < last && out < end);
 
-    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    /* return unused bytes (every byte counted in bits was taken from in) */
     len = bits >> 3;
     in -= len;
     bits -= len << 3;
@@ -338,9 +393,12 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* update state and return */
     strm->next_in = in + OFF;
     strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+                                 (INFLATE_FAST_MIN_LEFT - 1) + (end - out) :
+                                 (INFLATE_FAST_MIN_LEFT - 1) - (out - end));
     state->hold = hold;
     state->bits = bits;
     return;
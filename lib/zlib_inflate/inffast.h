@@ -8,4 +8,12 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/*
+ * inflate_fast() refills its bit buffer a word at a time, reading up to
+ * eight bytes ahead, so it needs that much input rather than the six
+ * bytes a length/distance pair can use.
+ */
+#define INFLATE_FAST_MIN_HAVE 8
+#define INFLATE_FAST_MIN_LEFT 258
+
 void inflate_fast (z_streamp strm, unsigned start);
@@ -0,0 +1,142 @@
+/*
+ * ext4 fsync latency benchmark
+ *
+ * Times write()+fsync() pairs on a single file, the pattern of database
+ * and message broker logs. fsync_bench.sh runs it on a loopback image
+ * with and without the fast_commit mount option; it can also be pointed
+ * at any scratch mount:
+ *
+ *   fsync_bench [-n count] [-w write_kb] [-a] [-d] <dir>
+ *
+ * By default a file of count * write_kb is written and synced first and
+ * then overwritten write_kb at a time, each write followed by an fsync().
+ * With -a the file is instead fallocate()d and the writes append into the
+ * preallocated space, which also has to convert the extents written to.
+ * -d uses fdatasync() instead of fsync().
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static unsigned long count = 10000;
+static unsigned long write_kb = 4;
+static int append;
+static int datasync;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n count] [-w write_kb] [-a] [-d] <dir>\n",
+		prog);
+	exit(1);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Set up the file so that the timed writes do not allocate blocks. */
+static int prepare(int fd, char *buf, off_t size)
+{
+	off_t off;
+
+	if (append)
+		return fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+
+	for (off = 0; off < size; off += write_kb << 10)
+		if (pwrite(fd, buf, write_kb << 10, off) != (ssize_t)(write_kb << 10))
+			return -1;
+	return fsync(fd);
+}
+
+int main(int argc, char **argv)
+{
+	char path[4096];
+	double *lat, total = 0, t;
+	size_t len;
+	unsigned long i;
+	char *buf;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "n:w:ad")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			write_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			append = 1;
+			break;
+		case 'd':
+			datasync = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !count || !write_kb)
+		usage(argv[0]);
+
+	len = write_kb << 10;
+	lat = calloc(count, sizeof(*lat));
+	buf = malloc(len);
+	if (!lat || !buf)
+		return 1;
+	memset(buf, 0x5a, len);
+
+	snprintf(path, sizeof(path), "%s/fsync_bench.dat", argv[optind]);
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if (prepare(fd, buf, (off_t)count * len)) {
+		perror(path);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		t = now_us();
+		if (pwrite(fd, buf, len, (off_t)i * len) != (ssize_t)len ||
+		    (datasync ? fdatasync(fd) : fsync(fd))) {
+			perror(path);
+			return 1;
+		}
+		lat[i] = now_us() - t;
+		total += lat[i];
+	}
+
+	qsort(lat, count, sizeof(*lat), cmp_double);
+	printf("%lu %s of %lu KiB (%s): avg %.0f us, min %.0f, median %.0f, "
+	       "p99 %.0f, max %.0f\n",
+	       count, datasync ? "fdatasyncs" : "fsyncs", write_kb,
+	       append ? "append" : "overwrite", total / count, lat[0],
+	       lat[count / 2], lat[count * 99 / 100], lat[count - 1]);
+
+	close(fd);
+	unlink(path);
+	free(buf);
+	free(lat);
+	return 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Run fsync_bench on a loopback ext4 image, first with regular journal
+# commits and then with the fast_commit mount option, for both the
+# overwrite and the preallocated append pattern, and print the fsync
+# latencies of all runs.
+#
+# usage: fsync_bench.sh [image size, default 1G] [fsync_bench options]
+#
+# Loop devices pass cache flushes on to the backing file, so the numbers
+# include the cost of making each fsync durable. Must be run as root.
+
+size=${1:-1G}
+[ $# -gt 0 ] && shift
+
+bench=$(dirname "$0")/fsync_bench
+img=$(mktemp /var/tmp/fsync.XXXXXX)
+mnt=$(mktemp -d /tmp/fsync.XXXXXX)
+
+cleanup() {
+	umount "$mnt" 2>/dev/null
+	rm -f "$img"
+	rmdir "$mnt"
+}
+trap cleanup EXIT
+
+truncate -s "$size" "$img" || exit 1
+mkfs.ext4 -q -F -E lazy_itable_init=0 "$img" || exit 1
+
+for opts in nofast_commit fast_commit; do
+	for mode in "" -a; do
+		mount -o loop,$opts "$img" "$mnt" || exit 1
+		echo "$opts $mode:"
+		"$bench" $mode "$@" "$mnt" || exit 1
+		dev=$(basename "$(findmnt -n -o SOURCE "$mnt")")
+		grep -h "fast commits\|transactions" /proc/fs/jbd2/$dev-*/info
+		umount "$mnt"
+	done
+done
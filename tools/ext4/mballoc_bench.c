@@ -0,0 +1,182 @@
+/*
+ * ext4 block allocation latency benchmark
+ *
+ * Fragments the free space of a mounted filesystem and then times
+ * individual block allocations, which is where the group scanning of
+ * mballoc shows up on large, nearly full filesystems. mballoc_bench.sh
+ * runs it on a freshly made loopback image; it can also be pointed at any
+ * scratch mount:
+ *
+ *   mballoc_bench [-s frag_kb] [-k keep] [-n allocs] [-l alloc_kb] <dir>
+ *
+ * The directory is first filled with frag_kb sized files until the
+ * filesystem is full. Then every keep-th file is deleted, which leaves
+ * the free space in frag_kb holes spread over all block groups. Finally
+ * allocs new files of alloc_kb each are fallocate()d and fsync()ed one
+ * at a time and the latency of each allocation is reported.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static unsigned long frag_kb = 64;
+static unsigned long keep = 4;
+static unsigned long allocs = 1000;
+static unsigned long alloc_kb = 1024;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s frag_kb] [-k keep] [-n allocs] [-l alloc_kb] <dir>\n",
+		prog);
+	exit(1);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Create a file of the given size; returns 0, or -1 with errno set. */
+static int make_file(const char *path, unsigned long kb, double *us)
+{
+	double t;
+	int fd;
+	int ret;
+
+	fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0)
+		return -1;
+
+	t = now_us();
+	ret = fallocate(fd, 0, 0, (off_t)kb << 10);
+	if (!ret)
+		ret = fsync(fd);
+	if (us)
+		*us = now_us() - t;
+
+	if (ret) {
+		int err = errno;
+
+		close(fd);
+		unlink(path);
+		errno = err;
+		return -1;
+	}
+	return close(fd);
+}
+
+/* Fill the filesystem with small files and punch holes by deleting some. */
+static unsigned long fragment(const char *dir)
+{
+	char path[4096];
+	unsigned long n, i, freed = 0;
+
+	for (n = 0; ; n++) {
+		snprintf(path, sizeof(path), "%s/frag.%lu", dir, n);
+		if (make_file(path, frag_kb, NULL)) {
+			if (errno != ENOSPC) {
+				perror(path);
+				exit(1);
+			}
+			break;
+		}
+		if (n % 1024 == 1023) {
+			printf("\rfilling: %lu MiB", (n + 1) * frag_kb >> 10);
+			fflush(stdout);
+		}
+	}
+	printf("\rfilled with %lu files of %lu KiB\n", n, frag_kb);
+
+	for (i = 0; i < n; i += keep) {
+		snprintf(path, sizeof(path), "%s/frag.%lu", dir, i);
+		if (!unlink(path))
+			freed++;
+	}
+	sync();
+	printf("deleted %lu files, %lu MiB free in %lu KiB holes\n",
+	       freed, freed * frag_kb >> 10, frag_kb);
+	return freed;
+}
+
+int main(int argc, char **argv)
+{
+	char path[4096];
+	double *lat, total = 0;
+	unsigned long i, done;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:k:n:l:")) != -1) {
+		switch (opt) {
+		case 's':
+			frag_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			keep = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			allocs = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			alloc_kb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !frag_kb || keep < 2 || !allocs || !alloc_kb)
+		usage(argv[0]);
+
+	lat = calloc(allocs, sizeof(*lat));
+	if (!lat)
+		return 1;
+
+	fragment(argv[optind]);
+
+	for (done = 0; done < allocs; done++) {
+		snprintf(path, sizeof(path), "%s/alloc.%lu", argv[optind],
+			 done);
+		if (make_file(path, alloc_kb, &lat[done])) {
+			if (errno != ENOSPC)
+				perror(path);
+			break;
+		}
+		total += lat[done];
+	}
+	if (!done) {
+		fprintf(stderr, "no allocation succeeded\n");
+		return 1;
+	}
+
+	qsort(lat, done, sizeof(*lat), cmp_double);
+	printf("%lu allocations of %lu KiB: avg %.0f us, min %.0f, "
+	       "median %.0f, p99 %.0f, max %.0f\n",
+	       done, alloc_kb, total / done, lat[0], lat[done / 2],
+	       lat[done * 99 / 100], lat[done - 1]);
+
+	for (i = 0; i < done; i++) {
+		snprintf(path, sizeof(path), "%s/alloc.%lu", argv[optind], i);
+		unlink(path);
+	}
+	free(lat);
+	return 0;
+}
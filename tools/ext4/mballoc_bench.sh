@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Run mballoc_bench on a fragmented loopback ext4 image, once with the
+# free space index (mb_optimize_scan=1) and once with the plain linear
+# group scan, and print the allocation latencies of both.
+#
+# usage: mballoc_bench.sh [image size, default 64G] [mballoc_bench options]
+#
+# The image is sparse but gets filled completely; make sure the backing
+# filesystem has room for it. Must be run as root.
+
+size=${1:-64G}
+[ $# -gt 0 ] && shift
+
+bench=$(dirname "$0")/mballoc_bench
+img=$(mktemp /var/tmp/mballoc.XXXXXX)
+mnt=$(mktemp -d /tmp/mballoc.XXXXXX)
+
+cleanup() {
+	umount "$mnt" 2>/dev/null
+	rm -f "$img"
+	rmdir "$mnt"
+}
+trap cleanup EXIT
+
+truncate -s "$size" "$img" || exit 1
+mkfs.ext4 -q -F -E lazy_itable_init=0 "$img" || exit 1
+
+for optimize in 1 0; do
+	mount -o loop "$img" "$mnt" || exit 1
+	dev=$(basename "$(findmnt -n -o SOURCE "$mnt")")
+	echo $optimize > /sys/fs/ext4/$dev/mb_optimize_scan
+	echo 1 > /sys/fs/ext4/$dev/mb_stats
+
+	echo "mb_optimize_scan=$optimize:"
+	"$bench" "$@" "$mnt" || exit 1
+
+	rm -rf "$mnt"/*
+	umount "$mnt"
+	dmesg | grep "mballoc:" | tail -5
+done
@@ -10,3 +10,13 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMCPY_FN(fn, name, desc)		\
+	extern void *fn(void *, const void *, size_t);
+
+#include "mem-memcpy-arm-asm-def.h"
+
+#undef MEMCPY_FN
+
+#endif
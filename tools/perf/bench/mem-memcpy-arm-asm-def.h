@@ -0,0 +1,10 @@
+
+MEMCPY_FN(memcpy_arm,
+	"arm",
+	"memcpy() in arch/arm/lib/memcpy.S")
+
+#ifdef __ARM_NEON__
+MEMCPY_FN(__memcpy_neon,
+	"arm-neon",
+	"NEON memcpy() in arch/arm/lib/memcpy-neon.S")
+#endif
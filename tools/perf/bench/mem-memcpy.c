@@ -64,6 +64,14 @@ struct routine routines[] = {
 #include "mem-memcpy-x86-64-asm-def.h"
 #undef MEMCPY_FN
 
+#endif
+
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMCPY_FN(fn, name, desc) { name, desc, fn },
+#include "mem-memcpy-arm-asm-def.h"
+#undef MEMCPY_FN
+
 #endif
 
 	{ NULL,
@@ -10,3 +10,13 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMSET_FN(fn, name, desc)		\
+	extern void *fn(void *, int, size_t);
+
+#include "mem-memset-arm-asm-def.h"
+
+#undef MEMSET_FN
+
+#endif
@@ -0,0 +1,10 @@
+
+MEMSET_FN(memset_arm,
+	"arm",
+	"memset() in arch/arm/lib/memset.S")
+
+#ifdef __ARM_NEON__
+MEMSET_FN(__memset_neon,
+	"arm-neon",
+	"NEON memset() in arch/arm/lib/memset-neon.S")
+#endif
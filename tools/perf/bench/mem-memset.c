@@ -64,6 +64,14 @@ static const struct routine routines[] = {
 #include "mem-memset-x86-64-asm-def.h"
 #undef MEMSET_FN
 
+#endif
+
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMSET_FN(fn, name, desc) { name, desc, fn },
+#include "mem-memset-arm-asm-def.h"
+#undef MEMSET_FN
+
 #endif
 
 	{ NULL,
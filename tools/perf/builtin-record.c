@@ -28,6 +28,7 @@
 
 #include <unistd.h>
 #include <sched.h>
+#include <pthread.h>
 #include <sys/mman.h>
 
 #ifndef HAVE_ON_EXIT_SUPPORT
@@ -62,6 +63,26 @@ static void __handle_on_exit_funcs(void)
 }
 #endif
 
+/*
+ * With --write-buffer, data read from the mmaps is copied into one of two
+ * buffers while a separate thread writes the other one out, so that the
+ * mmaps are drained without waiting for the storage.
+ */
+struct record_writer {
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	unsigned long		size;
+	void			*buf[2];
+	size_t			used[2];
+	int			fill;	 /* buffer being filled */
+	bool			pending; /* the other buffer is being written */
+	bool			stop;
+	bool			active;
+	int			err;
+	unsigned long		stalls;
+};
+
 struct record {
 	struct perf_tool	tool;
 	struct record_opts	opts;
@@ -74,11 +95,180 @@ struct record {
 	bool			no_buildid;
 	bool			no_buildid_cache;
 	long			samples;
+	struct record_writer	writer;
 };
 
+static void *record__writer_thread(void *arg)
+{
+	struct record *rec = arg;
+	struct record_writer *w = &rec->writer;
+	int idx, err;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (!w->pending && !w->stop)
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (!w->pending)
+			break;
+
+		idx = !w->fill;
+		pthread_mutex_unlock(&w->lock);
+
+		err = 0;
+		if (perf_data_file__write(rec->session->file,
+					  w->buf[idx], w->used[idx]) < 0)
+			err = errno;
+
+		pthread_mutex_lock(&w->lock);
+		if (err && !w->err)
+			w->err = err;
+		w->used[idx] = 0;
+		w->pending = false;
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/*
+ * Hand the buffer being filled to the writer thread. If the writer is
+ * still busy with the other buffer, either wait for it or, when @wait
+ * is false, keep filling the current one.
+ *
+ * Returns the negated errno of the first failed write, if any.
+ */
+static int record_writer__flip(struct record_writer *w, bool wait)
+{
+	int err;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->pending && wait)
+		w->stalls++;
+	while (w->pending && wait)
+		pthread_cond_wait(&w->cond, &w->lock);
+
+	if (!w->pending && w->used[w->fill]) {
+		w->fill = !w->fill;
+		w->pending = true;
+		pthread_cond_broadcast(&w->cond);
+	}
+	err = w->err;
+	pthread_mutex_unlock(&w->lock);
+
+	return -err;
+}
+
+static int record_writer__err(struct record_writer *w)
+{
+	int err;
+
+	pthread_mutex_lock(&w->lock);
+	err = w->err;
+	pthread_mutex_unlock(&w->lock);
+
+	return err;
+}
+
+static int record_writer__push(struct record_writer *w, void *bf, size_t size)
+{
+	size_t room, n;
+	int err;
+
+	while (size) {
+		room = w->size - w->used[w->fill];
+		if (!room) {
+			err = record_writer__flip(w, true);
+			if (err < 0)
+				return err;
+			continue;
+		}
+
+		n = min(size, room);
+		memcpy(w->buf[w->fill] + w->used[w->fill], bf, n);
+		w->used[w->fill] += n;
+		bf += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+static int record__writer_start(struct record *rec)
+{
+	struct record_writer *w = &rec->writer;
+
+	w->buf[0] = malloc(w->size);
+	w->buf[1] = malloc(w->size);
+	if (!w->buf[0] || !w->buf[1])
+		goto out_free;
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+
+	if (pthread_create(&w->thread, NULL, record__writer_thread, rec)) {
+		pr_err("failed to create the writer thread: %m\n");
+		pthread_cond_destroy(&w->cond);
+		pthread_mutex_destroy(&w->lock);
+		goto out_free;
+	}
+
+	w->active = true;
+	return 0;
+
+out_free:
+	free(w->buf[0]);
+	free(w->buf[1]);
+	return -1;
+}
+
+/* Write out what is left in the buffers and wait for the writer to exit */
+static int record__writer_stop(struct record *rec)
+{
+	struct record_writer *w = &rec->writer;
+	int err;
+
+	if (!w->active)
+		return 0;
+
+	record_writer__flip(w, true);
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = true;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+	w->active = false;
+
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->lock);
+
+	free(w->buf[0]);
+	free(w->buf[1]);
+
+	err = record_writer__err(w);
+	if (err) {
+		pr_err("failed to write perf data, error: %s\n", strerror(err));
+		return -1;
+	}
+
+	return 0;
+}
+
 static int record__write(struct record *rec, void *bf, size_t size)
 {
-	if (perf_data_file__write(rec->session->file, bf, size) < 0) {
+	struct record_writer *w = &rec->writer;
+	int err;
+
+	if (w->active) {
+		err = record_writer__push(w, bf, size);
+		if (err < 0) {
+			pr_err("failed to write perf data, error: %s\n",
+			       strerror(-err));
+			return -1;
+		}
+	} else if (perf_data_file__write(rec->session->file, bf, size) < 0) {
 		pr_err("failed to write perf data, error: %m\n");
 		return -1;
 	}
@@ -315,6 +505,10 @@ static int record__mmap_read_all(struct record *rec)
 	if (perf_header__has_feat(&rec->session->header, HEADER_TRACING_DATA))
 		rc = record__write(rec, &finished_round_event, sizeof(finished_round_event));
 
+	/* Don't let a round sit in the buffer if the writer is idle */
+	if (!rc && rec->writer.active)
+		rc = record_writer__flip(&rec->writer, false);
+
 out:
 	return rc;
 }
@@ -507,6 +701,16 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 		perf_evlist__enable(rec->evlist);
 	}
 
+	/*
+	 * Everything written so far went straight to the file, which
+	 * keeps the synthesized events ordered with the tracing data
+	 * written directly to the pipe.
+	 */
+	if (rec->writer.size && record__writer_start(rec) < 0) {
+		err = -1;
+		goto out_delete_session;
+	}
+
 	for (;;) {
 		int hits = rec->samples;
 
@@ -533,6 +737,11 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 		}
 	}
 
+	if (record__writer_stop(rec) < 0) {
+		err = -1;
+		goto out_delete_session;
+	}
+
 	if (forks && workload_exec_errno) {
 		char msg[512];
 		const char *emsg = strerror_r(workload_exec_errno, msg, sizeof(msg));
@@ -546,6 +755,10 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 
 	fprintf(stderr, "[ perf record: Woken up %ld times to write data ]\n", waking);
 
+	if (rec->writer.stalls)
+		fprintf(stderr, "[ perf record: Waited %lu times for the writer thread ]\n",
+			rec->writer.stalls);
+
 	/*
 	 * Approximate RIP event size: 24 bytes.
 	 */
@@ -558,6 +771,7 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 	return 0;
 
 out_delete_session:
+	record__writer_stop(rec);
 	perf_session__delete(session);
 	return err;
 }
@@ -763,6 +977,30 @@ int record_parse_callchain_opt(const struct option *opt,
 	return ret;
 }
 
+static int record__parse_write_buffer(const struct option *opt,
+				      const char *str,
+				      int unset __maybe_unused)
+{
+	unsigned long *size = opt->value;
+	static struct parse_tag tags[] = {
+		{ .tag  = 'B', .mult = 1       },
+		{ .tag  = 'K', .mult = 1 << 10 },
+		{ .tag  = 'M', .mult = 1 << 20 },
+		{ .tag  = 'G', .mult = 1 << 30 },
+		{ .tag  = 0 },
+	};
+	unsigned long val;
+
+	val = parse_tag_value(str, tags);
+	if (val == (unsigned long) -1 || val < page_size) {
+		pr_err("Invalid argument for --write-buffer\n");
+		return -1;
+	}
+
+	*size = val;
+	return 0;
+}
+
 int record_callchain_opt(const struct option *opt,
 			 const char *arg __maybe_unused,
 			 int unset __maybe_unused)
@@ -894,6 +1132,10 @@ const struct option record_options[] = {
 		    "sample transaction flags (special events only)"),
 	OPT_BOOLEAN(0, "per-thread", &record.opts.target.per_thread,
 		    "use per-thread mmaps"),
+	OPT_CALLBACK(0, "write-buffer", &record.writer.size, "size",
+		     "copy data into two buffers of this size (B/K/M/G), "
+		     "written out by a separate thread",
+		     record__parse_write_buffer),
 	OPT_END()
 };
 
@@ -52,6 +52,7 @@ struct report {
 	bool			header;
 	bool			header_only;
 	int			max_stack;
+	int			symbol_threads;
 	struct perf_read_values	show_threads_values;
 	const char		*pretty_printing_style;
 	const char		*cpu_list;
@@ -66,6 +67,10 @@ static int report__config(const char *var, const char *value, void *cb)
 		symbol_conf.event_group = perf_config_bool(var, value);
 		return 0;
 	}
+	if (!strcmp(var, "report.symbol-cache")) {
+		symbol_conf.symbol_cache = perf_config_bool(var, value);
+		return 0;
+	}
 	if (!strcmp(var, "report.percent-limit")) {
 		struct report *rep = cb;
 		rep->min_percent = strtof(value, NULL);
@@ -543,6 +548,15 @@ static int __cmd_report(struct report *rep)
 	if (ret)
 		return ret;
 
+	if (rep->symbol_threads > 0) {
+		struct machine *host = &session->machines.host;
+
+		ret = dsos__load(&host->user_dsos, MAP__FUNCTION,
+				 host->symbol_filter, rep->symbol_threads);
+		if (ret)
+			return ret;
+	}
+
 	ret = perf_session__process_events(session, &rep->tool);
 	if (ret)
 		return ret;
@@ -827,6 +841,11 @@ int cmd_report(int argc, const char **argv, const char *prefix __maybe_unused)
 	OPT_BOOLEAN(0, "demangle", &symbol_conf.demangle,
 		    "Disable symbol demangling"),
 	OPT_BOOLEAN(0, "mem-mode", &report.mem_mode, "mem access profile"),
+	OPT_BOOLEAN(0, "symbol-cache", &symbol_conf.symbol_cache,
+		    "keep loaded symbols in the buildid cache and reuse them"),
+	OPT_INTEGER(0, "symbol-threads", &report.symbol_threads,
+		    "load the symbols of the dsos in the build-id table with "
+		    "this many threads before processing samples"),
 	OPT_CALLBACK(0, "percent-limit", &report, "percent",
 		     "Don't show entries under that percent", parse_percent_limit),
 	OPT_END()
@@ -10,6 +10,7 @@
 #include "util/header.h"
 #include "util/session.h"
 #include "util/tool.h"
+#include "util/callchain.h"
 
 #include "util/parse-options.h"
 #include "util/trace-event.h"
@@ -67,6 +68,7 @@ struct sched_atom {
 };
 
 #define TASK_STATE_TO_CHAR_STR "RSDTtZX"
+#define TASK_STATE_MAX		1024
 
 enum thread_state {
 	THREAD_SLEEPING = 0,
@@ -97,6 +99,44 @@ struct work_atoms {
 
 typedef int (*sort_fn_t)(struct work_atoms *, struct work_atoms *);
 
+/*
+ * Off-CPU analysis: a resolved callchain, interned so that identical
+ * blocking and waker stacks can be compared by pointer.
+ */
+struct offcpu_frame {
+	struct symbol		*sym;
+	u64			ip;	/* only set when sym is NULL */
+};
+
+struct offcpu_chain {
+	struct rb_node		node;
+	u32			nr;
+	struct offcpu_frame	frames[0];
+};
+
+/* per thread state, hung off thread->priv */
+struct offcpu_thread {
+	u64			sched_out_time;
+	struct offcpu_chain	*block;
+	struct offcpu_chain	*waker;
+	char			waker_comm[COMM_LEN];
+	bool			woken;
+	bool			new_task;
+};
+
+struct offcpu_entry {
+	struct rb_node		node;
+	char			*comm;
+	char			*waker_comm;
+	struct offcpu_chain	*block;
+	struct offcpu_chain	*waker;
+	u64			total;
+	u64			max;
+	u64			max_at;
+	u64			count;
+	bool			new_task;
+};
+
 struct perf_sched;
 
 struct trace_sched_handler {
@@ -109,6 +149,12 @@ struct trace_sched_handler {
 	int (*wakeup_event)(struct perf_sched *sched, struct perf_evsel *evsel,
 			    struct perf_sample *sample, struct machine *machine);
 
+	/* sched_wakeup_new, handled as sched_wakeup when not set */
+	int (*wakeup_new_event)(struct perf_sched *sched,
+				struct perf_evsel *evsel,
+				struct perf_sample *sample,
+				struct machine *machine);
+
 	/* PERF_RECORD_FORK event, not sched_process_fork tracepoint */
 	int (*fork_event)(struct perf_sched *sched, union perf_event *event,
 			  struct machine *machine);
@@ -169,6 +215,16 @@ struct perf_sched {
 	u64		 cpu_last_switched[MAX_CPUS];
 	struct rb_root	 atom_root, sorted_atom_root;
 	struct list_head sort_list, cmp_pid;
+	struct rb_root	 offcpu_chains, offcpu_root, sorted_offcpu_root;
+	int		 offcpu_max_stack;
+	u64		 offcpu_min_time;
+	u64		 offcpu_total;
+	unsigned long	 nr_offcpu_no_callchain;
+	/* 'perf sched offcpu record' */
+	struct offcpu_queued **offcpu_queue;
+	unsigned int	 nr_offcpu_queued, offcpu_queue_size;
+	u64		 offcpu_round_max;
+	unsigned long	 nr_offcpu_unparsed;
 };
 
 static u64 get_nsecs(void)
@@ -1263,6 +1319,20 @@ static int process_sched_wakeup_event(struct perf_tool *tool,
 	return 0;
 }
 
+static int process_sched_wakeup_new_event(struct perf_tool *tool,
+					  struct perf_evsel *evsel,
+					  struct perf_sample *sample,
+					  struct machine *machine)
+{
+	struct perf_sched *sched = container_of(tool, struct perf_sched, tool);
+
+	if (sched->tp_handler->wakeup_new_event)
+		return sched->tp_handler->wakeup_new_event(sched, evsel, sample,
+							   machine);
+
+	return process_sched_wakeup_event(tool, evsel, sample, machine);
+}
+
 static int map_switch_event(struct perf_sched *sched, struct perf_evsel *evsel,
 			    struct perf_sample *sample, struct machine *machine)
 {
@@ -1342,6 +1412,277 @@ static int map_switch_event(struct perf_sched *sched, struct perf_evsel *evsel,
 	return 0;
 }
 
+static int offcpu_chain_cmp(const struct offcpu_frame *frames, u32 nr,
+			    const struct offcpu_chain *chain)
+{
+	if (nr != chain->nr)
+		return nr < chain->nr ? -1 : 1;
+
+	return memcmp(frames, chain->frames, nr * sizeof(*frames));
+}
+
+/*
+ * Resolve the sample's callchain against @thread and return the interned
+ * copy of it, or NULL if the sample carries no callchain.
+ */
+static struct offcpu_chain *offcpu_chain__findnew(struct perf_sched *sched,
+						  struct perf_evsel *evsel,
+						  struct perf_sample *sample,
+						  struct machine *machine,
+						  struct thread *thread)
+{
+	struct offcpu_frame frames[PERF_MAX_STACK_DEPTH];
+	struct rb_node **p = &sched->offcpu_chains.rb_node;
+	struct rb_node *parent = NULL;
+	struct symbol *sym_parent = NULL;
+	struct callchain_cursor_node *node;
+	struct offcpu_chain *chain;
+	u32 nr = 0;
+
+	if (sample->callchain == NULL) {
+		sched->nr_offcpu_no_callchain++;
+		return NULL;
+	}
+
+	if (machine__resolve_callchain(machine, evsel, thread, sample,
+				       &sym_parent, NULL, sched->offcpu_max_stack))
+		return NULL;
+
+	/* zeroed, so that memcmp() does not trip over padding */
+	memset(frames, 0, sizeof(frames));
+
+	callchain_cursor_commit(&callchain_cursor);
+	while ((node = callchain_cursor_current(&callchain_cursor)) != NULL &&
+	       nr < PERF_MAX_STACK_DEPTH) {
+		frames[nr].sym = node->sym;
+		if (node->sym == NULL)
+			frames[nr].ip = node->ip;
+		nr++;
+		callchain_cursor_advance(&callchain_cursor);
+	}
+
+	while (*p != NULL) {
+		int cmp;
+
+		parent = *p;
+		chain = rb_entry(parent, struct offcpu_chain, node);
+
+		cmp = offcpu_chain_cmp(frames, nr, chain);
+		if (cmp == 0)
+			return chain;
+
+		if (cmp < 0)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	chain = zalloc(sizeof(*chain) + nr * sizeof(*frames));
+	if (chain == NULL)
+		return NULL;
+
+	chain->nr = nr;
+	memcpy(chain->frames, frames, nr * sizeof(*frames));
+
+	rb_link_node(&chain->node, parent, p);
+	rb_insert_color(&chain->node, &sched->offcpu_chains);
+	return chain;
+}
+
+static struct offcpu_thread *offcpu_thread(struct thread *thread)
+{
+	if (thread->priv == NULL)
+		thread->priv = zalloc(sizeof(struct offcpu_thread));
+
+	return thread->priv;
+}
+
+static int offcpu_entry_cmp(struct offcpu_entry *l, struct offcpu_entry *r)
+{
+	int cmp = strcmp(l->comm, r->comm);
+
+	if (cmp)
+		return cmp;
+	if (l->new_task != r->new_task)
+		return l->new_task ? -1 : 1;
+	if (l->block != r->block)
+		return l->block < r->block ? -1 : 1;
+	if (l->waker != r->waker)
+		return l->waker < r->waker ? -1 : 1;
+
+	return strcmp(l->waker_comm, r->waker_comm);
+}
+
+static int offcpu_account(struct perf_sched *sched, struct thread *thread,
+			  struct offcpu_thread *ot, u64 timestamp)
+{
+	struct rb_node **p = &sched->offcpu_root.rb_node;
+	struct rb_node *parent = NULL;
+	const char *comm = thread__comm_str(thread);
+	struct offcpu_entry key = {
+		.comm	    = (char *)(comm ? comm : "<unknown>"),
+		.waker_comm = ot->waker_comm,
+		.block	    = ot->block,
+		.waker	    = ot->waker,
+		.new_task   = ot->new_task,
+	}, *entry;
+	u64 delta = timestamp - ot->sched_out_time;
+
+	sched->offcpu_total += delta;
+	if (delta < sched->offcpu_min_time)
+		return 0;
+
+	while (*p != NULL) {
+		int cmp;
+
+		parent = *p;
+		entry = rb_entry(parent, struct offcpu_entry, node);
+
+		cmp = offcpu_entry_cmp(&key, entry);
+		if (cmp == 0)
+			goto found;
+
+		if (cmp < 0)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	entry = zalloc(sizeof(*entry));
+	if (entry == NULL)
+		goto out_enomem;
+
+	*entry = key;
+	/* comm strings are refcounted and go away on exec, keep our own */
+	entry->comm = strdup(key.comm);
+	entry->waker_comm = strdup(key.waker_comm);
+	if (entry->comm == NULL || entry->waker_comm == NULL) {
+		free(entry->comm);
+		free(entry->waker_comm);
+		free(entry);
+		goto out_enomem;
+	}
+
+	rb_link_node(&entry->node, parent, p);
+	rb_insert_color(&entry->node, &sched->offcpu_root);
+found:
+	entry->total += delta;
+	entry->count++;
+	if (delta > entry->max) {
+		entry->max = delta;
+		entry->max_at = timestamp;
+	}
+	return 0;
+
+out_enomem:
+	pr_err("No memory at %s\n", __func__);
+	return -1;
+}
+
+static int offcpu_switch_event(struct perf_sched *sched,
+			       struct perf_evsel *evsel,
+			       struct perf_sample *sample,
+			       struct machine *machine)
+{
+	const u32 prev_pid = perf_evsel__intval(evsel, sample, "prev_pid"),
+		  next_pid = perf_evsel__intval(evsel, sample, "next_pid");
+	const u64 prev_state = perf_evsel__intval(evsel, sample, "prev_state");
+	struct thread *sched_out, *sched_in;
+	struct offcpu_thread *ot;
+
+	sched_in = machine__findnew_thread(machine, 0, next_pid);
+	if (sched_in == NULL || (ot = offcpu_thread(sched_in)) == NULL)
+		return -1;
+
+	if (ot->sched_out_time && next_pid) {
+		if (offcpu_account(sched, sched_in, ot, sample->time))
+			return -1;
+	}
+	memset(ot, 0, sizeof(*ot));
+
+	/*
+	 * Preempted tasks (TASK_RUNNING, possibly with the preempt flag
+	 * the tracepoint adds on top) are waiting for a CPU, not blocked;
+	 * 'perf sched latency' covers those.  The idle task never blocks.
+	 */
+	if (!prev_pid || !(prev_state & (TASK_STATE_MAX - 1)))
+		return 0;
+
+	/* the tracepoint fires in the context of the outgoing task */
+	sched_out = machine__findnew_thread(machine, sample->pid, sample->tid);
+	if (sched_out == NULL || (ot = offcpu_thread(sched_out)) == NULL)
+		return -1;
+
+	ot->sched_out_time = sample->time;
+	ot->block = offcpu_chain__findnew(sched, evsel, sample, machine, sched_out);
+	return 0;
+}
+
+static int offcpu_set_waker(struct perf_sched *sched,
+			    struct perf_evsel *evsel,
+			    struct perf_sample *sample,
+			    struct machine *machine,
+			    struct offcpu_thread *ot)
+{
+	struct thread *waker;
+
+	/* the tracepoint fires in the context of the waker */
+	waker = machine__findnew_thread(machine, sample->pid, sample->tid);
+	if (waker == NULL)
+		return -1;
+
+	ot->woken = true;
+	strncpy(ot->waker_comm, thread__comm_str(waker) ?: "<unknown>",
+		sizeof(ot->waker_comm) - 1);
+	ot->waker = offcpu_chain__findnew(sched, evsel, sample, machine, waker);
+	return 0;
+}
+
+static int offcpu_wakeup_event(struct perf_sched *sched,
+			       struct perf_evsel *evsel,
+			       struct perf_sample *sample,
+			       struct machine *machine)
+{
+	const u32 pid = perf_evsel__intval(evsel, sample, "pid");
+	struct thread *wakee;
+	struct offcpu_thread *ot;
+
+	wakee = machine__findnew_thread(machine, 0, pid);
+	if (wakee == NULL || (ot = offcpu_thread(wakee)) == NULL)
+		return -1;
+
+	/* only the first wakeup after blocking is the interesting one */
+	if (!ot->sched_out_time || ot->woken)
+		return 0;
+
+	return offcpu_set_waker(sched, evsel, sample, machine, ot);
+}
+
+/*
+ * A new task has not blocked yet, account the time until it first runs
+ * as a block of its own, with the stack of the task that forked it as
+ * the waker stack.
+ */
+static int offcpu_wakeup_new_event(struct perf_sched *sched,
+				   struct perf_evsel *evsel,
+				   struct perf_sample *sample,
+				   struct machine *machine)
+{
+	const u32 pid = perf_evsel__intval(evsel, sample, "pid");
+	struct thread *wakee;
+	struct offcpu_thread *ot;
+
+	wakee = machine__findnew_thread(machine, 0, pid);
+	if (wakee == NULL || (ot = offcpu_thread(wakee)) == NULL)
+		return -1;
+
+	memset(ot, 0, sizeof(*ot));
+	ot->sched_out_time = sample->time;
+	ot->new_task = true;
+
+	return offcpu_set_waker(sched, evsel, sample, machine, ot);
+}
+
 static int process_sched_switch_event(struct perf_tool *tool,
 				      struct perf_evsel *evsel,
 				      struct perf_sample *sample,
@@ -1442,7 +1783,7 @@ static int perf_sched__read_events(struct perf_sched *sched,
 		{ "sched:sched_switch",	      process_sched_switch_event, },
 		{ "sched:sched_stat_runtime", process_sched_runtime_event, },
 		{ "sched:sched_wakeup",	      process_sched_wakeup_event, },
-		{ "sched:sched_wakeup_new",   process_sched_wakeup_event, },
+		{ "sched:sched_wakeup_new",   process_sched_wakeup_new_event, },
 		{ "sched:sched_migrate_task", process_sched_migrate_task_event, },
 	};
 	struct perf_session *session;
@@ -1565,6 +1906,411 @@ static int perf_sched__map(struct perf_sched *sched)
 	return 0;
 }
 
+static void perf_sched__sort_offcpu(struct perf_sched *sched)
+{
+	struct rb_node *node;
+
+	while ((node = rb_first(&sched->offcpu_root)) != NULL) {
+		struct rb_node **p = &sched->sorted_offcpu_root.rb_node;
+		struct rb_node *parent = NULL;
+		struct offcpu_entry *entry, *this;
+
+		rb_erase(node, &sched->offcpu_root);
+		entry = rb_entry(node, struct offcpu_entry, node);
+
+		while (*p != NULL) {
+			parent = *p;
+			this = rb_entry(parent, struct offcpu_entry, node);
+
+			if (entry->total > this->total)
+				p = &(*p)->rb_left;
+			else
+				p = &(*p)->rb_right;
+		}
+
+		rb_link_node(&entry->node, parent, p);
+		rb_insert_color(&entry->node, &sched->sorted_offcpu_root);
+	}
+}
+
+static void print_offcpu_chain(struct offcpu_chain *chain)
+{
+	u32 i;
+
+	if (chain == NULL) {
+		printf("                [no callchain]\n");
+		return;
+	}
+
+	for (i = 0; i < chain->nr; i++) {
+		struct offcpu_frame *frame = &chain->frames[i];
+
+		if (frame->sym)
+			printf("                %s\n", frame->sym->name);
+		else
+			printf("                [unknown] %#" PRIx64 "\n", frame->ip);
+	}
+}
+
+static void output_offcpu_entry(struct offcpu_entry *entry)
+{
+	int i, ret;
+
+	ret = printf("  %s ", entry->comm);
+	for (i = 0; i < 24 - ret; i++)
+		printf(" ");
+
+	printf("|%12.3f ms |%9" PRIu64 " | avg:%9.3f ms | max:%9.3f ms | max at: %13.6f s\n",
+	       (double)entry->total / 1e6, entry->count,
+	       (double)entry->total / entry->count / 1e6,
+	       (double)entry->max / 1e6, (double)entry->max_at / 1e9);
+
+	if (entry->new_task) {
+		printf("            new task, waiting for its first run\n");
+	} else {
+		printf("            blocked in:\n");
+		print_offcpu_chain(entry->block);
+	}
+
+	if (entry->waker_comm[0]) {
+		printf("            woken by %s:\n", entry->waker_comm);
+		print_offcpu_chain(entry->waker);
+	} else {
+		printf("            woken by: [no wakeup seen]\n");
+	}
+	printf("\n");
+}
+
+static void perf_sched__print_offcpu(struct perf_sched *sched)
+{
+	struct rb_node *next;
+
+	perf_sched__sort_offcpu(sched);
+
+	printf("\n ---------------------------------------------------------------------------------------------------------------\n");
+	printf("  Task                  |   Off-CPU ms  |  Blocks  |  Average delay  |  Maximum delay  |  Maximum delay at  |\n");
+	printf(" ---------------------------------------------------------------------------------------------------------------\n");
+
+	next = rb_first(&sched->sorted_offcpu_root);
+
+	while (next) {
+		struct offcpu_entry *entry;
+
+		entry = rb_entry(next, struct offcpu_entry, node);
+		output_offcpu_entry(entry);
+		next = rb_next(next);
+	}
+
+	printf(" -----------------------------------------------------------------------------------------\n");
+	printf("  TOTAL:                |%11.3f ms |\n", (double)sched->offcpu_total / 1e6);
+	printf(" ---------------------------------------------------\n");
+
+	if (sched->nr_offcpu_no_callchain) {
+		printf("  INFO: %ld samples without callchains, "
+		       "record with -g or use 'perf sched offcpu record'\n",
+		       sched->nr_offcpu_no_callchain);
+	}
+	print_bad_events(sched);
+	printf("\n");
+}
+
+static int perf_sched__offcpu(struct perf_sched *sched)
+{
+	struct perf_session *session;
+
+	setup_pager();
+
+	/* save session -- interned chains point to its symbols */
+	if (perf_sched__read_events(sched, &session))
+		return -1;
+
+	perf_sched__print_offcpu(sched);
+
+	perf_session__delete(session);
+	return 0;
+}
+
+/*
+ * An event copied out of the ring buffers by 'perf sched offcpu record',
+ * waiting to be processed in timestamp order.
+ */
+struct offcpu_queued {
+	struct perf_sample	sample;
+	struct perf_evsel	*evsel;
+	u64			event[0];
+};
+
+typedef int (*offcpu_handler_t)(struct perf_sched *sched,
+				struct perf_evsel *evsel,
+				struct perf_sample *sample,
+				struct machine *machine);
+
+static volatile int offcpu_done;
+
+static void offcpu_sig_handler(int sig __maybe_unused)
+{
+	offcpu_done = 1;
+}
+
+static int offcpu_tool_process(struct perf_tool *tool __maybe_unused,
+			       union perf_event *event,
+			       struct perf_sample *sample,
+			       struct machine *machine)
+{
+	return machine__process_event(machine, event, sample);
+}
+
+static int offcpu_queued_cmp(const void *a, const void *b)
+{
+	const struct offcpu_queued *l = *(const struct offcpu_queued **)a,
+				   *r = *(const struct offcpu_queued **)b;
+
+	if (l->sample.time == r->sample.time)
+		return 0;
+
+	return l->sample.time < r->sample.time ? -1 : 1;
+}
+
+static int offcpu_queue_event(struct perf_sched *sched,
+			      struct perf_evlist *evlist,
+			      union perf_event *event)
+{
+	struct offcpu_queued *q;
+
+	if (sched->nr_offcpu_queued == sched->offcpu_queue_size) {
+		unsigned int size = sched->offcpu_queue_size * 2 ?: 4096;
+		struct offcpu_queued **queue;
+
+		queue = realloc(sched->offcpu_queue, size * sizeof(*queue));
+		if (queue == NULL)
+			return -ENOMEM;
+
+		sched->offcpu_queue = queue;
+		sched->offcpu_queue_size = size;
+	}
+
+	/* the ring buffer space is reused once consumed, keep a copy */
+	q = malloc(sizeof(*q) + event->header.size);
+	if (q == NULL)
+		return -ENOMEM;
+
+	memcpy(q->event, event, event->header.size);
+	event = (union perf_event *)q->event;
+
+	if (perf_evlist__parse_sample(evlist, event, &q->sample)) {
+		free(q);
+		sched->nr_offcpu_unparsed++;
+		return 0;
+	}
+
+	q->evsel = NULL;
+	if (event->header.type == PERF_RECORD_SAMPLE) {
+		q->evsel = perf_evlist__id2evsel(evlist, q->sample.id);
+		if (q->evsel == NULL || q->sample.raw_data == NULL) {
+			free(q);
+			sched->nr_offcpu_unparsed++;
+			return 0;
+		}
+	} else if (event->header.type == PERF_RECORD_LOST) {
+		sched->nr_lost_events += event->lost.lost;
+		sched->nr_lost_chunks++;
+	}
+
+	if (q->sample.time > sched->offcpu_round_max)
+		sched->offcpu_round_max = q->sample.time;
+
+	sched->nr_events++;
+	sched->offcpu_queue[sched->nr_offcpu_queued++] = q;
+	return 0;
+}
+
+/* Aggregate, in timestamp order, the queued events up to @limit */
+static int offcpu_queue_flush(struct perf_sched *sched,
+			      struct machine *machine, u64 limit)
+{
+	struct offcpu_queued **queue = sched->offcpu_queue;
+	unsigned int i;
+	int err = 0;
+
+	qsort(queue, sched->nr_offcpu_queued, sizeof(*queue),
+	      offcpu_queued_cmp);
+
+	for (i = 0; i < sched->nr_offcpu_queued; i++) {
+		struct offcpu_queued *q = queue[i];
+		union perf_event *event = (union perf_event *)q->event;
+
+		if (q->sample.time > limit)
+			break;
+
+		if (q->evsel) {
+			offcpu_handler_t handler = q->evsel->handler;
+
+			err = handler(sched, q->evsel, &q->sample, machine);
+		} else {
+			err = machine__process_event(machine, event, &q->sample);
+		}
+
+		free(q);
+		if (err) {
+			i++;
+			break;
+		}
+	}
+
+	sched->nr_offcpu_queued -= i;
+	memmove(queue, queue + i, sched->nr_offcpu_queued * sizeof(*queue));
+	return err;
+}
+
+static int offcpu_read_rings(struct perf_sched *sched,
+			     struct perf_evlist *evlist)
+{
+	union perf_event *event;
+	int i, nr = 0;
+
+	for (i = 0; i < evlist->nr_mmaps; i++) {
+		while ((event = perf_evlist__mmap_read(evlist, i)) != NULL) {
+			int err = offcpu_queue_event(sched, evlist, event);
+
+			perf_evlist__mmap_consume(evlist, i);
+			if (err)
+				return err;
+			nr++;
+		}
+	}
+
+	return nr;
+}
+
+/*
+ * Record the scheduler events system wide and aggregate them as they are
+ * read from the ring buffers, nothing is written out: the memory used
+ * grows with the number of distinct blocking/waker stack pairs, not with
+ * the number of events, so this can be left running.
+ *
+ * Each ring is in timestamp order but the rings are not ordered against
+ * each other. An event not read by the end of a pass over the rings was
+ * written after the previous pass, so everything up to the newest
+ * timestamp of the previous pass can be aggregated.
+ */
+static int perf_sched__offcpu_record(struct perf_sched *sched, int argc,
+				     const char **argv)
+{
+	struct record_opts opts = {
+		.target = {
+			.uid	     = UINT_MAX,
+			.uses_mmap   = true,
+			.system_wide = true,
+		},
+		.call_graph	  = CALLCHAIN_FP,
+		.raw_samples	  = true,
+		.mmap_pages	  = 1024,
+		.user_freq	  = UINT_MAX,
+		.user_interval	  = ULLONG_MAX,
+		.default_interval = 1,
+	};
+	struct perf_evlist *evlist = perf_evlist__new();
+	struct machine *machine = NULL;
+	u64 limit = 0;
+	char errbuf[BUFSIZ];
+	int err = -1;
+
+	if (evlist == NULL)
+		return -ENOMEM;
+
+	if (perf_evlist__add_newtp(evlist, "sched", "sched_switch",
+				   offcpu_switch_event) ||
+	    perf_evlist__add_newtp(evlist, "sched", "sched_wakeup",
+				   offcpu_wakeup_event) ||
+	    perf_evlist__add_newtp(evlist, "sched", "sched_wakeup_new",
+				   offcpu_wakeup_new_event)) {
+		perf_evlist__strerror_tp(evlist, errno, errbuf, sizeof(errbuf));
+		pr_err("%s\n", errbuf);
+		goto out_delete_evlist;
+	}
+
+	if (perf_evlist__create_maps(evlist, &opts.target) < 0)
+		goto out_delete_evlist;
+
+	machine = machine__new_host();
+	if (machine == NULL)
+		goto out_delete_evlist;
+
+	if (__machine__synthesize_threads(machine, &sched->tool, &opts.target,
+					  evlist->threads, offcpu_tool_process,
+					  false))
+		goto out_delete_machine;
+
+	perf_evlist__config(evlist, &opts);
+
+	signal(SIGCHLD, offcpu_sig_handler);
+	signal(SIGINT, offcpu_sig_handler);
+
+	if (argc > 0 && perf_evlist__prepare_workload(evlist, &opts.target,
+						      argv, false, NULL) < 0) {
+		pr_err("Couldn't run the workload!\n");
+		goto out_delete_machine;
+	}
+
+	if (perf_evlist__open(evlist) < 0) {
+		perf_evlist__strerror_open(evlist, errno, errbuf, sizeof(errbuf));
+		pr_err("%s\n", errbuf);
+		goto out_delete_machine;
+	}
+
+	if (perf_evlist__mmap(evlist, opts.mmap_pages, false) < 0) {
+		pr_err("Couldn't mmap the events: %s\n", strerror(errno));
+		goto out_delete_machine;
+	}
+
+	perf_evlist__enable(evlist);
+
+	if (argc > 0)
+		perf_evlist__start_workload(evlist);
+
+	while (!offcpu_done) {
+		err = offcpu_read_rings(sched, evlist);
+		if (err < 0)
+			goto out_disable;
+
+		if (err == 0)
+			poll(evlist->pollfd, evlist->nr_fds, 100);
+
+		err = offcpu_queue_flush(sched, machine, limit);
+		if (err)
+			goto out_disable;
+		limit = sched->offcpu_round_max;
+	}
+
+	perf_evlist__disable(evlist);
+
+	err = offcpu_read_rings(sched, evlist);
+	if (err >= 0)
+		err = offcpu_queue_flush(sched, machine, ULLONG_MAX);
+
+	if (!err) {
+		setup_pager();
+		perf_sched__print_offcpu(sched);
+		if (sched->nr_offcpu_unparsed) {
+			printf("  INFO: %ld events could not be parsed\n\n",
+			       sched->nr_offcpu_unparsed);
+		}
+	}
+	goto out_delete_machine;
+
+out_disable:
+	perf_evlist__disable(evlist);
+out_delete_machine:
+	while (sched->nr_offcpu_queued)
+		free(sched->offcpu_queue[--sched->nr_offcpu_queued]);
+	zfree(&sched->offcpu_queue);
+	/* the aggregated chains point to the machine's symbols */
+	machine__delete(machine);
+out_delete_evlist:
+	perf_evlist__delete(evlist);
+	return err;
+}
+
 static int perf_sched__replay(struct perf_sched *sched)
 {
 	unsigned long i;
@@ -1675,7 +2421,9 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		.profile_cpu	      = -1,
 		.next_shortname1      = 'A',
 		.next_shortname2      = '0',
+		.offcpu_max_stack     = PERF_MAX_STACK_DEPTH,
 	};
+	u64 offcpu_min_time = 0;
 	const struct option latency_options[] = {
 	OPT_STRING('s', "sort", &sched.sort_order, "key[,key2...]",
 		   "sort by key(s): runtime, switch, avg, max"),
@@ -1696,6 +2444,19 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		    "dump raw trace in ASCII"),
 	OPT_END()
 	};
+	const struct option offcpu_options[] = {
+	OPT_INTEGER(0, "max-stack", &sched.offcpu_max_stack,
+		    "Set the maximum stack depth when parsing the callchain, "
+		    "anything beyond the specified depth will be ignored. "
+		    "Default: " __stringify(PERF_MAX_STACK_DEPTH)),
+	OPT_U64(0, "min-time", &offcpu_min_time,
+		"only show blocks of at least this many usecs"),
+	OPT_INCR('v', "verbose", &verbose,
+		    "be more verbose (show symbol address, etc)"),
+	OPT_BOOLEAN('D', "dump-raw-trace", &dump_trace,
+		    "dump raw trace in ASCII"),
+	OPT_END()
+	};
 	const struct option sched_options[] = {
 	OPT_STRING('i', "input", &input_name, "file",
 		    "input file name"),
@@ -1713,8 +2474,13 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		"perf sched replay [<options>]",
 		NULL
 	};
+	const char * const offcpu_usage[] = {
+		"perf sched offcpu [<options>]",
+		"perf sched offcpu record [<options>] [<command>]",
+		NULL
+	};
 	const char * const sched_usage[] = {
-		"perf sched [<options>] {record|latency|map|replay|script}",
+		"perf sched [<options>] {record|latency|map|replay|offcpu|script}",
 		NULL
 	};
 	struct trace_sched_handler lat_ops  = {
@@ -1731,6 +2497,11 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 		.switch_event	    = replay_switch_event,
 		.fork_event	    = replay_fork_event,
 	};
+	struct trace_sched_handler offcpu_ops  = {
+		.wakeup_event	    = offcpu_wakeup_event,
+		.wakeup_new_event   = offcpu_wakeup_new_event,
+		.switch_event	    = offcpu_switch_event,
+	};
 	unsigned int i;
 
 	for (i = 0; i < ARRAY_SIZE(sched.curr_pid); i++)
@@ -1771,6 +2542,26 @@ int cmd_sched(int argc, const char **argv, const char *prefix __maybe_unused)
 				usage_with_options(replay_usage, replay_options);
 		}
 		return perf_sched__replay(&sched);
+	} else if (!strncmp(argv[0], "off", 3)) {
+		if (argc > 1 && !strncmp(argv[1], "rec", 3)) {
+			argc = parse_options(argc - 1, argv + 1, offcpu_options,
+					     offcpu_usage,
+					     PARSE_OPT_STOP_AT_NON_OPTION);
+			sched.offcpu_min_time = offcpu_min_time * NSEC_PER_USEC;
+			return perf_sched__offcpu_record(&sched, argc, argv + 1);
+		}
+
+		sched.tp_handler = &offcpu_ops;
+		/* user space stacks need the maps */
+		sched.tool.mmap	 = perf_event__process_mmap;
+		sched.tool.mmap2 = perf_event__process_mmap2;
+		if (argc > 1) {
+			argc = parse_options(argc, argv, offcpu_options, offcpu_usage, 0);
+			if (argc)
+				usage_with_options(offcpu_usage, offcpu_options);
+		}
+		sched.offcpu_min_time = offcpu_min_time * NSEC_PER_USEC;
+		return perf_sched__offcpu(&sched);
 	} else {
 		usage_with_options(sched_usage, sched_options);
 	}
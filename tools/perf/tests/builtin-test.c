@@ -115,6 +115,14 @@ static struct test {
 		.desc = "Test parsing with no sample_id_all bit set",
 		.func = test__parse_no_sample_id_all,
 	},
+	{
+		.desc = "Test dso symbol lookup cache",
+		.func = test__dso_symbol_cache,
+	},
+	{
+		.desc = "Test build-id symbol cache",
+		.func = test__build_id_symbol_cache,
+	},
 	{
 		.func = NULL,
 	},
@@ -0,0 +1,155 @@
+#include "util.h"
+#include "dso.h"
+#include "symbol.h"
+#include "debug.h"
+#include "build-id.h"
+#include "tests.h"
+
+/*
+ * dso__find_symbol() caches its lookups, make sure the cache follows
+ * symbols being added to and removed from the dso.
+ */
+int test__dso_symbol_cache(void)
+{
+	struct symbol *sym, *foo, *bar;
+	struct dso *dso;
+	int i, err = -1;
+
+	dso = dso__new("test-dso");
+	TEST_ASSERT_VAL("failed to create dso", dso);
+
+	foo = symbol__new(0x1000, 0x100, STB_GLOBAL, "foo");
+	if (foo == NULL)
+		goto out;
+	symbols__insert(&dso->symbols[MAP__FUNCTION], foo);
+
+	for (i = 0; i < 2; i++) {
+		sym = dso__find_symbol(dso, MAP__FUNCTION, 0x1050);
+		if (sym != foo) {
+			pr_debug("wrong symbol for 0x1050\n");
+			goto out;
+		}
+
+		sym = dso__find_symbol(dso, MAP__FUNCTION, 0x2050);
+		if (sym != NULL) {
+			pr_debug("unexpected symbol for 0x2050\n");
+			goto out;
+		}
+	}
+
+	/* A cached miss must not survive a new symbol */
+	bar = symbol__new(0x2000, 0x100, STB_GLOBAL, "bar");
+	if (bar == NULL)
+		goto out;
+	symbols__insert(&dso->symbols[MAP__FUNCTION], bar);
+
+	sym = dso__find_symbol(dso, MAP__FUNCTION, 0x2050);
+	if (sym != bar) {
+		pr_debug("stale lookup for 0x2050 after insert\n");
+		goto out;
+	}
+
+	/* Nor a cached hit a symbol that was freed */
+	symbols__delete(&dso->symbols[MAP__FUNCTION]);
+
+	sym = dso__find_symbol(dso, MAP__FUNCTION, 0x1050);
+	if (sym != NULL) {
+		pr_debug("stale lookup for 0x1050 after delete\n");
+		goto out;
+	}
+
+	err = 0;
+out:
+	dso__delete(dso);
+	return err;
+}
+
+/*
+ * Symbols saved in the buildid cache for a build-id must come back the
+ * same for another dso with that build-id.
+ */
+int test__build_id_symbol_cache(void)
+{
+	u8 build_id[BUILD_ID_SIZE] = { 0x12, 0x34, 0x56, 0x78, };
+	char dir[] = "/tmp/perf-test-XXXXXX";
+	char saved_dir[MAXPATHLEN], path[MAXPATHLEN];
+	struct dso *dso, *cached = NULL;
+	struct map *map = NULL;
+	struct symbol *sym;
+	int err = -1;
+
+	if (mkdtemp(dir) == NULL) {
+		pr_debug("failed to create %s\n", dir);
+		return -1;
+	}
+
+	strcpy(saved_dir, buildid_dir);
+	strcpy(buildid_dir, dir);
+
+	dso = dso__new("test-dso");
+	if (dso == NULL)
+		goto out;
+	dso__set_build_id(dso, build_id);
+	dso->adjust_symbols = 1;
+
+	sym = symbol__new(0x1000, 0x100, STB_GLOBAL, "foo");
+	if (sym == NULL)
+		goto out;
+	symbols__insert(&dso->symbols[MAP__FUNCTION], sym);
+
+	sym = symbol__new(0x2000, 0x10, STB_LOCAL, "bar baz");
+	if (sym == NULL)
+		goto out;
+	symbols__insert(&dso->symbols[MAP__FUNCTION], sym);
+
+	if (build_id_cache__save_symbols(dso, MAP__FUNCTION)) {
+		pr_debug("failed to save symbols\n");
+		goto out;
+	}
+
+	cached = dso__new("test-dso-cached");
+	if (cached == NULL)
+		goto out;
+	dso__set_build_id(cached, build_id);
+
+	map = map__new2(0, cached, MAP__FUNCTION);
+	if (map == NULL)
+		goto out;
+
+	if (build_id_cache__load_symbols(cached, map, NULL) != 2) {
+		pr_debug("wrong number of cached symbols\n");
+		goto out;
+	}
+
+	sym = dso__find_symbol(cached, MAP__FUNCTION, 0x200f);
+	if (sym == NULL || strcmp(sym->name, "bar baz") ||
+	    sym->start != 0x2000 || sym->end != 0x200f ||
+	    sym->binding != STB_LOCAL) {
+		pr_debug("wrong cached symbol for 0x200f\n");
+		goto out;
+	}
+
+	if (!cached->adjust_symbols) {
+		pr_debug("adjust_symbols not restored\n");
+		goto out;
+	}
+
+	err = 0;
+out:
+	if (dso && dso__build_id_filename(dso, path, sizeof(path))) {
+		strcat(path, ".symbols");
+		unlink(path);
+		*strrchr(path, '/') = '\0';
+		rmdir(path);
+		*strrchr(path, '/') = '\0';
+		rmdir(path);
+	}
+	rmdir(dir);
+	map__delete(map);
+	if (cached)
+		dso__delete(cached);
+	if (dso)
+		dso__delete(dso);
+	strcpy(buildid_dir, saved_dir);
+	return err;
+}
@@ -40,5 +40,7 @@ int test__code_reading(void);
 int test__sample_parsing(void);
 int test__keep_tracking(void);
 int test__parse_no_sample_id_all(void);
+int test__dso_symbol_cache(void);
+int test__build_id_symbol_cache(void);
 
 #endif /* TESTS_H */
@@ -106,3 +106,152 @@ char *dso__build_id_filename(const struct dso *dso, char *bf, size_t size)
 			 build_id_hex, build_id_hex + 2);
 	return bf;
 }
+
+/*
+ * The symbols of a given build-id never change, so once a dso has been
+ * loaded its symbol table is kept next to the build-id link in the
+ * buildid cache, and later sessions can skip the ELF parsing and
+ * demangling.
+ *
+ * The file starts with a header line recording how the symbols were
+ * obtained, followed by one "start size binding name" line per symbol,
+ * numbers in hex.
+ */
+#define SYMBOL_CACHE_HEADER "# perf symbols v1"
+
+static char *dso__symbol_cache_filename(const struct dso *dso, char *bf,
+					size_t size)
+{
+	size_t len;
+
+	if (dso__build_id_filename(dso, bf, size) == NULL)
+		return NULL;
+
+	len = strlen(bf);
+	if (len + sizeof(".symbols") > size)
+		return NULL;
+
+	strcpy(bf + len, ".symbols");
+	return bf;
+}
+
+int build_id_cache__load_symbols(struct dso *dso, struct map *map,
+				 symbol_filter_t filter)
+{
+	char filename[PATH_MAX];
+	char *line = NULL;
+	size_t n;
+	FILE *file;
+	int symtab_type, adjust_symbols, demangle;
+	int nr_syms = 0;
+
+	if (dso__symbol_cache_filename(dso, filename, sizeof(filename)) == NULL)
+		return -1;
+
+	file = fopen(filename, "r");
+	if (file == NULL)
+		return -1;
+
+	if (fscanf(file, SYMBOL_CACHE_HEADER " %d %d %d\n", &symtab_type,
+		   &adjust_symbols, &demangle) != 3 ||
+	    demangle != symbol_conf.demangle) {
+		fclose(file);
+		return -1;
+	}
+
+	while (!feof(file)) {
+		u64 start, size, binding;
+		struct symbol *sym;
+		int line_len, len;
+
+		line_len = getline(&line, &n, file);
+		if (line_len < 0)
+			break;
+
+		if (line_len > 0 && line[line_len - 1] == '\n')
+			line[--line_len] = '\0';
+
+		len = hex2u64(line, &start);
+
+		len++;
+		if (len + 2 >= line_len)
+			continue;
+
+		len += hex2u64(line + len, &size);
+
+		len++;
+		if (len + 2 >= line_len)
+			continue;
+
+		len += hex2u64(line + len, &binding);
+
+		len++;
+		if (len >= line_len)
+			continue;
+
+		sym = symbol__new(start, size, binding, line + len);
+		if (sym == NULL) {
+			symbols__delete(&dso->symbols[map->type]);
+			nr_syms = -1;
+			break;
+		}
+
+		if (filter && filter(map, sym))
+			symbol__delete(sym);
+		else {
+			symbols__insert(&dso->symbols[map->type], sym);
+			nr_syms++;
+		}
+	}
+
+	free(line);
+	fclose(file);
+
+	if (nr_syms > 0) {
+		dso->symtab_type = symtab_type;
+		dso->adjust_symbols = adjust_symbols;
+	}
+
+	return nr_syms;
+}
+
+int build_id_cache__save_symbols(struct dso *dso, enum map_type type)
+{
+	char filename[PATH_MAX], tmp[PATH_MAX];
+	struct rb_node *nd;
+	char *dir;
+	FILE *file;
+
+	if (dso__symbol_cache_filename(dso, filename, sizeof(filename)) == NULL)
+		return -1;
+
+	/* The .build-id/xx directory only exists once a binary was cached */
+	strcpy(tmp, filename);
+	dir = strrchr(tmp, '/');
+	*dir = '\0';
+	if (mkdir_p(tmp, 0755))
+		return -1;
+
+	/* Write it aside and rename, concurrent sessions may be reading it */
+	scnprintf(tmp, sizeof(tmp), "%s.%d", filename, getpid());
+	file = fopen(tmp, "w");
+	if (file == NULL)
+		return -1;
+
+	fprintf(file, SYMBOL_CACHE_HEADER " %d %d %d\n", dso->symtab_type,
+		dso->adjust_symbols, symbol_conf.demangle);
+
+	for (nd = rb_first(&dso->symbols[type]); nd; nd = rb_next(nd)) {
+		struct symbol *pos = rb_entry(nd, struct symbol, rb_node);
+
+		fprintf(file, "%" PRIx64 " %zx %x %s\n", pos->start,
+			symbol__size(pos), pos->binding, pos->name);
+	}
+
+	if (fclose(file) || rename(tmp, filename)) {
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
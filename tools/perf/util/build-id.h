@@ -5,6 +5,7 @@
 
 #include "tool.h"
 #include "types.h"
+#include "map.h"
 
 extern struct perf_tool build_id__mark_dso_hit_ops;
 struct dso;
@@ -12,6 +13,10 @@ struct dso;
 int build_id__sprintf(const u8 *build_id, int len, char *bf);
 char *dso__build_id_filename(const struct dso *dso, char *bf, size_t size);
 
+int build_id_cache__load_symbols(struct dso *dso, struct map *map,
+				 symbol_filter_t filter);
+int build_id_cache__save_symbols(struct dso *dso, enum map_type type);
+
 int build_id__mark_dso_hit(struct perf_tool *tool, union perf_event *event,
 			   struct perf_sample *sample, struct perf_evsel *evsel,
 			   struct machine *machine);
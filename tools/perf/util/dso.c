@@ -471,8 +471,11 @@ struct dso *dso__new(const char *name)
 		strcpy(dso->name, name);
 		dso__set_long_name(dso, dso->name, false);
 		dso__set_short_name(dso, dso->name, false);
-		for (i = 0; i < MAP__NR_TYPES; ++i)
+		for (i = 0; i < MAP__NR_TYPES; ++i) {
 			dso->symbols[i] = dso->symbol_names[i] = RB_ROOT;
+			/* never matches a zeroed cache entry */
+			dso->symbol_generation[i] = 1;
+		}
 		dso->cache = RB_ROOT;
 		dso->symtab_type = DSO_BINARY_TYPE__NOT_FOUND;
 		dso->binary_type = DSO_BINARY_TYPE__NOT_FOUND;
@@ -493,8 +496,10 @@ struct dso *dso__new(const char *name)
 void dso__delete(struct dso *dso)
 {
 	int i;
-	for (i = 0; i < MAP__NR_TYPES; ++i)
+	for (i = 0; i < MAP__NR_TYPES; ++i) {
 		symbols__delete(&dso->symbols[i]);
+		zfree(&dso->symbol_cache[i]);
+	}
 
 	if (dso->short_name_allocated) {
 		zfree((char **)&dso->short_name);
@@ -72,10 +72,21 @@ struct dso_cache {
 	char data[0];
 };
 
+#define DSO__SYMBOL_CACHE_BITS 6
+
+/* Result of a dso__find_symbol() lookup */
+struct dso_symbol_cache {
+	u64		addr;
+	u64		generation;
+	struct symbol	*symbol;
+};
+
 struct dso {
 	struct list_head node;
 	struct rb_root	 symbols[MAP__NR_TYPES];
 	struct rb_root	 symbol_names[MAP__NR_TYPES];
+	struct dso_symbol_cache *symbol_cache[MAP__NR_TYPES];
+	u64		 symbol_generation[MAP__NR_TYPES];
 	struct rb_root	 cache;
 	void		 *a2l;
 	char		 *symsrc_filename;
@@ -102,9 +113,16 @@ struct dso {
 	char		 name[0];
 };
 
+/* Invalidates the dso__find_symbol() results cached for @type */
+static inline void dso__symbols_changed(struct dso *dso, enum map_type type)
+{
+	dso->symbol_generation[type]++;
+}
+
 static inline void dso__set_loaded(struct dso *dso, enum map_type type)
 {
 	dso->loaded |= (1 << type);
+	dso__symbols_changed(dso, type);
 }
 
 struct dso *dso__new(const char *name);
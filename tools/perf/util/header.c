@@ -349,6 +349,7 @@ int build_id_cache__remove_s(const char *sbuild_id, const char *debugdir)
 	const size_t size = PATH_MAX;
 	char *filename = zalloc(size),
 	     *linkname = zalloc(size);
+	ssize_t len;
 	int err = -1;
 
 	if (filename == NULL || linkname == NULL)
@@ -360,8 +361,14 @@ int build_id_cache__remove_s(const char *sbuild_id, const char *debugdir)
 	if (access(linkname, F_OK))
 		goto out_free;
 
-	if (readlink(linkname, filename, size - 1) < 0)
+	/* Symbols kept by 'perf report --symbol-cache' for this build-id */
+	snprintf(filename, size, "%s.symbols", linkname);
+	unlink(filename);
+
+	len = readlink(linkname, filename, size - 1);
+	if (len < 0)
 		goto out_free;
+	filename[len] = '\0';
 
 	if (unlink(linkname))
 		goto out_free;
@@ -0,0 +1,21 @@
+#ifndef _PERF_ASM_ASSEMBLER_H
+#define _PERF_ASM_ASSEMBLER_H
+
+/*
+ * Just what arch/arm/lib/{memcpy,copy_template,memset,*-neon}.S need,
+ * so that they can be built for perf bench:
+ */
+
+#ifndef __ARMEB__
+#define pull		lsr
+#define push		lsl
+#else
+#define pull		lsl
+#define push		lsr
+#endif
+
+#define PLD(code...)	code
+#define CALGN(code...)
+#define W(instr)	instr
+
+#endif
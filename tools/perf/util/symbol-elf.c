@@ -946,6 +946,7 @@ new_symbol:
 			symbol__delete(f);
 		else {
 			symbols__insert(&curr_dso->symbols[curr_map->type], f);
+			dso__symbols_changed(curr_dso, curr_map->type);
 			nr++;
 		}
 	}
@@ -19,7 +19,9 @@
 #include <elf.h>
 #include <limits.h>
 #include <symbol/kallsyms.h>
+#include <linux/hash.h>
 #include <sys/utsname.h>
+#include <pthread.h>
 
 static int dso__load_kernel_sym(struct dso *dso, struct map *map,
 				symbol_filter_t filter);
@@ -407,7 +409,29 @@ static struct symbol *symbols__find_by_name(struct rb_root *symbols,
 struct symbol *dso__find_symbol(struct dso *dso,
 				enum map_type type, u64 addr)
 {
-	return symbols__find(&dso->symbols[type], addr);
+	struct dso_symbol_cache *cache = dso->symbol_cache[type];
+	struct dso_symbol_cache *entry;
+
+	/*
+	 * Samples keep hitting the same addresses (hot loops, callchain
+	 * return addresses), so remember the result of the rbtree walk.
+	 */
+	if (cache == NULL) {
+		cache = calloc(1 << DSO__SYMBOL_CACHE_BITS, sizeof(*cache));
+		if (cache == NULL)
+			return symbols__find(&dso->symbols[type], addr);
+		dso->symbol_cache[type] = cache;
+	}
+
+	entry = &cache[hash_64(addr, DSO__SYMBOL_CACHE_BITS)];
+	if (entry->generation != dso->symbol_generation[type] ||
+	    entry->addr != addr) {
+		entry->symbol	  = symbols__find(&dso->symbols[type], addr);
+		entry->addr	  = addr;
+		entry->generation = dso->symbol_generation[type];
+	}
+
+	return entry->symbol;
 }
 
 struct symbol *dso__first_symbol(struct dso *dso, enum map_type type)
@@ -609,6 +633,8 @@ static int dso__split_kallsyms_for_kcore(struct dso *dso, struct map *map,
 				symbols__insert(
 					&curr_map->dso->symbols[curr_map->type],
 					pos);
+				dso__symbols_changed(curr_map->dso,
+						     curr_map->type);
 				++moved;
 			} else {
 				++count;
@@ -740,6 +766,7 @@ discard_symbol:		rb_erase(&pos->rb_node, root);
 			if (curr_map != map) {
 				rb_erase(&pos->rb_node, root);
 				symbols__insert(&curr_map->dso->symbols[curr_map->type], pos);
+				dso__symbols_changed(curr_map->dso, curr_map->type);
 				++moved;
 			} else
 				++count;
@@ -1251,7 +1278,19 @@ out_failure:
 	return -1;
 }
 
-int dso__load(struct dso *dso, struct map *map, symbol_filter_t filter)
+/*
+ * Only the function symbols are kept in the buildid cache, and only for
+ * tools that asked for it: the cached table is what the symbol filter
+ * left, so their filters must not drop symbols.
+ */
+static bool dso__use_symbol_cache(struct dso *dso, struct map *map)
+{
+	return symbol_conf.symbol_cache && dso->has_build_id &&
+	       map->type == MAP__FUNCTION;
+}
+
+static int __dso__load(struct dso *dso, struct map *map,
+		       symbol_filter_t filter)
 {
 	char *name;
 	int ret = -1;
@@ -1294,6 +1333,13 @@ int dso__load(struct dso *dso, struct map *map, symbol_filter_t filter)
 		return ret;
 	}
 
+	if (dso__use_symbol_cache(dso, map)) {
+		ret = build_id_cache__load_symbols(dso, map, filter);
+		if (ret > 0)
+			return ret;
+		ret = -1;
+	}
+
 	if (machine)
 		root_dir = machine->root_dir;
 
@@ -1369,6 +1415,9 @@ int dso__load(struct dso *dso, struct map *map, symbol_filter_t filter)
 		nr_plt = dso__synthesize_plt_symbols(dso, runtime_ss, map, filter);
 		if (nr_plt > 0)
 			ret += nr_plt;
+
+		if (dso__use_symbol_cache(dso, map))
+			build_id_cache__save_symbols(dso, map->type);
 	}
 
 	for (; ss_pos > 0; ss_pos--)
@@ -1380,6 +1429,108 @@ out_free:
 	return ret;
 }
 
+int dso__load(struct dso *dso, struct map *map, symbol_filter_t filter)
+{
+	int ret = __dso__load(dso, map, filter);
+
+	dso__symbols_changed(dso, map->type);
+	return ret;
+}
+
+struct dsos_loader {
+	pthread_mutex_t	lock;
+	struct dso	**dsos;
+	int		nr;
+	int		next;
+	enum map_type	type;
+	symbol_filter_t	filter;
+};
+
+static void *dsos_loader__thread(void *arg)
+{
+	struct dsos_loader *loader = arg;
+
+	while (1) {
+		struct dso *dso = NULL;
+		struct map *map;
+
+		pthread_mutex_lock(&loader->lock);
+		if (loader->next < loader->nr)
+			dso = loader->dsos[loader->next++];
+		pthread_mutex_unlock(&loader->lock);
+
+		if (dso == NULL)
+			break;
+
+		map = map__new2(0, dso, loader->type);
+		if (map == NULL)
+			continue;
+
+		if (dso__load(dso, map, loader->filter) < 0)
+			pr_debug("Failed to preload symbols for %s\n",
+				 dso->long_name);
+		map__delete(map);
+	}
+
+	return NULL;
+}
+
+/*
+ * Load the symbols of the user space dsos on @head with @nr_threads
+ * threads, instead of one by one as samples hit them. Each dso is loaded
+ * by one thread only, and dso__load() on a user space dso only touches
+ * that dso, so no further locking is needed. Kernel dsos need the
+ * machine's kernel maps and are left to the lazy loading.
+ */
+int dsos__load(struct list_head *head, enum map_type type,
+	       symbol_filter_t filter, int nr_threads)
+{
+	struct dsos_loader loader = {
+		.type	= type,
+		.filter	= filter,
+	};
+	pthread_t *threads;
+	struct dso *pos;
+	int i, nr_started = 0, err = -1;
+
+	list_for_each_entry(pos, head, node)
+		loader.nr++;
+
+	if (loader.nr == 0)
+		return 0;
+
+	loader.dsos = calloc(loader.nr, sizeof(*loader.dsos));
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (loader.dsos == NULL || threads == NULL)
+		goto out_free;
+
+	loader.nr = 0;
+	list_for_each_entry(pos, head, node) {
+		if (pos->kernel == DSO_TYPE_USER && !dso__loaded(pos, type))
+			loader.dsos[loader.nr++] = pos;
+	}
+
+	pthread_mutex_init(&loader.lock, NULL);
+
+	for (i = 0; i < nr_threads && i < loader.nr; i++) {
+		if (pthread_create(&threads[i], NULL, dsos_loader__thread,
+				   &loader))
+			break;
+		nr_started++;
+	}
+
+	/* Whatever the threads did not get to is loaded lazily */
+	for (i = 0; i < nr_started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&loader.lock);
+	err = 0;
+out_free:
+	free(threads);
+	free(loader.dsos);
+	return err;
+}
+
 struct map *map_groups__find_by_name(struct map_groups *mg,
 				     enum map_type type, const char *name)
 {
@@ -104,7 +104,8 @@ struct symbol_conf {
 			annotate_asm_raw,
 			annotate_src,
 			event_group,
-			demangle;
+			demangle,
+			symbol_cache;
 	const char	*vmlinux_name,
 			*kallsyms_name,
 			*source_prefix,
@@ -211,6 +212,8 @@ bool symsrc__has_symtab(struct symsrc *ss);
 bool symsrc__possibly_runtime(struct symsrc *ss);
 
 int dso__load(struct dso *dso, struct map *map, symbol_filter_t filter);
+int dsos__load(struct list_head *head, enum map_type type,
+	       symbol_filter_t filter, int nr_threads);
 int dso__load_vmlinux(struct dso *dso, struct map *map,
 		      const char *vmlinux, bool vmlinux_allocated,
 		      symbol_filter_t filter);
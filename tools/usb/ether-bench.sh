@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Measure USB Ethernet gadget throughput without hardware: dummy_hcd
+# connects g_ether to the host side of the same machine, the gadget and
+# host interfaces are put into separate network namespaces, and iperf3
+# runs between them in both directions.
+#
+# usage: ether-bench.sh [rndis|ecm] [seconds, default 10]
+#
+# "rndis" selects the RNDIS configuration of g_ether (handled by
+# rndis_host on the host side), "ecm" the CDC Ethernet one (cdc_ether).
+# Needs root, iperf3, and dummy_hcd and g_ether built as modules.
+
+proto=${1:-rndis}
+secs=${2:-10}
+
+cleanup() {
+	[ -n "$server" ] && kill $server 2>/dev/null
+	ip netns del ubench-gadget 2>/dev/null
+	ip netns del ubench-host 2>/dev/null
+	rmmod g_ether dummy_hcd 2>/dev/null
+}
+trap cleanup EXIT
+
+case $proto in
+rndis)	config=2 ;;
+ecm)	config=1 ;;
+*)	echo "unknown protocol $proto" >&2; exit 1 ;;
+esac
+
+modprobe dummy_hcd || exit 1
+modprobe g_ether host_addr=02:00:00:00:00:01 dev_addr=02:00:00:00:00:02 \
+	|| exit 1
+sleep 2
+
+# the host side device hangs off dummy_hcd's root hub
+udev=$(for d in /sys/bus/usb/devices/*-1; do
+	readlink -f "$d" | grep -q /dummy_hcd && echo "$d"; done | head -1)
+if [ -z "$udev" ]; then
+	echo "no device on dummy_hcd" >&2
+	exit 1
+fi
+if [ "$(cat "$udev/bConfigurationValue")" != "$config" ]; then
+	echo "$config" > "$udev/bConfigurationValue" || exit 1
+	sleep 2
+fi
+
+gnet=$(ls /sys/class/net | while read n; do
+	[ "$(cat /sys/class/net/$n/address)" = 02:00:00:00:00:02 ] && echo $n
+done)
+hnet=$(ls /sys/class/net | while read n; do
+	[ "$(cat /sys/class/net/$n/address)" = 02:00:00:00:00:01 ] && echo $n
+done)
+if [ -z "$gnet" ] || [ -z "$hnet" ]; then
+	echo "network interfaces not found" >&2
+	exit 1
+fi
+
+ip netns add ubench-gadget
+ip netns add ubench-host
+ip link set "$gnet" netns ubench-gadget
+ip link set "$hnet" netns ubench-host
+ip -n ubench-gadget addr add 192.168.250.1/24 dev "$gnet"
+ip -n ubench-host addr add 192.168.250.2/24 dev "$hnet"
+ip -n ubench-gadget link set "$gnet" up
+ip -n ubench-host link set "$hnet" up
+sleep 1
+
+ip netns exec ubench-gadget iperf3 -s -1 -D -I /tmp/ether-bench.pid
+sleep 1
+server=$(cat /tmp/ether-bench.pid)
+echo "$proto, host to gadget:"
+ip netns exec ubench-host iperf3 -c 192.168.250.1 -t "$secs" | tail -4
+
+ip netns exec ubench-gadget iperf3 -s -1 -D -I /tmp/ether-bench.pid
+sleep 1
+server=$(cat /tmp/ether-bench.pid)
+echo "$proto, gadget to host:"
+ip netns exec ubench-host iperf3 -c 192.168.250.1 -R -t "$secs" | tail -4
+
+echo "gadget interface:"
+ip -n ubench-gadget -s link show "$gnet"
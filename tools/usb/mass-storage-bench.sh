@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# Measure mass storage gadget throughput without hardware: dummy_hcd
+# connects a configfs mass storage gadget to the host side of the same
+# machine, whose usb-storage driver turns it into a SCSI disk.  The
+# backing file lives on a loop-mounted ext4 image, so the gadget's file
+# I/O goes through a filesystem and a block device as on real hardware.
+# The host side reads and writes the disk with O_DIRECT, once for each
+# number of gadget pipeline buffers given, and with usb-storage's
+# bulk_pipeline parameter both off and on.
+#
+# usage: mass-storage-bench.sh [MiB, default 256] [buffer counts, default "2 8 32"]
+#
+# Needs root, configfs, and dummy_hcd, libcomposite and usb_f_mass_storage
+# built as modules.
+
+mib=${1:-256}
+counts=${2:-"2 8 32"}
+
+img=$(mktemp /var/tmp/msbench.XXXXXX)
+mnt=$(mktemp -d /tmp/msbench.XXXXXX)
+cfg=/sys/kernel/config/usb_gadget/msbench
+
+gadget_down() {
+	[ -d $cfg ] || return
+	echo "" > $cfg/UDC 2>/dev/null
+	rm -f $cfg/configs/c.1/mass_storage.0
+	rmdir $cfg/configs/c.1 $cfg/functions/mass_storage.0 $cfg
+}
+
+cleanup() {
+	gadget_down
+	umount "$mnt" 2>/dev/null
+	rm -f "$img"
+	rmdir "$mnt"
+	rmmod usb_f_mass_storage libcomposite dummy_hcd 2>/dev/null
+}
+trap cleanup EXIT
+
+modprobe dummy_hcd || exit 1
+modprobe libcomposite || exit 1
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+
+truncate -s $((mib + 64))M "$img" || exit 1
+mkfs.ext4 -q -F "$img" || exit 1
+mount -o loop "$img" "$mnt" || exit 1
+dd if=/dev/zero of="$mnt/backing" bs=1M count="$mib" 2>/dev/null || exit 1
+sync
+
+for n in $counts; do
+	mkdir $cfg || exit 1
+	echo 0x1d6b > $cfg/idVendor
+	echo 0x0104 > $cfg/idProduct
+	mkdir $cfg/configs/c.1 $cfg/functions/mass_storage.0 || exit 1
+	echo "$n" > $cfg/functions/mass_storage.0/num_buffers || exit 1
+	echo "$mnt/backing" > $cfg/functions/mass_storage.0/lun.0/file || exit 1
+	ln -s $cfg/functions/mass_storage.0 $cfg/configs/c.1/
+	ls /sys/class/udc | grep dummy_udc | head -1 > $cfg/UDC || exit 1
+	sleep 3
+
+	# the host side device hangs off dummy_hcd's root hub
+	udev=$(for d in /sys/bus/usb/devices/*-1; do
+		readlink -f "$d" | grep -q /dummy_hcd && echo "$d"; done | head -1)
+	blk=$(ls -d "$udev"/*/host*/target*/*/block/* 2>/dev/null | head -1)
+	if [ -z "$blk" ]; then
+		echo "no disk on dummy_hcd" >&2
+		exit 1
+	fi
+	dev=/dev/$(basename "$blk")
+
+	for p in N Y; do
+		echo $p > /sys/module/usb_storage/parameters/bulk_pipeline
+		echo "$n buffers, bulk_pipeline=$p, sequential read:"
+		echo 3 > /proc/sys/vm/drop_caches
+		dd if="$dev" of=/dev/null bs=1M count="$mib" iflag=direct \
+			2>&1 | tail -1
+		echo "$n buffers, bulk_pipeline=$p, sequential write:"
+		dd if=/dev/zero of="$dev" bs=1M count="$mib" oflag=direct \
+			conv=fsync 2>&1 | tail -1
+		echo "$n buffers, bulk_pipeline=$p, 4 KiB writes:"
+		dd if=/dev/zero of="$dev" bs=4k count=$((mib * 64)) \
+			oflag=direct,dsync 2>&1 | tail -1
+	done
+
+	gadget_down
+	sleep 1
+done
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Measure random read IOPS on a virtio-blk disk from inside a guest, for
+# a growing number of fio jobs, with and without the irq_coalesce module
+# parameter, and print one line per run.
+#
+# usage: virtio_blk_bench.sh <disk, e.g. vdb> [max jobs, default nr cpus]
+#
+# The number of virtqueues is chosen by the host, so compare single and
+# multiple queues by booting the guest once with each, e.g. with QEMU's
+# "-device virtio-blk-pci,drive=...,num-queues=N" and an iothread or a
+# vhost backend. The disk is only read. Must be run as root, needs fio.
+
+dev=${1:?usage: $0 <disk> [max jobs]}
+maxjobs=${2:-$(nproc)}
+param=/sys/module/virtio_blk/parameters/irq_coalesce
+
+[ -b /dev/$dev ] || { echo "no such disk: /dev/$dev" >&2; exit 1; }
+queues=$(ls -d /sys/block/$dev/mq/* 2>/dev/null | wc -l)
+old=$(cat $param)
+trap 'echo $old > $param' EXIT
+
+echo "$dev: $queues hardware queue(s)"
+for coalesce in N Y; do
+	echo $coalesce > $param || exit 1
+	jobs=1
+	while [ $jobs -le $maxjobs ]; do
+		# terse format: field 8 is the read IOPS of the group
+		iops=$(fio --name=randread --filename=/dev/$dev --direct=1 \
+			--rw=randread --bs=4k --ioengine=libaio --iodepth=32 \
+			--numjobs=$jobs --group_reporting --runtime=20 \
+			--time_based --minimal | cut -d';' -f8)
+		echo "irq_coalesce=$coalesce jobs=$jobs iops=$iops"
+		jobs=$((jobs * 2))
+	done
+done
@@ -11,6 +11,7 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <time.h>
 #include <linux/vhost.h>
 #include <linux/virtio.h>
 #include <linux/virtio_ring.h>
@@ -86,6 +87,31 @@ void vhost_vq_setup(struct vdev_info *dev, struct vq_info *info)
 	assert(r >= 0);
 }
 
+static void vq_set_busyloop(struct vdev_info *dev, struct vq_info *info,
+			    unsigned int timeout)
+{
+	struct vhost_vring_state state = {
+		.index = info->idx,
+		.num = timeout,
+	};
+	int r;
+	r = ioctl(dev->control, VHOST_SET_VRING_BUSYLOOP_TIMEOUT, &state);
+	assert(r >= 0);
+}
+
+static void vq_print_busyloop(struct vdev_info *dev, struct vq_info *info)
+{
+	struct vhost_vring_busyloop_stats stats = { .index = info->idx };
+	int r;
+	r = ioctl(dev->control, VHOST_GET_VRING_BUSYLOOP_STATS, &stats);
+	assert(r >= 0);
+	fprintf(stderr, "busy polls: %llu, found work: %llu, %.3f ms polling,"
+		" polling for %u us\n",
+		(unsigned long long)stats.polls,
+		(unsigned long long)stats.hits,
+		stats.poll_ns / 1e6, stats.timeout);
+}
+
 static void vq_info_add(struct vdev_info *dev, int num)
 {
 	struct vq_info *info = &dev->vqs[dev->nvqs];
@@ -151,16 +177,19 @@ static void wait_for_interrupt(struct vdev_info *dev)
 }
 
 static void run_test(struct vdev_info *dev, struct vq_info *vq,
-		     bool delayed, int bufs)
+		     bool delayed, int batch, int bufs)
 {
 	struct scatterlist sl;
-	long started = 0, completed = 0;
+	long started = 0, completed = 0, kicked = 0;
 	long completed_before;
 	int r, test = 1;
 	unsigned len;
 	long long spurious = 0;
+	struct timespec start, end;
+	double elapsed;
 	r = ioctl(dev->control, VHOST_TEST_RUN, &test);
 	assert(r >= 0);
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	for (;;) {
 		virtqueue_disable_cb(vq->vq);
 		completed_before = completed;
@@ -170,14 +199,20 @@ static void run_test(struct vdev_info *dev, struct vq_info *vq,
 				r = virtqueue_add_outbuf(vq->vq, &sl, 1,
 							 dev->buf + started,
 							 GFP_ATOMIC);
-				if (likely(r == 0)) {
+				if (likely(r == 0))
 					++started;
-					if (unlikely(!virtqueue_kick(vq->vq))
-						r = -1;
-				}
 			} else
 				r = -1;
 
+			/* Kick once per batch, and whenever we can't add
+			 * more, so that no buffer is left behind. */
+			if (started > kicked &&
+			    (r || started - kicked >= batch)) {
+				kicked = started;
+				if (unlikely(!virtqueue_kick(vq->vq)))
+					r = -1;
+			}
+
 			/* Flush out completed bufs if any */
 			if (virtqueue_get_buf(vq->vq, &len)) {
 				++completed;
@@ -199,10 +234,15 @@ static void run_test(struct vdev_info *dev, struct vq_info *vq,
 				wait_for_interrupt(dev);
 		}
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
 	test = 0;
 	r = ioctl(dev->control, VHOST_TEST_RUN, &test);
 	assert(r >= 0);
 	fprintf(stderr, "spurious wakeus: 0x%llx\n", spurious);
+	elapsed = (end.tv_sec - start.tv_sec) +
+		  (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "%ld buffers in %.3f s: %.3f Mbuf/s\n",
+		completed, elapsed, completed / elapsed / 1e6);
 }
 
 const char optstring[] = "h";
@@ -235,6 +275,16 @@ const struct option longopts[] = {
 		.name = "no-delayed-interrupt",
 		.val = 'd',
 	},
+	{
+		.name = "batch",
+		.has_arg = required_argument,
+		.val = 'b',
+	},
+	{
+		.name = "busyloop",
+		.has_arg = required_argument,
+		.val = 'B',
+	},
 	{
 	}
 };
@@ -245,6 +295,8 @@ static void help(void)
 		" [--no-indirect]"
 		" [--no-event-idx]"
 		" [--delayed-interrupt]"
+		" [--batch=buffers_per_kick]"
+		" [--busyloop=microseconds]"
 		"\n");
 }
 
@@ -255,6 +307,8 @@ int main(int argc, char **argv)
 		(1ULL << VIRTIO_RING_F_EVENT_IDX);
 	int o;
 	bool delayed = false;
+	int batch = 1;
+	long busyloop = 0;
 
 	for (;;) {
 		o = getopt_long(argc, argv, optstring, longopts, NULL);
@@ -276,6 +330,14 @@ int main(int argc, char **argv)
 		case 'D':
 			delayed = true;
 			break;
+		case 'b':
+			batch = strtol(optarg, NULL, 10);
+			assert(batch > 0);
+			break;
+		case 'B':
+			busyloop = strtol(optarg, NULL, 10);
+			assert(busyloop >= 0);
+			break;
 		default:
 			assert(0);
 			break;
@@ -285,6 +347,10 @@ int main(int argc, char **argv)
 done:
 	vdev_info_init(&dev, features);
 	vq_info_add(&dev, 256);
-	run_test(&dev, &dev.vqs[0], delayed, 0x100000);
+	if (busyloop)
+		vq_set_busyloop(&dev, &dev.vqs[0], busyloop);
+	run_test(&dev, &dev.vqs[0], delayed, batch, 0x100000);
+	if (busyloop)
+		vq_print_busyloop(&dev, &dev.vqs[0]);
 	return 0;
 }
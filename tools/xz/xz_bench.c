@@ -0,0 +1,246 @@
+/*
+ * XZ decoder benchmark
+ *
+ * Decodes .xz files with the lib/xz decoder built for userspace and
+ * reports throughput. Multi-call modes feed the decoder through small
+ * fixed buffers the same way lib/xz/xz_dec_test.c does; single-call mode
+ * decodes the whole file into one output buffer like the initramfs and
+ * squashfs users do. The CRC32 of the output is printed so runs can be
+ * compared with "xz -dc file | crc32".
+ *
+ * This file has been put into the public domain.
+ * You can do whatever you want with this file.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xz.h"
+
+/* Maximum supported dictionary size in the multi-call modes */
+#define DICT_MAX (64 << 20)
+
+static const char * const ret_names[] = {
+	[XZ_OK] = "XZ_OK",
+	[XZ_STREAM_END] = "XZ_STREAM_END",
+	[XZ_UNSUPPORTED_CHECK] = "XZ_UNSUPPORTED_CHECK",
+	[XZ_MEM_ERROR] = "XZ_MEM_ERROR",
+	[XZ_MEMLIMIT_ERROR] = "XZ_MEMLIMIT_ERROR",
+	[XZ_FORMAT_ERROR] = "XZ_FORMAT_ERROR",
+	[XZ_OPTIONS_ERROR] = "XZ_OPTIONS_ERROR",
+	[XZ_DATA_ERROR] = "XZ_DATA_ERROR",
+	[XZ_BUF_ERROR] = "XZ_BUF_ERROR",
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m single|prealloc|dynalloc] [-b bufsize] [-n loops] file.xz...\n",
+		prog);
+	exit(1);
+}
+
+static uint8_t *read_file(const char *name, size_t *size)
+{
+	FILE *f = fopen(name, "rb");
+	uint8_t *buf = NULL;
+	size_t alloc = 0;
+	size_t n;
+
+	if (!f) {
+		perror(name);
+		return NULL;
+	}
+
+	*size = 0;
+	do {
+		if (*size == alloc) {
+			alloc = alloc ? alloc * 2 : 1 << 20;
+			buf = realloc(buf, alloc);
+			if (!buf) {
+				fclose(f);
+				return NULL;
+			}
+		}
+		n = fread(buf + *size, 1, alloc - *size, f);
+		*size += n;
+	} while (n > 0);
+
+	fclose(f);
+	return buf;
+}
+
+/*
+ * Multi-call decoding through small buffers, as in xz_dec_test.c. Returns
+ * the uncompressed size and the CRC32 of the output.
+ */
+static enum xz_ret decode_multi(struct xz_dec *s, const uint8_t *in,
+				size_t in_size, size_t bufsize,
+				uint8_t *out, size_t *out_size, uint32_t *crc)
+{
+	struct xz_buf b;
+	enum xz_ret ret;
+
+	xz_dec_reset(s);
+	*crc = 0;
+	*out_size = 0;
+
+	b.in = in;
+	b.in_pos = 0;
+	b.in_size = 0;
+	b.out = out;
+	b.out_size = bufsize;
+
+	do {
+		if (b.in_pos == b.in_size) {
+			b.in += b.in_pos;
+			b.in_pos = 0;
+			b.in_size = in_size - (size_t)(b.in - in);
+			if (b.in_size > bufsize)
+				b.in_size = bufsize;
+		}
+
+		b.out_pos = 0;
+		ret = xz_dec_run(s, &b);
+		*crc = xz_crc32(out, b.out_pos, *crc);
+		*out_size += b.out_pos;
+	} while (ret == XZ_OK || ret == XZ_UNSUPPORTED_CHECK);
+
+	return ret;
+}
+
+static enum xz_ret decode_single(struct xz_dec *s, const uint8_t *in,
+				 size_t in_size, uint8_t *out,
+				 size_t out_max, size_t *out_size,
+				 uint32_t *crc)
+{
+	struct xz_buf b = {
+		.in = in,
+		.in_size = in_size,
+		.out = out,
+		.out_size = out_max,
+	};
+	enum xz_ret ret;
+
+	xz_dec_reset(s);
+	ret = xz_dec_run_parallel(s, &b);
+	*out_size = b.out_pos;
+	*crc = xz_crc32(out, b.out_pos, 0);
+	return ret;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	enum xz_mode mode = XZ_PREALLOC;
+	size_t bufsize = 1024;
+	unsigned int loops = 10;
+	int status = 0;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "m:b:n:")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (!strcmp(optarg, "single"))
+				mode = XZ_SINGLE;
+			else if (!strcmp(optarg, "prealloc"))
+				mode = XZ_PREALLOC;
+			else if (!strcmp(optarg, "dynalloc"))
+				mode = XZ_DYNALLOC;
+			else
+				usage(argv[0]);
+			break;
+		case 'b':
+			bufsize = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind == argc || !bufsize || !loops)
+		usage(argv[0]);
+
+	xz_crc32_init();
+
+	for (i = optind; i < argc; i++) {
+		struct xz_dec *multi, *s;
+		size_t in_size, out_size, size;
+		uint8_t *in, *out;
+		uint32_t crc, c;
+		enum xz_ret ret;
+		unsigned int n;
+		double t;
+
+		in = read_file(argv[i], &in_size);
+		if (!in) {
+			status = 1;
+			continue;
+		}
+
+		/* A first multi-call pass finds the uncompressed size. */
+		multi = xz_dec_init(XZ_DYNALLOC, DICT_MAX);
+		out = malloc(bufsize);
+		ret = decode_multi(multi, in, in_size, bufsize, out,
+				   &out_size, &crc);
+		xz_dec_end(multi);
+		if (ret != XZ_STREAM_END) {
+			fprintf(stderr, "%s: %s\n", argv[i], ret_names[ret]);
+			free(out);
+			free(in);
+			status = 1;
+			continue;
+		}
+
+		if (mode == XZ_SINGLE) {
+			free(out);
+			out = malloc(out_size ? out_size : 1);
+		}
+
+		s = xz_dec_init(mode, DICT_MAX);
+		t = now();
+		for (n = 0; n < loops; n++) {
+			if (mode == XZ_SINGLE)
+				ret = decode_single(s, in, in_size, out,
+						    out_size, &size, &c);
+			else
+				ret = decode_multi(s, in, in_size, bufsize,
+						   out, &size, &c);
+
+			if (ret != XZ_STREAM_END || size != out_size
+					|| c != crc) {
+				fprintf(stderr, "%s: %s, output mismatch\n",
+					argv[i], ret_names[ret]);
+				status = 1;
+				break;
+			}
+		}
+		t = now() - t;
+		xz_dec_end(s);
+
+		if (n == loops)
+			printf("%s: %zu -> %zu bytes, CRC32 0x%08X, "
+			       "%.1f MB/s\n", argv[i], in_size, out_size,
+			       crc, out_size * (double)loops / t / 1e6);
+
+		free(out);
+		free(in);
+	}
+
+	return status;
+}
@@ -0,0 +1,130 @@
+/*
+ * Userspace configuration for building lib/xz in tools/xz
+ *
+ * This provides the few kernel facilities the decoder uses when it is
+ * built outside the kernel, see lib/xz/xz_private.h.
+ */
+
+#ifndef XZ_CONFIG_H
+#define XZ_CONFIG_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xz.h"
+
+#define kmalloc(size, flags) malloc(size)
+#define kfree(ptr) free(ptr)
+#define vmalloc(size) malloc(size)
+#define vfree(ptr) free(ptr)
+
+#define memeq(a, b, size) (memcmp(a, b, size) == 0)
+#define memzero(buf, size) memset(buf, 0, size)
+
+#ifndef min
+#	define min(x, y) ((x) < (y) ? (x) : (y))
+#endif
+#define min_t(type, x, y) min(x, y)
+
+#ifndef __always_inline
+#	define __always_inline inline __attribute__((__always_inline__))
+#endif
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+static inline uint32_t get_unaligned_le32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0]
+			| ((uint32_t)buf[1] << 8)
+			| ((uint32_t)buf[2] << 16)
+			| ((uint32_t)buf[3] << 24);
+}
+
+static inline uint32_t get_unaligned_be32(const uint8_t *buf)
+{
+	return (uint32_t)(buf[0] << 24)
+			| ((uint32_t)buf[1] << 16)
+			| ((uint32_t)buf[2] << 8)
+			| (uint32_t)buf[3];
+}
+
+static inline void put_unaligned_le32(uint32_t val, uint8_t *buf)
+{
+	buf[0] = (uint8_t)val;
+	buf[1] = (uint8_t)(val >> 8);
+	buf[2] = (uint8_t)(val >> 16);
+	buf[3] = (uint8_t)(val >> 24);
+}
+
+static inline void put_unaligned_be32(uint32_t val, uint8_t *buf)
+{
+	buf[0] = (uint8_t)(val >> 24);
+	buf[1] = (uint8_t)(val >> 16);
+	buf[2] = (uint8_t)(val >> 8);
+	buf[3] = (uint8_t)val;
+}
+
+#define get_le32 get_unaligned_le32
+
+#ifdef XZ_DEC_PARALLEL
+/*
+ * Minimal workqueue and atomic_t emulation for the parallel LZMA2 decoder.
+ * Each queued work item simply gets its own thread.
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define num_online_cpus() ((unsigned int)sysconf(_SC_NPROCESSORS_ONLN))
+
+typedef struct {
+	int counter;
+} atomic_t;
+
+#define atomic_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define atomic_set(v, i) __atomic_store_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic_inc_return(v) \
+	__atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+
+struct work_struct {
+	pthread_t thread;
+	bool started;
+	void (*func)(struct work_struct *work);
+};
+
+#define system_unbound_wq NULL
+#define INIT_WORK(w, f) ((w)->func = (f))
+
+static void *xz_work_thread(void *arg)
+{
+	struct work_struct *work = arg;
+
+	work->func(work);
+	return NULL;
+}
+
+static inline bool queue_work(void *wq, struct work_struct *work)
+{
+	work->started = pthread_create(&work->thread, NULL,
+				       xz_work_thread, work) == 0;
+	if (!work->started)
+		work->func(work);
+
+	return true;
+}
+
+static inline bool flush_work(struct work_struct *work)
+{
+	if (work->started)
+		pthread_join(work->thread, NULL);
+
+	return true;
+}
+#endif
+
+#endif